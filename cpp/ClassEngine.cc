@@ -65,7 +65,7 @@ template string str(const unsigned long long &x);
 //---------------
 // Constructors --
 //----------------
-ClassEngine::ClassEngine(const ClassParams& pars, bool verbose): cl(0),dofree(true){
+ClassEngine::ClassEngine(const ClassParams& pars, bool verbose): cl(0),_cancel(0),_status(_SUCCESS_),dofree(true){
 
   //prepare fp structure
   size_t n=pars.size();
@@ -110,7 +110,7 @@ ClassEngine::ClassEngine(const ClassParams& pars, bool verbose): cl(0),dofree(tr
 }
 
 
-ClassEngine::ClassEngine(const ClassParams& pars,const string & precision_file, bool verbose): cl(0),dofree(true){
+ClassEngine::ClassEngine(const ClassParams& pars,const string & precision_file, bool verbose): cl(0),_cancel(0),_status(_SUCCESS_),dofree(true){
 
   struct file_content fc_precision;
   fc_precision.size = 0;
@@ -234,6 +234,9 @@ int ClassEngine::class_main(
     return _FAILURE_;
   }
 
+  //the input module cannot be cancelled (but max_run_time applies to it)
+  ppr->cancel=&_cancel;
+
   if (background_init(ppr,pba) == _FAILURE_) {
     printf("\n\nError running background_init \n=>%s\n",pba->error_message);
     dofree=false;
@@ -336,7 +339,11 @@ int ClassEngine::computeCls(){
   //printFC();
 #endif
 
+  _cancel=0;
   int status=this->class_main(&fc,&pr,&ba,&th,&pt,&tr,&pm,&sp,&nl,&le,&sd,&op,_errmsg);
+  //distinguish runs stopped by their deadline or by cancel()
+  if (status==_FAILURE_ && class_run_aborted(&pr)) status=_ABORTED_;
+  _status=status;
 #ifdef DBUG
   cout <<"status=" << status << endl;
 #endif
@@ -80,6 +80,12 @@ public:
   //modfiers: _FAILURE_ returned if CLASS pb:
   bool updateParValues(const std::vector<double>& par);
 
+  //stop the current computation (can be called from another thread):
+  //updateParValues then returns false, and aborted() true.
+  //A time limit is set with the CLASS parameter max_run_time (in s)
+  inline void cancel() {_cancel=1;}
+  inline bool aborted() const {return _status==_ABORTED_;}
+
 
   //get value at l ( 2<l<lmax): in units = (micro-K)^2
   //don't call if FAILURE returned previously
@@ -156,6 +162,8 @@ private:
 
   ErrorMsg _errmsg;            /* for error messages */
   double * cl;
+  volatile sig_atomic_t _cancel; /* cancellation flag of the current computation (set asynchronously by cancel()) */
+  int _status;                 /* status of the last computation */
 
   //helpers
   bool dofree;
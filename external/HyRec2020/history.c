@@ -922,6 +922,48 @@ char* rec_build_history(HYREC_DATA *data, int model, double *hubble_array){
 }
 
 
+/***********************************************************
+Rate tables shared by all HYREC_DATA structures of the process.
+They are read-only once loaded, so that a resident process can
+load them once with hyrec_load_tables() (e.g. before forking
+workers) instead of reading the files in each hyrec_allocate().
+***********************************************************/
+
+static HYREC_ATOMIC *hyrec_shared_atomic = NULL;
+static FIT_FUNC *hyrec_shared_fit = NULL;
+static char hyrec_shared_path[SIZE_InputFile];
+
+void hyrec_load_tables(char *path_to_hyrec, int *error, char error_message[SIZE_ErrorM]) {
+  HYREC_ATOMIC *atomic;
+  FIT_FUNC *fit;
+
+  if (hyrec_shared_atomic != NULL) return;
+
+  /* zero-initialised, so that the tables allocated before a read error can be freed */
+  atomic = (HYREC_ATOMIC *) calloc(1, sizeof(HYREC_ATOMIC));
+  allocate_and_read_atomic(atomic, error, path_to_hyrec, error_message);
+  if (*error != 0) {
+    if (atomic->logAlpha_tab[0] != NULL) free_atomic(atomic);
+    free(atomic);
+    return;
+  }
+
+  fit = (FIT_FUNC *) calloc(1, sizeof(FIT_FUNC));
+  allocate_and_read_fit(fit, error, path_to_hyrec, error_message);
+  if (*error != 0) {
+    free_fit(fit);
+    free(fit);
+    free_atomic(atomic);
+    free(atomic);
+    return;
+  }
+
+  strncpy(hyrec_shared_path, path_to_hyrec, SIZE_InputFile-1);
+  hyrec_shared_path[SIZE_InputFile-1] = 0;
+  hyrec_shared_fit = fit;
+  hyrec_shared_atomic = atomic;
+}
+
 /***********************************************************
 Function to allocate and initialize HYREC-2 internal tables
 Note that path_to_hyrec in HYREC_DATA should be defined first
@@ -940,11 +982,17 @@ void hyrec_allocate(HYREC_DATA *data, double zmax, double zmin) {
   data->zmax = (zmax > 3000.? zmax : 3000.);
   data->zmin = zmin;
 
-  data->atomic = (HYREC_ATOMIC *) malloc(sizeof(HYREC_ATOMIC));
-  allocate_and_read_atomic(data->atomic, &data->error, data->path_to_hyrec, data->error_message);
+  if (hyrec_shared_atomic != NULL && strcmp(data->path_to_hyrec, hyrec_shared_path) == 0) {
+    data->atomic = hyrec_shared_atomic;
+    data->fit = hyrec_shared_fit;
+  }
+  else {
+    data->atomic = (HYREC_ATOMIC *) malloc(sizeof(HYREC_ATOMIC));
+    allocate_and_read_atomic(data->atomic, &data->error, data->path_to_hyrec, data->error_message);
 
-  data->fit = (FIT_FUNC *) malloc(sizeof(FIT_FUNC));
-  allocate_and_read_fit(data->fit, &data->error, data->path_to_hyrec, data->error_message);
+    data->fit = (FIT_FUNC *) malloc(sizeof(FIT_FUNC));
+    allocate_and_read_fit(data->fit, &data->error, data->path_to_hyrec, data->error_message);
+  }
 
   data->cosmo  = (REC_COSMOPARAMS *) malloc(sizeof(REC_COSMOPARAMS));
   data->cosmo->inj_params = (INJ_PARAMS *)  malloc(sizeof(INJ_PARAMS));
@@ -963,17 +1011,19 @@ void hyrec_allocate(HYREC_DATA *data, double zmax, double zmin) {
 
 
 void hyrec_free(HYREC_DATA *data) {
-  free_atomic(data->atomic);
+  if (data->atomic != hyrec_shared_atomic) {
+    free_atomic(data->atomic);
+    free(data->atomic);
+    free_fit(data->fit);
+    free(data->fit);
+  }
   free(data->cosmo->inj_params);
   free(data->cosmo);
-  free(data->atomic);
   free(data->xe_output);
   free(data->Tm_output);
   free(data->error_message);
   if (MODEL == FULL) free_radiation(data->rad);
   free(data->rad);
-  free_fit(data->fit);
-  free(data->fit);
 }
 
 /******************************************************************
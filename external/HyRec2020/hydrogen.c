@@ -130,6 +130,7 @@ void allocate_and_read_atomic(HYREC_ATOMIC *atomic, int *error, char *path_to_hy
     sprintf(sub_message, "in allocate_and_read_atomic: could not open file %s \n", alpha_file);
     strcat(error_message, sub_message);
     *error = 1;
+    free(alpha_file);
     return;
   }
 
@@ -143,6 +144,9 @@ void allocate_and_read_atomic(HYREC_ATOMIC *atomic, int *error, char *path_to_hy
     sprintf(sub_message, "in allocate_and_read_atomic: could not open file %s \n", rr_file);
     strcat(error_message, sub_message);
     *error = 1;
+    fclose(fA);
+    free(alpha_file);
+    free(rr_file);
     return;
   }
 
@@ -165,6 +169,10 @@ void allocate_and_read_atomic(HYREC_ATOMIC *atomic, int *error, char *path_to_hy
         sprintf(sub_message, "in allocate_and_read_atomic: could not read file %s completely -- The file might be corrupted\n", alpha_file);
         strcat(error_message, sub_message);
         *error = 1;
+        fclose(fA);
+        fclose(fR);
+        free(alpha_file);
+        free(rr_file);
         return;
       }
       atomic->logAlpha_tab[l][j][i] = log(atomic->logAlpha_tab[l][j][i]);
@@ -173,6 +181,10 @@ void allocate_and_read_atomic(HYREC_ATOMIC *atomic, int *error, char *path_to_hy
         sprintf(sub_message, "in allocate_and_read_atomic: could not read file %s completely -- The file might be corrupted\n", rr_file);
         strcat(error_message, sub_message);
         *error = 1;
+        fclose(fA);
+        fclose(fR);
+        free(alpha_file);
+        free(rr_file);
         return;
     }
     atomic->logR2p2s_tab[i] = log(atomic->logR2p2s_tab[i]);
@@ -197,6 +209,9 @@ void allocate_and_read_atomic(HYREC_ATOMIC *atomic, int *error, char *path_to_hy
     sprintf(sub_message, "in allocate_and_read_atomic: could not open file %s \n", twog_file);
     strcat(error_message, sub_message);
     *error = 1;
+    free(alpha_file);
+    free(rr_file);
+    free(twog_file);
     return;
   }
 
@@ -211,6 +226,10 @@ void allocate_and_read_atomic(HYREC_ATOMIC *atomic, int *error, char *path_to_hy
       sprintf(sub_message, "in allocate_and_read_atomic: could not read file %s completely -- The file might be corrupted\n", twog_file);
       strcat(error_message, sub_message);
       *error = 1;
+      fclose(f2g);
+      free(alpha_file);
+      free(rr_file);
+      free(twog_file);
       return;
     }
   }
@@ -283,6 +302,7 @@ void allocate_and_read_fit(FIT_FUNC *fit, int *error, char *path_to_hyrec, char
     sprintf(sub_message, "in allocate_and_read_fit: could not open file %s \n", fit_file);
     strcat(error_message, sub_message);
     *error = 1;
+    free(fit_file);
     return;
   }
   unsigned i, j;
@@ -300,6 +320,8 @@ void allocate_and_read_fit(FIT_FUNC *fit, int *error, char *path_to_hyrec, char
         sprintf(sub_message, "in allocate_and_read_atomic: could not read file %s completely -- The file might be corrupted\n", fit_file);
         strcat(error_message, sub_message);
         *error = 1;
+        fclose(fA);
+        free(fit_file);
         return;
       }
     }
@@ -436,7 +458,7 @@ double rec_swift_hyrec_dxHIIdlna(HYREC_DATA *data, double xe, double xHII, doubl
   double Alpha[2], DAlpha[2], Beta[2], R2p2s, RLya;
   double DK_K_fid=0., DK_K, fitted_RLya;
   double C_2s, C_2p, gamma_2s, gamma_2p, s, Dxe2;
-  static double diff[3];
+  double diff[3];
   unsigned i;
   double ratio;
   char sub_message[128];
@@ -68,6 +68,31 @@ int thermodynamics_hyrec_init(struct precision* ppr, struct background * pba, st
 }
 
 
+/**
+ * Read the HyRec rate tables once for the whole process: the following
+ * calls to thermodynamics_hyrec_init() with the same path share them
+ * instead of reading the files. This is meant for resident processes
+ * (e.g. before forking workers); the tables are never freed.
+ *
+ * @param path_to_hyrec Input: directory of the HyRec tables
+ * @param error_message Output: error message
+ * @return the error status
+ */
+int thermodynamics_hyrec_load_tables(char * path_to_hyrec, ErrorMsg error_message){
+
+  int error = 0;
+  char hyrec_message[SIZE_ErrorM] = "";
+
+  hyrec_load_tables(path_to_hyrec, &error, hyrec_message);
+  if(error != 0){
+    class_call_message(error_message,"hyrec_load_tables",hyrec_message);
+    return _FAILURE_;
+  }
+
+  return _SUCCESS_;
+}
+
+
 /**
  * Free all memory space allocated by thermodynamics_hyrec_init
  *
@@ -40,6 +40,8 @@ extern "C" {
 
   int thermodynamics_hyrec_get_xe(struct thermohyrec * phy, double z, double* x_e, double* dxdlna);
 
+  int thermodynamics_hyrec_load_tables(char * path_to_hyrec, ErrorMsg error_message);
+
   int thermodynamics_hyrec_free(struct thermohyrec* phy);
 
   int hyrec_dx_H_dz(struct thermodynamics* pth, struct thermohyrec* phy, double x_H, double x_He, double xe, double nH, double z, double Hz, double Tmat, double Trad, double alpha, double me, double *dx_H_dz);
@@ -6,9 +6,9 @@ import numpy as np
 
 from classy import Class
 
-from Calc2D.TransferFunction import ComputeTransferFunctionList
+from Calc2D.TransferFunction import ComputeTransferFunctionTable, InterpolateTransferFunctions, TRANSFER_QUANTITIES
 from Calc2D.DataGeneration import GenerateGaussianData, GenerateSIData
-from Calc2D.DataPropagation import PropagateDatawithList
+from Calc2D.DataPropagation import PropagateDataBatch
 from Calc2D.rFourier import *
 from Calc2D.Database import Database
 from collections import namedtuple
@@ -32,6 +32,105 @@ def normalize(real):
     result = real / bound
     return result
 
+def calculate_spectra(cosmo_params, force_recalc=False):
+    """
+    Return the multipoles and temperature Cl's, the wavenumbers in h/Mpc
+    and matter power spectrum in (Mpc/h)^3, and the redshift of
+    recombination.
+    """
+    settings = cosmo_params.copy()
+    settings.update({
+        "output": "tCl,mPk",
+        "evolver": "1",
+        "gauge": "newtonian",
+        "P_k_max_1/Mpc": 10,
+        })
+
+    database = Database(config.DATABASE_DIR, "spectra")
+
+    if settings in database and not force_recalc:
+        data = database[settings]
+        ell = data["ell"]
+        tt = data["tt"]
+        kh = data["kh"]
+        Pkh = data["Pkh"]
+        z_rec = float(data["z_rec"])
+    else:
+        cosmo = Class()
+        cosmo.set(settings)
+        cosmo.compute()
+        # Cl's
+        data = cosmo.raw_cl()
+        ell = data["ell"]
+        tt = data["tt"]
+        # Matter spectrum
+        k = np.logspace(-3, 1, config.MATTER_SPECTRUM_CLIENT_SAMPLES_PER_DECADE * 4)
+        Pk = np.vectorize(cosmo.pk)(k, 0)
+        kh = k * cosmo.h()
+        Pkh = Pk / cosmo.h()**3
+        # Get redshift of decoupling
+        z_rec = cosmo.get_current_derived_parameters(['z_rec'])['z_rec']
+        cosmo.struct_cleanup()
+        # Store to database
+        database[settings] = {
+        "ell": data["ell"],
+        "tt": data["tt"],
+
+        "kh": kh,
+        "Pkh": Pkh,
+
+        "z_rec": z_rec,
+        }
+
+    return ell[2:], tt[2:], kh, Pkh, z_rec
+
+def compute_cosmology(cosmologicalParameters, redshift):
+    """
+    Run classy for the given cosmological parameters, and return the
+    table of transfer functions at each redshift (see
+    `ComputeTransferFunctionTable`) followed by the spectra (see
+    `calculate_spectra`).
+
+    This only takes and returns plain arrays and dictionaries, so that
+    it can run in a worker process.
+    """
+    k_table, transfer_table = ComputeTransferFunctionTable(cosmologicalParameters, redshift)
+    return (k_table, transfer_table) + calculate_spectra(cosmologicalParameters)
+
+def compute_frames(k, FValue, k_table, transfer_table, krange):
+    """
+    Propagate the initial state `FValue` (in Fourier space, on the grid
+    of wavenumbers `k`) to each redshift of `transfer_table`, with one
+    batched inverse rFFT per quantity.
+
+    Return, for each redshift, a tuple of
+     * a dictionary of the normalized real space data of each quantity,
+     * a dictionary of the transfer functions of each quantity at `krange`,
+     * the (minimum, maximum) of the real space data before normalization.
+    Arrays are returned in single precision, as sent to the client.
+
+    This only takes and returns plain arrays and dictionaries, so that
+    it can run in a worker process.
+    """
+    FValuenew = PropagateDataBatch(FValue, InterpolateTransferFunctions(k_table, transfer_table, k))
+    TransferData = InterpolateTransferFunctions(k_table, transfer_table, krange)
+
+    number_of_frames = len(transfer_table[TRANSFER_QUANTITIES[0]])
+    Valuenew = [dict() for _ in range(number_of_frames)]
+    Transfer = [dict() for _ in range(number_of_frames)]
+    for quantity in TRANSFER_QUANTITIES:
+        real = realInverseAllFourier(FValuenew[quantity]).reshape(number_of_frames, -1)
+        minimum, maximum = real.min(axis=1), real.max(axis=1)
+        bound = np.maximum(np.abs(minimum), np.abs(maximum))
+        real = (real / bound[:, np.newaxis]).astype(np.float32)
+        for index in range(number_of_frames):
+            Valuenew[index][quantity] = real[index]
+            Transfer[index][quantity] = TransferData[quantity][index].astype(np.float32)
+
+    # as before, the extrema refer to the last quantity
+    return [(Valuenew[index], Transfer[index], (float(minimum[index]), float(maximum[index])))
+            for index in range(number_of_frames)]
+
 class Calculation(object):
     def __init__(self,
                  kbins,
@@ -61,30 +160,16 @@ class Calculation(object):
         self._resolution = resolution
         self.endshape = (resolution, resolution)
 
-    def getData(self, redshiftindex):
-        FValuenew = PropagateDatawithList(
-            k=self.k,
-            FValue=self.FValue,
-            zredindex=redshiftindex,
-            transferFunctionlist=self.TransferFunctionList)
-
-        Valuenew = dict()
-        FValue_abs = np.abs(self.FValue)
-        _min, _max = FValue_abs.min(), FValue_abs.max()
-        dimensions = (self.endshape[0] / 2, self.endshape[1])
-        for quantity, FT in FValuenew.items():
-            FT_abs = np.abs(FT)
-            FT_normalized = cv2.resize(FT_abs, dimensions).ravel()
-            FT_normalized = (FT_normalized - _min) / (_max - _min)
-            real = realInverseFourier(FT.reshape(self.FValue.shape))
-            # real = cv2.resize(real, self.endshape).ravel()
-            real = real.ravel()
-
-            minimum, maximum = real.min(), real.max()
-            Valuenew[quantity] = normalize(real)
-
-        return Valuenew, FValuenew, (minimum, maximum)
+    def frameArguments(self, redshiftindices):
+        """
+        Arguments of `compute_frames` for the redshifts of index
+        `redshiftindices` in `self.redshift`.
+        """
+        transfer_table = {field: table[redshiftindices] for field, table in self.transferTable.items()}
+        return self.k, self.FValue, self.kTable, transfer_table, self.krange
 
+    def getFrames(self, redshiftindices):
+        return compute_frames(*self.frameArguments(redshiftindices))
 
     def getInitialData(self):
         # for odd values of self._resolution, this is necessary
@@ -101,63 +186,20 @@ class Calculation(object):
             (self.endshape[0] / 2, self.endshape[1])).ravel(), (minimum,
                                                                 maximum)
 
-    def getTransferData(self, redshiftindex):
-        return {field: transfer_function[redshiftindex](self.krange) for field, transfer_function in self.TransferFunctionList.items()}, self.krange
-
     def setCosmologialParameters(self, cosmologicalParameters):
-        self.cosmologicalParameters = cosmologicalParameters
+        self.setCosmologicalData(cosmologicalParameters,
+                                 *compute_cosmology(cosmologicalParameters, self.redshift))
 
-        # Calculate transfer functions
-        self.TransferFunctionList = ComputeTransferFunctionList(self.cosmologicalParameters, self.redshift)
-        # Calculate Cl's
-        self.tCl, self.mPk = self.calculate_spectra(self.cosmologicalParameters)
-
-    def calculate_spectra(self, cosmo_params, force_recalc=False):
-        settings = cosmo_params.copy()
-        settings.update({
-            "output": "tCl,mPk",
-            "evolver": "1",
-            "gauge": "newtonian",
-            "P_k_max_1/Mpc": 10,
-            })
-
-        database = Database(config.DATABASE_DIR, "spectra.dat")
-
-        if settings in database and not force_recalc:
-            data = database[settings]
-            ell = data["ell"]
-            tt = data["tt"]
-            kh = data["kh"]
-            Pkh = data["Pkh"]
-            self.z_rec = data["z_rec"]
-        else:
-            cosmo = Class()
-            cosmo.set(settings)
-            cosmo.compute()
-            # Cl's
-            data = cosmo.raw_cl()
-            ell = data["ell"]
-            tt = data["tt"]
-            # Matter spectrum
-            k = np.logspace(-3, 1, config.MATTER_SPECTRUM_CLIENT_SAMPLES_PER_DECADE * 4)
-            Pk = np.vectorize(cosmo.pk)(k, 0)
-            kh = k * cosmo.h()
-            Pkh = Pk / cosmo.h()**3
-            # Get redshift of decoupling
-            z_rec = cosmo.get_current_derived_parameters(['z_rec'])['z_rec']
-            self.z_rec = z_rec
-            # Store to database
-            database[settings] = {
-            "ell": data["ell"],
-            "tt": data["tt"],
-
-            "kh": k,
-            "Pkh": Pk,
-
-            "z_rec": z_rec,
-            }
-
-        return ClSpectrum(ell[2:], tt[2:]), PkSpectrum(kh, Pkh)
+    def setCosmologicalData(self, cosmologicalParameters, kTable, transferTable, ell, tt, kh, Pkh, z_rec):
+        """
+        Store the result of `compute_cosmology`
+        """
+        self.cosmologicalParameters = cosmologicalParameters
+        self.kTable = kTable
+        self.transferTable = transferTable
+        self.tCl = ClSpectrum(ell, tt)
+        self.mPk = PkSpectrum(kh, Pkh)
+        self.z_rec = z_rec
 
     @property
     def z_dec(self):
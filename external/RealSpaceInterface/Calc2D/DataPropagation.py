@@ -9,6 +9,14 @@ def PropagateDatawithList(k, FValue, zredindex, transferFunctionlist):
         result[field] = (transfer_function[zredindex](k.ravel()) * FValue.ravel()).reshape(FValue.shape)
     return result
 
+#propagates a batch of redshifts at once, given the transfer functions interpolated on the grid k for each of them
+#(see TransferFunction.InterpolateTransferFunctions); returns arrays of shape (number of redshifts,) + FValue.shape
+def PropagateDataBatch(FValue, transferFunctionsOnGrid):
+    result = {}
+    for field, transfer_function in transferFunctionsOnGrid.items():
+        result[field] = transfer_function * FValue[np.newaxis]
+    return result
+
 #module with uses two dimensional interpolation and propagates all data at once (fastest but high memory consumption)
 def PropagateAllData(k,FValue,allzred,transferFunction):
 
@@ -1,58 +1,51 @@
-import pickle
 import os
 import logging
-import uuid
+import hashlib
+import tempfile
+
+import numpy as np
 
 class Database:
-    def __init__(self, directory, db_file="database.dat"):
+    """
+    Store of records of numpy arrays, keyed by dictionaries of parameters
+    (e.g. cosmological parameters and redshifts).
+
+    Each record is a binary `.npz` file named after a hash of its key, so
+    that there is no index to keep in sync: several worker processes can
+    look up and add records at the same time.
+    """
+    def __init__(self, directory, name="database"):
         self.directory = directory
-        self.db_file = db_file
+        self.name = name
 
         if not os.path.isdir(directory):
             raise ValueError("'{}' is not a directory!".format(directory))
 
-        self.db_path = os.path.join(directory, db_file)
-        if not os.path.exists(self.db_path):
-            logging.info("No database found; Creating one at {}.".format(self.db_path))
-            with open(self.db_path, "w") as f:
-                pickle.dump(dict(), f)
-
-        self.db = self.__read_database()
-
-    def __read_database(self):
-        with open(self.db_path) as f:
-            return pickle.load(f)
-
-    def __write_database(self):
-        with open(self.db_path, "w") as f:
-            pickle.dump(self.db, f)
-
-    def __create_file(self, data):
-        filename = str(uuid.uuid4())
-        with open(os.path.join(self.directory, filename), "w") as f:
-            pickle.dump(data, f)
-        return filename
-
-    def __get_frozen_key(self, key):
-        return frozenset(key.items())
+    def __get_path(self, key):
+        frozen_key = repr(sorted((str(k), repr(v)) for k, v in key.items()))
+        digest = hashlib.sha1(frozen_key.encode("utf-8")).hexdigest()
+        return os.path.join(self.directory, "{}_{}.npz".format(self.name, digest))
 
     def __getitem__(self, key):
-        frozen_key = self.__get_frozen_key(key)
-        if frozen_key in self.db:
-            filename = self.db[frozen_key]
-            with open(os.path.join(self.directory, filename)) as f:
-                return pickle.load(f)
-        else:
+        path = self.__get_path(key)
+        if not os.path.exists(path):
             raise KeyError("No data for key: {}".format(key))
+        with np.load(path) as f:
+            return {field: f[field] for field in f.files}
 
     def __setitem__(self, key, data):
-        frozen_key = self.__get_frozen_key(key)
-        self.db[frozen_key] = self.__create_file(data)
-        self.__write_database()
+        path = self.__get_path(key)
+        # Write to a temporary file first, so that concurrent readers
+        # never see a partially written record
+        fd, tmp_path = tempfile.mkstemp(dir=self.directory, suffix=".tmp")
+        with os.fdopen(fd, "wb") as f:
+            np.savez(f, **data)
+        os.rename(tmp_path, path)
+        logging.info("Stored record {}".format(path))
 
     def __contains__(self, key):
         """
         Return whether `self` contains a record
         for the given `key`.
         """
-        return self.__get_frozen_key(key) in self.db
\ No newline at end of file
+        return os.path.exists(self.__get_path(key))
@@ -1,9 +1,5 @@
-import os.path
-import pickle
-import uuid
 import numpy as np
-from scipy.interpolate import InterpolatedUnivariateSpline, RectBivariateSpline
-import sys
+from scipy.interpolate import InterpolatedUnivariateSpline
 import logging
 
 from classy import Class
@@ -14,30 +10,41 @@ import config
 TRANSFER_QUANTITIES = ["d_g", "d_ur", "d_cdm", "d_b", "d_g/4 + psi"]
 
 def ComputeTransferData(settings, redshift):
+    """
+    Return the wavenumbers `k` in h/Mpc and a dictionary mapping each of
+    `TRANSFER_QUANTITIES` to a 2d array of transfer functions, with one
+    row per redshift.
+    """
     database_key = settings.copy()
-    database_key.update({'redshift': tuple(redshift)})
+    database_key.update({'redshift': tuple(float(z) for z in redshift)})
 
-    database = Database.Database(config.DATABASE_DIR)
+    database = Database.Database(config.DATABASE_DIR, "transfer")
     if database_key in database:
-        return database[database_key], redshift
+        data = database[database_key]
     else:
         cosmo = Class()
         cosmo.set(settings)
         cosmo.compute()
 
         outputData = [cosmo.get_transfer(z) for z in redshift]
-        # Calculate d_g/4+psi
-        for transfer_function_dict in outputData:
-            transfer_function_dict["d_g/4 + psi"] = transfer_function_dict["d_g"]/4 + transfer_function_dict["psi"]
-        # Now filter the relevant fields
-        fields = TRANSFER_QUANTITIES + ["k (h/Mpc)"]
-        outputData = [{field: outputData[i][field] for field in fields} for i in range(len(redshift))]
+        data = {field: np.array([transfer["d_g"] / 4 + transfer["psi"] if field == "d_g/4 + psi" else transfer[field]
+                                 for transfer in outputData])
+                for field in TRANSFER_QUANTITIES}
+        data["k"] = outputData[0]["k (h/Mpc)"]
 
-        database[database_key] = outputData
-        return outputData, redshift
+        cosmo.struct_cleanup()
+        database[database_key] = data
 
+    k = data.pop("k")
+    return k, data
 
-def ComputeTransferFunctionList(cosmologicalParameters, redshift, kperdecade=200, P_k_max=100):
+
+def ComputeTransferFunctionTable(cosmologicalParameters, redshift, kperdecade=200, P_k_max=100):
+    """
+    Return the wavenumbers in 1/Mpc, starting with k=0, and a dictionary
+    mapping each of `TRANSFER_QUANTITIES` to a 2d array of transfer
+    functions normalized to 1 at k=0, with one row per redshift.
+    """
     class_settings = cosmologicalParameters.copy()
     class_settings.update({
         "output": "mTk",
@@ -48,17 +55,27 @@ def ComputeTransferFunctionList(cosmologicalParameters, redshift, kperdecade=200
         "z_max_pk": str(max(redshift)),
     })
 
-    data_dict, redshift = ComputeTransferData(class_settings, redshift)
-    transfer_functions = {field: [] for field in TRANSFER_QUANTITIES}
+    k_data, data = ComputeTransferData(class_settings, redshift)
+
+    k_data_zero = np.concatenate(([0.0], k_data * cosmologicalParameters["h"]))  #in order to get k [1/Mpc]
+    transfer_table = {}
+    for field in TRANSFER_QUANTITIES:
+        normalized = data[field] / data[field][:, :1]
+        transfer_table[field] = np.hstack((np.ones((len(redshift), 1)), normalized))
 
+    return k_data_zero, transfer_table
 
-    for i in range(len(redshift)):
-        k_data = data_dict[0]["k (h/Mpc)"] * cosmologicalParameters["h"]  #in order to get k [1/Mpc]
-        k_data_zero = np.concatenate(([0.0], k_data))
-        for field in TRANSFER_QUANTITIES:
-            data = data_dict[i][field] / data_dict[i][field][0]
-            data_zero = np.concatenate(([1.0], data))
-            interpolated_func = InterpolatedUnivariateSpline(k_data_zero, data_zero)
-            transfer_functions[field].append(interpolated_func)
 
-    return transfer_functions
+def InterpolateTransferFunctions(k_table, transfer_table, k):
+    """
+    Interpolate each row of the arrays in `transfer_table` (as returned
+    by `ComputeTransferFunctionTable`) at the wavenumbers `k` (any shape).
+    Return a dictionary of arrays of shape (number of rows,) + k.shape.
+    """
+    # the 2d grids of wavenumbers contain each |k| several times
+    k_unique, k_inverse = np.unique(k, return_inverse=True)
+    result = {}
+    for field, table in transfer_table.items():
+        interpolated = np.array([InterpolatedUnivariateSpline(k_table, row)(k_unique) for row in table])
+        result[field] = interpolated[:, k_inverse.ravel()].reshape((len(table),) + np.shape(k))
+    return result
@@ -10,6 +10,13 @@ DATABASE_DIR = "cache"
 # Maximum number of thread pool workers (only required for multi-user usage)
 MAX_THREADPOOL_WORKERS = 8
 
+# Maximum number of worker processes running classy and propagating the data
+# (shared by all users)
+MAX_PROCESSPOOL_WORKERS = 4
+
+# Number of redshifts propagated together by one worker process
+REDSHIFT_BATCH_SIZE = 16
+
 # Path of colormap directory relative to the static directory from which
 # tornado serves static files
 COLORMAP_PATH = os.path.join("images", "colormaps")
@@ -1,8 +1,8 @@
-from Calc2D.CalculationClass import Calculation
+from Calc2D.CalculationClass import Calculation, compute_cosmology, compute_frames
 
 import time
 import numpy as np
-from concurrent.futures import ThreadPoolExecutor
+from concurrent.futures import ThreadPoolExecutor, ProcessPoolExecutor
 from tornado.ioloop import IOLoop
 from tornado import gen
 import tornado.web
@@ -19,6 +19,9 @@ import sys
 import config
 
 pool = ThreadPoolExecutor(max_workers=config.MAX_THREADPOOL_WORKERS)
+# classy runs and the propagation of the data are done in worker processes,
+# so that they neither block the event loop nor each other
+process_pool = ProcessPoolExecutor(max_workers=config.MAX_PROCESSPOOL_WORKERS)
 
 def generate_redshifts(redshift_config):
     logging.info(redshift_config)
@@ -118,33 +121,47 @@ class DataConnection(tornado.websocket.WebSocketHandler):
         elif param_type == "Cosmo":
             logging.info("Received cosmological parameters")
             cosmological_parameters = params
-            logging.info("Submitting calculation to ThreadPoolExecutor")
-            messages = yield pool.submit(self.set_cosmological_parameters, cosmological_parameters)
-            for message in messages:
-                self.write_message(json.dumps(message))
+            logging.info("Submitting calculation to ProcessPoolExecutor")
+            try:
+                result = yield process_pool.submit(compute_cosmology, cosmological_parameters, self.calc.redshift)
+            except Exception as e:
+                logging.exception(e)
+                self.send_exception(e)
+            else:
+                messages = self.set_cosmological_parameters(cosmological_parameters, result)
+                for message in messages:
+                    self.write_message(json.dumps(message))
         elif param_type == "Start":
             logging.info("Starting propagation...")
             try:
-                for redindex, z in enumerate(self.calc.redshift):
-                    self.send_frame(redindex)
+                # Submit all batches of redshifts at once, and send the
+                # frames in order as soon as their batch is ready
+                indices = list(range(len(self.calc.redshift)))
+                batches = [indices[i:i + config.REDSHIFT_BATCH_SIZE]
+                           for i in range(0, len(indices), config.REDSHIFT_BATCH_SIZE)]
+                futures = [process_pool.submit(compute_frames, *self.calc.frameArguments(batch))
+                           for batch in batches]
+                for batch, future in zip(batches, futures):
+                    frames = yield future
+                    for redindex, frame in zip(batch, frames):
+                        self.send_frame(redindex, frame)
                 self.write_message(json.dumps({'type': 'success', 'sort': 'Data'}))
             except Exception as e:
                 logging.exception(e)
                 self.send_exception(e)
 
-    def send_frame(self, redindex):
-        # `extrema`: (minimum, maximum) of (real space) data
-        Valuenew, FValuenew, extrema = self.calc.getData(redindex)
+    def send_frame(self, redindex, frame):
+        # `frame`: as returned by `compute_frames`, with the data to be displayed
+        # in the real space and transfer function windows, and `extrema`:
+        # (minimum, maximum) of (real space) data
+        Valuenew, TransferData, extrema = frame
         logging.info("Sending data for redshift = {}".format(self.calc.redshift[redindex]))
 
-        # Create data to be displayed in transfer function window
-        TransferData, _ = self.calc.getTransferData(redindex)
-
         self.write_message(json.dumps({'type': 'extrema', 'extrema': extrema}))
         progress = float(redindex) / len(self.calc.redshift)
 
-        real = {quantity: base64.b64encode(data.astype(np.float32)) for quantity, data in Valuenew.iteritems()}
-        transfer = {quantity: base64.b64encode(data.astype(np.float32)) for quantity, data in TransferData.iteritems()}
+        real = {quantity: base64.b64encode(data) for quantity, data in Valuenew.items()}
+        transfer = {quantity: base64.b64encode(data) for quantity, data in TransferData.items()}
         self.write_message(
             json.dumps({
                 'type': 'data',
@@ -191,11 +208,10 @@ class DataConnection(tornado.websocket.WebSocketHandler):
     def send_exception(self, e):
         self.write_message(json.dumps({'type': 'exception', 'exception': traceback.format_exc()}))
 
-    def set_cosmological_parameters(self, cosmologicalParameters):
+    def set_cosmological_parameters(self, cosmologicalParameters, result):
         try:
             messages = []
-            logging.info("Starting calculation...")
-            self.calc.setCosmologialParameters(cosmologicalParameters=cosmologicalParameters)
+            self.calc.setCosmologicalData(cosmologicalParameters, *result)
             logging.info("Finished calculation!")
 
             messages.append({'type': 'success', 'sort': 'Cosmo'})
@@ -158,24 +158,24 @@ with open(os.path.join(dir_path,readfile)) as f:
     x_z = x*lnz_arr/lnz_arr
     DI_T_shift[index_x_new,:] = DI_units*1.0e26*x_z**3.*(np.exp(-x_s)/(1.-np.exp(-x_s))-np.exp(-x_z)/(1.-np.exp(-x_z)))/Greens_drho_Spline(lnz_arr)
 
-    try:
-      # Find position in xarray
-      while(x>Greens_x[index_x_old]):
-        index_x_old += 1
-      # Linear interpolation in x
-      frac = (x-Greens_x[index_x_old])/(Greens_x[index_x_old+1]-Greens_x[index_x_old])
-
-      # Cubic interpolation for all values of z
-      lowx_vals = Greens_G_th_Spline[index_x_old](lnz_arr)
-      highx_vals = Greens_G_th_Spline[index_x_old+1](lnz_arr)
-
-      G_th[index_x_new,:] = (lowx_vals*(1.-frac)+highx_vals*frac)
-      G_th[index_x_new,:] *= bb_vis*1.e-8
-      G_th[index_x_new,:] += DI_T_shift[index_x_new,:]*1.e-8
-      #G_th[index_x_new,:] += Gdist[index_x_new]*df_g
-    except:
+    if(x<Greens_x[0] or x>Greens_x[-1]):
       raise ValueError("{} is not in the file range [{},{}] for file '{}'".format(x,Greens_x[0],Greens_x[-1],readfile))
 
+    # Find the tabulated frequencies bracketing x
+    while(index_x_old<Greens_Nx-2 and x>Greens_x[index_x_old+1]):
+      index_x_old += 1
+    # Linear interpolation in x
+    frac = (x-Greens_x[index_x_old])/(Greens_x[index_x_old+1]-Greens_x[index_x_old])
+
+    # Cubic interpolation for all values of z
+    lowx_vals = Greens_G_th_Spline[index_x_old](lnz_arr)
+    highx_vals = Greens_G_th_Spline[index_x_old+1](lnz_arr)
+
+    G_th[index_x_new,:] = (lowx_vals*(1.-frac)+highx_vals*frac)
+    G_th[index_x_new,:] *= bb_vis*1.e-8
+    G_th[index_x_new,:] += DI_T_shift[index_x_new,:]*1.e-8
+    #G_th[index_x_new,:] += Gdist[index_x_new]*df_g
+
   # Begin orthonormlization
   # Y distortion
   e_Y = Ydist/vector_norm(Ydist)
@@ -226,6 +226,11 @@ with open(os.path.join(dir_path,readfile)) as f:
   eigvecs = eigvecs[:,::-1]
 
   E_vecs = np.real(eigvecs[:,:sd_PCA_size]).T
+  # The sign of eigenvectors is arbitrary (it depends on the LAPACK version):
+  # fix it such that the largest component of each vector is positive, as in CLASS
+  for index_pca in range(sd_PCA_size):
+    if E_vecs[index_pca][np.argmax(np.abs(E_vecs[index_pca]))] < 0.:
+      E_vecs[index_pca] *= -1.
   S_vecs = np.zeros((sd_PCA_size,Nx_arr))
   for index_pca in range(sd_PCA_size):
     for index_x in range(Nx_arr):
@@ -39,6 +39,8 @@ int noninjection_init(struct precision* ppr,
   double h,a,b;
   double temp_injection;
   double z_coarse;
+  double A_wkb;
+  double *kD_coarse, *rate_factor_coarse, *integrals_coarse;
 
   /* z-table */
   pni->z_size = pth->tt_size;
@@ -112,9 +114,13 @@ int noninjection_init(struct precision* ppr,
              pni->error_message,
              pni->error_message);
 
-  class_alloc(pni->integrand_approx,
+  /** - Absorb the primordial spectrum in the weights of the wavenumber integral of the acoustic dissipation */
+  class_alloc(pni->pk_weights,
               pni->k_size*sizeof(double),
               pni->error_message);
+  for (index_k=0; index_k<pni->k_size; index_k++) {
+    pni->pk_weights[index_k] = pni->k_weights[index_k]*pni->k[index_k]*pni->pk_primordial_k[index_k];
+  }
 
   /** - Allocate backgorund and thermodynamcis vectors */
   last_index_back = 0;
@@ -138,6 +144,7 @@ int noninjection_init(struct precision* ppr,
              pni->error_message);
 
   pni->f_nu_wkb = (1.-pvecback[pba->index_bg_rho_g]/(pvecback[pba->index_bg_Omega_r]*pvecback[pba->index_bg_rho_crit]));
+  A_wkb = 1./(1.+4./15.*pni->f_nu_wkb);
 
   /** - Import quantities from other structures */
   /* Background structure */
@@ -151,6 +158,17 @@ int noninjection_init(struct precision* ppr,
   pni->fHe = pth->fHe;                                                                              // [-]
   pni->N_e0 = pth->n_e;                                                                             // [1/m^3]
 
+  /** - Allocate the damping scales and prefactors of the acoustic dissipation at each z */
+  class_alloc(kD_coarse,
+              pni->z_size_coarse*sizeof(double),
+              pni->error_message);
+  class_alloc(rate_factor_coarse,
+              pni->z_size_coarse*sizeof(double),
+              pni->error_message);
+  class_alloc(integrals_coarse,
+              pni->z_size_coarse*sizeof(double),
+              pni->error_message);
+
   /** - Loop over z and calculate the heating at each point */
   dEdt = 0.;
   for(index_z=0; index_z<pni->z_size_coarse; ++index_z){
@@ -201,15 +219,27 @@ int noninjection_init(struct precision* ppr,
                pni->error_message);
     pni->noninjection_table[index_z]+=dEdt;
 
-    /* Second order acoustic dissipation of BAO */
-    class_call(noninjection_rate_acoustic_diss(pni,
-                                               z_coarse,
-                                               &dEdt),
-               pni->error_message,
-               pni->error_message);
-    pni->noninjection_table[index_z]+=dEdt;
+    /* Second order acoustic dissipation of BAO, as in noninjection_rate_acoustic_diss(), with
+       the wavenumber integrals computed below for all z at once */
+    kD_coarse[index_z] = pni->kD;
+    rate_factor_coarse[index_z] = 4.*A_wkb*A_wkb*pni->dkD_dz*pni->H*pni->rho_g/pni->a;
+  }
+
+  class_call(noninjection_acoustic_diss_integrals(pni,
+                                                  kD_coarse,
+                                                  pni->z_size_coarse,
+                                                  integrals_coarse),
+             pni->error_message,
+             pni->error_message);
+
+  for(index_z=0; index_z<pni->z_size_coarse; ++index_z){
+    pni->noninjection_table[index_z] += rate_factor_coarse[index_z]*integrals_coarse[index_z];
   }
 
+  free(kD_coarse);
+  free(rate_factor_coarse);
+  free(integrals_coarse);
+
   /** - Spline coarse z table in view of interpolation */
   class_call(array_spline_table_columns2(pni->z_table_coarse,
                                          pni->z_size_coarse,
@@ -266,7 +296,7 @@ int noninjection_free(struct noninjection* pni){
   free(pni->noninjection_table);
   free(pni->ddnoninjection_table);
 
-  free(pni->integrand_approx);
+  free(pni->pk_weights);
 
   return _SUCCESS_;
 }
@@ -335,7 +365,6 @@ int noninjection_rate_acoustic_diss(struct noninjection * pni,
                                     double * energy_rate){
 
   /** Define local variables */
-  int index_k;
   double dQrho_dz;
   double A_wkb;
 
@@ -347,22 +376,15 @@ int noninjection_rate_acoustic_diss(struct noninjection * pni,
 
     A_wkb = 1./(1.+4./15.*pni->f_nu_wkb);
 
-    /* Define integrand for approximated function */
-    for (index_k=0; index_k<pni->k_size; index_k++) {
-      pni->integrand_approx[index_k] = 4.*A_wkb*A_wkb*pow(pni->k[index_k],1.)*
-                              pni->pk_primordial_k[index_k]*
-                              exp(-2.*pow(pni->k[index_k]/pni->kD,2.))*
-                              pni->dkD_dz;
-    }
-
-    class_call(array_trapezoidal_integral(pni->integrand_approx,
-                                          pni->k_size,
-                                          pni->k_weights,
-                                          &dQrho_dz,
-                                          pni->error_message),
+    class_call(noninjection_acoustic_diss_integrals(pni,
+                                                    &(pni->kD),
+                                                    1,
+                                                    &dQrho_dz),
                pni->error_message,
                pni->error_message);
 
+    dQrho_dz *= 4.*A_wkb*A_wkb*pni->dkD_dz;
+
   }
 
   *energy_rate = dQrho_dz*pni->H*pni->rho_g/pni->a;                                                 // [J/(m^3 s)]
@@ -370,6 +392,79 @@ int noninjection_rate_acoustic_diss(struct noninjection * pni,
   return _SUCCESS_;
 }
 
+/**
+ * Calculate the wavenumber integrals of the approximated acoustic
+ * dissipation rate, int dk k P(k) exp(-2 (k/kD)^2), for several
+ * damping wavenumbers kD at once.
+ *
+ * The damping kernel is tabulated for all (kD, k) pairs, and then
+ * contracted with the weights pk_weights (which include the
+ * primordial spectrum) as a matrix-vector product. Since the
+ * wavenumbers are sorted, each row of the kernel is only evaluated up
+ * to the wavenumber where it becomes negligible.
+ *
+ * @param pni          Input: pointer to noninjection structure
+ * @param kD           Input: damping wavenumbers in 1/Mpc
+ * @param z_size       Input: number of damping wavenumbers (usually, one per redshift)
+ * @param integrals    Output: wavenumber integrals, one per damping wavenumber
+ * @return the error status
+ */
+int noninjection_acoustic_diss_integrals(struct noninjection * pni,
+                                         double * kD,
+                                         int z_size,
+                                         double * integrals){
+
+  /** Define local variables */
+  int index_z, index_k;
+  int * k_size_z;
+  double * kernel;
+  double * kernel_z;
+  double inv_kD2;
+  double integral;
+  /* exp(-2 x^2) is below 1e-300 for x above this bound */
+  double x_max = sqrt(0.5*300.*log(10.));
+
+  class_alloc(kernel,
+              z_size*pni->k_size*sizeof(double),
+              pni->error_message);
+  class_alloc(k_size_z,
+              z_size*sizeof(int),
+              pni->error_message);
+
+  /** - Tabulate the damping kernel exp(-2 (k/kD)^2) */
+  for (index_z=0; index_z<z_size; index_z++) {
+
+    class_test(kD[index_z] <= 0.,
+               pni->error_message,
+               "damping wavenumber kD=%e should be positive",kD[index_z]);
+
+    for (k_size_z[index_z]=0;
+         k_size_z[index_z]<pni->k_size && pni->k[k_size_z[index_z]] < x_max*kD[index_z];
+         k_size_z[index_z]++);
+
+    kernel_z = kernel + index_z*pni->k_size;
+    inv_kD2 = 1./kD[index_z]/kD[index_z];
+    for (index_k=0; index_k<k_size_z[index_z]; index_k++) {
+      kernel_z[index_k] = exp(-2.*pni->k[index_k]*pni->k[index_k]*inv_kD2);
+    }
+  }
+
+  /** - Contract the kernel with the weighted primordial spectrum */
+  for (index_z=0; index_z<z_size; index_z++) {
+    kernel_z = kernel + index_z*pni->k_size;
+    integral = 0.;
+    for (index_k=0; index_k<k_size_z[index_z]; index_k++) {
+      integral += kernel_z[index_k]*pni->pk_weights[index_k];
+    }
+    integrals[index_z] = integral;
+  }
+
+  free(kernel);
+  free(k_size_z);
+
+  return _SUCCESS_;
+}
+
 /**
  * Outputs
  */
@@ -17,7 +17,8 @@ struct noninjection{
   double* pk_primordial_k;
 
   /* Array related to WKB approximation for diss. of acc. waves */
-  double* integrand_approx;
+  double* pk_weights;  /* integration weights times k times primordial spectrum, such that the
+                          k-integral at any z is the sum of pk_weights times the damping kernel */
 
   /* Arrays related to redshift */
   double* z_table_coarse;
@@ -105,6 +106,11 @@ extern "C" {
                                       double z,
                                       double * energy_rate);
 
+  int noninjection_acoustic_diss_integrals(struct noninjection * pni,
+                                           double * kD,
+                                           int z_size,
+                                           double * integrals);
+
   int noninjection_output_titles(struct noninjection * pni,
                                  char titles[_MAXTITLESTRINGLENGTH_]);
 
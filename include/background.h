@@ -513,11 +513,22 @@ extern "C" {
                                char titles[_MAXTITLESTRINGLENGTH_]
                                );
 
+  int background_output_derived_data(
+                                     struct background *pba,
+                                     int index_tau,
+                                     double *dataptr,
+                                     int *storeidx);
+
   int background_output_data(
                              struct background *pba,
                              int number_of_titles,
                              double *data);
 
+  int background_output_columns(
+                                struct background *pba,
+                                int number_of_titles,
+                                int *index_column);
+
   int background_derivs(
                         double loga,
                         double * y,
@@ -0,0 +1,64 @@
+/**
+ * definitions for module background_derivatives.c
+ */
+
+#ifndef __BACKGROUND_DERIVATIVES__
+#define __BACKGROUND_DERIVATIVES__
+
+#include "background.h"
+
+/**
+ * Cosmological parameters with respect to which background quantities
+ * are differentiated. Omega_Lambda is adjusted to close the budget
+ * equation, all other parameters being fixed.
+ */
+
+enum background_derivatives_parameter {
+  bgd_h,         /**< reduced Hubble parameter */
+  bgd_omega_b,   /**< physical baryon density */
+  bgd_omega_cdm, /**< physical cdm density */
+  bgd_N_ur,      /**< effective number of ultra-relativistic species */
+  bgd_Omega_k    /**< curvature density fraction */
+};
+
+#define _BGD_PARAMETERS_SIZE_ 5 /**< number of parameters in enum background_derivatives_parameter */
+
+/**
+ * Background quantities that can be differentiated, in the same units
+ * as in the background table
+ */
+
+enum background_derivatives_quantity {
+  bgd_H,             /**< Hubble rate in 1/Mpc */
+  bgd_time,          /**< proper time in Mpc */
+  bgd_conf_distance, /**< conformal distance in Mpc */
+  bgd_ang_distance,  /**< angular diameter distance in Mpc */
+  bgd_lum_distance,  /**< luminosity distance in Mpc */
+  bgd_rs,            /**< comoving sound horizon in Mpc */
+  bgd_theta          /**< angle subtended by the sound horizon, rs over comoving angular distance */
+};
+
+#define _BGD_QUANTITIES_SIZE_ 7 /**< number of quantities in enum background_derivatives_quantity */
+
+#define _BGD_CONSISTENCY_ 1.e-5 /**< largest relative difference allowed between the quantities and those of the background table */
+
+/**
+ * Boilerplate for C++
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  int background_derivatives_at_z(
+                                  struct background * pba,
+                                  double * z,
+                                  int z_size,
+                                  double * values,
+                                  double * derivatives
+                                  );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
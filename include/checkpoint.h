@@ -0,0 +1,78 @@
+/**
+ * definitions for module checkpoint.c
+ */
+
+#ifndef __CHECKPOINT__
+#define __CHECKPOINT__
+
+#include "common.h"
+
+/**
+ * File to which the results of independent pieces of a long
+ * computation (e.g. one wavenumber) are appended as soon as they are
+ * completed, so that a restarted run can recover them.
+ *
+ * Each record contains a fixed number of integers (identifying the
+ * piece of computation) followed by a fixed number of doubles (the
+ * results). The file starts with a header containing a hash of all
+ * input parameters and a list of integers describing the array
+ * sizes: a file with a different header is discarded.
+ */
+
+struct checkpoint {
+
+  FILE * file;        /**< checkpoint file, open for reading and writing */
+  int record_ints;    /**< number of integers in each record */
+  int record_doubles; /**< number of doubles in each record */
+  void * lock;        /**< mutex serializing writes from parallel tasks */
+
+};
+
+/**
+ * Boilerplate for C++
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  unsigned long long checkpoint_hash(
+                                     unsigned long long hash,
+                                     const char * string
+                                     );
+
+  int checkpoint_open(
+                      char * filename,
+                      unsigned long long hash,
+                      int * header,
+                      int header_size,
+                      int record_ints,
+                      int record_doubles,
+                      struct checkpoint * pch,
+                      ErrorMsg error_message
+                      );
+
+  int checkpoint_read(
+                      struct checkpoint * pch,
+                      int * ints,
+                      double * doubles,
+                      int * has_record,
+                      ErrorMsg error_message
+                      );
+
+  int checkpoint_write(
+                       struct checkpoint * pch,
+                       int * ints,
+                       double * doubles,
+                       ErrorMsg error_message
+                       );
+
+  int checkpoint_close(
+                       struct checkpoint * pch,
+                       ErrorMsg error_message
+                       );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
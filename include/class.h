@@ -22,6 +22,7 @@
 #include "common.h"
 #include "input.h"
 #include "background.h"
+#include "background_derivatives.h"
 #include "thermodynamics.h"
 #include "perturbations.h"
 #include "primordial.h"
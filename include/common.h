@@ -7,11 +7,16 @@
 #include "float.h"
 #include "svnversion.h"
 #include <stdarg.h>
+#include <signal.h>
 
 #ifdef _OPENMP
 #include "omp.h"
 #endif
 
+#ifdef WITH_MPI
+#include "mpi.h"
+#endif
+
 #ifndef __COMMON__
 #define __COMMON__
 
@@ -24,6 +29,7 @@
 
 #define _SUCCESS_ 0 /**< integer returned after successful call of a function */
 #define _FAILURE_ 1 /**< integer returned after failure in a function */
+#define _ABORTED_ 2 /**< exit status of a run stopped by its deadline or by a cancellation (the functions of the modules still return _FAILURE_) */
 
 #define _ERRORMSGSIZE_ 2048 /**< generic error messages are cut beyond this number of characters */
 typedef char ErrorMsg[_ERRORMSGSIZE_]; /**< Generic error messages (there is such a field in each structure) */
@@ -94,6 +100,21 @@ extern "C" {
     int compare_doubles(const void * a,
                         const void * b);
     int string_begins_with(char* thestring, char beginchar);
+
+    /* distribution of loops over MPI processes (trivial without MPI) */
+    int class_mpi_rank_and_size(int * rank, int * size);
+    int class_mpi_sum(double ** arrays, size_t * sizes, int number_of_arrays, ErrorMsg error_message);
+    int class_mpi_check_status(int status, ErrorMsg error_message);
+
+    /* deadline and cancellation of a run */
+    struct precision;
+    double class_wall_time(void);
+    int class_run_aborted(struct precision * ppr);
+    int class_check_deadline(struct precision * ppr, ErrorMsg error_message);
+
+    /* number of threads of the parallel loops started by the calling thread */
+    void class_set_num_threads(int number_of_threads);
+    int class_get_num_threads(void);
 #ifdef __cplusplus
 }
 #endif
@@ -330,6 +351,14 @@ extern "C" {
       storage[dataindex++] = value;                                     \
   }
 
+#define class_store_int(storage,                                        \
+                        value,                                          \
+                        condition,                                      \
+                        dataindex){                                     \
+    if (condition == _TRUE_)                                            \
+      storage[dataindex++] = value;                                     \
+  }
+
 #define class_store_double_or_default(storage,                          \
                                       value,                            \
                                       condition,                        \
@@ -354,6 +383,7 @@ printf("-> %-30s Omega = %-15g , omega = %-15g\n",name,pba->Omega0_##type,pba->O
     double, double *, int, \
     int (*)(double, double *, double *, int, void *, ErrorMsg), \
     int (*)(double, double *, double *, void *, ErrorMsg), \
+    struct precision *, \
     ErrorMsg
 
 /* Forward-Declare the structs of CLASS */
@@ -422,6 +452,17 @@ struct precision
 
   //@}
 
+  /** @name - deadline and cancellation of the run */
+
+  //@{
+
+  double deadline;       /**< wall-clock time (as returned by class_wall_time()) after which the run is aborted, or 0 for no deadline; set from the input parameter max_run_time */
+  volatile sig_atomic_t * cancel; /**< if not NULL, the run is aborted as soon as this flag becomes non-zero (it can be raised from another thread) */
+  short aborted;         /**< set by class_check_deadline() when it stops the run, such that a later error is not mistaken for an abort */
+  struct precision * main_run; /**< for the preliminary runs of a run (shooting, refresh of a correction file), precision structure of the latter, marked as aborted with them */
+
+  //@}
+
   /** @name - zone for writing error messages */
 
   //@{
@@ -0,0 +1,126 @@
+/**
+ * definitions for module correction.c
+ */
+
+#ifndef __CORRECTION__
+#define __CORRECTION__
+
+#include "common.h"
+
+#define _CORRECTION_MAGIC_ "CLASSCOR" /**< first bytes of any correction file */
+
+/**
+ * Modes of the multi-fidelity correction
+ */
+
+enum correction_mode {
+  correction_none,      /**< no correction */
+  correction_reference, /**< store the spectra of this run (fiducial model, reference precision) */
+  correction_fast,      /**< store the spectra of this run (fiducial model, fast precision) */
+  correction_apply      /**< correct the spectra of this run by the stored reference/fast ratio */
+};
+
+/**
+ * Modules storing their spectra in a correction file. Each module has
+ * a reference and a fast slot in the file, in this order.
+ */
+
+enum correction_module {
+  correction_fourier,  /**< linear P(k) at z=0 */
+  correction_harmonic, /**< unlensed C_l's */
+  correction_modules   /**< number of modules */
+};
+
+/**
+ * Copy size bytes from pointer to position in a slot, and move
+ * position after them.
+ */
+
+#define class_correction_pack(position,pointer,size) {  \
+    memcpy(position,pointer,size);                      \
+    position += (size);                                 \
+  }
+
+/**
+ * Point to number values of a given type at position in a slot ending
+ * at end, and move position after them.
+ */
+
+#define class_correction_unpack(position,end,pointer,type,number,filename,error_message) { \
+    class_test((number) < 0 || (position)+(number)*sizeof(type) > (end),    \
+               error_message,                                           \
+               "corrupted correction file %s",filename);                \
+    pointer = (type *)(position);                                       \
+    position += (number)*sizeof(type);                                  \
+  }
+
+/**
+ * Boilerplate for C++
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  int correction_fetch(
+                       char * filename,
+                       enum correction_module module,
+                       char ** slot,
+                       size_t * slot_size,
+                       ErrorMsg error_message
+                       );
+
+  int correction_store(
+                       char * filename,
+                       enum correction_module module,
+                       enum correction_mode mode,
+                       char * slot,
+                       size_t slot_size,
+                       ErrorMsg error_message
+                       );
+
+  int correction_pack_parameters(
+                                 char * parameters,
+                                 char ** position
+                                 );
+
+  int correction_unpack_parameters(
+                                   char ** position,
+                                   char * end,
+                                   char ** parameters,
+                                   int * parameters_size,
+                                   char * filename,
+                                   ErrorMsg error_message
+                                   );
+
+  int correction_check(
+                       char ** slot,
+                       size_t * slot_size,
+                       char * parameters,
+                       double max_drift,
+                       char * filename,
+                       double * drift,
+                       short * is_usable,
+                       ErrorMsg error_message
+                       );
+
+  int correction_drift(
+                       char * text1,
+                       int size1,
+                       char * text2,
+                       int size2,
+                       double * drift
+                       );
+
+  int correction_interpolate(
+                             double * x,
+                             double * y,
+                             int size,
+                             double x0,
+                             double * y0
+                             );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -92,7 +92,6 @@ struct distortions
 
   /* File names for the PCA */
   char sd_detector_noise_file[2*_FILENAMESIZE_+_MAX_DETECTOR_NAME_LENGTH_+256];              /**< Full path of detector noise file */
-  DetectorFileName sd_PCA_file_generator;               /**< Full path of PCA generator file */
   DetectorFileName sd_detector_list_file;               /**< Full path of detector list file */
 
 
@@ -215,6 +214,13 @@ extern "C" {
   int distortions_generate_detector(struct precision * ppr,
                                     struct distortions * psd);
 
+  int distortions_PCA_Jacobi(double * matrix,
+                             int row_size,
+                             int column_size,
+                             double * sigma,
+                             double * vectors,
+                             ErrorMsg error_message);
+
   int distortions_set_detector(struct precision * ppr,
                                struct distortions* psd);
 
@@ -0,0 +1,79 @@
+/**
+ * definitions for dual numbers (C++ only)
+ *
+ * A dual number carries a value and its derivatives with respect to N
+ * independent parameters. Functions templated on their scalar type
+ * and called with dual numbers return these derivatives exactly, in a
+ * single pass (forward-mode automatic differentiation).
+ *
+ * Dual numbers have constructors: arrays of them must be created with
+ * std::vector (or new[]), not with class_alloc().
+ */
+
+#ifndef __DUAL__
+#define __DUAL__
+
+#ifdef __cplusplus
+
+#include <cmath>
+
+template <int N> struct dual {
+
+  double val;    /**< value */
+  double der[N]; /**< derivatives with respect to each parameter */
+
+  /** constant: all derivatives vanish */
+  dual(double value=0.) : val(value) {
+    for (int i=0; i<N; i++) der[i] = 0.;
+  }
+
+  /** independent parameter number index */
+  dual(double value, int index) : val(value) {
+    for (int i=0; i<N; i++) der[i] = (i == index) ? 1. : 0.;
+  }
+
+  /** value and derivatives of f(x) given f(x.val) and f'(x.val) */
+  static dual chain(const dual & x, double f, double df) {
+    dual r(f);
+    for (int i=0; i<N; i++) r.der[i] = df*x.der[i];
+    return r;
+  }
+
+  dual & operator+=(const dual & y) { val += y.val; for (int i=0; i<N; i++) der[i] += y.der[i]; return *this; }
+  dual & operator-=(const dual & y) { val -= y.val; for (int i=0; i<N; i++) der[i] -= y.der[i]; return *this; }
+  dual & operator*=(const dual & y) { for (int i=0; i<N; i++) der[i] = der[i]*y.val + val*y.der[i]; val *= y.val; return *this; }
+  dual & operator/=(const dual & y) { val /= y.val; for (int i=0; i<N; i++) der[i] = (der[i] - val*y.der[i])/y.val; return *this; }
+
+};
+
+template <int N> dual<N> operator-(const dual<N> & x) { dual<N> r(x); r *= -1.; return r; }
+
+template <int N> dual<N> operator+(dual<N> x, const dual<N> & y) { return x += y; }
+template <int N> dual<N> operator-(dual<N> x, const dual<N> & y) { return x -= y; }
+template <int N> dual<N> operator*(dual<N> x, const dual<N> & y) { return x *= y; }
+template <int N> dual<N> operator/(dual<N> x, const dual<N> & y) { return x /= y; }
+
+template <int N> dual<N> operator+(dual<N> x, double y) { return x += dual<N>(y); }
+template <int N> dual<N> operator-(dual<N> x, double y) { return x -= dual<N>(y); }
+template <int N> dual<N> operator*(dual<N> x, double y) { return x *= dual<N>(y); }
+template <int N> dual<N> operator/(dual<N> x, double y) { return x /= dual<N>(y); }
+
+template <int N> dual<N> operator+(double x, const dual<N> & y) { return dual<N>(x) += y; }
+template <int N> dual<N> operator-(double x, const dual<N> & y) { return dual<N>(x) -= y; }
+template <int N> dual<N> operator*(double x, const dual<N> & y) { return dual<N>(x) *= y; }
+template <int N> dual<N> operator/(double x, const dual<N> & y) { return dual<N>(x) /= y; }
+
+template <int N> dual<N> sqrt(const dual<N> & x) { double s = std::sqrt(x.val); return dual<N>::chain(x,s,0.5/s); }
+template <int N> dual<N> exp(const dual<N> & x) { double e = std::exp(x.val); return dual<N>::chain(x,e,e); }
+template <int N> dual<N> log(const dual<N> & x) { return dual<N>::chain(x,std::log(x.val),1./x.val); }
+template <int N> dual<N> pow(const dual<N> & x, double p) { return dual<N>::chain(x,std::pow(x.val,p),p*std::pow(x.val,p-1.)); }
+template <int N> dual<N> sin(const dual<N> & x) { return dual<N>::chain(x,std::sin(x.val),std::cos(x.val)); }
+template <int N> dual<N> sinh(const dual<N> & x) { return dual<N>::chain(x,std::sinh(x.val),std::cosh(x.val)); }
+
+/** value of a scalar, for code templated on double or dual numbers */
+inline double dual_value(double x) { return x; }
+template <int N> double dual_value(const dual<N> & x) { return x.val; }
+
+#endif
+
+#endif
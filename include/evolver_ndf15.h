@@ -113,6 +113,7 @@ int evolver_ndf15(
 		ErrorMsg error_message),
 	int (*print_variables)(double x, double y[], double dy[], void *parameters_and_workspace,
 		ErrorMsg error_message),
+	struct precision * ppr,
 	ErrorMsg error_message);
 
 
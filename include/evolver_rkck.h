@@ -43,6 +43,7 @@ extern "C" {
 					     double dy[],
 					     void * parameters_and_workspace,
 					     ErrorMsg error_message),
+		      struct precision * ppr,
 		      ErrorMsg error_message);
 
 #ifdef __cplusplus
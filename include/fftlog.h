@@ -0,0 +1,48 @@
+/**
+ * definitions for module fftlog.c
+ */
+
+#ifndef __FFTLOG__
+#define __FFTLOG__
+
+#include "common.h"
+
+/**
+ * Boilerplate for C++
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  int fftlog_fft(
+                 double * re,
+                 double * im,
+                 int N,
+                 ErrorMsg error_message
+                 );
+
+  int fftlog_lngamma(
+                     double re,
+                     double im,
+                     double * lngamma_re,
+                     double * lngamma_im,
+                     ErrorMsg error_message
+                     );
+
+  int fftlog_spherical_bessel_transform(
+                                        double * x,
+                                        double * f,
+                                        int N,
+                                        double l,
+                                        int derivative,
+                                        double bias,
+                                        double * y,
+                                        double * F,
+                                        ErrorMsg error_message
+                                        );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -2,6 +2,7 @@
 
 #include "primordial.h"
 #include "trigonometric_integrals.h"
+#include "correction.h"
 
 #ifndef __FOURIER__
 #define __FOURIER__
@@ -12,6 +13,8 @@
 
 #define _MAX_NUM_EXTRAPOLATION_ 100000
 
+#define _SOURCE_FIT_SIZE_ 4 /**< number of coefficients of the function fitted to the sources, for extending them beyond the last computed k */
+
 enum non_linear_method {nl_none,nl_halofit,nl_HMcode};
 enum pk_outputs {pk_linear,pk_nonlinear};
 
@@ -51,6 +54,16 @@ struct fourier {
 
   short has_pk_eq;  /**< flag: in case wa_fld is defined and non-zero, should we use the pk_eq method? */
 
+  short pk_growth_factorisation; /**< flag: should we try to store the linear P(k,z) as D^2(z) P(k,0)? */
+
+  enum correction_mode correction_mode; /**< multi-fidelity correction: store the linear P(k) of a fiducial model computed with reference or fast precision, or apply the stored correction */
+
+  FileName correction_file; /**< binary file with the spectra of the fiducial model */
+
+  double correction_max_drift; /**< if positive, the run stops with an error if the input parameters differ from those of the fiducial model by more than this relative amount */
+
+  char * correction_parameters; /**< input parameters of this run, as 'name=value' lines (excluding file names and verbosity), allocated by the input module */
+
   //@}
 
   /** @name - information on number of modes and pairs of initial conditions */
@@ -95,6 +108,10 @@ struct fourier {
 
   int k_size;      /**< k_size = total number of k values */
   int k_size_pk;   /**< k_size = number of k values for P(k,z) and T(k,z) output) */
+  int k_size_sources; /**< number of k values for which the sources were computed in the perturbation
+                         module; if smaller than k_size, P(k,z) is extended analytically until k_size */
+  int index_k_fit; /**< if k_size_sources < k_size, index of the first k value of the sources to which the
+                      analytic extension is fitted */
   double * k;      /**< k[index_k] = list of k values */
   double * ln_k;   /**< ln_k[index_k] = list of log(k) values */
 
@@ -139,6 +156,20 @@ struct fourier {
 
   double ** ddln_pk_l; /**< second derivative of above array with respect to log(tau), for spline interpolation. */
 
+  short pk_is_growth_factorised; /**< _TRUE_ if the linear spectra are stored as P_L(k,tau) = D^2(tau) P_L(k,tau_0)
+                                    (requested with pk_growth_factorisation, and accurate enough). Then ln_pk_l and
+                                    ln_pk_ic_l only contain the spectra today, ln_pk_l[index_pk][index_k] and
+                                    ln_pk_ic_l[index_pk][index_k * pfo->ic_ic_size + index_ic1_ic2], while
+                                    ddln_pk_l and ddln_pk_ic_l are not allocated */
+
+  double * ln_D2;     /**< ln_D2[index_tau] = ln[D^2(tau)/D^2(tau_0)] at each ln_tau (only if pk_is_growth_factorised) */
+  double * ddln_D2;   /**< second derivative of above array with respect to log(tau), for spline interpolation */
+
+  double pk_growth_factorisation_error; /**< maximum error on ln P_L(k,tau) of the factorised form, over all tabulated k and tau */
+
+  double pk_extrapolation_error; /**< estimated maximum relative error on P_L(k,tau) where it is extended analytically
+                                    beyond the sources, for k_size_sources <= index_k < k_size (zero if k_size_sources = k_size) */
+
   double ** ln_pk_nl;   /**< Total matter power spectrum summed over initial conditions (nonlinear).
                            Only depends on indices index_pk,index_k, index_tau as:
                            ln_pk[index_pk][index_tau * pfo->k_size + index_k]
@@ -148,6 +179,10 @@ struct fourier {
 
   double * sigma8;   /**< sigma8[index_pk] */
 
+  double correction_drift; /**< largest relative difference between the input parameters of this run and of the fiducial model (_HUGE_ if some parameters differ otherwise) */
+
+  short correction_is_applied; /**< was the multi-fidelity correction applied to the linear P(k) of this run? */
+
   //@}
 
   /** @name - table non-linear corrections for matter density, sqrt(P_NL(k,z)/P_NL(k,z)) */
@@ -160,7 +195,7 @@ struct fourier {
   double * tau;    /**< tau[index_tau] = list of time values, covering
                       all the values of the perturbation module */
 
-  double ** nl_corr_density;   /**< nl_corr_density[index_pk][index_tau * ppt->k_size + index_k] */
+  double ** nl_corr_density;   /**< nl_corr_density[index_pk][index_tau * pfo->k_size + index_k] */
   double ** k_nl;              /**< wavenumber at which non-linear corrections become important,
                                   defined differently by different non_linear_method's */
   int index_tau_min_nl;        /**< index of smallest value of tau at which nonlinear corrections have been computed
@@ -301,6 +336,19 @@ extern "C" {
                                    double * out_pk_cb
                                    );
 
+  int fourier_pk_at_kvec_and_zvec(
+                                  struct background * pba,
+                                  struct primordial * ppm,
+                                  struct fourier * pfo,
+                                  enum pk_outputs pk_output,
+                                  double * kvec,
+                                  int kvec_size,
+                                  double * zvec,
+                                  int zvec_size,
+                                  int index_pk,
+                                  double * out_pk
+                                  );
+
   int fourier_sigmas_at_z(
                           struct precision * ppr,
                           struct background * pba,
@@ -346,6 +394,10 @@ extern "C" {
                    struct fourier *pfo
                    );
 
+  int fourier_free_input(
+                         struct fourier *pfo
+                         );
+
   int fourier_indices(
                       struct precision *ppr,
                       struct background *pba,
@@ -374,13 +426,74 @@ extern "C" {
                          int index_tp,
                          int index_tau,
                          double ** sources,
+                         double * fit_coefficients,
                          double * source);
 
+  int fourier_source_fit(
+                         struct perturbations * ppt,
+                         struct fourier * pfo,
+                         int index_ic,
+                         int index_tp,
+                         int index_tau,
+                         int index_k_min,
+                         int index_k_max,
+                         double ** sources,
+                         double * fit_coefficients
+                         );
+
+  int fourier_source_fit_basis(
+                               struct fourier * pfo,
+                               double k,
+                               double * basis
+                               );
+
+  int fourier_source_fit_at_k(
+                              struct fourier * pfo,
+                              double * fit_coefficients,
+                              double k,
+                              double * source
+                              );
+
+  int fourier_pk_extrapolation_error(
+                                     struct precision *ppr,
+                                     struct background *pba,
+                                     struct perturbations *ppt,
+                                     struct fourier *pfo
+                                     );
+
+  int fourier_pk_primordial(
+                            struct primordial *ppm,
+                            struct fourier *pfo,
+                            double * pk_primordial
+                            );
+
+  int fourier_correction(
+                         struct fourier *pfo
+                         );
+
+  int fourier_correction_pack(
+                              struct fourier *pfo,
+                              char ** slot,
+                              size_t * slot_size
+                              );
+
+  int fourier_correction_apply(
+                               struct fourier *pfo,
+                               char ** slot,
+                               size_t * slot_size
+                               );
+
+  int fourier_pk_growth_factorise(
+                                  struct precision *ppr,
+                                  struct background *pba,
+                                  struct fourier *pfo
+                                  );
+
   int fourier_pk_linear(
                         struct background *pba,
                         struct perturbations *ppt,
-                        struct primordial *ppm,
                         struct fourier *pfo,
+                        double * pk_primordial,
                         int index_pk,
                         int index_tau,
                         int k_size,
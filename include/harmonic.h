@@ -4,6 +4,7 @@
 #define __HARMONIC__
 
 #include "transfer.h"
+#include "correction.h"
 
 /**
  * Structure containing everything about anisotropy and Fourier power spectra that other modules need to know.
@@ -29,6 +30,14 @@ struct harmonic {
                    and number of bins minus one means all
                    correlations */
 
+  enum correction_mode correction_mode; /**< multi-fidelity correction: store the C_l's of a fiducial model computed with reference or fast precision, or apply the stored correction */
+
+  FileName correction_file; /**< binary file with the spectra of the fiducial model */
+
+  double correction_max_drift; /**< if positive, the run stops with an error if the input parameters differ from those of the fiducial model by more than this relative amount */
+
+  char * correction_parameters; /**< input parameters of this run, as 'name=value' lines (excluding file names and verbosity), allocated by the input module */
+
   //@}
 
   /** @name - information on number of modes and pairs of initial conditions */
@@ -130,6 +139,10 @@ struct harmonic {
                            deprecated functions are removed, it will
                            be possible to remove also this pointer. */
 
+  double correction_drift; /**< largest relative difference between the input parameters of this run and of the fiducial model (_HUGE_ if some parameters differ otherwise) */
+
+  short correction_is_applied; /**< was the multi-fidelity correction applied to the C_l's of this run? */
+
   short harmonic_verbose; /**< flag regulating the amount of information sent to standard output (none if set to zero) */
 
   ErrorMsg error_message; /**< zone for writing error messages */
@@ -174,6 +187,10 @@ extern "C" {
                     struct harmonic * phr
                     );
 
+  int harmonic_free_input(
+                          struct harmonic * phr
+                          );
+
   int harmonic_indices(
                        struct background * pba,
                        struct perturbations * ppt,
@@ -199,15 +216,12 @@ extern "C" {
                           struct primordial * ppm,
                           struct harmonic * phr,
                           int index_md,
-                          int index_ic1,
-                          int index_ic2,
                           int index_l,
                           int cl_integrand_num_columns,
                           double * cl_integrand,
                           double * cl_integrand_limber,
                           double * primordial_pk,
-                          double * transfer_ic1,
-                          double * transfer_ic2
+                          double * transfer
                           );
 
   int harmonic_k_and_tau(
@@ -217,6 +231,22 @@ extern "C" {
                          struct harmonic * phr
                          );
 
+  int harmonic_correction(
+                          struct harmonic * phr
+                          );
+
+  int harmonic_correction_pack(
+                               struct harmonic * phr,
+                               char ** slot,
+                               size_t * slot_size
+                               );
+
+  int harmonic_correction_apply(
+                                struct harmonic * phr,
+                                char ** slot,
+                                size_t * slot_size
+                                );
+
   /* deprecated functions (since v2.8) */
 
   int harmonic_pk_at_z(
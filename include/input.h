@@ -199,6 +199,29 @@
                name,entries_read_temp, siz);                                    \
   } while(0);
 
+/* macro for setting a precision parameter automatically, unless the user passed it
+   (under its name, or under a deprecated one: then it differs from its default) */
+
+#define class_auto_precision_parameter(name,value,reason)                       \
+  do {                                                                          \
+    char string_temp[_ARGUMENT_LENGTH_MAX_]; int flag_temp;                     \
+    class_call(parser_read_string(pfc,#name,&string_temp,&flag_temp,errmsg),    \
+               errmsg,                                                          \
+               errmsg);                                                         \
+    if ((flag_temp == _FALSE_) && (ppr->name != ppr_default->name)){            \
+      if (input_verbose > 0)                                                    \
+        printf(" -> auto precision: keeping input value %s = %g (deprecated name)\n",#name,(double)(ppr->name)); \
+    }                                                                           \
+    else if (flag_temp == _FALSE_){                                             \
+      ppr->name = value;                                                        \
+      if (input_verbose > 0)                                                    \
+        printf(" -> auto precision: %s = %g (%s)\n",#name,(double)(value),reason); \
+    }                                                                           \
+    else if (input_verbose > 0){                                                \
+      printf(" -> auto precision: keeping input value %s = %s\n",#name,string_temp); \
+    }                                                                           \
+  } while(0);
+
 /**
  * For shooting method: definition of the possible targets
  */
@@ -210,6 +233,13 @@ enum target_names {theta_s, theta_s_100, Neff, Omega_dcdmdr, omega_dcdmdr, Omega
 /* Until which class stage is being computed? Pretty much fixed list, don't change. */
 enum computation_stage {cs_background, cs_thermodynamics, cs_perturbations, cs_primordial, cs_nonlinear, cs_transfer, cs_spectra};
 
+/**
+ * Accuracy tiers of the automatic precision mode (relative error
+ * targeted on the requested spectra: defaults, below 1e-3, a few 1e-3)
+ */
+
+enum auto_precision_tier {auto_precision_no, auto_precision_standard, auto_precision_fast};
+
 /**
  * Structure for all temporary parameters for background fzero function
  */
@@ -221,6 +251,9 @@ struct fzerofun_workspace {
   double * target_value;
   int target_size;
   enum computation_stage required_computation_stage;
+  double deadline;        /**< deadline of the main run, shared by the preliminary runs */
+  volatile sig_atomic_t * cancel;  /**< cancellation flag of the main run, shared by the preliminary runs */
+  struct precision * main_run;     /**< precision structure of the main run, marked as aborted with the preliminary runs */
 };
 
 /**************************************************************/
@@ -329,6 +362,27 @@ extern "C" {
                       struct fzerofun_workspace * pfzw,
                       ErrorMsg errmsg);
 
+  int input_correction(struct file_content * pfc,
+                       int input_size,
+                       struct precision * ppr,
+                       struct perturbations * ppt,
+                       struct fourier * pfo,
+                       struct harmonic * phr,
+                       int input_verbose,
+                       ErrorMsg errmsg);
+
+  int input_correction_refresh(struct file_content * pfc,
+                               int input_size,
+                               struct precision * ppr,
+                               char * precision_file,
+                               int input_verbose,
+                               ErrorMsg errmsg);
+
+  int input_correction_set(struct file_content * pfc,
+                           char * name,
+                           char * value,
+                           ErrorMsg errmsg);
+
   int input_try_unknown_parameters(double * unknown_parameter,
                                    int unknown_parameters_size,
                                    void * pfzw,
@@ -337,6 +391,8 @@ extern "C" {
 
   /* Read from precision.h */
 
+  int input_default_precisions(struct precision * ppr);
+
   int input_read_precisions(struct file_content * pfc,
                             struct precision * ppr,
                             struct background * pba,
@@ -418,6 +474,11 @@ extern "C" {
                                     struct output * pop,
                                     ErrorMsg errmsg);
 
+  int input_read_parameters_correction(struct file_content * pfc,
+                                       struct fourier * pfo,
+                                       struct harmonic * phr,
+                                       ErrorMsg errmsg);
+
   int input_read_parameters_lensing(struct file_content * pfc,
                                     struct precision * ppr,
                                     struct perturbations * ppt,
@@ -449,6 +510,12 @@ extern "C" {
                                    struct output *pop,
                                    ErrorMsg errmsg);
 
+  int input_auto_precision(struct file_content * pfc,
+                           struct precision * ppr,
+                           struct perturbations * ppt,
+                           int input_verbose,
+                           ErrorMsg errmsg);
+
   int input_write_info(struct file_content * pfc,
                        struct output * pop,
                        ErrorMsg errmsg);
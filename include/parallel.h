@@ -34,6 +34,14 @@ for (std::future<int>& future : future_output) {  \
 }                                                 \
 future_output.clear();
 
+// Same, but sets status to _FAILURE_ instead of returning when a job failed, for
+// callers which must first tell other MPI processes (see class_mpi_check_status()).
+#define class_finish_parallel_status(status)      \
+for (std::future<int>& future : future_output) {  \
+  if(future.get()!=_SUCCESS_) status = _FAILURE_; \
+}                                                 \
+future_output.clear();
+
 //
 //  thread_pool.h
 //  ppCLASS
@@ -52,6 +60,7 @@ future_output.clear();
 #include <thread>
 #include <utility>
 #include <vector>
+#include "common.h"
 
 namespace Tools {
 
@@ -132,7 +141,16 @@ public:
     for (auto& e : threads_) e.join();
   }
 
+  // The number of threads can be set for each thread starting parallel
+  // loops, e.g. for each CLASS instance running in its own thread (see
+  // class_set_num_threads). Inside the tasks of a pool it is one by default,
+  // such that nested parallel loops do not multiply the number of threads;
+  // a task knowing that few tasks run at the same time can raise it (see
+  // fzero_Newton).
   static unsigned int GetNumThreads() {
+    if (class_get_num_threads() > 0) {
+      return class_get_num_threads();
+    }
     unsigned int number_of_threads = std::thread::hardware_concurrency();
     for (const std::string& env_var_name : {"OMP_NUM_THREADS", "SLURM_CPUS_PER_TASK"}) {
       if (char* s = std::getenv(env_var_name.c_str())) {
@@ -199,6 +217,7 @@ public:
 
 private:
   void Run(unsigned int i) {
+    class_set_num_threads(1);
     while (true) {
       std::function<void()> f;
       for (unsigned n = 0; n != count_; ++n) {
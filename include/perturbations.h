@@ -4,6 +4,7 @@
 #define __PERTURBATIONS__
 
 #include "thermodynamics.h"
+#include "checkpoint.h"
 
 #define _scalars_ ((ppt->has_scalars == _TRUE_) && (index_md == ppt->index_md_scalars))
 #define _vectors_ ((ppt->has_vectors == _TRUE_) && (index_md == ppt->index_md_vectors))
@@ -15,7 +16,8 @@
  * flags for various approximation schemes
  * (tca = tight-coupling approximation,
  *  rsa = radiation streaming approximation,
- *  ufa = massless neutrinos / ultra-relativistic relics fluid approximation)
+ *  ufa = massless neutrinos / ultra-relativistic relics fluid approximation,
+ *  hta = early-time truncation of the Boltzmann hierarchies at a reduced l_max)
  *
  * CAUTION: must be listed below in chronological order, and cannot be
  * reversible. When integrating equations for a given mode, it is only
@@ -30,6 +32,7 @@ enum tca_idm_dr_flags {tca_idm_dr_on, tca_idm_dr_off};
 enum rsa_idr_flags {rsa_idr_off, rsa_idr_on};
 enum ufa_flags {ufa_off, ufa_on};
 enum ncdmfa_flags {ncdmfa_off, ncdmfa_on};
+enum hta_flags {hta_on, hta_off};
 
 //@}
 
@@ -45,6 +48,7 @@ enum idr_method {idr_free_streaming,idr_fluid}; /* for the idm-idr case */
 enum rsa_idr_method {rsa_idr_none,rsa_idr_MD};  /* for the idm-idr case */
 enum ufa_method {ufa_mb,ufa_hu,ufa_CLASS,ufa_none};
 enum ncdmfa_method {ncdmfa_mb,ncdmfa_hu,ncdmfa_CLASS,ncdmfa_none};
+enum hta_method {hta_CLASS,hta_none};
 enum tensor_methods {tm_photons_only,tm_massless_approximation,tm_exact};
 
 //@}
@@ -149,6 +153,8 @@ struct perturbations
   int l_tensor_max; /**< maximum l value for CMB tensors \f$ C_l \f$'s */
   int l_lss_max; /**< maximum l value for LSS \f$ C_l \f$'s (density and lensing potential in  bins) */
   double k_max_for_pk; /**< maximum value of k in 1/Mpc required for the output of P(k,z) and T(k,z) */
+  short has_k_max_for_pk_sources; /**< do we stop the sources of P(k,z) at k_max_for_pk_sources, and let the fourier module extend P(k,z) analytically up to k_max_for_pk? */
+  double k_max_for_pk_sources; /**< maximum value of k in 1/Mpc up to which the sources of P(k,z) are computed, when has_k_max_for_pk_sources is true */
 
   short want_lcmb_full_limber; /**< In general, do we want to use the full Limber scheme introduced in v3.2.2? With this full Limber scheme, the calculation of the CMB lensing potential spectrum C_l^phiphi for l > ppr->l_switch_limber is based on a new integration scheme. Compared to the previous scheme, which can be recovered by switching this parameter to _FALSE_, the new scheme uses a larger k_max and a coarser k-grid (or q-grid) than the CMB transfer function. The new scheme is used by default, because the old one is inaccurate at large l due to the too small k_max. */
 
@@ -361,6 +367,12 @@ struct perturbations
   double * tau_sampling;    /**< array of tau values */
   int tau_size;             /**< number of values in this array */
 
+  double * tau_sampling_pvecback;   /**< background quantities (in normal_info format) at each tau value,
+                                       tau_sampling_pvecback[index_tau*pba->bg_size_normal+index_bg],
+                                       shared by all wavenumbers when computing source functions */
+  double * tau_sampling_pvecthermo; /**< thermodynamics quantities at each tau value,
+                                       tau_sampling_pvecthermo[index_tau*pth->th_size+index_th] */
+
   double selection_min_of_tau_min; /**< used in presence of selection functions (for matter density, cosmic shear...) */
   double selection_max_of_tau_max; /**< used in presence of selection functions (for matter density, cosmic shear...) */
 
@@ -438,6 +450,12 @@ struct perturbations
 
   short perturbations_verbose; /**< flag regulating the amount of information sent to standard output (none if set to zero) */
 
+  short has_checkpoint; /**< do we append the sources of each evolved wavenumber to a checkpoint file, and recover those already present? */
+
+  FileName checkpoint_file; /**< name of the checkpoint file */
+
+  unsigned long long checkpoint_hash; /**< hash of the input parameters, identifying the run to which a checkpoint file belongs */
+
   ErrorMsg error_message; /**< zone for writing error messages */
 
   short is_allocated; /**< flag is set to true if allocated */
@@ -631,6 +649,7 @@ struct perturbations_workspace
   int index_ap_rsa_idr; /**< index for dark radiation streaming approximation */
   int index_ap_ufa; /**< index for ur fluid approximation */
   int index_ap_ncdmfa; /**< index for ncdm fluid approximation */
+  int index_ap_hta; /**< index for early-time hierarchy truncation approximation */
   int ap_size;      /**< number of relevant approximations for a given mode */
 
   int * approx;     /**< array of approximation flags holding at a given time: approx[index_ap] */
@@ -642,6 +661,7 @@ struct perturbations_workspace
   //@{
 
   int max_l_max;    /**< maximum l_max for any multipole */
+  double hta_trigger_tau_over_tau_k; /**< value of \f$ k \tau \f$ below which the hierarchies are truncated at l_max_hta */
   double * s_l;     /**< array of freestreaming coefficients \f$ s_l = \sqrt{1-K*(l^2-1)/k^2} \f$*/
 
   //@}
@@ -763,6 +783,33 @@ extern "C" {
                          struct perturbations * ppt
                          );
 
+  int perturbations_downsize_sources(
+                                     struct perturbations * ppt
+                                     );
+
+  int perturbations_checkpoint_init(
+                                    struct perturbations * ppt,
+                                    int mpi_rank,
+                                    int mpi_size,
+                                    struct checkpoint * pch,
+                                    short *** is_restored
+                                    );
+
+  int perturbations_checkpoint_free(
+                                    struct perturbations * ppt,
+                                    struct checkpoint * pch,
+                                    double * doubles,
+                                    short ** is_restored
+                                    );
+
+  int perturbations_checkpoint_write(
+                                     struct perturbations * ppt,
+                                     struct checkpoint * pch,
+                                     int index_md,
+                                     int index_ic,
+                                     int index_k
+                                     );
+
   int perturbations_indices(
                             struct precision * ppr,
                             struct background * pba,
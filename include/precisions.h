@@ -387,6 +387,19 @@ class_precision_parameter(ncdm_fluid_approximation,int,ncdmfa_CLASS) /**< method
  * relics) fluid approximation
  */
 class_precision_parameter(ncdm_fluid_trigger_tau_over_tau_k,double,31.0)
+/**
+ * method for truncating the photon, ur and ncdm Boltzmann hierarchies
+ * (scalar) at a reduced l_max as long as \f$ k \tau \f$ is small
+ * (hta_CLASS), or for always using the full hierarchies (hta_none)
+ */
+class_precision_parameter(hierarchy_truncation_approximation,int,hta_none)
+class_precision_parameter(l_max_hta,int,6) /**< l_max of the truncated hierarchies, at least 4 */
+/**
+ * maximum estimated amplitude of the first neglected multipole,
+ * relative to the shear, for the truncated hierarchies; it fixes the
+ * value of \f$ k \tau \f$ at which the full hierarchies are restored
+ */
+class_precision_parameter(hierarchy_truncation_tolerance,double,1.0e-5)
 /**
  * whether CMB source functions can be approximated as zero when
  * visibility function g(tau) is tiny
@@ -500,6 +513,11 @@ class_precision_parameter(l_switch_limber_for_nc_local_over_z,double,100.0) /**<
 // reduce to e.g. 30.
 class_precision_parameter(l_switch_limber_for_nc_los_over_z,double,30.0) /**< when to use the Limber approximation for number count contributions to cl's integrated along the line-of-sight (relative to central redshift of each bin) */
 
+class_precision_parameter(transfer_nc_method,int,nc_line_of_sight) /**< method for the density, RSD and lensing number count transfer functions below the Limber switch: nc_line_of_sight, or nc_fftlog (flat space only) which assumes scale-independent growth at late times and computes all wavenumbers with one FFTLog transform per multipole */
+class_precision_parameter(fftlog_nc_sampling,double,2.0) /**< number of FFTLog points per (logarithmic) step of the time sampling of the selection function */
+class_precision_parameter(fftlog_nc_size_max,int,65536) /**< maximum number of FFTLog points (power of two) */
+class_precision_parameter(fftlog_nc_chi_min_over_max,double,1.e-6) /**< smallest (tau0-tau) of the FFTLog grid, relative to the largest one, for windows extending down to the observer (lensing) */
+
 class_precision_parameter(selection_cut_at_sigma,double,5.0)/**< in sigma units, where to cut gaussian selection functions */
 class_precision_parameter(selection_sampling,double,50.0) /**< controls sampling of integral over time when selection functions vary quicker than Bessel functions. Increase for better sampling. */
 class_precision_parameter(selection_sampling_bessel,double,20.0)/**< controls sampling of integral over time when selection functions vary slower than Bessel functions. Increase for better sampling. IMPORTANT for lensed contributions. */
@@ -551,6 +569,19 @@ class_precision_parameter(pk_eq_z_max,double,5.0)  /**< Maximum z for the pk_eq
 class_precision_parameter(pk_eq_Nzlog,int,10)      /**< Number of logarithmically spaced redshift values for the pk_eq method */
 class_precision_parameter(pk_eq_tol,double,1.0e-7) /**< Tolerance on the pk_eq method for finding the pk */
 
+class_precision_parameter(pk_growth_factorisation_tolerance,double,1.e-2) /**< maximum error on ln P_L(k,z) accepted for
+                                                                             storing the linear spectrum as D^2(z) P_L(k,0),
+                                                                             when pk_growth_factorisation is requested (in
+                                                                             LCDM, the error is dominated by super-horizon
+                                                                             wavenumbers and reaches 1.e-2 around z=5) */
+
+class_precision_parameter(pk_extrapolation_fit_decades,double,1.0) /**< when the sources stop before the k_max of P(k)
+                                                                      (see perturbations_P_k_max_h/Mpc), P(k) is extended
+                                                                      with a function fitted to the sources over this
+                                                                      number of decades below their last k */
+class_precision_parameter(pk_extrapolation_tolerance,double,1.e-2) /**< estimated relative error on the extended P(k)
+                                                                      above which a warning is issued */
+
 /** Parameters relevant for HMcode computation */
 
 class_precision_parameter(hmcode_max_k_extra,double,1.e6) /**< parameter specifying the maximum k value for
@@ -522,8 +522,19 @@ extern "C" {
 
   int thermodynamics_free_input(struct thermodynamics * pth);
 
+  int thermodynamics_load_bbn_table(char * file,
+                                    ErrorMsg errmsg);
+
   /* internal functions of the module */
 
+  int thermodynamics_read_bbn_table(char * file,
+                                    int * num_omegab_out,
+                                    int * num_deltaN_out,
+                                    double ** omegab_out,
+                                    double ** deltaN_out,
+                                    double ** YHe_out,
+                                    ErrorMsg errmsg);
+
   int thermodynamics_helium_from_bbn(struct precision * ppr,
                                      struct background * pba,
                                      struct thermodynamics * pth);
@@ -653,11 +664,22 @@ extern "C" {
                                    struct thermodynamics *pth,
                                    char titles[_MAXTITLESTRINGLENGTH_]);
 
+  int thermodynamics_output_derived_data(struct background * pba,
+                                         struct thermodynamics *pth,
+                                         int index_z,
+                                         double *dataptr,
+                                         int *storeidx);
+
   int thermodynamics_output_data(struct background * pba,
                                  struct thermodynamics *pth,
                                  int number_of_titles,
                                  double *data);
 
+  int thermodynamics_output_columns(struct background * pba,
+                                    struct thermodynamics *pth,
+                                    int number_of_titles,
+                                    int *index_column);
+
   int thermodynamics_calculate_idm_and_idr_quantities(struct precision * ppr,
                                                       struct background * pba,
                                                       struct thermodynamics * pth,
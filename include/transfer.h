@@ -5,6 +5,8 @@
 
 #include "fourier.h"
 #include "hyperspherical.h"
+#include "fftlog.h"
+#include "checkpoint.h"
 #include "errno.h"
 
 /* macro: test if index_tt is in the range between index and index+num, while the flag is true */
@@ -203,6 +205,12 @@ struct transfer {
 
   short transfer_verbose; /**< flag regulating the amount of information sent to standard output (none if set to zero) */
 
+  short has_checkpoint; /**< do we append the transfer functions of each wavenumber to a checkpoint file, and recover those already present? */
+
+  FileName checkpoint_file; /**< name of the checkpoint file */
+
+  unsigned long long checkpoint_hash; /**< hash of the input parameters, identifying the run to which a checkpoint file belongs */
+
   ErrorMsg error_message; /**< zone for writing error messages */
 
   short is_allocated; /**< flag is set to true if allocated */
@@ -210,6 +218,14 @@ struct transfer {
   //@}
 };
 
+/**
+ * enumeration of possible methods for the density, redshift-space
+ * distortion and lensing contributions to number count transfer
+ * functions below the Limber regime
+ */
+
+enum transfer_nc_method {nc_line_of_sight, nc_fftlog};
+
 /**
  * Structure containing all the quantities that each thread needs to
  * know for computing transfer functions (but that can be forgotten
@@ -326,6 +342,36 @@ extern "C" {
                     struct transfer * ptr
                     );
 
+  int transfer_free_transfer_functions(
+                                       struct transfer * ptr
+                                       );
+
+  int transfer_checkpoint_init(
+                               struct perturbations * ppt,
+                               struct transfer * ptr,
+                               int mpi_rank,
+                               int mpi_size,
+                               struct checkpoint * pch,
+                               short ** is_restored,
+                               short ** is_restored_limber
+                               );
+
+  int transfer_checkpoint_free(
+                               struct transfer * ptr,
+                               struct checkpoint * pch,
+                               double * doubles,
+                               short * is_restored,
+                               short * is_restored_limber
+                               );
+
+  int transfer_checkpoint_write(
+                                struct perturbations * ppt,
+                                struct transfer * ptr,
+                                struct checkpoint * pch,
+                                int index_q,
+                                short is_limber
+                                );
+
   int transfer_indices(
                        struct precision * ppr,
                        struct perturbations * ppt,
@@ -574,6 +620,30 @@ extern "C" {
                           short * use_limber
                           );
 
+  int transfer_use_fftlog(
+                          struct precision * ppr,
+                          struct background * pba,
+                          struct perturbations * ppt,
+                          struct transfer * ptr,
+                          int index_md,
+                          int index_tt,
+                          double l,
+                          short * use_fftlog
+                          );
+
+  int transfer_fftlog_nc(
+                         struct precision * ppr,
+                         struct background * pba,
+                         struct perturbations * ppt,
+                         struct transfer * ptr,
+                         int ** tp_of_tt,
+                         double tau_rec,
+                         int tau_size_max,
+                         double *** pert_sources,
+                         double *** pert_sources_spline,
+                         double * window
+                         );
+
   int transfer_integrate(
                          struct perturbations * ppt,
                          struct transfer * ptr,
@@ -4,9 +4,21 @@
 
 #include "class.h"
 
+/* exit status of a failed run, telling apart the runs stopped by their
+   deadline (see the input parameter max_run_time). With MPI, the other
+   processes may be waiting for this one in a collective operation:
+   they are all stopped with the same status. */
+static int failure_status(struct precision * ppr) {
+  int status = (class_run_aborted(ppr) == _TRUE_) ? _ABORTED_ : _FAILURE_;
+#ifdef WITH_MPI
+  MPI_Abort(MPI_COMM_WORLD,status);
+#endif
+  return status;
+}
+
 int main(int argc, char **argv) {
 
-  struct precision pr;        /* for precision parameters */
+  struct precision pr = {0};  /* for precision parameters */
   struct background ba;       /* for cosmological background */
   struct thermodynamics th;           /* for thermodynamics */
   struct perturbations pt;         /* for source functions */
@@ -18,109 +30,134 @@ int main(int argc, char **argv) {
   struct distortions sd;      /* for spectral distortions */
   struct output op;           /* for output files */
   ErrorMsg errmsg;            /* for error messages */
+  int mpi_rank, mpi_size;     /* for runs distributed over MPI processes */
+
+#ifdef WITH_MPI
+  /* when compiled with MPI, the perturbation, transfer and harmonic
+     modules share their loops over wavenumbers and multipoles among
+     all processes; only the root process writes output files */
+  MPI_Init(&argc,&argv);
+#endif
+  class_mpi_rank_and_size(&mpi_rank,&mpi_size);
 
   if (input_init(argc, argv,&pr,&ba,&th,&pt,&tr,&pm,&hr,&fo,&le,&sd,&op,errmsg) == _FAILURE_) {
     printf("\n\nError running input_init \n=>%s\n",errmsg);
-    return _FAILURE_;
+    return failure_status(&pr);
   }
 
   if (background_init(&pr,&ba) == _FAILURE_) {
     printf("\n\nError running background_init \n=>%s\n",ba.error_message);
-    return _FAILURE_;
+    return failure_status(&pr);
   }
 
   if (thermodynamics_init(&pr,&ba,&th) == _FAILURE_) {
     printf("\n\nError in thermodynamics_init \n=>%s\n",th.error_message);
-    return _FAILURE_;
+    return failure_status(&pr);
   }
 
   if (perturbations_init(&pr,&ba,&th,&pt) == _FAILURE_) {
     printf("\n\nError in perturbations_init \n=>%s\n",pt.error_message);
-    return _FAILURE_;
+    return failure_status(&pr);
   }
 
   if (primordial_init(&pr,&pt,&pm) == _FAILURE_) {
     printf("\n\nError in primordial_init \n=>%s\n",pm.error_message);
-    return _FAILURE_;
+    return failure_status(&pr);
   }
 
   if (fourier_init(&pr,&ba,&th,&pt,&pm,&fo) == _FAILURE_) {
     printf("\n\nError in fourier_init \n=>%s\n",fo.error_message);
-    return _FAILURE_;
+    return failure_status(&pr);
   }
 
   if (transfer_init(&pr,&ba,&th,&pt,&fo,&tr) == _FAILURE_) {
     printf("\n\nError in transfer_init \n=>%s\n",tr.error_message);
-    return _FAILURE_;
+    return failure_status(&pr);
+  }
+
+  /* the full time sampling of the sources is not needed anymore */
+  if (perturbations_downsize_sources(&pt) == _FAILURE_) {
+    printf("\n\nError in perturbations_downsize_sources \n=>%s\n",pt.error_message);
+    return failure_status(&pr);
   }
 
   if (harmonic_init(&pr,&ba,&pt,&pm,&fo,&tr,&hr) == _FAILURE_) {
     printf("\n\nError in harmonic_init \n=>%s\n",hr.error_message);
-    return _FAILURE_;
+    return failure_status(&pr);
+  }
+
+  /* the transfer functions are not needed anymore */
+  if (transfer_free_transfer_functions(&tr) == _FAILURE_) {
+    printf("\n\nError in transfer_free_transfer_functions \n=>%s\n",tr.error_message);
+    return failure_status(&pr);
   }
 
   if (lensing_init(&pr,&pt,&hr,&fo,&le) == _FAILURE_) {
     printf("\n\nError in lensing_init \n=>%s\n",le.error_message);
-    return _FAILURE_;
+    return failure_status(&pr);
   }
 
   if (distortions_init(&pr,&ba,&th,&pt,&pm,&sd) == _FAILURE_) {
     printf("\n\nError in distortions_init \n=>%s\n",sd.error_message);
-    return _FAILURE_;
+    return failure_status(&pr);
   }
 
-  if (output_init(&ba,&th,&pt,&pm,&tr,&hr,&fo,&le,&sd,&op) == _FAILURE_) {
+  if ((mpi_rank == 0) && (output_init(&ba,&th,&pt,&pm,&tr,&hr,&fo,&le,&sd,&op) == _FAILURE_)) {
     printf("\n\nError in output_init \n=>%s\n",op.error_message);
-    return _FAILURE_;
+    return failure_status(&pr);
   }
 
   /****** all calculations done, now free the structures ******/
 
   if (distortions_free(&sd) == _FAILURE_) {
     printf("\n\nError in distortions_free \n=>%s\n",sd.error_message);
-    return _FAILURE_;
+    return failure_status(&pr);
   }
 
   if (lensing_free(&le) == _FAILURE_) {
     printf("\n\nError in lensing_free \n=>%s\n",le.error_message);
-    return _FAILURE_;
+    return failure_status(&pr);
   }
 
   if (harmonic_free(&hr) == _FAILURE_) {
     printf("\n\nError in harmonic_free \n=>%s\n",hr.error_message);
-    return _FAILURE_;
+    return failure_status(&pr);
   }
 
   if (transfer_free(&tr) == _FAILURE_) {
     printf("\n\nError in transfer_free \n=>%s\n",tr.error_message);
-    return _FAILURE_;
+    return failure_status(&pr);
   }
 
   if (fourier_free(&fo) == _FAILURE_) {
     printf("\n\nError in fourier_free \n=>%s\n",fo.error_message);
-    return _FAILURE_;
+    return failure_status(&pr);
   }
 
   if (primordial_free(&pm) == _FAILURE_) {
     printf("\n\nError in primordial_free \n=>%s\n",pm.error_message);
-    return _FAILURE_;
+    return failure_status(&pr);
   }
 
   if (perturbations_free(&pt) == _FAILURE_) {
     printf("\n\nError in perturbations_free \n=>%s\n",pt.error_message);
-    return _FAILURE_;
+    return failure_status(&pr);
   }
 
   if (thermodynamics_free(&th) == _FAILURE_) {
     printf("\n\nError in thermodynamics_free \n=>%s\n",th.error_message);
-    return _FAILURE_;
+    return failure_status(&pr);
   }
 
   if (background_free(&ba) == _FAILURE_) {
     printf("\n\nError in background_free \n=>%s\n",ba.error_message);
-    return _FAILURE_;
+    return failure_status(&pr);
   }
 
+#ifdef WITH_MPI
+  MPI_Finalize();
+#endif
+
   return _SUCCESS_;
 
 }
@@ -0,0 +1,552 @@
+/** @file classd.c
+ *
+ * Resident CLASS service listening on a local (Unix domain) socket.
+ *
+ * Usage: ./classd <socket> [file.pre] [-j <jobs>]
+ *
+ * The precision file, the HyRec rate tables and the BBN table are read
+ * once at startup. Each connection carries one request, served by a
+ * child process forked from the resident parent, so that no startup
+ * cost (loading the executable, reading the precision file and the
+ * tables) is paid per request, and a failed run cannot affect later
+ * ones. At most <jobs> requests are computed
+ * concurrently (default: one); the cores of the machine are shared
+ * among them by setting the number of threads of each child.
+ *
+ * Protocol (all integers are 32-bit, all numbers in the byte order of
+ * the machine):
+ *
+ * - request: length of text, then text with the input parameters in
+ *   the format of a .ini file ('name = value' lines).
+ *
+ * - reply: status (0 on success, 1 on failure). On failure: length of
+ *   message, then error message. On success: a sequence of blocks, each
+ *   made of the length of the block name, the block name, the length of
+ *   the comma-separated column titles, the titles, the number of rows,
+ *   the number of columns, and the rows*columns doubles of the table
+ *   (row after row). The sequence ends with a block name of length zero.
+ *
+ * Blocks: 'cl' (unlensed total C_l's, dimensionless, as returned by
+ * harmonic_cl_at_l()), 'cl_lensed' (lensed C_l's), 'pk' and 'pk_nl'
+ * (total matter power spectrum in Mpc^3 at each z_pk, as a function of
+ * k in 1/Mpc), 'background' and 'thermodynamics' (the tables written by
+ * the output module, if write_background or write_thermodynamics is
+ * set).
+ */
+
+#include "class.h"
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define _CLASSD_REQUEST_SIZE_MAX_ 16777216 /**< largest request accepted, in bytes */
+
+/**
+ * Read or write exactly size bytes on a socket.
+ *
+ * @param fd        Input: socket
+ * @param buffer    Input/Output: data
+ * @param size      Input: number of bytes
+ * @param is_write  Input: _TRUE_ for writing, _FALSE_ for reading
+ * @return the error status
+ */
+
+int classd_transfer(int fd, void * buffer, size_t size, int is_write) {
+
+  char * pointer = (char *)buffer;
+  ssize_t done;
+
+  while (size > 0) {
+    if (is_write == _TRUE_)
+      done = write(fd,pointer,size);
+    else
+      done = read(fd,pointer,size);
+    if (done <= 0)
+      return _FAILURE_;
+    pointer += done;
+    size -= done;
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Send a string preceded by its length.
+ */
+
+int classd_send_string(int fd, const char * string) {
+
+  int length = strlen(string);
+
+  if (classd_transfer(fd,&length,sizeof(int),_TRUE_) == _FAILURE_)
+    return _FAILURE_;
+  return classd_transfer(fd,(void *)string,length,_TRUE_);
+}
+
+/**
+ * Send one block of the reply.
+ *
+ * @param fd      Input: socket
+ * @param name    Input: block name
+ * @param titles  Input: comma-separated column titles
+ * @param rows    Input: number of rows
+ * @param columns Input: number of columns
+ * @param data    Input: table
+ * @param errmsg  Output: error message
+ * @return the error status
+ */
+
+int classd_send_block(int fd, const char * name, const char * titles, int rows, int columns, double * data, ErrorMsg errmsg) {
+
+  class_test((classd_send_string(fd,name) == _FAILURE_) ||
+             (classd_send_string(fd,titles) == _FAILURE_) ||
+             (classd_transfer(fd,&rows,sizeof(int),_TRUE_) == _FAILURE_) ||
+             (classd_transfer(fd,&columns,sizeof(int),_TRUE_) == _FAILURE_) ||
+             (classd_transfer(fd,data,(size_t)rows*columns*sizeof(double),_TRUE_) == _FAILURE_),
+             errmsg,
+             "could not send block '%s' to client",name);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Convert the text of a request into a file_content structure.
+ *
+ * @param text   Input: parameters in the format of a .ini file
+ * @param pfc    Output: file content
+ * @param errmsg Output: error message
+ * @return the error status
+ */
+
+int classd_read_request(char * text, struct file_content * pfc, ErrorMsg errmsg) {
+
+  char line[_LINE_LENGTH_MAX_];
+  FileArg name,value;
+  FILE * stream;
+  int counter,is_data,pass;
+
+  pfc->size = 0;
+
+  if (strlen(text) == 0)
+    return _SUCCESS_;
+
+  for (pass=0; pass<2; pass++) {
+
+    stream = fmemopen(text,strlen(text),"r");
+    class_test(stream == NULL,errmsg,"could not read request");
+
+    counter = 0;
+    while (fgets(line,_LINE_LENGTH_MAX_,stream) != NULL) {
+      class_call(parser_read_line(line,&is_data,name,value,errmsg),errmsg,errmsg);
+      if (is_data == _TRUE_) {
+        if (pass == 1) {
+          strcpy(pfc->name[counter],name);
+          strcpy(pfc->value[counter],value);
+          pfc->read[counter] = _FALSE_;
+        }
+        counter++;
+      }
+    }
+    fclose(stream);
+
+    if ((pass == 0) && (counter > 0)) {
+      class_call(parser_init(pfc,counter,"classd request",errmsg),errmsg,errmsg);
+    }
+    if (counter == 0)
+      break;
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Comma-separated names of the C_l types, in the order of their
+ * indices in the harmonic module (the lensing module uses the same
+ * indices).
+ */
+
+int classd_cl_titles(struct harmonic * phr, char * titles) {
+
+  const char * names[] = {"tt","ee","te","bb","pp","tp","ep","dd","td","pd","ll","tl","dl"};
+  int first[13] = {phr->index_ct_tt,phr->index_ct_ee,phr->index_ct_te,phr->index_ct_bb,phr->index_ct_pp,phr->index_ct_tp,phr->index_ct_ep,
+                   phr->index_ct_dd,phr->index_ct_td,phr->index_ct_pd,phr->index_ct_ll,phr->index_ct_tl,phr->index_ct_dl};
+  int has[13] = {phr->has_tt,phr->has_ee,phr->has_te,phr->has_bb,phr->has_pp,phr->has_tp,phr->has_ep,
+                 phr->has_dd,phr->has_td,phr->has_pd,phr->has_ll,phr->has_tl,phr->has_dl};
+  int index,index_type,best;
+
+  /* each column belongs to the type with the largest first index not above it */
+  strcpy(titles,"l");
+  for (index=0; index<phr->ct_size; index++) {
+    best = -1;
+    for (index_type=0; index_type<13; index_type++) {
+      if ((has[index_type] == _TRUE_) && (first[index_type] <= index) &&
+          ((best < 0) || (first[index_type] > first[best])))
+        best = index_type;
+    }
+    if (best < 0)
+      sprintf(titles+strlen(titles),",cl%d",index);
+    else if (first[best] == index)
+      sprintf(titles+strlen(titles),",%s",names[best]);
+    else
+      sprintf(titles+strlen(titles),",%s_%d",names[best],index-first[best]);
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Convert a list of titles written by class_store_columntitle() (separated
+ * by _DELIMITER_) into a comma-separated list.
+ */
+
+int classd_comma_titles(char * titles) {
+
+  char * pointer;
+
+  for (pointer=titles; *pointer != '\0'; pointer++)
+    if (*pointer == _DELIMITER_[0])
+      *pointer = ',';
+
+  if ((pointer > titles) && (*(pointer-1) == ','))
+    *(pointer-1) = '\0';
+
+  return _SUCCESS_;
+}
+
+/**
+ * Run all modules for one request and send the results.
+ *
+ * @param fd          Input: socket
+ * @param pfc_pre     Input: content of the precision file (size 0 if none)
+ * @param text        Input: text of the request
+ * @param is_replying Output: _TRUE_ once the success status has been sent
+ * @param errmsg      Output: error message
+ * @return the error status
+ */
+
+int classd_compute(int fd, struct file_content * pfc_pre, char * text, int * is_replying, ErrorMsg errmsg) {
+
+  struct precision pr;
+  struct background ba;
+  struct thermodynamics th;
+  struct perturbations pt;
+  struct primordial pm;
+  struct fourier fo;
+  struct transfer tr;
+  struct harmonic hr;
+  struct lensing le;
+  struct distortions sd;
+  struct output op;
+  struct file_content fc_request,fc;
+  struct file_content * pfc;
+  char titles[_MAXTITLESTRINGLENGTH_];
+  double * data;
+  double * pk;
+  double ** cl_md;
+  double ** cl_md_ic;
+  int status = 0;
+  int index_md,index_l,index_z,index_k,rows,columns,nl;
+  enum pk_outputs pk_output;
+
+  *is_replying = _FALSE_;
+
+  class_call(classd_read_request(text,&fc_request,errmsg),errmsg,errmsg);
+
+  pfc = &fc_request;
+  if ((pfc_pre->size > 0) && (fc_request.size > 0)) {
+    class_call(parser_cat(&fc_request,pfc_pre,&fc,errmsg),errmsg,errmsg);
+    pfc = &fc;
+  }
+  else if (pfc_pre->size > 0) {
+    pfc = pfc_pre;
+  }
+
+  class_call(input_read_from_file(pfc,&pr,&ba,&th,&pt,&tr,&pm,&hr,&fo,&le,&sd,&op,errmsg),errmsg,errmsg);
+
+  class_call(background_init(&pr,&ba),ba.error_message,errmsg);
+  class_call(thermodynamics_init(&pr,&ba,&th),th.error_message,errmsg);
+  class_call(perturbations_init(&pr,&ba,&th,&pt),pt.error_message,errmsg);
+  class_call(primordial_init(&pr,&pt,&pm),pm.error_message,errmsg);
+  class_call(fourier_init(&pr,&ba,&th,&pt,&pm,&fo),fo.error_message,errmsg);
+  class_call(transfer_init(&pr,&ba,&th,&pt,&fo,&tr),tr.error_message,errmsg);
+  class_call(perturbations_downsize_sources(&pt),pt.error_message,errmsg);
+  class_call(harmonic_init(&pr,&ba,&pt,&pm,&fo,&tr,&hr),hr.error_message,errmsg);
+  class_call(transfer_free_transfer_functions(&tr),tr.error_message,errmsg);
+  class_call(lensing_init(&pr,&pt,&hr,&fo,&le),le.error_message,errmsg);
+  class_call(distortions_init(&pr,&ba,&th,&pt,&pm,&sd),sd.error_message,errmsg);
+
+  *is_replying = _TRUE_;
+  class_test(classd_transfer(fd,&status,sizeof(int),_TRUE_) == _FAILURE_,
+             errmsg,
+             "could not send reply to client");
+
+  /** - unlensed and lensed C_l's */
+  if (pt.has_cls == _TRUE_) {
+
+    class_alloc(cl_md,hr.md_size*sizeof(double *),errmsg);
+    class_alloc(cl_md_ic,hr.md_size*sizeof(double *),errmsg);
+    for (index_md=0; index_md<hr.md_size; index_md++) {
+      class_alloc(cl_md[index_md],hr.ct_size*sizeof(double),errmsg);
+      class_alloc(cl_md_ic[index_md],hr.ic_ic_size[index_md]*hr.ct_size*sizeof(double),errmsg);
+    }
+
+    rows = hr.l_max_tot-1;
+    columns = hr.ct_size+1;
+    class_alloc(data,rows*columns*sizeof(double),errmsg);
+    for (index_l=0; index_l<rows; index_l++) {
+      data[index_l*columns] = index_l+2;
+      class_call(harmonic_cl_at_l(&hr,index_l+2,data+index_l*columns+1,cl_md,cl_md_ic),hr.error_message,errmsg);
+    }
+    classd_cl_titles(&hr,titles);
+    class_call(classd_send_block(fd,"cl",titles,rows,columns,data,errmsg),errmsg,errmsg);
+    free(data);
+
+    if (le.has_lensed_cls == _TRUE_) {
+      rows = le.l_lensed_max-1;
+      columns = le.lt_size+1;
+      class_alloc(data,rows*columns*sizeof(double),errmsg);
+      for (index_l=0; index_l<rows; index_l++) {
+        data[index_l*columns] = index_l+2;
+        class_call(lensing_cl_at_l(&le,index_l+2,data+index_l*columns+1),le.error_message,errmsg);
+      }
+      class_call(classd_send_block(fd,"cl_lensed",titles,rows,columns,data,errmsg),errmsg,errmsg);
+      free(data);
+    }
+  }
+
+  /** - linear and non-linear matter power spectrum at each z_pk */
+  if (pt.has_pk_matter == _TRUE_) {
+    for (nl=0; nl<2; nl++) {
+      pk_output = (nl == 0) ? pk_linear : pk_nonlinear;
+      if ((pk_output == pk_nonlinear) && (fo.method == nl_none))
+        continue;
+      rows = fo.k_size;
+      columns = op.z_pk_num+1;
+      class_alloc(data,rows*columns*sizeof(double),errmsg);
+      class_alloc(pk,fo.k_size*sizeof(double),errmsg);
+      strcpy(titles,"k");
+      for (index_k=0; index_k<rows; index_k++)
+        data[index_k*columns] = fo.k[index_k];
+      for (index_z=0; index_z<op.z_pk_num; index_z++) {
+        class_call(fourier_pk_at_z(&ba,&fo,linear,pk_output,op.z_pk[index_z],fo.index_pk_m,pk,NULL),
+                   fo.error_message,
+                   errmsg);
+        for (index_k=0; index_k<rows; index_k++)
+          data[index_k*columns+index_z+1] = pk[index_k];
+        sprintf(titles+strlen(titles),",z=%g",op.z_pk[index_z]);
+      }
+      class_call(classd_send_block(fd,(nl == 0) ? "pk" : "pk_nl",titles,rows,columns,data,errmsg),errmsg,errmsg);
+      free(pk);
+      free(data);
+    }
+  }
+
+  /** - background and thermodynamics tables, if requested */
+  if (op.write_background == _TRUE_) {
+    titles[0] = '\0';
+    class_call(background_output_titles(&ba,titles),ba.error_message,errmsg);
+    columns = get_number_of_titles(titles);
+    classd_comma_titles(titles);
+    class_alloc(data,columns*ba.bt_size*sizeof(double),errmsg);
+    class_call(background_output_data(&ba,columns,data),ba.error_message,errmsg);
+    class_call(classd_send_block(fd,"background",titles,ba.bt_size,columns,data,errmsg),errmsg,errmsg);
+    free(data);
+  }
+
+  if (op.write_thermodynamics == _TRUE_) {
+    titles[0] = '\0';
+    class_call(thermodynamics_output_titles(&ba,&th,titles),th.error_message,errmsg);
+    columns = get_number_of_titles(titles);
+    classd_comma_titles(titles);
+    class_alloc(data,columns*th.tt_size*sizeof(double),errmsg);
+    class_call(thermodynamics_output_data(&ba,&th,columns,data),th.error_message,errmsg);
+    class_call(classd_send_block(fd,"thermodynamics",titles,th.tt_size,columns,data,errmsg),errmsg,errmsg);
+    free(data);
+  }
+
+  /** - end of reply */
+  class_test(classd_send_string(fd,"") == _FAILURE_,
+             errmsg,
+             "could not send reply to client");
+
+  /* the child process exits after this request, which releases all
+     the memory of the modules at once */
+
+  return _SUCCESS_;
+}
+
+/**
+ * Serve one connection (in a child process).
+ *
+ * @param fd       Input: socket of the connection
+ * @param pfc_pre  Input: content of the precision file
+ * @return the error status
+ */
+
+int classd_serve(int fd, struct file_content * pfc_pre) {
+
+  ErrorMsg errmsg;
+  char * text;
+  int length,status,is_replying;
+
+  class_test(classd_transfer(fd,&length,sizeof(int),_FALSE_) == _FAILURE_,
+             errmsg,
+             "could not read request length");
+  class_test((length < 0) || (length > _CLASSD_REQUEST_SIZE_MAX_),
+             errmsg,
+             "request of %d bytes is too large",length);
+
+  class_alloc(text,length+1,errmsg);
+  class_test(classd_transfer(fd,text,length,_FALSE_) == _FAILURE_,
+             errmsg,
+             "could not read request");
+  text[length] = '\0';
+
+  if (classd_compute(fd,pfc_pre,text,&is_replying,errmsg) == _FAILURE_) {
+    /* after the success status, the client can only see a truncated reply */
+    if (is_replying == _FALSE_) {
+      status = 1;
+      if (classd_transfer(fd,&status,sizeof(int),_TRUE_) == _SUCCESS_)
+        classd_send_string(fd,errmsg);
+    }
+    return _FAILURE_;
+  }
+
+  free(text);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Load the tables read by every run (HyRec rates, BBN helium fraction)
+ * once in the parent process, with the paths of the precision file or
+ * the default ones.
+ *
+ * @param pfc_pre  Input: content of the precision file (size 0 if none)
+ * @param errmsg   Output: error message
+ * @return the error status
+ */
+
+int classd_load_tables(struct file_content * pfc_pre, ErrorMsg errmsg) {
+
+  struct precision pr;
+  FileArg value;
+  int found;
+
+  class_call(input_default_precisions(&pr),errmsg,errmsg);
+
+  if (pfc_pre->size > 0) {
+    class_call(parser_read_string(pfc_pre,"hyrec_path",&value,&found,errmsg),errmsg,errmsg);
+    if (found == _TRUE_)
+      strcpy(pr.hyrec_path,value);
+    class_call(parser_read_string(pfc_pre,"sBBN file",&value,&found,errmsg),errmsg,errmsg);
+    if (found == _TRUE_)
+      strcpy(pr.sBBN_file,value);
+  }
+
+  class_call(thermodynamics_hyrec_load_tables(pr.hyrec_path,errmsg),errmsg,errmsg);
+  class_call(thermodynamics_load_bbn_table(pr.sBBN_file,errmsg),errmsg,errmsg);
+
+  return _SUCCESS_;
+}
+
+int main(int argc, char **argv) {
+
+  struct file_content fc_pre;
+  struct sockaddr_un address;
+  ErrorMsg errmsg;
+  char * socket_name = NULL;
+  char * precision_file = NULL;
+  char threads[16];
+  int jobs = 1;
+  int running = 0;
+  int i,listen_fd,fd,cores;
+  pid_t pid;
+
+  for (i=1; i<argc; i++) {
+    if ((strcmp(argv[i],"-j") == 0) && (i+1 < argc))
+      jobs = atoi(argv[++i]);
+    else if ((strlen(argv[i]) > 4) && (strcmp(argv[i]+strlen(argv[i])-4,".pre") == 0))
+      precision_file = argv[i];
+    else
+      socket_name = argv[i];
+  }
+
+  if ((socket_name == NULL) || (jobs < 1) || (strlen(socket_name) >= sizeof(address.sun_path))) {
+    printf("Usage: %s <socket> [file.pre] [-j <jobs>]\n",argv[0]);
+    return _FAILURE_;
+  }
+
+  /** - read the precision file once */
+  fc_pre.size = 0;
+  if ((precision_file != NULL) && (parser_read_file(precision_file,&fc_pre,errmsg) == _FAILURE_)) {
+    printf("\n\nError reading precision file \n=>%s\n",errmsg);
+    return _FAILURE_;
+  }
+
+  /** - read the HyRec rate tables and the BBN table once, so that the
+        children inherit them instead of reading the files again (a
+        request setting another hyrec_path or sBBN file reads its own) */
+  if (classd_load_tables(&fc_pre,errmsg) == _FAILURE_) {
+    printf("\n\nError loading tables \n=>%s\n",errmsg);
+    return _FAILURE_;
+  }
+
+  /** - share the cores among concurrent requests, unless the user fixed the number of threads */
+  cores = sysconf(_SC_NPROCESSORS_ONLN);
+  if (getenv("OMP_NUM_THREADS") == NULL) {
+    sprintf(threads,"%d",MAX(1,cores/jobs));
+    setenv("OMP_NUM_THREADS",threads,1);
+  }
+
+  /** - listen on the socket */
+  listen_fd = socket(AF_UNIX,SOCK_STREAM,0);
+  memset(&address,0,sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path,socket_name);
+  unlink(socket_name);
+
+  if ((listen_fd < 0) ||
+      (bind(listen_fd,(struct sockaddr *)&address,sizeof(address)) != 0) ||
+      (listen(listen_fd,64) != 0)) {
+    printf("\n\nError: could not listen on socket %s\n",socket_name);
+    return _FAILURE_;
+  }
+
+  /* a client closing its connection early should only stop the corresponding child */
+  signal(SIGPIPE,SIG_IGN);
+
+  printf("classd listening on %s with %d job(s)\n",socket_name,jobs);
+  fflush(stdout);
+
+  /** - fork one child per connection, with at most 'jobs' children at a time */
+  while (1) {
+
+    while ((running > 0) && (waitpid(-1,NULL,(running < jobs) ? WNOHANG : 0) > 0))
+      running--;
+
+    fd = accept(listen_fd,NULL,NULL);
+    if (fd < 0)
+      continue;
+
+    pid = fork();
+
+    if (pid == 0) {
+      close(listen_fd);
+      if (classd_serve(fd,&fc_pre) == _FAILURE_) {
+        close(fd);
+        _exit(1);
+      }
+      close(fd);
+      _exit(0);
+    }
+
+    close(fd);
+    if (pid > 0)
+      running++;
+  }
+
+  return _SUCCESS_;
+}
@@ -98,6 +98,7 @@ cdef extern from "class.h":
         double Omega0_scf
         double Omega0_k
         int bt_size
+        double * background_table
         double Omega0_m
         double Omega0_r
         double Omega0_de
@@ -141,6 +142,7 @@ cdef extern from "class.h":
         double cross_idm_b
         double n_index_idm_b
         int tt_size
+        double * thermodynamics_table
 
     cdef struct perturbations:
         short is_allocated
@@ -351,6 +353,8 @@ cdef extern from "class.h":
         int index_ct_tl
         int * l_size
         int index_md_scalars
+        double correction_drift
+        short correction_is_applied
 
     cdef struct output:
         ErrorMsg error_message
@@ -419,7 +423,11 @@ cdef extern from "class.h":
         double * tau
         double ** ln_pk_l
         double ** ln_pk_nl
+        short pk_is_growth_factorised
+        double * ln_D2
         double * sigma8
+        double correction_drift
+        short correction_is_applied
         int has_pk_m
         int has_pk_cb
         int index_pk_m
@@ -449,6 +457,9 @@ cdef extern from "class.h":
     cdef int _FALSE_
     cdef int _TRUE_
 
+    cdef int _BGD_PARAMETERS_SIZE_
+    cdef int _BGD_QUANTITIES_SIZE_
+
     int input_read_from_file(void*, void*, void*, void*, void*, void*, void*, void*, void*,
         void*, void*, void*, char*)
     int background_init(void*,void*)
@@ -459,18 +470,27 @@ cdef extern from "class.h":
     int transfer_init(void*,void*,void*,void*,void*,void*)
     int harmonic_init(void*,void*,void*,void*,void*,void*,void*)
     int lensing_init(void*,void*,void*,void*,void*)
+    int perturbations_downsize_sources(void*)
+    int transfer_free_transfer_functions(void*)
     int distortions_init(void*,void*,void*,void*,void*,void*)
 
+    int class_run_aborted(void*)
+
     int background_tau_of_z(void* pba, double z,double* tau)
     int background_z_of_tau(void* pba, double tau,double* z)
     int background_at_z(void* pba, double z, int return_format, int inter_mode, int * last_index, double *pvecback)
     int background_at_tau(void* pba, double tau, int return_format, int inter_mode, int * last_index, double *pvecback)
     int background_output_titles(void * pba, char titles[8000])
+    int background_derivatives_at_z(void* pba, double* z, int z_size, double* values, double* derivatives)
     int background_output_data(void *pba, int number_of_titles, double *data)
+    int background_output_derived_data(void *pba, int index_tau, double *dataptr, int *storeidx)
+    int background_output_columns(void *pba, int number_of_titles, int *index_column)
 
     int thermodynamics_at_z(void * pba, void * pth, double z, int inter_mode, int * last_index, double *pvecback, double *pvecthermo)
     int thermodynamics_output_titles(void * pba, void *pth, char titles[8000])
     int thermodynamics_output_data(void *pba, void *pth, int number_of_titles, double *data)
+    int thermodynamics_output_derived_data(void *pba, void *pth, int index_z, double *dataptr, int *storeidx)
+    int thermodynamics_output_columns(void *pba, void *pth, int number_of_titles, int *index_column)
 
     int perturbations_output_data_at_z(void *pba,void *ppt, file_format output_format, double z, int number_of_titles, double *data)
     int perturbations_output_data_at_index_tau(void *pba,void *ppt, file_format output_format, int ondex_tau, int number_of_titles, double *data)
@@ -575,6 +595,18 @@ cdef extern from "class.h":
         double * out_pk,
         double * out_pk_cb)
 
+    int fourier_pk_at_kvec_and_zvec(
+        void * pba,
+        void * ppm,
+        void * pfo,
+        pk_outputs pk_output,
+        double * kvec,
+        int kvec_size,
+        double * zvec,
+        int zvec_size,
+        int index_pk,
+        double * out_pk) nogil
+
     int fourier_hmcode_sigma8_at_z(void* pba, void* pfo, double z, double* sigma_8, double* sigma_8_cb)
     int fourier_hmcode_sigmadisp_at_z(void* pba, void* pfo, double z, double* sigma_disp, double* sigma_disp_cb)
     int fourier_hmcode_sigmadisp100_at_z(void* pba, void* pfo, double z, double* sigma_disp_100, double* sigma_disp_100_cb)
@@ -17,14 +17,18 @@ cimport numpy as np
 from libc.stdlib cimport *
 from libc.stdio cimport *
 from libc.string cimport *
+from cpython.buffer cimport PyBUF_WRITABLE
 import cython
 cimport cython
 from scipy.interpolate import CubicSpline
 from scipy.interpolate import UnivariateSpline
 from scipy.interpolate import interp1d
+from collections import OrderedDict
+import weakref
 
 # Nils : Added for python 3.x and python 2.x compatibility
 import sys
+import os
 def viewdictitems(d):
     if sys.version_info >= (3,0):
         return d.items()
@@ -78,6 +82,120 @@ class CosmoComputationError(CosmoError):
     pass
 
 
+class CosmoTimeoutError(CosmoComputationError):
+    """
+    Raised when the computation was stopped because it went past the
+    time limit given to Class.compute (input parameter max_run_time).
+    """
+    pass
+
+
+cdef class _TableView:
+    """
+    Read-only buffer on a table of a computed structure, from which
+    NumPy views are made without copying the table. When the structure
+    is freed or moved to the memoisation cache (see Class.struct_cleanup),
+    the views still alive keep the original table, and the structure
+    gets a copy of it. There is at most one buffer per table, shared by
+    all the arrays on it (see Class._table_view).
+    """
+    cdef double ** slot   # Location of the table pointer in the structure (NULL once detached)
+    cdef double * data    # Table exposed by the buffer
+    cdef int owns_data    # Flag to see if the table must be freed with the buffer
+    cdef Py_ssize_t shape[2]
+    cdef Py_ssize_t strides[2]
+    cdef object __weakref__
+
+    def __cinit__(self):
+        self.slot = NULL
+        self.data = NULL
+        self.owns_data = False
+
+    def __dealloc__(self):
+        if self.owns_data:
+            free(self.data)
+
+    def __getbuffer__(self, Py_buffer *buffer, int flags):
+        if flags & PyBUF_WRITABLE:
+            raise BufferError("The tables of a computed model are read-only")
+        buffer.buf = self.data
+        buffer.format = 'd'
+        buffer.internal = NULL
+        buffer.itemsize = sizeof(double)
+        buffer.len = self.shape[0]*self.shape[1]*sizeof(double)
+        buffer.ndim = 2
+        buffer.obj = self
+        buffer.readonly = 1
+        buffer.shape = self.shape
+        buffer.strides = self.strides
+        buffer.suboffsets = NULL
+
+    def __releasebuffer__(self, Py_buffer *buffer):
+        pass
+
+    cdef detach(self):
+        cdef size_t size = self.shape[0]*self.shape[1]*sizeof(double)
+        cdef double * copy
+        if self.slot == NULL:
+            return
+        if self.slot[0] == self.data:
+            copy = <double*>malloc(size)
+            assert(copy!=NULL)
+            memcpy(copy, self.data, size)
+            self.slot[0] = copy
+            self.owns_data = True
+        self.slot = NULL
+
+
+cdef class _ComputedStructures:
+    """
+    Structures of one computed model, kept in the memoisation cache of a
+    Class instance (see Class.set_memoisation). The entry owns the
+    tables of the structures until it is moved back into the instance
+    that computed it, or evicted from the cache.
+    """
+    cdef precision pr
+    cdef background ba
+    cdef thermodynamics th
+    cdef perturbations pt
+    cdef primordial pm
+    cdef fourier fo
+    cdef transfer tr
+    cdef harmonic hr
+    cdef output op
+    cdef lensing le
+    cdef distortions sd
+
+    cdef object ncp        # Structures initialized in this entry
+    cdef int owns_memory   # Flag to see if the tables must be freed with the entry
+
+    def __cinit__(self):
+        self.owns_memory = False
+
+    def __dealloc__(self):
+        if not self.owns_memory:
+            return
+        if self.sd.is_allocated:
+            distortions_free(&self.sd)
+        if self.le.is_allocated:
+            lensing_free(&self.le)
+        if self.hr.is_allocated:
+            harmonic_free(&self.hr)
+        if self.tr.is_allocated:
+            transfer_free(&self.tr)
+        if self.fo.is_allocated:
+            fourier_free(&self.fo)
+        if self.pm.is_allocated:
+            primordial_free(&self.pm)
+        if self.pt.is_allocated:
+            perturbations_free(&self.pt)
+        if self.th.is_allocated:
+            thermodynamics_free(&self.th)
+        if self.ba.is_allocated:
+            background_free(&self.ba)
+        self.owns_memory = False
+
+
 cdef class Class:
     """
     Class wrapping, creates the glue between C and python
@@ -106,6 +224,12 @@ cdef class Class:
     cdef int allocated # Flag to see if classy structs are allocated already
     cdef object _pars # Dictionary of the parameters
     cdef object ncp   # Keeps track of the structures initialized, in view of cleaning.
+    cdef object _correction_reference # Reference precision parameters for refreshing a multi-fidelity correction
+    cdef object _memo # Memoisation cache, from parameter keys to computed structures, least recently used first
+    cdef int _memo_size # Maximum number of models in the memoisation cache (0: no memoisation)
+    cdef object _table_views # Weak references to the read-only views on tables of the structures, by table location
+    cdef object _computed_key # Memoisation key of the computed structures (None if they cannot be memoised)
+    cdef int _sources_downsized # Were the structures restored from the memoisation cache, with late-time sources only?
 
     # Defining two new properties to recover, respectively, the parameters used
     # or the age (set after computation). Follow this syntax if you want to
@@ -140,9 +264,17 @@ cdef class Class:
         dumc = "NOFILE"
         sprintf(self.fc.filename,"%s",dumc)
         self.ncp = set()
+        self._correction_reference = None
+        self._memo = OrderedDict()
+        self._memo_size = 0
+        self._computed_key = None
+        self._sources_downsized = False
+        self._table_views = {}
         if default: self.set_default()
 
     def __dealloc__(self):
+        self._memo_size = 0
+        self._memo = None
         if self.allocated:
           self.struct_cleanup()
         self.empty()
@@ -173,40 +305,51 @@ cdef class Class:
 
     # Create an equivalent of the parameter file. Non specified values will be
     # taken at their default (in Class)
-    def _fillparfile(self):
+    def _fillparfile(self, extra_pars={}):
         cdef char* dumc
 
+        # extra_pars are passed to CLASS without being part of the model
+        # (e.g. the time limit of compute), hence not stored in self._pars
+        pars = dict(self._pars)
+        pars.update(extra_pars)
+
         if self.fc.size!=0:
             free(self.fc.name)
             free(self.fc.value)
             free(self.fc.read)
-        self.fc.size = len(self._pars)
-        self.fc.name = <FileArg*> malloc(sizeof(FileArg)*len(self._pars))
+        self.fc.size = len(pars)
+        self.fc.name = <FileArg*> malloc(sizeof(FileArg)*len(pars))
         assert(self.fc.name!=NULL)
 
-        self.fc.value = <FileArg*> malloc(sizeof(FileArg)*len(self._pars))
+        self.fc.value = <FileArg*> malloc(sizeof(FileArg)*len(pars))
         assert(self.fc.value!=NULL)
 
-        self.fc.read = <short*> malloc(sizeof(short)*len(self._pars))
+        self.fc.read = <short*> malloc(sizeof(short)*len(pars))
         assert(self.fc.read!=NULL)
 
         # fill parameter file
         i = 0
-        for kk in self._pars:
+        for kk in pars:
 
             dumcp = kk.strip().encode()
             dumc = dumcp
             sprintf(self.fc.name[i],"%s",dumc)
-            dumcp = str(self._pars[kk]).strip().encode()
+            dumcp = str(pars[kk]).strip().encode()
             dumc = dumcp
             sprintf(self.fc.value[i],"%s",dumc)
             self.fc.read[i] = _FALSE_
             i+=1
 
-    # Called at the end of a run, to free memory
+    # Called at the end of a run, to free memory (or to move the structures
+    # to the memoisation cache, if enabled)
     def struct_cleanup(self):
         if(self.allocated != True):
           return
+        self._detach_table_views()
+        if self._computed_key is not None and self._memo_size > 0:
+            self._memo_store()
+            return
+        self._computed_key = None
         if self.sd.is_allocated:
             distortions_free(&self.sd)
         if self.le.is_allocated:
@@ -230,6 +373,180 @@ cdef class Class:
         self.allocated = False
         self.computed = False
 
+    def set_memoisation(self, size=16):
+        """
+        set_memoisation(size=16)
+
+        Enable the memoisation of computed models.
+
+        When compute() is called with a parameter set already computed
+        by this instance, the structures of that model are restored from
+        a cache instead of being computed again, and all accessors
+        (Cl's, P(k), background and thermodynamics tables, derived
+        parameters, ...) are served from them. Structures released by
+        struct_cleanup() or by a new compute() go to the cache, which
+        keeps the `size` most recently used models and frees the others.
+        The key of each model is the full parameter set, including the
+        precision parameters, as passed to CLASS. To save memory, the
+        cache only keeps the late-time part of the source functions (as
+        the class executable does) and drops the transfer functions
+        Delta_l(q), which are only needed to compute the Cl's: calling
+        get_sources() on a restored model computes it again. Models using a
+        multi-fidelity correction ('correction_mode') are never memoised,
+        since they depend on the content of the correction file.
+
+        Parameters
+        ----------
+        size : int
+                Maximum number of models kept in the cache. 0 disables
+                the memoisation and empties the cache.
+        """
+        if size < 0:
+            raise CosmoSevereError("The memoisation cache size must be positive, got %s" % size)
+        self._memo_size = size
+        while len(self._memo) > self._memo_size:
+            self._memo.popitem(last=False)
+
+    def clear_memoisation(self):
+        """
+        Free all the models kept in the memoisation cache, keeping the
+        memoisation enabled.
+        """
+        self._memo.clear()
+
+    def _memo_key(self):
+        """
+        Canonical key of the current parameter set, as seen by CLASS (see
+        _fillparfile), or None if the model cannot be memoised.
+        """
+        if self._memo_size == 0:
+            return None
+        if str(self._pars.get("correction_mode", "none")).strip() != "none":
+            return None
+        return tuple(sorted((str(key).strip(), str(value).strip())
+                            for key, value in self._pars.items()))
+
+    def _memo_store(self):
+        """
+        Move the computed structures of this instance to the memoisation
+        cache, evicting the least recently used models.
+        """
+        cdef _ComputedStructures entry = _ComputedStructures()
+
+        # keep only what the accessors of a restored model need: the
+        # late-time sources (for P(k) and transfer functions at
+        # z <= z_max_pk), and not the transfer functions Delta_l(q)
+        if perturbations_downsize_sources(&self.pt) == _FAILURE_:
+            raise CosmoSevereError(self.pt.error_message)
+        if transfer_free_transfer_functions(&self.tr) == _FAILURE_:
+            raise CosmoSevereError(self.tr.error_message)
+
+        entry.pr = self.pr
+        entry.ba = self.ba
+        entry.th = self.th
+        entry.pt = self.pt
+        entry.pm = self.pm
+        entry.fo = self.fo
+        entry.tr = self.tr
+        entry.hr = self.hr
+        entry.op = self.op
+        entry.le = self.le
+        entry.sd = self.sd
+        entry.ncp = self.ncp
+        entry.owns_memory = True
+
+        # the tables now belong to the entry: make sure that they can
+        # never be freed through this instance
+        memset(&self.ba, 0, sizeof(background))
+        memset(&self.th, 0, sizeof(thermodynamics))
+        memset(&self.pt, 0, sizeof(perturbations))
+        memset(&self.pm, 0, sizeof(primordial))
+        memset(&self.fo, 0, sizeof(fourier))
+        memset(&self.tr, 0, sizeof(transfer))
+        memset(&self.hr, 0, sizeof(harmonic))
+        memset(&self.le, 0, sizeof(lensing))
+        memset(&self.sd, 0, sizeof(distortions))
+
+        self._memo[self._computed_key] = entry
+        self._memo.move_to_end(self._computed_key)
+        while len(self._memo) > self._memo_size:
+            self._memo.popitem(last=False)
+
+        self._computed_key = None
+        self.ncp = set()
+        self.allocated = False
+        self.computed = False
+
+    def _memo_restore(self, key, level):
+        """
+        Move the structures memoised under key back into this instance,
+        if they contain all the modules in level. Return True on success.
+        """
+        cdef _ComputedStructures entry
+        if key is None or key not in self._memo:
+            return False
+        entry = self._memo.pop(key)
+        if not entry.ncp.issuperset(level):
+            # incomplete model, freed with the entry and computed again
+            return False
+
+        # the structures must come back to the same addresses, since
+        # some of them point to each other (e.g. harmonic to fourier)
+        self.pr = entry.pr
+        self.ba = entry.ba
+        self.th = entry.th
+        self.pt = entry.pt
+        self.pm = entry.pm
+        self.fo = entry.fo
+        self.tr = entry.tr
+        self.hr = entry.hr
+        self.op = entry.op
+        self.le = entry.le
+        self.sd = entry.sd
+        entry.owns_memory = False
+
+        self.ncp = entry.ncp
+        self._computed_key = key
+        self._sources_downsized = True
+        self.allocated = True
+        self.computed = True
+        return True
+
+    cdef object _table_view(self, double ** slot, Py_ssize_t rows, Py_ssize_t columns):
+        """
+        Read-only NumPy array on the table *slot of rows x columns values
+        of the structures, without copy.
+        """
+        cdef _TableView view
+        cdef size_t key = <size_t>slot
+        # a single view owns each table: the arrays on the same table all
+        # share it, so that it is detached (and freed) only once
+        reference = self._table_views.get(key)
+        view = reference() if reference is not None else None
+        if view is None or view.data != slot[0]:
+            view = _TableView()
+            view.slot = slot
+            view.data = slot[0]
+            view.shape[0] = rows
+            view.shape[1] = columns
+            view.strides[0] = columns*sizeof(double)
+            view.strides[1] = sizeof(double)
+            self._table_views = {other: other_reference for other, other_reference in self._table_views.items() if other_reference() is not None}
+            self._table_views[key] = weakref.ref(view)
+        return np.asarray(view)
+
+    def _detach_table_views(self):
+        """
+        Give their own table to the views still alive, before the structures
+        are freed or moved.
+        """
+        cdef _TableView view
+        for reference in self._table_views.values():
+            view = reference()
+            if view is not None:
+                view.detach()
+        self._table_views = {}
+
     def _check_task_dependency(self, level):
         """
         Fill the level list with all the needed modules
@@ -300,9 +617,9 @@ cdef class Class:
             return True
         return False
 
-    def compute(self, level=["distortions"]):
+    def compute(self, level=["distortions"], timeout=None):
         """
-        compute(level=["distortions"])
+        compute(level=["distortions"], timeout=None)
 
         Main function, execute all the _init methods for all desired modules.
         This is called in MontePython, and this ensures that the Class instance
@@ -316,6 +633,12 @@ cdef class Class:
                 _check_task_dependency will then add to this list all the
                 necessary modules to compute in order to initialize this last
                 one. The default last module is "lensing".
+        timeout : float, optional
+                maximum wall-clock time of the computation in seconds,
+                including the shooting. Beyond it, the computation stops
+                and raises a CosmoTimeoutError (a CosmoComputationError),
+                after freeing the structures. Models restored from the
+                memoisation cache are not affected.
 
         .. warning::
 
@@ -339,11 +662,22 @@ cdef class Class:
         if self.allocated:
             self.struct_cleanup()
 
-        # Otherwise, proceed with the normal computation.
+        # Otherwise, restore the model from the memoisation cache, or
+        # proceed with the normal computation.
         self.computed = False
+        memo_key = self._memo_key()
+        if self._memo_restore(memo_key, level):
+            return
+        self._sources_downsized = False
 
         # Equivalent of writing a parameter file
-        self._fillparfile()
+        extra_pars = {}
+        if timeout is not None:
+            extra_pars["max_run_time"] = timeout
+        if (self._correction_reference is not None and
+            str(self._pars.get("correction_mode", "none")).strip() == "apply"):
+            extra_pars["correction_reference_precision"] = self._write_correction_reference()
+        self._fillparfile(extra_pars)
 
         # self.ncp will contain the list of computed modules (under the form of
         # a set, instead of a python list)
@@ -363,6 +697,8 @@ cdef class Class:
             if input_read_from_file(&self.fc, &self.pr, &self.ba, &self.th,
                                     &self.pt, &self.tr, &self.pm, &self.hr,
                                     &self.fo, &self.le, &self.sd, &self.op, errmsg) == _FAILURE_:
+                if class_run_aborted(&self.pr):
+                    raise CosmoTimeoutError(errmsg)
                 raise CosmoSevereError(errmsg)
             self.ncp.add("input")
             # This part is done to list all the unread parameters, for debugging
@@ -383,42 +719,42 @@ cdef class Class:
         if "background" in level:
             if background_init(&(self.pr), &(self.ba)) == _FAILURE_:
                 self.struct_cleanup()
-                raise CosmoComputationError(self.ba.error_message)
+                raise self._computation_error(self.ba.error_message)
             self.ncp.add("background")
 
         if "thermodynamics" in level:
             if thermodynamics_init(&(self.pr), &(self.ba),
                                    &(self.th)) == _FAILURE_:
                 self.struct_cleanup()
-                raise CosmoComputationError(self.th.error_message)
+                raise self._computation_error(self.th.error_message)
             self.ncp.add("thermodynamics")
 
         if "perturb" in level:
             if perturbations_init(&(self.pr), &(self.ba),
                             &(self.th), &(self.pt)) == _FAILURE_:
                 self.struct_cleanup()
-                raise CosmoComputationError(self.pt.error_message)
+                raise self._computation_error(self.pt.error_message)
             self.ncp.add("perturb")
 
         if "primordial" in level:
             if primordial_init(&(self.pr), &(self.pt),
                                &(self.pm)) == _FAILURE_:
                 self.struct_cleanup()
-                raise CosmoComputationError(self.pm.error_message)
+                raise self._computation_error(self.pm.error_message)
             self.ncp.add("primordial")
 
         if "fourier" in level:
             if fourier_init(&self.pr, &self.ba, &self.th,
                               &self.pt, &self.pm, &self.fo) == _FAILURE_:
                 self.struct_cleanup()
-                raise CosmoComputationError(self.fo.error_message)
+                raise self._computation_error(self.fo.error_message)
             self.ncp.add("fourier")
 
         if "transfer" in level:
             if transfer_init(&(self.pr), &(self.ba), &(self.th),
                              &(self.pt), &(self.fo), &(self.tr)) == _FAILURE_:
                 self.struct_cleanup()
-                raise CosmoComputationError(self.tr.error_message)
+                raise self._computation_error(self.tr.error_message)
             self.ncp.add("transfer")
 
         if "harmonic" in level:
@@ -426,29 +762,76 @@ cdef class Class:
                             &(self.pm), &(self.fo), &(self.tr),
                             &(self.hr)) == _FAILURE_:
                 self.struct_cleanup()
-                raise CosmoComputationError(self.hr.error_message)
+                raise self._computation_error(self.hr.error_message)
             self.ncp.add("harmonic")
 
         if "lensing" in level:
             if lensing_init(&(self.pr), &(self.pt), &(self.hr),
                             &(self.fo), &(self.le)) == _FAILURE_:
                 self.struct_cleanup()
-                raise CosmoComputationError(self.le.error_message)
+                raise self._computation_error(self.le.error_message)
             self.ncp.add("lensing")
 
         if "distortions" in level:
             if distortions_init(&(self.pr), &(self.ba), &(self.th),
                                 &(self.pt), &(self.pm), &(self.sd)) == _FAILURE_:
                 self.struct_cleanup()
-                raise CosmoComputationError(self.sd.error_message)
+                raise self._computation_error(self.sd.error_message)
             self.ncp.add("distortions")
 
         self.computed = True
+        self._computed_key = memo_key
 
         # At this point, the cosmological instance contains everything needed. The
         # following functions are only to output the desired numbers
         return
 
+    def _computation_error(self, message):
+        """
+        Exception raised when a module failed: CosmoTimeoutError if the
+        run was stopped by the time limit of compute, CosmoComputationError
+        otherwise (even if the error happened after the time limit).
+        """
+        if class_run_aborted(&self.pr):
+            return CosmoTimeoutError(message)
+        return CosmoComputationError(message)
+
+    def set_correction_reference(self, reference_precision):
+        """
+        set_correction_reference(reference_precision)
+
+        Enable the automatic refresh of a multi-fidelity correction.
+
+        With 'correction_mode':'apply' and a 'correction_file', the
+        spectra of each (fast precision) run are corrected by the
+        reference/fast ratio of a fiducial model stored in the file.
+        When CLASS finds the file incomplete, or the parameters further
+        than 'correction_max_drift' from the fiducial model, the
+        current parameters become the new fiducial model: they are
+        computed once with these reference precision parameters, and
+        once with the current ones, before the current model is
+        corrected. This is the 'correction_reference_precision' input
+        of CLASS, with the parameters written to '<correction_file>.pre'.
+
+        Parameters
+        ----------
+        reference_precision : dict
+                Precision parameters of the reference runs (e.g. the
+                content of cl_ref.pre), overriding the current ones.
+        """
+        self._correction_reference = dict(reference_precision)
+
+    def _write_correction_reference(self):
+        filename = str(self._pars.get("correction_file", "")).strip() + ".pre"
+        content = "".join("%s = %s\n" % (key, value) for key, value in self._correction_reference.items())
+        # written under a temporary name and renamed, for other instances
+        # reading the same file
+        temporary = "%s.%d.tmp" % (filename, os.getpid())
+        with open(temporary, "w") as precision_file:
+            precision_file.write(content)
+        os.replace(temporary, filename)
+        return filename
+
     def set_baseline(self, baseline_name):
         # Taken from montepython [https://github.com/brinckmann/montepython_public] (see also 1210.7183, 1804.07261)
         if ('planck' in baseline_name and '18' in baseline_name and 'lens' in baseline_name and 'bao' in baseline_name) or 'p18lb' in baseline_name.lower():
@@ -872,11 +1255,60 @@ cdef class Class:
 
         return (lum_distance[0] if np.isscalar(z) else lum_distance)
 
+    cdef _pk_at_k_and_z(self, k, z, pk_outputs pk_output, int index_pk):
+        """
+        P(k,z) of type index_pk for numbers or arrays k and z broadcast
+        against each other: a number if both are numbers, an array of
+        their broadcast shape otherwise.
+
+        The points are sorted by z and then k, and each group sharing the
+        same z is passed to fourier_pk_at_kvec_and_zvec() in one call
+        (releasing the GIL), so that P(k) is splined once per distinct z
+        and the k are found by hunting.
+        """
+        cdef double pk_value
+        cdef int index_start, index_end, status
+        cdef double[::1] k_view, z_view, pk_view
+
+        if np.ndim(k) == 0 and np.ndim(z) == 0:
+            if fourier_pk_at_k_and_z(&self.ba,&self.pm,&self.fo,pk_output,k,z,index_pk,&pk_value,NULL)==_FAILURE_:
+                raise CosmoSevereError(self.fo.error_message)
+            return pk_value
+
+        k_array, z_array = np.broadcast_arrays(np.asarray(k, dtype=np.float64), np.asarray(z, dtype=np.float64))
+        shape = k_array.shape
+        k_array = k_array.ravel()
+        z_array = z_array.ravel()
+
+        order = np.lexsort((k_array, z_array))
+        k_view = np.ascontiguousarray(k_array[order])
+        z_view = np.ascontiguousarray(z_array[order])
+        pk_sorted = np.empty(len(order), dtype=np.float64)
+        pk_view = pk_sorted
+
+        starts = np.flatnonzero(np.diff(z_array[order], prepend=np.nan) != 0)
+        ends = np.append(starts[1:], len(order))
+        for index_start, index_end in zip(starts, ends):
+            with nogil:
+                status = fourier_pk_at_kvec_and_zvec(&self.ba,&self.pm,&self.fo,pk_output,
+                                                     &k_view[index_start],index_end-index_start,
+                                                     &z_view[index_start],1,
+                                                     index_pk,&pk_view[index_start])
+            if status == _FAILURE_:
+                raise CosmoSevereError(self.fo.error_message)
+
+        pk = np.empty(len(order), dtype=np.float64)
+        pk[order] = pk_sorted
+        return pk.reshape(shape)
+
     # Gives the total matter pk for a given (k,z)
-    def pk(self,double k,double z):
+    def pk(self,k,z):
         """
         Gives the total matter pk (in Mpc**3) for a given k (in 1/Mpc) and z (will be non linear if requested to Class, linear otherwise)
 
+        k and z can be numbers, or arrays broadcast against each other
+        (e.g. k of shape (N,) and z of shape (M,1) for a (M,N) grid).
+
         .. note::
 
             there is an additional check that output contains `mPk`,
@@ -885,25 +1317,21 @@ cdef class Class:
         """
         self.compute(["fourier"])
 
-        cdef double pk
-
         if (self.pt.has_pk_matter == _FALSE_):
             raise CosmoSevereError("No power spectrum computed. You must add mPk to the list of outputs.")
 
         if (self.fo.method == nl_none):
-            if fourier_pk_at_k_and_z(&self.ba,&self.pm,&self.fo,pk_linear,k,z,self.fo.index_pk_m,&pk,NULL)==_FAILURE_:
-                raise CosmoSevereError(self.fo.error_message)
+            return self._pk_at_k_and_z(k,z,pk_linear,self.fo.index_pk_m)
         else:
-            if fourier_pk_at_k_and_z(&self.ba,&self.pm,&self.fo,pk_nonlinear,k,z,self.fo.index_pk_m,&pk,NULL)==_FAILURE_:
-                raise CosmoSevereError(self.fo.error_message)
-
-        return pk
+            return self._pk_at_k_and_z(k,z,pk_nonlinear,self.fo.index_pk_m)
 
     # Gives the cdm+b pk for a given (k,z)
-    def pk_cb(self,double k,double z):
+    def pk_cb(self,k,z):
         """
         Gives the cdm+b pk (in Mpc**3) for a given k (in 1/Mpc) and z (will be non linear if requested to Class, linear otherwise)
 
+        k and z can be numbers, or arrays broadcast against each other (see pk).
+
         .. note::
 
             there is an additional check that output contains `mPk`,
@@ -912,27 +1340,23 @@ cdef class Class:
         """
         self.compute(["fourier"])
 
-        cdef double pk_cb
-
         if (self.pt.has_pk_matter == _FALSE_):
             raise CosmoSevereError("No power spectrum computed. You must add mPk to the list of outputs.")
         if (self.fo.has_pk_cb == _FALSE_):
             raise CosmoSevereError("P_cb not computed (probably because there are no massive neutrinos) so you cannot ask for it")
 
         if (self.fo.method == nl_none):
-            if fourier_pk_at_k_and_z(&self.ba,&self.pm,&self.fo,pk_linear,k,z,self.fo.index_pk_cb,&pk_cb,NULL)==_FAILURE_:
-                raise CosmoSevereError(self.fo.error_message)
+            return self._pk_at_k_and_z(k,z,pk_linear,self.fo.index_pk_cb)
         else:
-            if fourier_pk_at_k_and_z(&self.ba,&self.pm,&self.fo,pk_nonlinear,k,z,self.fo.index_pk_cb,&pk_cb,NULL)==_FAILURE_:
-                raise CosmoSevereError(self.fo.error_message)
-
-        return pk_cb
+            return self._pk_at_k_and_z(k,z,pk_nonlinear,self.fo.index_pk_cb)
 
     # Gives the total matter pk for a given (k,z)
-    def pk_lin(self,double k,double z):
+    def pk_lin(self,k,z):
         """
         Gives the linear total matter pk (in Mpc**3) for a given k (in 1/Mpc) and z
 
+        k and z can be numbers, or arrays broadcast against each other (see pk).
+
         .. note::
 
             there is an additional check that output contains `mPk`,
@@ -941,21 +1365,18 @@ cdef class Class:
         """
         self.compute(["fourier"])
 
-        cdef double pk_lin
-
         if (self.pt.has_pk_matter == _FALSE_):
             raise CosmoSevereError("No power spectrum computed. You must add mPk to the list of outputs.")
 
-        if fourier_pk_at_k_and_z(&self.ba,&self.pm,&self.fo,pk_linear,k,z,self.fo.index_pk_m,&pk_lin,NULL)==_FAILURE_:
-            raise CosmoSevereError(self.fo.error_message)
-
-        return pk_lin
+        return self._pk_at_k_and_z(k,z,pk_linear,self.fo.index_pk_m)
 
     # Gives the cdm+b pk for a given (k,z)
-    def pk_cb_lin(self,double k,double z):
+    def pk_cb_lin(self,k,z):
         """
         Gives the linear cdm+b pk (in Mpc**3) for a given k (in 1/Mpc) and z
 
+        k and z can be numbers, or arrays broadcast against each other (see pk).
+
         .. note::
 
             there is an additional check that output contains `mPk`,
@@ -964,70 +1385,29 @@ cdef class Class:
         """
         self.compute(["fourier"])
 
-        cdef double pk_cb_lin
-
         if (self.pt.has_pk_matter == _FALSE_):
             raise CosmoSevereError("No power spectrum computed. You must add mPk to the list of outputs.")
 
         if (self.fo.has_pk_cb == _FALSE_):
             raise CosmoSevereError("P_cb not computed by CLASS (probably because there are no massive neutrinos)")
 
-        if fourier_pk_at_k_and_z(&self.ba,&self.pm,&self.fo,pk_linear,k,z,self.fo.index_pk_cb,&pk_cb_lin,NULL)==_FAILURE_:
-            raise CosmoSevereError(self.fo.error_message)
-
-        return pk_cb_lin
+        return self._pk_at_k_and_z(k,z,pk_linear,self.fo.index_pk_cb)
 
     def get_pk(self, np.ndarray[DTYPE_t,ndim=3] k, np.ndarray[DTYPE_t,ndim=1] z, int k_size, int z_size, int mu_size):
         """ Fast function to get the power spectrum on a k and z array """
-        self.compute(["fourier"])
-
-        cdef np.ndarray[DTYPE_t, ndim=3] pk = np.zeros((k_size,z_size,mu_size),'float64')
-        cdef int index_k, index_z, index_mu
-
-        for index_k in range(k_size):
-            for index_z in range(z_size):
-                for index_mu in range(mu_size):
-                    pk[index_k,index_z,index_mu] = self.pk(k[index_k,index_z,index_mu],z[index_z])
-        return pk
+        return self.pk(k,z[np.newaxis,:,np.newaxis])
 
     def get_pk_cb(self, np.ndarray[DTYPE_t,ndim=3] k, np.ndarray[DTYPE_t,ndim=1] z, int k_size, int z_size, int mu_size):
         """ Fast function to get the power spectrum on a k and z array """
-        self.compute(["fourier"])
-
-        cdef np.ndarray[DTYPE_t, ndim=3] pk_cb = np.zeros((k_size,z_size,mu_size),'float64')
-        cdef int index_k, index_z, index_mu
-
-        for index_k in range(k_size):
-            for index_z in range(z_size):
-                for index_mu in range(mu_size):
-                    pk_cb[index_k,index_z,index_mu] = self.pk_cb(k[index_k,index_z,index_mu],z[index_z])
-        return pk_cb
+        return self.pk_cb(k,z[np.newaxis,:,np.newaxis])
 
     def get_pk_lin(self, np.ndarray[DTYPE_t,ndim=3] k, np.ndarray[DTYPE_t,ndim=1] z, int k_size, int z_size, int mu_size):
         """ Fast function to get the linear power spectrum on a k and z array """
-        self.compute(["fourier"])
-
-        cdef np.ndarray[DTYPE_t, ndim=3] pk = np.zeros((k_size,z_size,mu_size),'float64')
-        cdef int index_k, index_z, index_mu
-
-        for index_k in range(k_size):
-            for index_z in range(z_size):
-                for index_mu in range(mu_size):
-                    pk[index_k,index_z,index_mu] = self.pk_lin(k[index_k,index_z,index_mu],z[index_z])
-        return pk
+        return self.pk_lin(k,z[np.newaxis,:,np.newaxis])
 
     def get_pk_cb_lin(self, np.ndarray[DTYPE_t,ndim=3] k, np.ndarray[DTYPE_t,ndim=1] z, int k_size, int z_size, int mu_size):
         """ Fast function to get the linear power spectrum on a k and z array """
-        self.compute(["fourier"])
-
-        cdef np.ndarray[DTYPE_t, ndim=3] pk_cb = np.zeros((k_size,z_size,mu_size),'float64')
-        cdef int index_k, index_z, index_mu
-
-        for index_k in range(k_size):
-            for index_z in range(z_size):
-                for index_mu in range(mu_size):
-                    pk_cb[index_k,index_z,index_mu] = self.pk_cb_lin(k[index_k,index_z,index_mu],z[index_z])
-        return pk_cb
+        return self.pk_cb_lin(k,z[np.newaxis,:,np.newaxis])
 
     def get_pk_all(self, k, z, nonlinear = True, cdmbar = False, z_axis_in_k_arr = 0, interpolation_kind='cubic'):
         """ General function to get the P(k,z) for ARBITRARY shapes of k,z
@@ -1216,6 +1596,8 @@ cdef class Class:
             for index_k in range(self.fo.k_size_pk):
                 if nonlinear == True:
                     pk[index_k, index_tau] = np.exp(self.fo.ln_pk_nl[index_pk][index_tau * self.fo.k_size + index_k])
+                elif self.fo.pk_is_growth_factorised:
+                    pk[index_k, index_tau] = np.exp(self.fo.ln_pk_l[index_pk][index_k] + self.fo.ln_D2[index_tau])
                 else:
                     pk[index_k, index_tau] = np.exp(self.fo.ln_pk_l[index_pk][index_tau * self.fo.k_size + index_k])
 
@@ -1690,6 +2072,58 @@ cdef class Class:
             elif self.ba.K < 0:
                 return np.sinh(np.sqrt(-self.ba.K)*(chi2-chi1))/np.sqrt(-self.ba.K)/(1+z2)
 
+    def background_derivatives(self, z):
+        """
+        background_derivatives(z)
+
+        Return background quantities and their exact derivatives with
+        respect to cosmological parameters, computed in a single pass
+        with forward-mode automatic differentiation. Omega_Lambda is
+        adjusted to close the budget equation; T_cmb and ncdm masses
+        are kept fixed.
+
+        The derivatives come from a separate integration of the
+        background equations, restricted to photons, baryons, cdm, ur,
+        ncdm, curvature and a cosmological constant, whose values are
+        checked against those of the background module. Other models
+        raise CosmoSevereError. Thermodynamical quantities are not
+        differentiated.
+
+        Parameters
+        ----------
+        z : float or array
+                Desired redshift(s)
+
+        Returns
+        -------
+        derivatives : dict
+                'parameters' lists the parameters ('h', 'omega_b',
+                'omega_cdm', 'N_ur', 'Omega_k'). 'values' maps each quantity
+                ('H' in 1/Mpc; 'time', 'conf_distance', 'ang_distance',
+                'lum_distance', 'rs' in Mpc; 'theta', the ratio of rs to
+                the comoving angular distance) to an array of shape
+                (len(z),), and 'derivatives' maps it to an array of shape
+                (len(z), number of parameters).
+        """
+        self.compute(["background"])
+
+        zarr = np.atleast_1d(z).astype(np.float64)
+        cdef int z_size = zarr.shape[0]
+        cdef double[::1] z_view = zarr
+        cdef double[::1] values = np.zeros(z_size*_BGD_QUANTITIES_SIZE_, dtype=np.float64)
+        cdef double[::1] derivatives = np.zeros(z_size*_BGD_QUANTITIES_SIZE_*_BGD_PARAMETERS_SIZE_, dtype=np.float64)
+
+        if background_derivatives_at_z(&self.ba, &z_view[0], z_size, &values[0], &derivatives[0]) == _FAILURE_:
+            raise CosmoSevereError(self.ba.error_message)
+
+        names = ['H', 'time', 'conf_distance', 'ang_distance', 'lum_distance', 'rs', 'theta']
+        vals = np.asarray(values).reshape(z_size, _BGD_QUANTITIES_SIZE_)
+        ders = np.asarray(derivatives).reshape(z_size, _BGD_QUANTITIES_SIZE_, _BGD_PARAMETERS_SIZE_)
+
+        return {'parameters': ['h', 'omega_b', 'omega_cdm', 'N_ur', 'Omega_k'],
+                'values': {name: vals[:, i] for i, name in enumerate(names)},
+                'derivatives': {name: ders[:, i, :] for i, name in enumerate(names)}}
+
     def comoving_distance(self, z):
         """
         comoving_distance(z)
@@ -2274,6 +2708,10 @@ cdef class Class:
         """
         Return an array of the background quantities at all times.
 
+        The quantities stored in the background table are read-only views
+        on it, valid as long as they are referenced; the others (z, proper
+        and conformal time) are computed from it.
+
         Parameters
         ----------
 
@@ -2284,7 +2722,9 @@ cdef class Class:
         self.compute(["background"])
 
         cdef char *titles
-        cdef double* data
+        cdef int *index_column
+        cdef int storeidx
+        cdef double[:,::1] data
         titles = <char*>calloc(_MAXTITLESTRINGLENGTH_,sizeof(char))
 
         if background_output_titles(&self.ba, titles)==_FAILURE_:
@@ -2296,29 +2736,50 @@ cdef class Class:
         names = tmp.split("\t")[:-1]
         number_of_titles = len(names)
         timesteps = self.ba.bt_size
+        free(titles)
 
-        data = <double*>malloc(sizeof(double)*timesteps*number_of_titles)
+        index_column = <int*>malloc(sizeof(int)*number_of_titles)
 
-        if background_output_data(&self.ba, number_of_titles, data)==_FAILURE_:
-            free(titles) #manual free due to error
-            free(data) #manual free due to error
+        if background_output_columns(&self.ba, number_of_titles, index_column)==_FAILURE_:
+            free(index_column) #manual free due to error
             raise CosmoSevereError(self.ba.error_message)
 
+        number_of_derived = 0
+        for i in range(number_of_titles):
+            if index_column[i] < 0:
+                number_of_derived += 1
+
+        data_array = np.empty((timesteps, number_of_derived), dtype=np.double)
+        data = data_array
+
+        for index in range(timesteps):
+            storeidx = 0
+            if background_output_derived_data(&self.ba, index, &data[index,0], &storeidx)==_FAILURE_:
+                free(index_column) #manual free due to error
+                raise CosmoSevereError(self.ba.error_message)
+
+        table = self._table_view(&self.ba.background_table, timesteps, self.ba.bg_size)
         background = {}
 
+        index_derived = 0
         for i in range(number_of_titles):
-            background[names[i]] = np.zeros(timesteps, dtype=np.double)
-            for index in range(timesteps):
-                background[names[i]][index] = data[index*number_of_titles+i]
+            if index_column[i] >= 0:
+                background[names[i]] = table[:,index_column[i]]
+            else:
+                background[names[i]] = data_array[:,index_derived]
+                index_derived += 1
 
-        free(titles)
-        free(data)
+        free(index_column)
         return background
 
     def get_thermodynamics(self):
         """
         Return the thermodynamics quantities.
 
+        The quantities stored in the thermodynamics table are read-only
+        views on it, valid as long as they are referenced; the others
+        (scale factor, z, conformal time) are computed from it.
+
         Returns
         -------
         thermodynamics : dictionary containing thermodynamics.
@@ -2326,7 +2787,9 @@ cdef class Class:
         self.compute(["thermodynamics"])
 
         cdef char *titles
-        cdef double* data
+        cdef int *index_column
+        cdef int storeidx
+        cdef double[:,::1] data
 
         titles = <char*>calloc(_MAXTITLESTRINGLENGTH_,sizeof(char))
 
@@ -2339,23 +2802,40 @@ cdef class Class:
         names = tmp.split("\t")[:-1]
         number_of_titles = len(names)
         timesteps = self.th.tt_size
+        free(titles)
 
-        data = <double*>malloc(sizeof(double)*timesteps*number_of_titles)
+        index_column = <int*>malloc(sizeof(int)*number_of_titles)
 
-        if thermodynamics_output_data(&self.ba, &self.th, number_of_titles, data)==_FAILURE_:
-            free(titles) #manual free due to error
-            free(data) #manual free due to error
+        if thermodynamics_output_columns(&self.ba, &self.th, number_of_titles, index_column)==_FAILURE_:
+            free(index_column) #manual free due to error
             raise CosmoSevereError(self.th.error_message)
 
+        number_of_derived = 0
+        for i in range(number_of_titles):
+            if index_column[i] < 0:
+                number_of_derived += 1
+
+        data_array = np.empty((timesteps, number_of_derived), dtype=np.double)
+        data = data_array
+
+        for index in range(timesteps):
+            storeidx = 0
+            if thermodynamics_output_derived_data(&self.ba, &self.th, index, &data[index,0], &storeidx)==_FAILURE_:
+                free(index_column) #manual free due to error
+                raise CosmoSevereError(self.th.error_message)
+
+        table = self._table_view(&self.th.thermodynamics_table, timesteps, self.th.th_size)
         thermodynamics = {}
 
+        index_derived = 0
         for i in range(number_of_titles):
-            thermodynamics[names[i]] = np.zeros(timesteps, dtype=np.double)
-            for index in range(timesteps):
-                thermodynamics[names[i]][index] = data[index*number_of_titles+i]
+            if index_column[i] >= 0:
+                thermodynamics[names[i]] = table[:,index_column[i]]
+            else:
+                thermodynamics[names[i]] = data_array[:,index_derived]
+                index_derived += 1
 
-        free(titles)
-        free(data)
+        free(index_column)
         return thermodynamics
 
     def get_primordial(self):
@@ -2370,7 +2850,7 @@ cdef class Class:
         self.compute(["primordial"])
 
         cdef char *titles
-        cdef double* data
+        cdef double[:,::1] data
 
         titles = <char*>calloc(_MAXTITLESTRINGLENGTH_,sizeof(char))
 
@@ -2383,23 +2863,21 @@ cdef class Class:
         names = tmp.split("\t")[:-1]
         number_of_titles = len(names)
         timesteps = self.pm.lnk_size
+        free(titles)
 
-        data = <double*>malloc(sizeof(double)*timesteps*number_of_titles)
+        # all quantities are computed from the logarithmic primordial
+        # table, in a single array of which each column is a view
+        data_array = np.empty((timesteps, number_of_titles), dtype=np.double)
+        data = data_array
 
-        if primordial_output_data(&self.pt, &self.pm, number_of_titles, data)==_FAILURE_:
-            free(titles) #manual free due to error
-            free(data) #manual free due to error
+        if primordial_output_data(&self.pt, &self.pm, number_of_titles, &data[0,0])==_FAILURE_:
             raise CosmoSevereError(self.pm.error_message)
 
         primordial = {}
 
         for i in range(number_of_titles):
-            primordial[names[i]] = np.zeros(timesteps, dtype=np.double)
-            for index in range(timesteps):
-                primordial[names[i]][index] = data[index*number_of_titles+i]
+            primordial[names[i]] = data_array[:,i]
 
-        free(titles)
-        free(data)
         return primordial
 
     def get_perturbations(self):
@@ -2491,7 +2969,7 @@ cdef class Class:
         self.compute(["transfer"])
 
         cdef char *titles
-        cdef double* data
+        cdef double[:,:,::1] data
         cdef char ic_info[1024]
         cdef FileName ic_suffix
         cdef file_format outf
@@ -2516,38 +2994,34 @@ cdef class Class:
         names = tmp.split("\t")[:-1]
         number_of_titles = len(names)
         timesteps = self.pt.k_size[index_md]
+        free(titles)
 
-        size_ic_data = timesteps*number_of_titles;
         ic_num = self.pt.ic_size[index_md];
 
-        data = <double*>malloc(sizeof(double)*size_ic_data*ic_num)
+        # the transfer functions are interpolated at z from the source
+        # tables, in a single array of which each column is a view
+        data_array = np.empty((ic_num, timesteps, number_of_titles), dtype=np.double)
+        data = data_array
 
-        if perturbations_output_data_at_z(&self.ba, &self.pt, outf, <double> z, number_of_titles, data)==_FAILURE_:
+        if perturbations_output_data_at_z(&self.ba, &self.pt, outf, <double> z, number_of_titles, &data[0,0,0])==_FAILURE_:
             raise CosmoSevereError(self.pt.error_message)
 
         transfers = {}
 
         for index_ic in range(ic_num):
             if perturbations_output_firstline_and_ic_suffix(&self.pt, index_ic, ic_info, ic_suffix)==_FAILURE_:
-                free(titles) #manual free due to error
-                free(data) #manual free due to error
                 raise CosmoSevereError(self.pt.error_message)
             ic_key = <bytes> ic_suffix
 
             tmpdict = {}
             for i in range(number_of_titles):
-                tmpdict[names[i]] = np.zeros(timesteps, dtype=np.double)
-                for index in range(timesteps):
-                    tmpdict[names[i]][index] = data[index_ic*size_ic_data+index*number_of_titles+i]
+                tmpdict[names[i]] = data_array[index_ic,:,i]
 
             if ic_num==1:
                 transfers = tmpdict
             else:
                 transfers[ic_key] = tmpdict
 
-        free(titles)
-        free(data)
-
         return transfers
 
     def get_current_derived_parameters(self, names):
@@ -3124,6 +3598,14 @@ make        nonlinear_scale_cb(z, z_size)
         tau_array: numpy array containing tau values.
         """
         self.compute(["fourier"])
+
+        # a model restored from the memoisation cache only kept its
+        # late-time sources: compute it again (without caching it)
+        if self._sources_downsized:
+            self._computed_key = None
+            self.struct_cleanup()
+            self.compute(["fourier"])
+
         sources = {}
 
         cdef:
@@ -3291,3 +3773,75 @@ make        nonlinear_scale_cb(z, z_size)
 
         return (sources, np.asarray(k_array), np.asarray(tau_array))
 
+
+
+class ClassDaemonClient(object):
+    """
+    Thin client for the resident CLASS service (see main/classd.c),
+    started with e.g. "./classd /tmp/classd.sock cl_permille.pre -j 4".
+
+    Each call to compute() sends one parameter set over the Unix socket
+    and returns the requested outputs as numpy arrays, without loading
+    or initialising CLASS in the calling process.
+    """
+
+    def __init__(self, socket_name):
+        self.socket_name = socket_name
+
+    def _receive(self, connection, size):
+        data = bytearray()
+        while len(data) < size:
+            chunk = connection.recv(size-len(data))
+            if not chunk:
+                raise CosmoComputationError("classd closed the connection before the end of the reply")
+            data.extend(chunk)
+        return bytes(data)
+
+    def _receive_int(self, connection):
+        return int(np.frombuffer(self._receive(connection, 4), dtype=np.int32)[0])
+
+    def _receive_string(self, connection):
+        return self._receive(connection, self._receive_int(connection)).decode()
+
+    def compute(self, params):
+        """
+        compute(params)
+
+        Parameters
+        ----------
+        params : dict
+                Input parameters, as for Class.set()
+
+        Returns
+        -------
+        blocks : dict
+                For each block sent by classd ('cl', 'cl_lensed', 'pk', 'pk_nl',
+                'background', 'thermodynamics'), a dictionary mapping each
+                column title to a numpy array.
+        """
+        import socket
+
+        text = "".join("{} = {}\n".format(key, value) for key, value in params.items()).encode()
+
+        connection = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        try:
+            connection.connect(self.socket_name)
+            connection.sendall(np.array([len(text)], dtype=np.int32).tobytes() + text)
+
+            if self._receive_int(connection) != 0:
+                raise CosmoComputationError(self._receive_string(connection))
+
+            blocks = {}
+            while True:
+                name = self._receive_string(connection)
+                if name == "":
+                    break
+                titles = self._receive_string(connection).split(",")
+                rows = self._receive_int(connection)
+                columns = self._receive_int(connection)
+                table = np.frombuffer(self._receive(connection, 8*rows*columns), dtype=np.float64).reshape(rows, columns)
+                blocks[name] = {title.strip(): table[:, index] for index, title in enumerate(titles)}
+        finally:
+            connection.close()
+
+        return blocks
@@ -404,6 +404,27 @@ class TestClass(unittest.TestCase):
             self.compare_output(cosmo_ref, "Reference", self.cosmo_newt, 'Newtonian', COMPARE_CL_RELATIVE_ERROR, COMPARE_PK_RELATIVE_ERROR)
             assert status, 'Reference comparison failed in Newtonian gauge!'
 
+    @attr('test_table_views')
+    def test_table_views(self):
+        """Views on the same table outliving struct_cleanup"""
+        self.cosmo.set({'output': 'tCl'})
+        self.cosmo.compute()
+        # two views on each table
+        background = [self.cosmo.get_background() for _ in range(2)]
+        thermodynamics = [self.cosmo.get_thermodynamics() for _ in range(2)]
+        expected_background = background[0]['H [1/Mpc]'].copy()
+        expected_thermodynamics = thermodynamics[0]['x_e'].copy()
+
+        self.cosmo.struct_cleanup()
+        # drop one view of each table, and reuse the memory
+        del background[0], thermodynamics[0]
+        self.cosmo.set({'h': 0.7})
+        self.cosmo.compute()
+
+        np.testing.assert_array_equal(background[0]['H [1/Mpc]'], expected_background)
+        np.testing.assert_array_equal(thermodynamics[0]['x_e'], expected_thermodynamics)
+        self.assertFalse(background[0]['H [1/Mpc]'].flags.writeable)
+
     def has_incompatible_input(self):
 
         should_fail = False
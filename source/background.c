@@ -1975,6 +1975,7 @@ int background_solve(
                              pba->bt_size,
                              background_sources,
                              NULL, //'print_variables' in evolver_rk could be set, but, not required
+                             ppr,
                              pba->error_message),
              pba->error_message,
              pba->error_message);
@@ -2480,6 +2481,36 @@ int background_output_titles(
   return _SUCCESS_;
 }
 
+/**
+ * Subroutine storing, at one time step, the leading background output
+ * quantities that are not columns of the background table (z, proper
+ * and conformal time), in the same order as background_output_data()
+ *
+ * @param pba       Input: pointer to background structure
+ * @param index_tau Input: index of the time step in the background table
+ * @param dataptr   Output: row in which the quantities are stored
+ * @param storeidx  Input/Output: index of the next free entry of the row
+ * @return the error status
+ */
+
+int background_output_derived_data(
+                                   struct background *pba,
+                                   int index_tau,
+                                   double *dataptr,
+                                   int *storeidx
+                                   ) {
+
+  double *pvecback;
+
+  pvecback = pba->background_table + index_tau*pba->bg_size;
+
+  class_store_double(dataptr,1./pvecback[pba->index_bg_a]-1.,_TRUE_,(*storeidx));
+  class_store_double(dataptr,pvecback[pba->index_bg_time]/_Gyr_over_Mpc_,_TRUE_,(*storeidx));
+  class_store_double(dataptr,pba->conformal_age-pvecback[pba->index_bg_conf_distance],_TRUE_,(*storeidx));
+
+  return _SUCCESS_;
+}
+
 /**
  * Subroutine for writing the background output
  *
@@ -2504,9 +2535,9 @@ int background_output_data(
     pvecback = pba->background_table + index_tau*pba->bg_size;
     storeidx = 0;
 
-    class_store_double(dataptr,1./pvecback[pba->index_bg_a]-1.,_TRUE_,storeidx);
-    class_store_double(dataptr,pvecback[pba->index_bg_time]/_Gyr_over_Mpc_,_TRUE_,storeidx);
-    class_store_double(dataptr,pba->conformal_age-pvecback[pba->index_bg_conf_distance],_TRUE_,storeidx);
+    class_call(background_output_derived_data(pba,index_tau,dataptr,&storeidx),
+               pba->error_message,
+               pba->error_message);
     class_store_double(dataptr,pvecback[pba->index_bg_H],_TRUE_,storeidx);
     class_store_double(dataptr,pvecback[pba->index_bg_conf_distance],_TRUE_,storeidx);
     class_store_double(dataptr,pvecback[pba->index_bg_ang_distance],_TRUE_,storeidx);
@@ -2555,6 +2586,78 @@ int background_output_data(
 }
 
 
+/**
+ * Subroutine locating the columns of the background output in the
+ * background table, in the same order as background_output_data().
+ * This allows wrappers to expose these columns without copying them.
+ *
+ * @param pba                  Input: pointer to background structure
+ * @param number_of_titles     Input: number of background quantities printed at each time step
+ * @param index_column         Ouput: for each quantity, its index in pba->background_table, or -1 if it is derived from the table
+ * @return the error status
+ */
+
+int background_output_columns(
+                              struct background *pba,
+                              int number_of_titles,
+                              int *index_column
+                              ) {
+
+  int storeidx=0, n;
+
+  class_store_int(index_column,-1,_TRUE_,storeidx); /* z */
+  class_store_int(index_column,-1,_TRUE_,storeidx); /* proper time in Gyr */
+  class_store_int(index_column,-1,_TRUE_,storeidx); /* conformal time */
+  class_store_int(index_column,pba->index_bg_H,_TRUE_,storeidx);
+  class_store_int(index_column,pba->index_bg_conf_distance,_TRUE_,storeidx);
+  class_store_int(index_column,pba->index_bg_ang_distance,_TRUE_,storeidx);
+  class_store_int(index_column,pba->index_bg_lum_distance,_TRUE_,storeidx);
+  class_store_int(index_column,pba->index_bg_rs,_TRUE_,storeidx);
+  class_store_int(index_column,pba->index_bg_rho_g,_TRUE_,storeidx);
+  class_store_int(index_column,pba->index_bg_rho_b,_TRUE_,storeidx);
+  class_store_int(index_column,pba->index_bg_rho_cdm,pba->has_cdm,storeidx);
+  class_store_int(index_column,pba->index_bg_rho_idm,pba->has_idm,storeidx);
+  if (pba->has_ncdm == _TRUE_) {
+    for (n=0; n<pba->N_ncdm; n++) {
+      class_store_int(index_column,pba->index_bg_rho_ncdm1+n,_TRUE_,storeidx);
+      class_store_int(index_column,pba->index_bg_p_ncdm1+n,_TRUE_,storeidx);
+    }
+  }
+  class_store_int(index_column,pba->index_bg_rho_lambda,pba->has_lambda,storeidx);
+  class_store_int(index_column,pba->index_bg_rho_fld,pba->has_fld,storeidx);
+  class_store_int(index_column,pba->index_bg_w_fld,pba->has_fld,storeidx);
+  class_store_int(index_column,pba->index_bg_rho_ur,pba->has_ur,storeidx);
+  class_store_int(index_column,pba->index_bg_rho_idr,pba->has_idr,storeidx);
+  class_store_int(index_column,pba->index_bg_rho_crit,_TRUE_,storeidx);
+  class_store_int(index_column,pba->index_bg_rho_dcdm,pba->has_dcdm,storeidx);
+  class_store_int(index_column,pba->index_bg_rho_dr,pba->has_dr,storeidx);
+
+  class_store_int(index_column,pba->index_bg_rho_scf,pba->has_scf,storeidx);
+  class_store_int(index_column,pba->index_bg_p_scf,pba->has_scf,storeidx);
+  class_store_int(index_column,pba->index_bg_p_prime_scf,pba->has_scf,storeidx);
+  class_store_int(index_column,pba->index_bg_phi_scf,pba->has_scf,storeidx);
+  class_store_int(index_column,pba->index_bg_phi_prime_scf,pba->has_scf,storeidx);
+  class_store_int(index_column,pba->index_bg_V_scf,pba->has_scf,storeidx);
+  class_store_int(index_column,pba->index_bg_dV_scf,pba->has_scf,storeidx);
+  class_store_int(index_column,pba->index_bg_ddV_scf,pba->has_scf,storeidx);
+
+  class_store_int(index_column,pba->index_bg_rho_tot,_TRUE_,storeidx);
+  class_store_int(index_column,pba->index_bg_p_tot,_TRUE_,storeidx);
+  class_store_int(index_column,pba->index_bg_p_tot_prime,_TRUE_,storeidx);
+
+  class_store_int(index_column,pba->index_bg_D,_TRUE_,storeidx);
+  class_store_int(index_column,pba->index_bg_f,_TRUE_,storeidx);
+
+  class_store_int(index_column,pba->index_bg_varc_alpha,pba->has_varconst,storeidx);
+  class_store_int(index_column,pba->index_bg_varc_me,pba->has_varconst,storeidx);
+
+  class_test(storeidx != number_of_titles,
+             pba->error_message,
+             "found %d background columns instead of %d",storeidx,number_of_titles);
+
+  return _SUCCESS_;
+}
+
 /**
  * Subroutine evaluating the derivative with respect to loga
  * of quantities which are integrated (tau, t, etc).
@@ -0,0 +1,403 @@
+/** @file background_derivatives.c Derivatives of background quantities
+ *
+ * Exact derivatives of a few background quantities with respect to
+ * cosmological parameters, obtained in a single pass by integrating
+ * the background equations with dual numbers (forward-mode automatic
+ * differentiation). This module is compiled as C++.
+ *
+ * This is not a differentiated version of background_init(): the
+ * background module itself is not templated, and the thermodynamics
+ * (hence the visibility function) are not differentiated. The
+ * functions below are a separate solver, templated on the scalar type,
+ * following the same equations as background_functions() and
+ * background_derivs() for the subset of species with an analytic
+ * density (photons, baryons, cdm, ultra-relativistic relics, ncdm with
+ * fixed masses, and a cosmological constant closing the budget
+ * equation). The equations are integrated with a fourth-order
+ * Runge-Kutta scheme on the log(a) grid of the background table, so
+ * that the derivatives are exact derivatives of this discretisation.
+ * The values it finds are checked against the background table, and
+ * any model where they differ by more than _BGD_CONSISTENCY_ is
+ * refused.
+ *
+ * The only function called from other modules is:
+ * -# background_derivatives_at_z() at any time after background_init()
+ */
+
+#include "background_derivatives.h"
+#include "dual.h"
+#include <vector>
+
+/**
+ * Densities today (in the units of the background module, i.e. with a
+ * factor 8 pi G / 3 absorbed), as a function of the parameters listed
+ * in enum background_derivatives_parameter.
+ */
+
+template <typename T> struct background_derivatives_densities {
+  T H0;         /**< Hubble rate today */
+  T rho_g;      /**< photon density today */
+  T rho_b;      /**< baryon density today */
+  T rho_cdm;    /**< cdm density today */
+  T rho_ur;     /**< ultra-relativistic relics density today */
+  T rho_lambda; /**< cosmological constant density */
+  T K;          /**< curvature */
+};
+
+/**
+ * Set the densities today given the parameters.
+ *
+ * @param pba        Input: pointer to background structure
+ * @param param      Input: parameters (indexed by enum background_derivatives_parameter)
+ * @param pbd        Output: densities today
+ * @return the error status
+ */
+
+template <typename T> int background_derivatives_densities_today(
+                                                                 struct background * pba,
+                                                                 T * param,
+                                                                 struct background_derivatives_densities<T> * pbd
+                                                                 ) {
+
+  double rho_ncdm,unit;
+  int n_ncdm;
+
+  /* omega_X = Omega_X h^2 and rho_X = Omega_X H0^2 */
+  unit = pow(1.e5/_c_,2);
+
+  pbd->H0 = param[bgd_h]*1.e5/_c_;
+  pbd->rho_g = pba->Omega0_g*pow(pba->H0,2);
+  pbd->rho_b = param[bgd_omega_b]*unit;
+  pbd->rho_cdm = param[bgd_omega_cdm]*unit;
+  pbd->rho_ur = param[bgd_N_ur]*7./8.*pow(4./11.,4./3.)*pbd->rho_g;
+  pbd->K = -param[bgd_Omega_k]*pbd->H0*pbd->H0;
+
+  /** - budget equation closed with Lambda */
+  pbd->rho_lambda = (1.-param[bgd_Omega_k])*pbd->H0*pbd->H0
+    - pbd->rho_g - pbd->rho_b - pbd->rho_cdm - pbd->rho_ur;
+
+  for (n_ncdm=0; n_ncdm<pba->N_ncdm; n_ncdm++) {
+    class_call(background_ncdm_momenta(pba->q_ncdm_bg[n_ncdm],
+                                       pba->w_ncdm_bg[n_ncdm],
+                                       pba->q_size_ncdm_bg[n_ncdm],
+                                       pba->M_ncdm[n_ncdm],
+                                       pba->factor_ncdm[n_ncdm],
+                                       0.,
+                                       NULL,
+                                       &rho_ncdm,
+                                       NULL,
+                                       NULL,
+                                       NULL),
+               pba->error_message,
+               pba->error_message);
+    pbd->rho_lambda -= rho_ncdm;
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Derivatives with respect to log(a) of the proper time, conformal
+ * time and sound horizon, as in background_derivs().
+ *
+ * @param pba        Input: pointer to background structure
+ * @param pbd        Input: densities today
+ * @param loga       Input: log of the scale factor
+ * @param y          Input: proper time, conformal time and sound horizon
+ * @param dy         Output: their derivatives with respect to log(a)
+ * @param H          Output: Hubble rate (can be NULL)
+ * @return the error status
+ */
+
+template <typename T> int background_derivatives_derivs(
+                                                        struct background * pba,
+                                                        struct background_derivatives_densities<T> * pbd,
+                                                        double loga,
+                                                        T * y,
+                                                        T * dy,
+                                                        T * H
+                                                        ) {
+
+  double a,rho_ncdm;
+  T rho_tot,R,Ha;
+  int n_ncdm;
+
+  a = exp(loga);
+
+  rho_tot = (pbd->rho_g + pbd->rho_ur)/pow(a,4)
+    + (pbd->rho_b + pbd->rho_cdm)/pow(a,3)
+    + pbd->rho_lambda;
+
+  for (n_ncdm=0; n_ncdm<pba->N_ncdm; n_ncdm++) {
+    class_call(background_ncdm_momenta(pba->q_ncdm_bg[n_ncdm],
+                                       pba->w_ncdm_bg[n_ncdm],
+                                       pba->q_size_ncdm_bg[n_ncdm],
+                                       pba->M_ncdm[n_ncdm],
+                                       pba->factor_ncdm[n_ncdm],
+                                       1./a-1.,
+                                       NULL,
+                                       &rho_ncdm,
+                                       NULL,
+                                       NULL,
+                                       NULL),
+               pba->error_message,
+               pba->error_message);
+    rho_tot += rho_ncdm;
+  }
+
+  /** - Friedmann equation, with the curvature term */
+  Ha = sqrt(rho_tot - pbd->K/a/a);
+
+  class_test(dual_value(Ha) <= 0.,
+             pba->error_message,
+             "H = %e instead of strictly positive",dual_value(Ha));
+
+  /** - baryon-to-photon ratio R = 3 rho_b / 4 rho_g */
+  R = 3.*pbd->rho_b/4./pbd->rho_g*a;
+
+  dy[0] = 1./Ha;
+  dy[1] = 1./a/Ha;
+  dy[2] = dy[1]/sqrt(3.*(1.+R))*sqrt(1.-pbd->K*y[2]*y[2]);
+
+  if (H != NULL)
+    *H = Ha;
+
+  return _SUCCESS_;
+}
+
+/**
+ * Integrate the proper time, conformal time and sound horizon on the
+ * log(a) grid of the background table, and interpolate them at each
+ * requested redshift.
+ *
+ * @param pba        Input: pointer to background structure
+ * @param param      Input: parameters (indexed by enum background_derivatives_parameter)
+ * @param z          Input: redshifts
+ * @param z_size     Input: number of redshifts
+ * @param quantities Output: quantities at each redshift (indexed by index_z*_BGD_QUANTITIES_SIZE_+enum background_derivatives_quantity)
+ * @return the error status
+ */
+
+template <typename T> int background_derivatives_solve(
+                                                       struct background * pba,
+                                                       T * param,
+                                                       double * z,
+                                                       int z_size,
+                                                       T * quantities
+                                                       ) {
+
+  struct background_derivatives_densities<T> bd;
+  T y[3],k1[3],k2[3],k3[3],k4[3],ytmp[3];
+  T H,conformal_age,conf_distance,comoving_radius;
+  T * pq;
+  double loga,step,s,h00,h10,h01,h11;
+  int index_loga,index_z,index_y;
+
+  class_call(background_derivatives_densities_today(pba,param,&bd),
+             pba->error_message,
+             pba->error_message);
+
+  /* std::vector constructs the elements, which class_alloc would not do for dual numbers */
+  std::vector<T> y_table(pba->bt_size*3);
+  std::vector<T> dy_table(pba->bt_size*3);
+
+  /** - initial conditions as in background_initial_conditions(),
+      assuming radiation domination since the Big Bang */
+  loga = pba->loga_table[0];
+  step = pba->loga_table[1]-pba->loga_table[0];
+
+  y[0] = 0.;
+  y[1] = 0.;
+  y[2] = 0.;
+  class_call(background_derivatives_derivs(pba,&bd,loga,y,k1,&H),
+             pba->error_message,
+             pba->error_message);
+  y[0] = 1./(2.*H);
+  y[1] = 1./(exp(loga)*H);
+  y[2] = y[1]/sqrt(3.);
+
+  /** - fourth-order Runge-Kutta steps between the points of the background table */
+  for (index_loga=0; index_loga<pba->bt_size; index_loga++) {
+
+    loga = pba->loga_table[index_loga];
+
+    class_call(background_derivatives_derivs(pba,&bd,loga,y,k1,(T*)NULL),
+               pba->error_message,
+               pba->error_message);
+
+    for (index_y=0; index_y<3; index_y++) {
+      y_table[3*index_loga+index_y] = y[index_y];
+      dy_table[3*index_loga+index_y] = k1[index_y];
+    }
+
+    if (index_loga == pba->bt_size-1)
+      break;
+
+    step = pba->loga_table[index_loga+1]-loga;
+
+    for (index_y=0; index_y<3; index_y++) ytmp[index_y] = y[index_y]+0.5*step*k1[index_y];
+    class_call(background_derivatives_derivs(pba,&bd,loga+0.5*step,ytmp,k2,(T*)NULL),
+               pba->error_message,
+               pba->error_message);
+
+    for (index_y=0; index_y<3; index_y++) ytmp[index_y] = y[index_y]+0.5*step*k2[index_y];
+    class_call(background_derivatives_derivs(pba,&bd,loga+0.5*step,ytmp,k3,(T*)NULL),
+               pba->error_message,
+               pba->error_message);
+
+    for (index_y=0; index_y<3; index_y++) ytmp[index_y] = y[index_y]+step*k3[index_y];
+    class_call(background_derivatives_derivs(pba,&bd,loga+step,ytmp,k4,(T*)NULL),
+               pba->error_message,
+               pba->error_message);
+
+    for (index_y=0; index_y<3; index_y++)
+      y[index_y] += step/6.*(k1[index_y]+2.*k2[index_y]+2.*k3[index_y]+k4[index_y]);
+  }
+
+  conformal_age = y_table[3*(pba->bt_size-1)+1];
+
+  /** - cubic Hermite interpolation at each redshift, and derived quantities */
+  for (index_z=0; index_z<z_size; index_z++) {
+
+    loga = -log(1.+z[index_z]);
+
+    class_test((loga < pba->loga_table[0]) || (loga > pba->loga_table[pba->bt_size-1]),
+               pba->error_message,
+               "z=%e out of the bounds of the background table",z[index_z]);
+
+    index_loga = (int)((loga-pba->loga_table[0])/step);
+    if (index_loga > pba->bt_size-2) index_loga = pba->bt_size-2;
+    s = (loga-pba->loga_table[index_loga])/step;
+
+    h00 = (1.+2.*s)*(1.-s)*(1.-s);
+    h10 = s*(1.-s)*(1.-s);
+    h01 = s*s*(3.-2.*s);
+    h11 = s*s*(s-1.);
+
+    for (index_y=0; index_y<3; index_y++) {
+      y[index_y] = h00*y_table[3*index_loga+index_y]
+        + h10*step*dy_table[3*index_loga+index_y]
+        + h01*y_table[3*(index_loga+1)+index_y]
+        + h11*step*dy_table[3*(index_loga+1)+index_y];
+    }
+
+    class_call(background_derivatives_derivs(pba,&bd,loga,y,k1,&H),
+               pba->error_message,
+               pba->error_message);
+
+    conf_distance = conformal_age - y[1];
+
+    /* in the flat case K vanishes but not its derivative with respect to Omega_k:
+       keep the first order of the expansion of sin or sinh */
+    if (pba->sgnK == 0) { comoving_radius = conf_distance - bd.K*conf_distance*conf_distance*conf_distance/6.; }
+    else if (pba->sgnK == 1) { comoving_radius = sin(sqrt(bd.K)*conf_distance)/sqrt(bd.K); }
+    else { comoving_radius = sinh(sqrt(-bd.K)*conf_distance)/sqrt(-bd.K); }
+
+    pq = quantities+index_z*_BGD_QUANTITIES_SIZE_;
+    pq[bgd_H] = H;
+    pq[bgd_time] = y[0];
+    pq[bgd_conf_distance] = conf_distance;
+    pq[bgd_ang_distance] = comoving_radius/(1.+z[index_z]);
+    pq[bgd_lum_distance] = comoving_radius*(1.+z[index_z]);
+    pq[bgd_rs] = y[2];
+    /* at z=0 the comoving radius vanishes */
+    pq[bgd_theta] = (dual_value(comoving_radius) > 0.) ? y[2]/comoving_radius : T(0.);
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Background quantities and their derivatives with respect to the
+ * parameters of enum background_derivatives_parameter, at a list of
+ * redshifts. Can be called at any time after background_init().
+ *
+ * Only models with photons, baryons, cdm, ultra-relativistic relics,
+ * ncdm species (whose masses are kept fixed), curvature and a
+ * cosmological constant closing the budget equation are supported.
+ * Derivatives are taken at fixed T_cmb and ncdm masses.
+ *
+ * @param pba         Input: pointer to background structure
+ * @param z           Input: redshifts
+ * @param z_size      Input: number of redshifts
+ * @param values      Output: allocated array of size z_size*_BGD_QUANTITIES_SIZE_, with
+ *                    the quantities of enum background_derivatives_quantity at each redshift
+ * @param derivatives Output: allocated array of size z_size*_BGD_QUANTITIES_SIZE_*_BGD_PARAMETERS_SIZE_,
+ *                    with derivatives[(index_z*_BGD_QUANTITIES_SIZE_+quantity)*_BGD_PARAMETERS_SIZE_+parameter]
+ * @return the error status
+ */
+
+int background_derivatives_at_z(
+                                struct background * pba,
+                                double * z,
+                                int z_size,
+                                double * values,
+                                double * derivatives
+                                ) {
+
+  typedef dual<_BGD_PARAMETERS_SIZE_> bgd_dual;
+
+  bgd_dual param[_BGD_PARAMETERS_SIZE_];
+  double N_ur,value,reference,scale;
+  double * pvecback;
+  int index_q,index_p,index_z,index_c,last_index=0;
+  /* quantities also in the background table */
+  enum background_derivatives_quantity checked[4] = {bgd_H,bgd_time,bgd_conf_distance,bgd_rs};
+  int index_bg[4] = {pba->index_bg_H,pba->index_bg_time,pba->index_bg_conf_distance,pba->index_bg_rs};
+  const char * names[4] = {"H","proper time","conformal distance","sound horizon"};
+
+  /** - check that the model only contains supported species */
+  class_test((pba->has_dcdm == _TRUE_) || (pba->has_dr == _TRUE_) ||
+             (pba->has_idm == _TRUE_) || (pba->has_idr == _TRUE_) ||
+             (pba->has_fld == _TRUE_) || (pba->has_scf == _TRUE_),
+             pba->error_message,
+             "derivatives of background quantities are only coded for photons, baryons, cdm, ur, ncdm, curvature and Lambda");
+
+  N_ur = pba->Omega0_ur/(7./8.*pow(4./11.,4./3.)*pba->Omega0_g);
+
+  /** - parameters as independent dual numbers */
+  param[bgd_h] = bgd_dual(pba->h,bgd_h);
+  param[bgd_omega_b] = bgd_dual(pba->Omega0_b*pba->h*pba->h,bgd_omega_b);
+  param[bgd_omega_cdm] = bgd_dual(pba->Omega0_cdm*pba->h*pba->h,bgd_omega_cdm);
+  param[bgd_N_ur] = bgd_dual(N_ur,bgd_N_ur);
+  param[bgd_Omega_k] = bgd_dual(pba->Omega0_k,bgd_Omega_k);
+
+  std::vector<bgd_dual> quantities(z_size*_BGD_QUANTITIES_SIZE_);
+
+  class_call(background_derivatives_solve(pba,param,z,z_size,quantities.data()),
+             pba->error_message,
+             pba->error_message);
+
+  for (index_q=0; index_q<z_size*_BGD_QUANTITIES_SIZE_; index_q++) {
+    values[index_q] = quantities[index_q].val;
+    for (index_p=0; index_p<_BGD_PARAMETERS_SIZE_; index_p++) {
+      derivatives[index_q*_BGD_PARAMETERS_SIZE_+index_p] = quantities[index_q].der[index_p];
+    }
+  }
+
+  /** - check the values against the background table, i.e. that the
+      equations of this module describe the model of background_init() */
+  class_alloc(pvecback,pba->bg_size*sizeof(double),pba->error_message);
+
+  for (index_z=0; index_z<z_size; index_z++) {
+    class_call_except(background_at_z(pba,z[index_z],long_info,inter_normal,&last_index,pvecback),
+                      pba->error_message,
+                      pba->error_message,
+                      free(pvecback));
+    for (index_c=0; index_c<4; index_c++) {
+      value = values[index_z*_BGD_QUANTITIES_SIZE_+checked[index_c]];
+      reference = pvecback[index_bg[index_c]];
+      /* the conformal distance vanishes today */
+      scale = (checked[index_c] == bgd_conf_distance) ? pba->conformal_age : fabs(reference);
+      class_test_except(fabs(value-reference) > _BGD_CONSISTENCY_*scale,
+                        pba->error_message,
+                        free(pvecback),
+                        "at z=%e, the %s is %e instead of %e in the background table: this model is not supported by the derivatives of background quantities",
+                        z[index_z],names[index_c],value,reference);
+    }
+  }
+
+  free(pvecback);
+
+  return _SUCCESS_;
+}
@@ -164,7 +164,6 @@ int distortions_constants(struct precision * ppr,
     pow(pba->Omega0_b*pow(pba->h,2.)/0.02225,-2./5.)*
     pow(pba->T_cmb/2.726,1./5.);
 
-  class_sprintf(psd->sd_PCA_file_generator,"%s/%s",ppr->sd_external_path,"generate_PCA_files.py");
   class_sprintf(psd->sd_detector_list_file,"%s/%s",ppr->sd_external_path,"detectors_list.dat");
 
   return _SUCCESS_;
@@ -337,20 +336,11 @@ int distortions_set_detector(struct precision * ppr,
   /* If the detector has not been found, either the user has specified the settings and we create a new one,
    * or the user hasn't specified the settings and we have to stop */
   if (found_detector == _FALSE_) {
-    if (psd->has_user_defined_detector==_TRUE_ || psd->has_detector_file==_TRUE_) {
-      if (psd->distortions_verbose > 0) {
-        printf(" -> Generating detector '%s' \n",psd->sd_detector_name);
-      }
-      class_call(distortions_generate_detector(ppr,psd),
-                 psd->error_message,
-                 psd->error_message);
-    }
-    else {
-      class_stop(psd->error_message,
-                 "You asked for detector '%s', but it was not in the database '%s'.\nPlease check the name of your detector, or specify its properties if you want to create a new one",
-                 psd->sd_detector_name,
-                 psd->sd_detector_list_file);
-    }
+    class_test(psd->has_user_defined_detector==_FALSE_ && psd->has_detector_file==_FALSE_,
+               psd->error_message,
+               "You asked for detector '%s', but it was not in the database '%s'.\nPlease check the name of your detector, or specify its properties if you want to create a new one",
+               psd->sd_detector_name,
+               psd->sd_detector_list_file);
   }
 
   if (psd->has_detector_file ==_TRUE_) {
@@ -359,15 +349,34 @@ int distortions_set_detector(struct precision * ppr,
                psd->error_message);
   }
 
+  if (found_detector == _FALSE_) {
+    if (psd->distortions_verbose > 0) {
+      printf(" -> Generating detector '%s' \n",psd->sd_detector_name);
+    }
+    class_call(distortions_generate_detector(ppr,psd),
+               psd->error_message,
+               psd->error_message);
+  }
+
   return _SUCCESS_;
 }
 
 /**
  * Evaluate branching ratios, spectral shapes, E and S vectors for a given detector as
- * described in external/distortions/README using generate_PCA_files.py.
+ * described in external/distortions/README, and store them in the files
+ * DETECTORNAME_branching_ratios.dat and DETECTORNAME_distortions_shapes.dat
+ * read later by distortions_read_br_data() and distortions_read_sd_data(). The
+ * detector is then appended to the list of known detectors.
+ *
+ * The Green's function of Chluba & Jeong 2014 is interpolated on the
+ * frequencies of the detector, and its residual after projection on the
+ * temperature shift, y and mu shapes is decomposed in principal
+ * components. These are the right singular vectors of the residual
+ * weighted by the detector noise (i.e. the eigenvectors of the Fisher
+ * matrix), obtained with distortions_PCA_Jacobi().
  *
  * @param ppr        Input: pointer to precision structure
- * @param psd        Input: pointer to the distortions structure
+ * @param psd        Input: pointer to the distortions structure (with the detector noise already read if there is a noise file)
  * @return the error status
  */
 
@@ -375,60 +384,514 @@ int distortions_generate_detector(struct precision * ppr,
                                   struct distortions * psd){
 
   /** Define local variables*/
-  int is_success;
-  char temporary_string[2*_FILENAMESIZE_+2*_MAX_DETECTOR_NAME_LENGTH_+1024];
-
+  FILE * infile;
+  FILE * outfile;
+  DetectorFileName filename;
+  char line[_LINE_LENGTH_MAX_];
+  char * left;
+  int headlines = 0;
+  int PCA_size = 6; /* number of principal components stored for each detector */
+
+  int Greens_Nz, Greens_Nx;
+  double * Greens_z;
+  double * Greens_lnz;
+  double * Greens_T_ini;
+  double * ddGreens_T_ini;
+  double * Greens_T_last;
+  double * ddGreens_T_last;
+  double * Greens_drho;
+  double * ddGreens_drho;
+  double * Greens_x;
+  double * Greens_G_th;   /* Greens_G_th[index_x*Greens_Nz+index_z] */
+  double * ddGreens_G_th;
+  double blackbody;
+
+  int z_size, x_size;
+  double * z;
+  double * x;
+  double * delta_Ic;
+  double delta_ln_z;
+  int * index_x_Greens;
+  double * frac_x_Greens;
+
+  double * G_th;          /* G_th[index_x*z_size+index_z] */
+  double * Gdist;
+  double * Ydist;
+  double * Mdist;
+  double * e_Y;
+  double * e_M;
+  double * e_G;
+  double norm_Y, norm_M, norm_G;
+  double M_Y, G_Y, G_M;
+  double * f_g;
+  double * f_y;
+  double * f_mu;
+  double * residual;      /* residual[index_x*z_size+index_z] */
+  double * weighted;
+  double * sigma;
+  double * E_vecs;        /* E_vecs[index_pca*z_size+index_z] */
+  double * S_vecs;        /* S_vecs[index_pca*x_size+index_x] */
+
+  int index_z, index_x, index_pca;
+  int last_index = 0;
+  double h, a, b;
+  double lnz, bb_vis, T_ini, T_last, drho, x_s, G_low, G_high;
+  double proj_G, proj_M, proj_Y;
 
-  /* Test first whether or not python exists*/
   if (psd->distortions_verbose > 0) {
-    printf(" -> Testing python\n");
+    printf(" -> Computing the PCA decomposition\n");
+  }
+
+  /** Read the Green's function */
+  class_sprintf(filename,"%s/Greens_data.dat",ppr->sd_external_path);
+  class_open(infile, filename, "r", psd->error_message);
+
+  Greens_Nz = 0;
+  while (fgets(line,_LINE_LENGTH_MAX_-1,infile) != NULL) {
+    headlines++;
+
+    /* Eliminate blank spaces at beginning of line */
+    left=line;
+    while (left[0]==' ') {
+      left++;
+    }
+
+    if (left[0] > 39) {
+      /* Read number of redshifts and frequencies */
+      class_test(sscanf(line,"%d %d", &Greens_Nz, &Greens_Nx) != 2,
+                 psd->error_message,
+                 "could not read header (number of redshifts, number of frequencies) at line %i in file '%s' \n",headlines,filename);
+      break;
+    }
+  }
+
+  class_alloc(Greens_z, Greens_Nz*sizeof(double), psd->error_message);
+  class_alloc(Greens_lnz, Greens_Nz*sizeof(double), psd->error_message);
+  class_alloc(Greens_T_ini, Greens_Nz*sizeof(double), psd->error_message);
+  class_alloc(ddGreens_T_ini, Greens_Nz*sizeof(double), psd->error_message);
+  class_alloc(Greens_T_last, Greens_Nz*sizeof(double), psd->error_message);
+  class_alloc(ddGreens_T_last, Greens_Nz*sizeof(double), psd->error_message);
+  class_alloc(Greens_drho, Greens_Nz*sizeof(double), psd->error_message);
+  class_alloc(ddGreens_drho, Greens_Nz*sizeof(double), psd->error_message);
+  class_alloc(Greens_x, Greens_Nx*sizeof(double), psd->error_message);
+  class_alloc(Greens_G_th, Greens_Nx*Greens_Nz*sizeof(double), psd->error_message);
+  class_alloc(ddGreens_G_th, Greens_Nx*Greens_Nz*sizeof(double), psd->error_message);
+
+  for (index_z=0; index_z<Greens_Nz; ++index_z) {
+    class_test(fscanf(infile,"%le",&(Greens_z[index_z])) != 1,
+               psd->error_message,
+               "Could not read z in file '%s'",filename);
+    Greens_lnz[index_z] = log(1.+Greens_z[index_z]);
+  }
+  for (index_z=0; index_z<Greens_Nz; ++index_z) {
+    class_test(fscanf(infile,"%le",&(Greens_T_ini[index_z])) != 1,
+               psd->error_message,
+               "Could not read T_ini in file '%s'",filename);
+  }
+  for (index_z=0; index_z<Greens_Nz; ++index_z) {
+    class_test(fscanf(infile,"%le",&(Greens_T_last[index_z])) != 1,
+               psd->error_message,
+               "Could not read T_last in file '%s'",filename);
+  }
+  for (index_z=0; index_z<Greens_Nz; ++index_z) {
+    class_test(fscanf(infile,"%le",&(Greens_drho[index_z])) != 1,
+               psd->error_message,
+               "Could not read drho in file '%s'",filename);
   }
-  is_success = system("python --version");
-  class_test(is_success == -1,
+  for (index_x=0; index_x<Greens_Nx; ++index_x) {
+    class_test(fscanf(infile,"%le",&(Greens_x[index_x])) != 1,
+               psd->error_message,
+               "Could not read x at line %i in file '%s'",index_x+headlines+5,filename);
+    for (index_z=0; index_z<Greens_Nz; ++index_z) {
+      class_test(fscanf(infile,"%le",&(Greens_G_th[index_x*Greens_Nz+index_z])) != 1,
+                 psd->error_message,
+                 "Could not read G_th at line %i in file '%s'",index_x+headlines+5,filename);
+    }
+    class_test(fscanf(infile,"%le",&blackbody) != 1,
+               psd->error_message,
+               "Could not read blackbody at line %i in file '%s'",index_x+headlines+5,filename);
+  }
+
+  fclose(infile);
+
+  /** Spline the Green's function and temperature shifts in ln(1+z) */
+  class_call(array_spline_table_columns(Greens_lnz,Greens_Nz,Greens_G_th,Greens_Nx,ddGreens_G_th,_SPLINE_EST_DERIV_,psd->error_message),
              psd->error_message,
-             "The command 'python --version' failed.\nPlease install a valid version of python.");
+             psd->error_message);
+  class_call(array_spline_table_columns(Greens_lnz,Greens_Nz,Greens_T_ini,1,ddGreens_T_ini,_SPLINE_EST_DERIV_,psd->error_message),
+             psd->error_message,
+             psd->error_message);
+  class_call(array_spline_table_columns(Greens_lnz,Greens_Nz,Greens_T_last,1,ddGreens_T_last,_SPLINE_EST_DERIV_,psd->error_message),
+             psd->error_message,
+             psd->error_message);
+  class_call(array_spline_table_columns(Greens_lnz,Greens_Nz,Greens_drho,1,ddGreens_drho,_SPLINE_EST_DERIV_,psd->error_message),
+             psd->error_message,
+             psd->error_message);
 
-  /* Then activate the PCA generator*/
-  if (psd->distortions_verbose > 0) {
-    printf(" -> Executing the PCA generator\n");
+  /** Define the redshifts and frequencies of the decomposition */
+  z_size = ppr->sd_z_size;
+  class_alloc(z, z_size*sizeof(double), psd->error_message);
+  for (index_z=0; index_z<z_size; ++index_z) {
+    z[index_z] = exp(log(ppr->sd_z_min)+(log(ppr->sd_z_max)-log(ppr->sd_z_min))*index_z/(z_size-1.));
   }
+  delta_ln_z = log(z[1])-log(z[0]);
 
   if (psd->has_detector_file == _TRUE_) {
-    class_sprintf(temporary_string,"python %s %s %s %s %.10e %.10e %i %i %.10e %.10e %.10e",
-            psd->sd_PCA_file_generator,
-            psd->sd_detector_name,
-            ppr->sd_external_path,
-            psd->sd_detector_file_name,
-            ppr->sd_z_min,
-            ppr->sd_z_max,
-            ppr->sd_z_size,
-            6,
-            psd->z_th,
-            psd->DI_units,
-            psd->x_to_nu);
+    x_size = psd->x_size;
+  }
+  else {
+    x_size = psd->sd_detector_bin_number+1;
+  }
+  class_test(x_size < PCA_size,
+             psd->error_message,
+             "The detector '%s' has %d frequencies, cannot compute %d principal components",psd->sd_detector_name,x_size,PCA_size);
+
+  class_alloc(x, x_size*sizeof(double), psd->error_message);
+  class_alloc(delta_Ic, x_size*sizeof(double), psd->error_message);
+  for (index_x=0; index_x<x_size; ++index_x) {
+    if (psd->has_detector_file == _TRUE_) {
+      x[index_x] = psd->x[index_x];
+      delta_Ic[index_x] = psd->delta_Ic_array[index_x];
+    }
+    else {
+      x[index_x] = (psd->sd_detector_nu_min+(psd->sd_detector_nu_max-psd->sd_detector_nu_min)*index_x/(x_size-1.))/psd->x_to_nu;
+      delta_Ic[index_x] = psd->sd_detector_delta_Ic;
+    }
+  }
+
+  /** Locate the frequencies of the detector in the Green's function table, for linear interpolation
+      between the two tabulated frequencies bracketing each of them */
+  class_alloc(index_x_Greens, x_size*sizeof(int), psd->error_message);
+  class_alloc(frac_x_Greens, x_size*sizeof(double), psd->error_message);
+  for (index_x=0; index_x<x_size; ++index_x) {
+    class_test(x[index_x] < Greens_x[0] || x[index_x] > Greens_x[Greens_Nx-1],
+               psd->error_message,
+               "x=%e is not in the file range [%e,%e] for file '%s'",x[index_x],Greens_x[0],Greens_x[Greens_Nx-1],filename);
+    index_x_Greens[index_x] = (index_x > 0 ? index_x_Greens[index_x-1] : 0);
+    while ((index_x_Greens[index_x] < Greens_Nx-2) && (x[index_x] > Greens_x[index_x_Greens[index_x]+1])) {
+      index_x_Greens[index_x]++;
+    }
+    frac_x_Greens[index_x] = (x[index_x]-Greens_x[index_x_Greens[index_x]])/
+      (Greens_x[index_x_Greens[index_x]+1]-Greens_x[index_x_Greens[index_x]]);
+  }
+
+  /** Interpolate the Green's function, including the temperature shift between the initial and last blackbody */
+  class_alloc(G_th, x_size*z_size*sizeof(double), psd->error_message);
+  for (index_z=0; index_z<z_size; ++index_z) {
+    lnz = log(1.+z[index_z]);
+    bb_vis = exp(-pow(z[index_z]/psd->z_th,2.5));
+
+    class_call(array_spline_hunt(Greens_lnz,Greens_Nz,lnz,&last_index,&h,&a,&b,psd->error_message),
+               psd->error_message,
+               psd->error_message);
+    T_ini = array_spline_eval(Greens_T_ini,ddGreens_T_ini,last_index,last_index+1,h,a,b);
+    T_last = array_spline_eval(Greens_T_last,ddGreens_T_last,last_index,last_index+1,h,a,b);
+    drho = array_spline_eval(Greens_drho,ddGreens_drho,last_index,last_index+1,h,a,b);
+
+    for (index_x=0; index_x<x_size; ++index_x) {
+      G_low = array_spline_eval(Greens_G_th+index_x_Greens[index_x]*Greens_Nz,
+                                ddGreens_G_th+index_x_Greens[index_x]*Greens_Nz,
+                                last_index,last_index+1,h,a,b);
+      G_high = array_spline_eval(Greens_G_th+(index_x_Greens[index_x]+1)*Greens_Nz,
+                                 ddGreens_G_th+(index_x_Greens[index_x]+1)*Greens_Nz,
+                                 last_index,last_index+1,h,a,b);
+      x_s = T_ini/T_last*x[index_x];
+
+      G_th[index_x*z_size+index_z] = 1.e-8*((G_low*(1.-frac_x_Greens[index_x])+G_high*frac_x_Greens[index_x])*bb_vis
+                                            +psd->DI_units*1.e26*pow(x[index_x],3.)*(1./(exp(x_s)-1.)-1./(exp(x[index_x])-1.))/drho);
+    }
+  }
+
+  /** Define the spectral shapes, and an orthonormal basis of the space they span */
+  class_alloc(Gdist, x_size*sizeof(double), psd->error_message);
+  class_alloc(Ydist, x_size*sizeof(double), psd->error_message);
+  class_alloc(Mdist, x_size*sizeof(double), psd->error_message);
+  class_alloc(e_G, x_size*sizeof(double), psd->error_message);
+  class_alloc(e_Y, x_size*sizeof(double), psd->error_message);
+  class_alloc(e_M, x_size*sizeof(double), psd->error_message);
+
+  norm_Y = 0.;
+  for (index_x=0; index_x<x_size; ++index_x) {
+    Gdist[index_x] = pow(x[index_x],4.)*exp(x[index_x])/pow(exp(x[index_x])-1.,2.)*psd->DI_units*1.e18;
+    Ydist[index_x] = Gdist[index_x]*(x[index_x]/tanh(x[index_x]/2.)-4.);
+    Mdist[index_x] = Gdist[index_x]*(1./2.19229-1./x[index_x]);
+    norm_Y += Ydist[index_x]*Ydist[index_x];
+  }
+  norm_Y = sqrt(norm_Y);
+
+  /* Y distortion */
+  M_Y = 0.;
+  G_Y = 0.;
+  for (index_x=0; index_x<x_size; ++index_x) {
+    e_Y[index_x] = Ydist[index_x]/norm_Y;
+    M_Y += e_Y[index_x]*Mdist[index_x];
+    G_Y += e_Y[index_x]*Gdist[index_x];
+  }
+  /* mu distortion */
+  norm_M = 0.;
+  for (index_x=0; index_x<x_size; ++index_x) {
+    e_M[index_x] = Mdist[index_x]-M_Y*e_Y[index_x];
+    norm_M += e_M[index_x]*e_M[index_x];
+  }
+  norm_M = sqrt(norm_M);
+  G_M = 0.;
+  for (index_x=0; index_x<x_size; ++index_x) {
+    e_M[index_x] /= norm_M;
+    G_M += e_M[index_x]*Gdist[index_x];
+  }
+  /* temperature shift */
+  norm_G = 0.;
+  for (index_x=0; index_x<x_size; ++index_x) {
+    e_G[index_x] = Gdist[index_x]-G_Y*e_Y[index_x]-G_M*e_M[index_x];
+    norm_G += e_G[index_x]*e_G[index_x];
+  }
+  norm_G = sqrt(norm_G);
+  for (index_x=0; index_x<x_size; ++index_x) {
+    e_G[index_x] /= norm_G;
+  }
+
+  /** Project the Green's function on this basis to get the branching ratios, and the residual */
+  class_alloc(f_g, z_size*sizeof(double), psd->error_message);
+  class_alloc(f_y, z_size*sizeof(double), psd->error_message);
+  class_alloc(f_mu, z_size*sizeof(double), psd->error_message);
+  class_alloc(residual, x_size*z_size*sizeof(double), psd->error_message);
+  class_alloc(weighted, x_size*z_size*sizeof(double), psd->error_message);
+
+  for (index_z=0; index_z<z_size; ++index_z) {
+    proj_G = 0.;
+    proj_M = 0.;
+    proj_Y = 0.;
+    for (index_x=0; index_x<x_size; ++index_x) {
+      proj_G += G_th[index_x*z_size+index_z]*e_G[index_x];
+      proj_M += G_th[index_x*z_size+index_z]*e_M[index_x];
+      proj_Y += G_th[index_x*z_size+index_z]*e_Y[index_x];
+    }
+    f_g[index_z] = proj_G/norm_G;
+    f_mu[index_z] = (proj_M-G_M*f_g[index_z])/norm_M;
+    f_y[index_z] = (proj_Y-M_Y*f_mu[index_z]-G_Y*f_g[index_z])/norm_Y;
+
+    for (index_x=0; index_x<x_size; ++index_x) {
+      residual[index_x*z_size+index_z] = G_th[index_x*z_size+index_z]
+        -Gdist[index_x]*f_g[index_z]-Ydist[index_x]*f_y[index_z]-Mdist[index_x]*f_mu[index_z];
+      /* The Fisher matrix is the product of the transposed weighted residual with itself */
+      weighted[index_x*z_size+index_z] = residual[index_x*z_size+index_z]*delta_ln_z/delta_Ic[index_x]*1.e8;
+    }
+  }
+
+  /** Principal components: E vectors in redshift, and corresponding S vectors in frequency */
+  class_alloc(sigma, x_size*sizeof(double), psd->error_message);
+  class_alloc(E_vecs, x_size*z_size*sizeof(double), psd->error_message);
+  class_call(distortions_PCA_Jacobi(weighted,x_size,z_size,sigma,E_vecs,psd->error_message),
+             psd->error_message,
+             psd->error_message);
+
+  class_alloc(S_vecs, PCA_size*x_size*sizeof(double), psd->error_message);
+  for (index_pca=0; index_pca<PCA_size; ++index_pca) {
+    for (index_x=0; index_x<x_size; ++index_x) {
+      S_vecs[index_pca*x_size+index_x] = 0.;
+      for (index_z=0; index_z<z_size; ++index_z) {
+        S_vecs[index_pca*x_size+index_x] += E_vecs[index_pca*z_size+index_z]*residual[index_x*z_size+index_z]*delta_ln_z;
+      }
+    }
+  }
+
+  /** Write the files read by distortions_read_br_data() and distortions_read_sd_data() */
+  class_sprintf(filename,"%s/%s_branching_ratios.dat",ppr->sd_external_path,psd->sd_detector_name);
+  class_open(outfile, filename, "w", psd->error_message);
+  fprintf(outfile,"# In the file there is: z, J_T, J_y, J_mu, E_i (i=1-%d)\n",PCA_size);
+  fprintf(outfile,"# The first line contains the number of lines and the number of columns.\n");
+  fprintf(outfile,"%d %d\n",z_size,PCA_size);
+  for (index_z=0; index_z<z_size; ++index_z) {
+    fprintf(outfile,"%.6e %.6e %.6e %.6e",z[index_z],f_g[index_z],f_y[index_z],f_mu[index_z]);
+    for (index_pca=0; index_pca<PCA_size; ++index_pca) {
+      fprintf(outfile," %.6e",E_vecs[index_pca*z_size+index_z]);
+    }
+    fprintf(outfile,"\n");
+  }
+  fclose(outfile);
+
+  class_sprintf(filename,"%s/%s_distortions_shapes.dat",ppr->sd_external_path,psd->sd_detector_name);
+  class_open(outfile, filename, "w", psd->error_message);
+  fprintf(outfile,"# In the file there is: nu, G_T, Y_SZ, M_mu, S_i (i=1-%d)\n",PCA_size);
+  fprintf(outfile,"# The first line contains the number of lines and the number of columns.\n");
+  fprintf(outfile,"%d %d\n",x_size,PCA_size);
+  for (index_x=0; index_x<x_size; ++index_x) {
+    fprintf(outfile,"%.6e %.6e %.6e %.6e",x[index_x]*psd->x_to_nu,Gdist[index_x],Ydist[index_x],Mdist[index_x]);
+    for (index_pca=0; index_pca<PCA_size; ++index_pca) {
+      fprintf(outfile," %.6e",S_vecs[index_pca*x_size+index_x]);
+    }
+    fprintf(outfile,"\n");
+  }
+  fclose(outfile);
 
+  /** Add the detector to the list of known detectors */
+  class_open(outfile, psd->sd_detector_list_file, "a", psd->error_message);
+  if (psd->has_detector_file == _TRUE_) {
+    fprintf(outfile,"%s  %s\n",psd->sd_detector_name,psd->sd_detector_file_name);
   }
   else {
-    class_sprintf(temporary_string,"python %s %s %.10e %.10e %.10e  %i %.10e %.10e %i %.10e %i %.10e %.10e %.10e",
-            psd->sd_PCA_file_generator,
+    fprintf(outfile,"%s  %.6e  %.6e  %.6e  %i  %.6e\n",
             psd->sd_detector_name,
             psd->sd_detector_nu_min,
             psd->sd_detector_nu_max,
             psd->sd_detector_nu_delta,
             psd->sd_detector_bin_number,
-            ppr->sd_z_min,
-            ppr->sd_z_max,
-            ppr->sd_z_size,
-            psd->sd_detector_delta_Ic,
-            6,
-            psd->z_th,
-            psd->DI_units,
-            psd->x_to_nu);
-  }
-  is_success = system(temporary_string);
-  class_test(is_success == -1,
-             psd->error_message,
-             "The command 'python %s' failed.\nPlease make sure the file exists.",psd->sd_PCA_file_generator);
+            psd->sd_detector_delta_Ic);
+  }
+  fclose(outfile);
+
+  /** Free local variables */
+  free(Greens_z);
+  free(Greens_lnz);
+  free(Greens_T_ini);
+  free(ddGreens_T_ini);
+  free(Greens_T_last);
+  free(ddGreens_T_last);
+  free(Greens_drho);
+  free(ddGreens_drho);
+  free(Greens_x);
+  free(Greens_G_th);
+  free(ddGreens_G_th);
+  free(z);
+  free(x);
+  free(delta_Ic);
+  free(index_x_Greens);
+  free(frac_x_Greens);
+  free(G_th);
+  free(Gdist);
+  free(Ydist);
+  free(Mdist);
+  free(e_G);
+  free(e_Y);
+  free(e_M);
+  free(f_g);
+  free(f_y);
+  free(f_mu);
+  free(residual);
+  free(weighted);
+  free(sigma);
+  free(E_vecs);
+  free(S_vecs);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Singular value decomposition of a matrix with few rows, by the
+ * one-sided Jacobi method: pairs of rows are rotated until all rows are
+ * orthogonal. The rows are then the right singular vectors, multiplied
+ * by the singular values. These vectors are also the eigenvectors of
+ * the product of the transposed matrix with itself (e.g. a Fisher
+ * matrix), with eigenvalues equal to the squared singular values.
+ *
+ * @param matrix     Input: matrix[index_row*column_size+index_column] (overwritten)
+ * @param row_size   Input: number of rows
+ * @param column_size Input: number of columns
+ * @param sigma      Output: singular values in decreasing order, sigma[index_row]
+ * @param vectors    Output: corresponding normalized right singular vectors, vectors[index_row*column_size+index_column],
+ *                   each with a positive largest (in absolute value) component
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int distortions_PCA_Jacobi(double * matrix,
+                           int row_size,
+                           int column_size,
+                           double * sigma,
+                           double * vectors,
+                           ErrorMsg error_message){
+
+  /** Define local variables */
+  int index_i, index_j, index_c, index_max, sweep;
+  int rotated;
+  double alpha, beta, gamma, zeta, t, c, s, ri, rj;
+  double * ri_row;
+  double * rj_row;
+  int * order;
+  int max_sweeps = 100;
+  double tolerance = 1.e-15;
+
+  /** Rotate pairs of rows until they are all orthogonal */
+  rotated = _TRUE_;
+  for (sweep=0; sweep<max_sweeps && rotated == _TRUE_; ++sweep) {
+    rotated = _FALSE_;
+    for (index_i=0; index_i<row_size-1; ++index_i) {
+      ri_row = matrix+index_i*column_size;
+      for (index_j=index_i+1; index_j<row_size; ++index_j) {
+        rj_row = matrix+index_j*column_size;
+        alpha = 0.;
+        beta = 0.;
+        gamma = 0.;
+        for (index_c=0; index_c<column_size; ++index_c) {
+          alpha += ri_row[index_c]*ri_row[index_c];
+          beta += rj_row[index_c]*rj_row[index_c];
+          gamma += ri_row[index_c]*rj_row[index_c];
+        }
+        if (fabs(gamma) <= tolerance*sqrt(alpha*beta)) {
+          continue;
+        }
+        rotated = _TRUE_;
+        zeta = (beta-alpha)/(2.*gamma);
+        t = (zeta >= 0. ? 1. : -1.)/(fabs(zeta)+sqrt(1.+zeta*zeta));
+        c = 1./sqrt(1.+t*t);
+        s = c*t;
+        for (index_c=0; index_c<column_size; ++index_c) {
+          ri = ri_row[index_c];
+          rj = rj_row[index_c];
+          ri_row[index_c] = c*ri-s*rj;
+          rj_row[index_c] = s*ri+c*rj;
+        }
+      }
+    }
+  }
+  class_test(rotated == _TRUE_,
+             error_message,
+             "Jacobi singular value decomposition did not converge after %d sweeps",max_sweeps);
+
+  /** Sort rows by decreasing norm, and normalize them */
+  class_alloc(order, row_size*sizeof(int), error_message);
+  for (index_i=0; index_i<row_size; ++index_i) {
+    order[index_i] = index_i;
+    sigma[index_i] = 0.;
+    for (index_c=0; index_c<column_size; ++index_c) {
+      sigma[index_i] += matrix[index_i*column_size+index_c]*matrix[index_i*column_size+index_c];
+    }
+    sigma[index_i] = sqrt(sigma[index_i]);
+  }
+  for (index_i=0; index_i<row_size; ++index_i) {
+    index_max = index_i;
+    for (index_j=index_i+1; index_j<row_size; ++index_j) {
+      if (sigma[order[index_j]] > sigma[order[index_max]]) {
+        index_max = index_j;
+      }
+    }
+    index_j = order[index_i];
+    order[index_i] = order[index_max];
+    order[index_max] = index_j;
+  }
+  for (index_i=0; index_i<row_size; ++index_i) {
+    index_max = 0;
+    for (index_c=0; index_c<column_size; ++index_c) {
+      vectors[index_i*column_size+index_c] = (sigma[order[index_i]] > 0. ? matrix[order[index_i]*column_size+index_c]/sigma[order[index_i]] : 0.);
+      if (fabs(vectors[index_i*column_size+index_c]) > fabs(vectors[index_i*column_size+index_max])) {
+        index_max = index_c;
+      }
+    }
+    /* The sign of singular vectors is arbitrary: fix it as generate_PCA_files.py does */
+    if (vectors[index_i*column_size+index_max] < 0.) {
+      for (index_c=0; index_c<column_size; ++index_c) {
+        vectors[index_i*column_size+index_c] *= -1.;
+      }
+    }
+  }
+  for (index_i=0; index_i<row_size; ++index_i) {
+    matrix[index_i] = sigma[order[index_i]];
+  }
+  for (index_i=0; index_i<row_size; ++index_i) {
+    sigma[index_i] = matrix[index_i];
+  }
+
+  free(order);
 
   return _SUCCESS_;
 }
@@ -955,7 +1418,7 @@ int distortions_compute_spectral_shapes(struct precision * ppr,
   }
   else {
     /* If PCA analysis is required, the shapes has to be vectorized. This is done in the external
-       file spectral_shapes.dat using generate_PCA_files.py */
+       file spectral_shapes.dat using distortions_generate_detector() */
 
     /* Read and spline data from file spectral_shapes.dat */
     class_call(distortions_read_sd_data(ppr,psd),
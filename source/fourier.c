@@ -12,6 +12,7 @@
  */
 
 #include "fourier.h"
+#include "parallel.h"
 
 /**
  * Return the P(k,z) for a given redshift z and pk type (_m, _cb)
@@ -72,6 +73,7 @@ int fourier_pk_at_z(
                     ) {
   double tau;
   double ln_tau;
+  double ln_D2;
   int index_k;
   int index_ic1;
   int index_ic2;
@@ -88,8 +90,62 @@ int fourier_pk_at_z(
 
   class_test(pk_output == pk_nonlinear && pfo->method == nl_none, pfo->error_message, "Cannot get nonlinear power spectrum when no nonlinear method is employed");
 
+  /** - case of a linear spectrum stored as D^2(z) P_L(k,0): rescale the spectrum today */
+  if ((pk_output == pk_linear) && (pfo->pk_is_growth_factorised == _TRUE_)) {
+
+    ln_D2 = 0.;
+
+    if (z != 0) {
+
+      class_call(background_tau_of_z(pba,
+                                     z,
+                                     &tau),
+                 pba->error_message,
+                 pfo->error_message);
+
+      ln_tau = log(tau);
+      last_index = pfo->ln_tau_size-1;
+
+      class_test(ln_tau<pfo->ln_tau[0]-100.*_EPSILON_,
+                 pfo->error_message,
+                 "requested z was not inside of tau tabulation range (Requested ln(tau_=%.10e, Min %.10e). Solution might be to increase input parameter z_max_pk (see explanatory.ini)",ln_tau,pfo->ln_tau[0]);
+
+      class_test(ln_tau>pfo->ln_tau[pfo->ln_tau_size-1]+_EPSILON_,
+                 pfo->error_message,
+                 "requested z was not inside of tau tabulation range (Requested ln(tau_=%.10e, Max %.10e) ",ln_tau,pfo->ln_tau[pfo->ln_tau_size-1]);
+
+      if (ln_tau <= pfo->ln_tau[0]) {
+        ln_D2 = pfo->ln_D2[0];
+      }
+      else if (ln_tau < pfo->ln_tau[pfo->ln_tau_size-1]) {
+        class_call(array_interpolate_spline(pfo->ln_tau,
+                                            pfo->ln_tau_size,
+                                            pfo->ln_D2,
+                                            pfo->ddln_D2,
+                                            1,
+                                            ln_tau,
+                                            &last_index,
+                                            &ln_D2,
+                                            1,
+                                            pfo->error_message),
+                   pfo->error_message,
+                   pfo->error_message);
+      }
+    }
+
+    for (index_k=0; index_k<pfo->k_size; index_k++) {
+      out_pk[index_k] = pfo->ln_pk_l[index_pk][index_k] + ln_D2;
+
+      if (do_ic == _TRUE_) {
+        for (index_ic1_ic2 = 0; index_ic1_ic2 < pfo->ic_ic_size; index_ic1_ic2++) {
+          out_pk_ic[index_k * pfo->ic_ic_size + index_ic1_ic2] = pfo->ln_pk_ic_l[index_pk][index_k * pfo->ic_ic_size + index_ic1_ic2] + ln_D2;
+        }
+      }
+    }
+  }
+
   /** - case z=0 requiring no interpolation in z */
-  if (z == 0) {
+  else if (z == 0) {
 
     for (index_k=0; index_k<pfo->k_size; index_k++) {
 
@@ -940,6 +996,147 @@ int fourier_pks_at_kvec_and_zvec(
   return _SUCCESS_;
 }
 
+/**
+ * Return one type of P(k,z) (_m or _cb), linear or nonlinear, for a
+ * grid of (k_i,z_j) passed in input.
+ *
+ * Each value is the same as the one returned by
+ * fourier_pk_at_k_and_z() (including the extrapolation to k < kmin,
+ * and an error for k > kmax), but the spline of P(k) at each z_j is
+ * computed only once, and the k_i are located by hunting from the
+ * previous one, which is fastest when they are sorted. This function
+ * does not return individual contributions from several initial
+ * conditions.
+ *
+ * @param pba            Input: pointer to background structure
+ * @param ppm            Input: pointer to primordial structure
+ * @param pfo            Input: pointer to fourier structure
+ * @param pk_output      Input: pk_linear or pk_nonlinear
+ * @param kvec           Input: array of wavenumbers in arbitrary order (in 1/Mpc)
+ * @param kvec_size      Input: size of array of wavenumbers
+ * @param zvec           Input: array of redshifts in arbitrary order
+ * @param zvec_size      Input: size of array of redshifts
+ * @param index_pk       Input: index of pk type (_m, _cb)
+ * @param out_pk         Output: P(k_i,z_j) in Mpc**3, as out_pk[index_zvec*kvec_size+index_kvec] (already allocated)
+ * @return the error status
+ */
+
+int fourier_pk_at_kvec_and_zvec(
+                                struct background * pba,
+                                struct primordial * ppm,
+                                struct fourier * pfo,
+                                enum pk_outputs pk_output,
+                                double * kvec,
+                                int kvec_size,
+                                double * zvec,
+                                int zvec_size,
+                                int index_pk,
+                                double * out_pk
+                                ) {
+
+  int index_kvec, index_zvec;
+  int last_index = 0;
+  double kmin, kmax;
+  double * pk_primordial_k;
+  double * pk_primordial_kmin;
+  double * ln_pk;
+  double * ddln_pk;
+  double h, a, b;
+
+  kmin = exp(pfo->ln_k[0]);
+  kmax = exp(pfo->ln_k[pfo->k_size-1]);
+
+  /** - check that all k are in valid range [0:kmax]
+      (the test for z will be done when calling fourier_pk_at_z()) */
+
+  for (index_kvec=0; index_kvec<kvec_size; index_kvec++) {
+    class_test((kvec[index_kvec] < 0.) || (kvec[index_kvec] > kmax),
+               pfo->error_message,
+               "k=%e out of bounds [%e:%e]",kvec[index_kvec],0.,kmax);
+  }
+
+  class_alloc(pk_primordial_k, pfo->ic_ic_size*sizeof(double), pfo->error_message);
+  class_alloc(pk_primordial_kmin, pfo->ic_ic_size*sizeof(double), pfo->error_message);
+
+  class_call(primordial_spectrum_at_k(ppm,
+                                      pfo->index_md_scalars,
+                                      linear,
+                                      kmin,
+                                      pk_primordial_kmin),
+             ppm->error_message,
+             pfo->error_message);
+
+  class_alloc(ln_pk, pfo->k_size*sizeof(double), pfo->error_message);
+  class_alloc(ddln_pk, pfo->k_size*sizeof(double), pfo->error_message);
+
+  for (index_zvec=0; index_zvec<zvec_size; index_zvec++) {
+
+    /** - get log(P(k)) at z_j for the pre-computed wavenumbers, and spline it along k */
+
+    class_call(fourier_pk_at_z(pba,
+                               pfo,
+                               logarithmic,
+                               pk_output,
+                               zvec[index_zvec],
+                               index_pk,
+                               ln_pk,
+                               NULL),
+               pfo->error_message,
+               pfo->error_message);
+
+    class_call(array_spline_table_lines(pfo->ln_k,
+                                        pfo->k_size,
+                                        ln_pk,
+                                        1,
+                                        ddln_pk,
+                                        _SPLINE_NATURAL_,
+                                        pfo->error_message),
+               pfo->error_message,
+               pfo->error_message);
+
+    /** - interpolate at each k_i, or extrapolate for 0 < k_i < kmin as in fourier_pk_at_k_and_z() */
+
+    for (index_kvec=0; index_kvec<kvec_size; index_kvec++) {
+
+      if (kvec[index_kvec] == 0.) {
+        out_pk[index_zvec*kvec_size+index_kvec] = 0.;
+      }
+      else if (kvec[index_kvec] > kmin) {
+        class_call(array_spline_hunt(pfo->ln_k,
+                                     pfo->k_size,
+                                     log(kvec[index_kvec]),
+                                     &last_index,
+                                     &h,&a,&b,
+                                     pfo->error_message),
+                   pfo->error_message,
+                   pfo->error_message);
+
+        out_pk[index_zvec*kvec_size+index_kvec] =
+          exp(array_spline_eval(ln_pk,ddln_pk,last_index,last_index+1,h,a,b));
+      }
+      else {
+        class_call(primordial_spectrum_at_k(ppm,
+                                            pfo->index_md_scalars,
+                                            linear,
+                                            kvec[index_kvec],
+                                            pk_primordial_k),
+                   ppm->error_message,
+                   pfo->error_message);
+
+        out_pk[index_zvec*kvec_size+index_kvec] =
+          exp(ln_pk[0])*kvec[index_kvec]*pk_primordial_k[0]/kmin/pk_primordial_kmin[0];
+      }
+    }
+  }
+
+  free(pk_primordial_k);
+  free(pk_primordial_kmin);
+  free(ln_pk);
+  free(ddln_pk);
+
+  return _SUCCESS_;
+}
+
 /**
  * Return the logarithmic slope of P(k,z) for a given (k,z), a given pk type (_m, _cb)
  * (computed with linear P_L if pk_output = pk_linear, nonlinear P_NL if pk_output = pk_nonlinear)
@@ -1210,6 +1407,7 @@ int fourier_init(
   double **pk_nl;
   double **lnpk_l;
   double **ddlnpk_l;
+  double * pk_primordial;
 
   short nl_corr_not_computable_at_this_k = _FALSE_;
 
@@ -1223,6 +1421,10 @@ int fourier_init(
   /** - Do we want to compute P(k,z)? Propagate the flag has_pk_matter
       from the perturbations structure to the fourier structure */
   pfo->has_pk_matter = ppt->has_pk_matter;
+  pfo->pk_is_growth_factorised = _FALSE_;
+  pfo->pk_extrapolation_error = 0.;
+  pfo->correction_is_applied = _FALSE_;
+  pfo->correction_drift = 0.;
 
   /** - preliminary tests */
 
@@ -1273,7 +1475,20 @@ int fourier_init(
              pfo->error_message,
              pfo->error_message);
 
-  /** - get the linear power spectrum at each time */
+  /** - get the primordial spectra, which are the same at each time */
+
+  class_alloc(pk_primordial,
+              pfo->k_size_extra*pfo->ic_ic_size*sizeof(double),
+              pfo->error_message);
+
+  class_call(fourier_pk_primordial(ppm,pfo,pk_primordial),
+             pfo->error_message,
+             pfo->error_message);
+
+  /** - get the linear power spectrum at each time (parallelized over
+      times and pk types) */
+
+  class_setup_parallel();
 
   for (index_tau=0; index_tau<pfo->ln_tau_size;index_tau++) {
 
@@ -1296,47 +1511,77 @@ int fourier_init(
 
       /** --> get the linear power spectrum for this time and this type */
 
-      class_call(fourier_pk_linear(
-                                   pba,
-                                   ppt,
-                                   ppm,
-                                   pfo,
-                                   index_pk,
-                                   index_tau_sources,
-                                   pfo->k_size,
-                                   &(pfo->ln_pk_l[index_pk][index_tau * pfo->k_size]),
-                                   &(pfo->ln_pk_ic_l[index_pk][index_tau * pfo->k_size * pfo->ic_ic_size])
-                                   ),
-                 pfo->error_message,
-                 pfo->error_message);
+      class_run_parallel(with_arguments(pba,ppt,pfo,pk_primordial,index_pk,index_tau,index_tau_sources),
 
+        class_call(fourier_pk_linear(
+                                     pba,
+                                     ppt,
+                                     pfo,
+                                     pk_primordial,
+                                     index_pk,
+                                     index_tau_sources,
+                                     pfo->k_size,
+                                     &(pfo->ln_pk_l[index_pk][index_tau * pfo->k_size]),
+                                     &(pfo->ln_pk_ic_l[index_pk][index_tau * pfo->k_size * pfo->ic_ic_size])
+                                     ),
+                   pfo->error_message,
+                   pfo->error_message);
 
-      /** --> if interpolation of \f$P(k,\tau)\f$ will be needed (as a
-          function of tau), compute array of second derivatives in view of
-          spline interpolation */
+        return _SUCCESS_;
+      );
+    }
+  }
 
-      if (pfo->ln_tau_size > 1) {
+  class_finish_parallel();
 
-        class_call(array_spline_table_lines(pfo->ln_tau,
-                                            pfo->ln_tau_size,
-                                            pfo->ln_pk_l[index_pk],
-                                            pfo->k_size,
-                                            pfo->ddln_pk_l[index_pk],
-                                            _SPLINE_EST_DERIV_,
-                                            pfo->error_message),
-                   pfo->error_message,
-                   pfo->error_message);
+  /** - if the linear power spectrum was extended analytically beyond
+      the last wavenumber of the sources, estimate the error of this
+      extension */
 
-        class_call(array_spline_table_lines(pfo->ln_tau,
-                                            pfo->ln_tau_size,
-                                            pfo->ln_pk_ic_l[index_pk],
-                                            pfo->k_size*pfo->ic_ic_size,
-                                            pfo->ddln_pk_ic_l[index_pk],
-                                            _SPLINE_EST_DERIV_,
-                                            pfo->error_message),
-                   pfo->error_message,
-                   pfo->error_message);
-      }
+  if (pfo->k_size > pfo->k_size_sources) {
+    class_call(fourier_pk_extrapolation_error(ppr,pba,ppt,pfo),
+               pfo->error_message,
+               pfo->error_message);
+  }
+
+  /** - store or apply a multi-fidelity correction of the linear
+      spectra, if requested (before the splines, sigma8 and the
+      non-linear spectra, which are then inferred from the corrected
+      linear spectra) */
+
+  if (pfo->correction_mode != correction_none) {
+    class_call(fourier_correction(pfo),
+               pfo->error_message,
+               pfo->error_message);
+  }
+
+  /** - if interpolation of \f$P(k,\tau)\f$ will be needed (as a
+      function of tau), compute array of second derivatives in view of
+      spline interpolation, once the whole table is filled */
+
+  if (pfo->ln_tau_size > 1) {
+
+    for (index_pk=0; index_pk<pfo->pk_size; index_pk++) {
+
+      class_call(array_spline_table_lines(pfo->ln_tau,
+                                          pfo->ln_tau_size,
+                                          pfo->ln_pk_l[index_pk],
+                                          pfo->k_size,
+                                          pfo->ddln_pk_l[index_pk],
+                                          _SPLINE_EST_DERIV_,
+                                          pfo->error_message),
+                 pfo->error_message,
+                 pfo->error_message);
+
+      class_call(array_spline_table_lines(pfo->ln_tau,
+                                          pfo->ln_tau_size,
+                                          pfo->ln_pk_ic_l[index_pk],
+                                          pfo->k_size*pfo->ic_ic_size,
+                                          pfo->ddln_pk_ic_l[index_pk],
+                                          _SPLINE_EST_DERIV_,
+                                          pfo->error_message),
+                 pfo->error_message,
+                 pfo->error_message);
     }
   }
 
@@ -1454,8 +1699,8 @@ int fourier_init(
         class_call(fourier_pk_linear(
                                      pba,
                                      ppt,
-                                     ppm,
                                      pfo,
+                                     pk_primordial,
                                      index_pk,
                                      index_tau,
                                      pfo->k_size_extra,
@@ -1642,6 +1887,18 @@ int fourier_init(
                "Your non-linear method variable is set to %d, out of the range defined in fourier.h",pfo->method);
   }
 
+  free(pk_primordial);
+
+  /** - if requested, replace the table of linear spectra by the
+      spectra today and a scale-independent growth factor (only after
+      the non-linear spectra have been inferred from the full table) */
+
+  if (pfo->pk_growth_factorisation == _TRUE_) {
+    class_call(fourier_pk_growth_factorise(ppr,pba,pfo),
+               pfo->error_message,
+               pfo->error_message);
+  }
+
   pfo->is_allocated = _TRUE_;
   return _SUCCESS_;
 }
@@ -1667,7 +1924,7 @@ int fourier_free(
     for (index_pk=0; index_pk<pfo->pk_size; index_pk++) {
       free(pfo->ln_pk_ic_l[index_pk]);
       free(pfo->ln_pk_l[index_pk]);
-      if (pfo->ln_tau_size>1) {
+      if ((pfo->ln_tau_size>1) && (pfo->pk_is_growth_factorised == _FALSE_)) {
         free(pfo->ddln_pk_ic_l[index_pk]);
         free(pfo->ddln_pk_l[index_pk]);
       }
@@ -1678,8 +1935,14 @@ int fourier_free(
     free (pfo->sigma8);
 
     if (pfo->ln_tau_size>1) {
-      free(pfo->ddln_pk_ic_l);
-      free(pfo->ddln_pk_l);
+      if (pfo->pk_is_growth_factorised == _FALSE_) {
+        free(pfo->ddln_pk_ic_l);
+        free(pfo->ddln_pk_l);
+      }
+      else {
+        free(pfo->ln_D2);
+        free(pfo->ddln_D2);
+      }
       free(pfo->ln_tau);
     }
 
@@ -1709,10 +1972,32 @@ int fourier_free(
     free(pfo->pk_eq_ddw_and_ddOmega);
   }
 
+  fourier_free_input(pfo);
+
   pfo->is_allocated = _FALSE_;
   return _SUCCESS_;
 }
 
+/**
+ * Free the memory space allocated by the input module for the
+ * multi-fidelity correction.
+ *
+ * Called by fourier_free(), and during shooting
+ *
+ * @param pfo Input: pointer to fourier structure with input pointers to be freed
+ * @return the error status
+ */
+
+int fourier_free_input(
+                       struct fourier *pfo
+                       ) {
+
+  free(pfo->correction_parameters);
+  pfo->correction_parameters = NULL;
+
+  return _SUCCESS_;
+}
+
 /**
  * Define indices in the fourier structure, and when possible, allocate
  * arrays in this structure given the index sizes found here
@@ -1862,13 +2147,41 @@ int fourier_get_k_list(
                        ) {
 
   double k=0;
-  double k_max,exponent;
+  double k_max,k_max_extended,exponent;
   int index_k;
 
-  pfo->k_size = ppt->k_size[pfo->index_md_scalars];
+  pfo->k_size_sources = ppt->k_size[pfo->index_md_scalars];
+  pfo->k_size = pfo->k_size_sources;
   pfo->k_size_pk = ppt->k_size_pk;
   k_max = ppt->k[pfo->index_md_scalars][pfo->k_size-1];
 
+  /** - if the sources stop before the k_max needed for the output
+      of P(k) or for non-linear corrections, compute the number of
+      values of the analytic extension of P(k) up to this k_max */
+  if (ppt->has_k_max_for_pk_sources == _TRUE_) {
+
+    k_max_extended = 0.;
+    if (pfo->has_pk_matter == _TRUE_)
+      k_max_extended = ppt->k_max_for_pk;
+    if (pfo->method > nl_none)
+      k_max_extended = MAX(k_max_extended,ppr->nonlinear_min_k_max);
+
+    index_k=0;
+    k = k_max;
+    while(k < k_max_extended && index_k < _MAX_NUM_EXTRAPOLATION_){
+      index_k++;
+      k = k_max * pow(10,(double)index_k/ppr->k_per_decade_for_pk);
+    }
+    class_test(index_k == _MAX_NUM_EXTRAPOLATION_,
+               pfo->error_message,
+               "could not reach extended value k = %.10e starting from k = %.10e with k_per_decade of %.10e in _MAX_NUM_INTERPOLATION_=%i steps",
+               k_max_extended,k_max,ppr->k_per_decade_for_pk,_MAX_NUM_EXTRAPOLATION_
+               );
+    pfo->k_size += index_k;
+    k_max = k;
+    k = 0;
+  }
+
   /** - if k extrapolation necessary, compute number of required extra values */
   if (pfo->method == nl_HMcode){
     index_k=0;
@@ -1893,19 +2206,41 @@ int fourier_get_k_list(
   class_alloc(pfo->ln_k,pfo->k_size_extra*sizeof(double),pfo->error_message);
 
   /** - fill array of k (not extrapolated) */
-  for (index_k=0; index_k<pfo->k_size; index_k++) {
+  for (index_k=0; index_k<pfo->k_size_sources; index_k++) {
     k = ppt->k[pfo->index_md_scalars][index_k];
     pfo->k[index_k] = k;
     pfo->ln_k[index_k] = log(k);
   }
 
   /** - fill additional values of k (extrapolated) */
-  for (index_k=pfo->k_size; index_k<pfo->k_size_extra; index_k++) {
-    exponent = (double)(index_k-(pfo->k_size-1))/ppr->k_per_decade_for_pk;
+  for (index_k=pfo->k_size_sources; index_k<pfo->k_size_extra; index_k++) {
+    exponent = (double)(index_k-(pfo->k_size_sources-1))/ppr->k_per_decade_for_pk;
     pfo->k[index_k] = k * pow(10,exponent);
     pfo->ln_k[index_k] = log(k) + exponent*log(10.);
   }
 
+  if (pfo->k_size > pfo->k_size_sources) {
+
+    /** - if P(k) is extended analytically and the sources stop
+        before k_max_for_pk, the output of P(k) also covers the
+        extension, until the first value above k_max_for_pk */
+    if (k <= ppt->k_max_for_pk) {
+      for (index_k=pfo->k_size_sources; (index_k<pfo->k_size-1) && (pfo->k[index_k] <= ppt->k_max_for_pk); index_k++);
+      pfo->k_size_pk = index_k+1;
+    }
+
+    /** - find the first value of k to which the extension is fitted */
+    pfo->index_k_fit = pfo->k_size_sources-1;
+    while ((pfo->index_k_fit > 0) &&
+           (pfo->k[pfo->index_k_fit-1] >= k*pow(10.,-ppr->pk_extrapolation_fit_decades)))
+      pfo->index_k_fit--;
+
+    class_test(pfo->k_size_sources-pfo->index_k_fit < 2*_SOURCE_FIT_SIZE_,
+               pfo->error_message,
+               "only %d values of k in the last %g decade(s) of the sources, from which P(k) should be extended until k=%e: increase pk_extrapolation_fit_decades or k_per_decade_for_pk",
+               pfo->k_size_sources-pfo->index_k_fit,ppr->pk_extrapolation_fit_decades,pfo->k[pfo->k_size-1]);
+  }
+
   return _SUCCESS_;
 }
 
@@ -1955,6 +2290,12 @@ int fourier_get_tau_list(
  * mode...) either directly from precomputed valkues (computed ain
  * perturbation module), or by analytic extrapolation
  *
+ * Between the last computed wavenumber and pfo->k[pfo->k_size-1]
+ * (when the sources stop before the k_max of P(k)), the sources are
+ * given by the function fitted by fourier_source_fit(). Beyond that
+ * (for HMcode), they are extrapolated from the last two values of
+ * pfo->k with pfo->extrapolation_method.
+ *
  * @param pba             Input: pointer to background structure
  * @param ppt             Input: pointer to perturbation structure
  * @param pfo             Input: pointer to fourier structure
@@ -1963,6 +2304,7 @@ int fourier_get_tau_list(
  * @param index_tp        Input: index of required tp value
  * @param index_tau       Input: index of required tau value
  * @param sources         Input: array containing the original sources
+ * @param fit_coefficients Input: coefficients computed by fourier_source_fit() (only used if pfo->k_size > pfo->k_size_sources)
  * @param source          Output: desired value of source
  * @return the error status
  */
@@ -1976,6 +2318,7 @@ int fourier_get_source(
                        int index_tp,
                        int index_tau,
                        double ** sources,
+                       double * fit_coefficients,
                        double * source
                        ) {
 
@@ -1984,8 +2327,14 @@ int fourier_get_source(
   double scaled_factor,log_scaled_factor;
 
   /** - use precomputed values */
-  if (index_k < pfo->k_size) {
-    *source = sources[index_ic * ppt->tp_size[pfo->index_md_scalars] + index_tp][index_tau * pfo->k_size + index_k];
+  if (index_k < pfo->k_size_sources) {
+    *source = sources[index_ic * ppt->tp_size[pfo->index_md_scalars] + index_tp][index_tau * pfo->k_size_sources + index_k];
+  }
+  /** - use the function fitted to the precomputed values */
+  else if (index_k < pfo->k_size) {
+    class_call(fourier_source_fit_at_k(pfo,fit_coefficients,pfo->k[index_k],source),
+               pfo->error_message,
+               pfo->error_message);
   }
   /** - extrapolate **/
   else {
@@ -1996,13 +2345,24 @@ int fourier_get_source(
      * --> Get last source and k, which are used in (almost) all methods
      */
     k_max = pfo->k[pfo->k_size-1];
-    source_max = sources[index_ic * ppt->tp_size[pfo->index_md_scalars] + index_tp][index_tau * pfo->k_size + pfo->k_size - 1];
 
     /**
      * --> Get previous source and k, which are used in best methods
      */
     k_previous = pfo->k[pfo->k_size-2];
-    source_previous = sources[index_ic * ppt->tp_size[pfo->index_md_scalars] + index_tp][index_tau * pfo->k_size + pfo->k_size - 2];
+
+    if (pfo->k_size > pfo->k_size_sources) {
+      class_call(fourier_source_fit_at_k(pfo,fit_coefficients,k_max,&source_max),
+                 pfo->error_message,
+                 pfo->error_message);
+      class_call(fourier_source_fit_at_k(pfo,fit_coefficients,k_previous,&source_previous),
+                 pfo->error_message,
+                 pfo->error_message);
+    }
+    else {
+      source_max = sources[index_ic * ppt->tp_size[pfo->index_md_scalars] + index_tp][index_tau * pfo->k_size + pfo->k_size - 1];
+      source_previous = sources[index_ic * ppt->tp_size[pfo->index_md_scalars] + index_tp][index_tau * pfo->k_size + pfo->k_size - 2];
+    }
 
     switch(pfo->extrapolation_method){
       /**
@@ -2070,61 +2430,313 @@ int fourier_get_source(
 }
 
 /**
- * This routine computes all the components of the matter power
- * spectrum P(k), given the source functions and the primordial
- * spectra, at a given time within the pre-computed table of sources
- * (= Fourier transfer functions) of the perturbation module, for a
- * given type (total matter _m or baryon+CDM _cb), and for the same
- * array of k values as in the pre-computed table.
- *
- * If the input array of k values pfo->ln_k contains wavemumbers
- * larger than those of the pre-computed table, the sources will be
- * extrapolated analytically.
- *
- * On the opther hand, if the primordial spectrum has sharp features
- * and needs to be sampled on a finer grid than the sources, this
- * function has to be modified to capture the features.
+ * Fit the sources of the perturbation module, for given time, type
+ * and initial condition, over the wavenumbers pfo->k[index_k] with
+ * index_k_min <= index_k < index_k_max, in view of extending them
+ * analytically beyond the last computed wavenumber k_s.
  *
- * There are two output arrays, because we consider:
- *
- * - the total matter (_m) or CDM+baryon (_cb) power spectrum
- *
- * - in the quantitites labelled _ic, the splitting of one of these
- * spectra in different modes for different initial conditions. If the
- * pointer ln_pk_ic is NULL in input, the function will ignore this
- * part; thus, to get the result, one should allocate the array before
- * calling the function. Then the convention is the following:
- *
- * -- the index_ic1_ic2 labels ordered pairs (index_ic1, index_ic2)
- * (since the primordial spectrum is symmetric in (index_ic1,
- * index_ic2)).
+ * The fitting function is the large-k limit of the density transfer
+ * functions of Eisenstein & Hu (astro-ph/9709112), delta(k) \propto
+ * k^2 L/(L + C q^2) with L = ln(e + 1.8 q), expanded in 1/k^2 and
+ * with free coefficients, in which the suppression of the baryon
+ * fluctuations by Silk damping is absorbed:
  *
- * -- for diagonal elements (index_ic1 = index_ic2) this
- * arrays contains ln[P(k)] where P(k) is positive by construction.
+ * source(k) = c_0 + c_1 x + (c_2 + c_3 x) y, with x = ln(k/k_s), y = (k_s/k)^2
  *
- * -- for non-diagonal elements this arrays contains the k-dependent
- * cosine of the correlation angle, namely P(k)_(index_ic1,
- * index_ic2)/sqrt[P(k)_index_ic1 P(k)_index_ic2]. E.g. for fully
- * correlated or anti-correlated initial conditions, this non-diagonal
- * element is independent on k, and equal to +1 or -1.
+ * The coefficients are found by least squares. This neglects the
+ * late-time Jeans filtering of baryons, which reduces the sources by
+ * about one percent at k = 50/Mpc.
  *
- * @param pba           Input: pointer to background structure
- * @param ppt           Input: pointer to perturbation structure
- * @param ppm           Input: pointer to primordial structure
- * @param pfo           Input: pointer to fourier structure
- * @param index_pk      Input: index of required P(k) type (_m, _cb)
- * @param index_tau     Input: index of time
- * @param k_size        Input: wavenumber array size
- * @param lnpk         Output: log of matter power spectrum for given type/time, for all wavenumbers
- * @param lnpk_ic      Output: log of matter power spectrum for given type/time, for all wavenumbers and initial conditions
+ * @param ppt              Input: pointer to perturbation structure
+ * @param pfo              Input: pointer to fourier structure
+ * @param index_ic         Input: index of initial condition
+ * @param index_tp         Input: index of source type
+ * @param index_tau        Input: index of time in the sources
+ * @param index_k_min      Input: index of the first fitted value of k
+ * @param index_k_max      Input: index following the last fitted value of k
+ * @param sources          Input: array containing the original sources
+ * @param fit_coefficients Output: array of _SOURCE_FIT_SIZE_ coefficients
  * @return the error status
  */
 
-int fourier_pk_linear(
-                      struct background *pba,
-                      struct perturbations *ppt,
-                      struct primordial *ppm,
+int fourier_source_fit(
+                       struct perturbations * ppt,
+                       struct fourier * pfo,
+                       int index_ic,
+                       int index_tp,
+                       int index_tau,
+                       int index_k_min,
+                       int index_k_max,
+                       double ** sources,
+                       double * fit_coefficients
+                       ) {
+
+  /* arrays indexed from 1 to _SOURCE_FIT_SIZE_, as expected by ludcmp() and lubksb() */
+  double matrix[_SOURCE_FIT_SIZE_+1][_SOURCE_FIT_SIZE_+1];
+  double * matrix_rows[_SOURCE_FIT_SIZE_+1];
+  double vector[_SOURCE_FIT_SIZE_+1];
+  double lu_work[_SOURCE_FIT_SIZE_+1];
+  int lu_index[_SOURCE_FIT_SIZE_+1];
+  double basis[_SOURCE_FIT_SIZE_];
+  double source,parity;
+  int index_k,i,j;
+
+  class_test(index_k_max-index_k_min < _SOURCE_FIT_SIZE_,
+             pfo->error_message,
+             "cannot fit %d coefficients to %d values of the sources",
+             _SOURCE_FIT_SIZE_,index_k_max-index_k_min);
+
+  /** - accumulate the normal equations of the least squares problem */
+  for (i=1; i<=_SOURCE_FIT_SIZE_; i++) {
+    matrix_rows[i] = matrix[i];
+    vector[i] = 0.;
+    for (j=1; j<=_SOURCE_FIT_SIZE_; j++) {
+      matrix[i][j] = 0.;
+    }
+  }
+
+  for (index_k=index_k_min; index_k<index_k_max; index_k++) {
+
+    source = sources[index_ic * ppt->tp_size[pfo->index_md_scalars] + index_tp][index_tau * pfo->k_size_sources + index_k];
+
+    class_call(fourier_source_fit_basis(pfo,pfo->k[index_k],basis),
+               pfo->error_message,
+               pfo->error_message);
+
+    for (i=1; i<=_SOURCE_FIT_SIZE_; i++) {
+      vector[i] += basis[i-1]*source;
+      for (j=1; j<=_SOURCE_FIT_SIZE_; j++) {
+        matrix[i][j] += basis[i-1]*basis[j-1];
+      }
+    }
+  }
+
+  /** - solve them */
+  class_test(ludcmp(matrix_rows,_SOURCE_FIT_SIZE_,lu_index,&parity,lu_work) == _FAILURE_,
+             pfo->error_message,
+             "singular system when fitting the sources between k=%e and k=%e",
+             pfo->k[index_k_min],pfo->k[index_k_max-1]);
+
+  lubksb(matrix_rows,_SOURCE_FIT_SIZE_,lu_index,vector);
+
+  for (i=0; i<_SOURCE_FIT_SIZE_; i++) {
+    fit_coefficients[i] = vector[i+1];
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Basis functions of the fit of fourier_source_fit() at a given k.
+ *
+ * @param pfo   Input: pointer to fourier structure
+ * @param k     Input: wavenumber
+ * @param basis Output: array of _SOURCE_FIT_SIZE_ values of the basis functions
+ * @return the error status
+ */
+
+int fourier_source_fit_basis(
+                             struct fourier * pfo,
+                             double k,
+                             double * basis
+                             ) {
+
+  double k_s,x,y;
+
+  k_s = pfo->k[pfo->k_size_sources-1];
+  x = log(k/k_s);
+  y = (k_s/k)*(k_s/k);
+
+  basis[0] = 1.;
+  basis[1] = x;
+  basis[2] = y;
+  basis[3] = x*y;
+
+  return _SUCCESS_;
+}
+
+/**
+ * Value of the function fitted to the sources by
+ * fourier_source_fit() at a given k.
+ *
+ * @param pfo              Input: pointer to fourier structure
+ * @param fit_coefficients Input: coefficients computed by fourier_source_fit()
+ * @param k                Input: wavenumber
+ * @param source           Output: fitted source
+ * @return the error status
+ */
+
+int fourier_source_fit_at_k(
+                            struct fourier * pfo,
+                            double * fit_coefficients,
+                            double k,
+                            double * source
+                            ) {
+
+  double basis[_SOURCE_FIT_SIZE_];
+  int i;
+
+  class_call(fourier_source_fit_basis(pfo,k,basis),
+             pfo->error_message,
+             pfo->error_message);
+
+  *source = 0.;
+  for (i=0; i<_SOURCE_FIT_SIZE_; i++) {
+    *source += fit_coefficients[i]*basis[i];
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Estimate the error of the analytic extension of the linear P(k)
+ * beyond the last wavenumber of the sources, by comparing, over the
+ * extended range of k, the function fitted by fourier_source_fit()
+ * to the one fitted without the upper third (in ln k) of the same
+ * wavenumbers. This is done for each P(k) type and initial condition,
+ * at each time of the output of P(k,z), and the maximum relative
+ * difference on P(k) is stored in pfo->pk_extrapolation_error.
+ *
+ * @param ppr Input: pointer to precision structure
+ * @param pba Input: pointer to background structure
+ * @param ppt Input: pointer to perturbation structure
+ * @param pfo Input/Output: pointer to fourier structure
+ * @return the error status
+ */
+
+int fourier_pk_extrapolation_error(
+                                   struct precision *ppr,
+                                   struct background *pba,
+                                   struct perturbations *ppt,
+                                   struct fourier *pfo
+                                   ) {
+
+  int index_pk,index_tp,index_ic,index_tau,index_tau_sources,index_k;
+  int index_k_holdout;
+  double fit_coefficients[_SOURCE_FIT_SIZE_];
+  double holdout_coefficients[_SOURCE_FIT_SIZE_];
+  double source,source_holdout;
+  double error=0.;
+
+  /** - the hold-out fit stops one third of pk_extrapolation_fit_decades below the last k of the sources */
+  for (index_k_holdout=pfo->index_k_fit;
+       pfo->k[index_k_holdout] < pfo->k[pfo->k_size_sources-1]*pow(10.,-ppr->pk_extrapolation_fit_decades/3.);
+       index_k_holdout++);
+
+  for (index_pk=0; index_pk<pfo->pk_size; index_pk++) {
+
+    if ((pfo->has_pk_m == _TRUE_) && (index_pk == pfo->index_pk_m))
+      index_tp = ppt->index_tp_delta_m;
+    else
+      index_tp = ppt->index_tp_delta_cb;
+
+    for (index_ic=0; index_ic<pfo->ic_size; index_ic++) {
+
+      /* same correspondance between output times and times of the sources as in fourier_init() */
+      for (index_tau=0; index_tau<pfo->ln_tau_size; index_tau++) {
+
+        index_tau_sources = ppt->tau_size-ppt->ln_tau_size+index_tau;
+
+        class_call(fourier_source_fit(ppt,pfo,index_ic,index_tp,index_tau_sources,pfo->index_k_fit,pfo->k_size_sources,
+                                      ppt->sources[pfo->index_md_scalars],fit_coefficients),
+                   pfo->error_message,
+                   pfo->error_message);
+
+        class_call(fourier_source_fit(ppt,pfo,index_ic,index_tp,index_tau_sources,pfo->index_k_fit,index_k_holdout,
+                                      ppt->sources[pfo->index_md_scalars],holdout_coefficients),
+                   pfo->error_message,
+                   pfo->error_message);
+
+        for (index_k=pfo->k_size_sources; index_k<pfo->k_size; index_k++) {
+
+          class_call(fourier_source_fit_at_k(pfo,fit_coefficients,pfo->k[index_k],&source),
+                     pfo->error_message,
+                     pfo->error_message);
+
+          class_call(fourier_source_fit_at_k(pfo,holdout_coefficients,pfo->k[index_k],&source_holdout),
+                     pfo->error_message,
+                     pfo->error_message);
+
+          error = MAX(error,fabs(source_holdout*source_holdout/source/source-1.));
+        }
+      }
+    }
+  }
+
+  pfo->pk_extrapolation_error = error;
+
+  if (pfo->fourier_verbose > 0)
+    printf(" -> linear P(k) extended analytically from k = %g to %g h/Mpc, with an estimated error of %.1e\n",
+           pfo->k[pfo->k_size_sources-1]/pba->h,pfo->k[pfo->k_size-1]/pba->h,error);
+
+  if (error > ppr->pk_extrapolation_tolerance)
+    fprintf(stdout,
+            " -> [WARNING:] The estimated error %.1e of the analytic extension of P(k) beyond k = %g h/Mpc exceeds pk_extrapolation_tolerance = %.1e.\n    Increase perturbations_P_k_max_h/Mpc (or _1/Mpc), or pk_extrapolation_fit_decades.\n",
+            error,pfo->k[pfo->k_size_sources-1]/pba->h,ppr->pk_extrapolation_tolerance);
+
+  return _SUCCESS_;
+}
+
+/**
+ * This routine computes all the components of the matter power
+ * spectrum P(k), given the source functions and the primordial
+ * spectra, at a given time within the pre-computed table of sources
+ * (= Fourier transfer functions) of the perturbation module, for a
+ * given type (total matter _m or baryon+CDM _cb), and for the same
+ * array of k values as in the pre-computed table.
+ *
+ * If the input array of k values pfo->ln_k contains wavemumbers
+ * larger than those of the pre-computed table, the sources will be
+ * extrapolated analytically.
+ *
+ * On the opther hand, if the primordial spectrum has sharp features
+ * and needs to be sampled on a finer grid than the sources, this
+ * function has to be modified to capture the features.
+ *
+ * There are two output arrays, because we consider:
+ *
+ * - the total matter (_m) or CDM+baryon (_cb) power spectrum
+ *
+ * - in the quantitites labelled _ic, the splitting of one of these
+ * spectra in different modes for different initial conditions. If the
+ * pointer ln_pk_ic is NULL in input, the function will ignore this
+ * part; thus, to get the result, one should allocate the array before
+ * calling the function. Then the convention is the following:
+ *
+ * -- the index_ic1_ic2 labels ordered pairs (index_ic1, index_ic2)
+ * (since the primordial spectrum is symmetric in (index_ic1,
+ * index_ic2)).
+ *
+ * -- for diagonal elements (index_ic1 = index_ic2) this
+ * arrays contains ln[P(k)] where P(k) is positive by construction.
+ *
+ * -- for non-diagonal elements this arrays contains the k-dependent
+ * cosine of the correlation angle, namely P(k)_(index_ic1,
+ * index_ic2)/sqrt[P(k)_index_ic1 P(k)_index_ic2]. E.g. for fully
+ * correlated or anti-correlated initial conditions, this non-diagonal
+ * element is independent on k, and equal to +1 or -1.
+ *
+ * The primordial spectra do not depend on time: they are read once
+ * for all wavenumbers by fourier_pk_primordial(), and passed to this
+ * function through the array pk_primordial.
+ *
+ * @param pba           Input: pointer to background structure
+ * @param ppt           Input: pointer to perturbation structure
+ * @param pfo           Input: pointer to fourier structure
+ * @param pk_primordial Input: table of primordial spectra filled by fourier_pk_primordial()
+ * @param index_pk      Input: index of required P(k) type (_m, _cb)
+ * @param index_tau     Input: index of time
+ * @param k_size        Input: wavenumber array size
+ * @param lnpk         Output: log of matter power spectrum for given type/time, for all wavenumbers
+ * @param lnpk_ic      Output: log of matter power spectrum for given type/time, for all wavenumbers and initial conditions
+ * @return the error status
+ */
+
+int fourier_pk_linear(
+                      struct background *pba,
+                      struct perturbations *ppt,
                       struct fourier *pfo,
+                      double * pk_primordial, //pk_primordial[index_ic1_ic2 * pfo->k_size_extra + index_k]
                       int index_pk,
                       int index_tau,
                       int k_size,
@@ -2135,18 +2747,12 @@ int fourier_pk_linear(
   int index_k;
   int index_tp;
   int index_ic1,index_ic2,index_ic1_ic1,index_ic1_ic2,index_ic2_ic2;
-  double * primordial_pk;
-  double pk;
+  int k_size_sources;
+  double * source;
+  double * source_ic;
   double * pk_ic;
-  double source_ic1;
-  double source_ic2;
   double cosine_correlation;
-
-  /** - allocate temporary vector where the primordial spectrum will be stored */
-
-  class_alloc(primordial_pk,pfo->ic_ic_size*sizeof(double),pfo->error_message);
-
-  class_alloc(pk_ic,pfo->ic_ic_size*sizeof(double),pfo->error_message);
+  double fit_coefficients[_SOURCE_FIT_SIZE_];
 
   if ((pfo->has_pk_m == _TRUE_) && (index_pk == pfo->index_pk_m)) {
     index_tp = ppt->index_tp_delta_m;
@@ -2158,34 +2764,43 @@ int fourier_pk_linear(
     class_stop(pfo->error_message,"P(k) is set neither to total matter nor to cold dark matter + baryons");
   }
 
-  /** - loop over k values */
+  /** - allocate temporary arrays for the sources, source[index_ic * k_size + index_k],
+      and the contributions of each pair of initial conditions, pk_ic[index_ic1_ic2 * k_size + index_k] */
 
-  for (index_k=0; index_k<k_size; index_k++) {
+  class_alloc(source,pfo->ic_size*k_size*sizeof(double),pfo->error_message);
 
-    /** --> get primordial spectrum */
-    class_call(primordial_spectrum_at_k(ppm,pfo->index_md_scalars,logarithmic,pfo->ln_k[index_k],primordial_pk),
-               ppm->error_message,
-               pfo->error_message);
+  class_alloc(pk_ic,pfo->ic_ic_size*k_size*sizeof(double),pfo->error_message);
 
-    /** --> initialize a local variable for P_m(k) and P_cb(k) to zero */
-    pk = 0.;
+  /** - copy the sources of each initial condition at this time (they
+      are contiguous in k), and extrapolate them beyond the largest
+      wavenumber of the perturbation module */
 
-    /** --> here we recall the relations relevant for the nomalization fo the power spectrum:
-        For adiabatic modes, the curvature primordial spectrum thnat we just read was:
-        P_R(k) = 1/(2pi^2) k^3 < R R >
-        Thus the primordial curvature correlator is given by:
-        < R R > = (2pi^2) k^-3 P_R(k)
-        So the delta_m correlator reads:
-        P(k) = < delta_m delta_m > = (source_m)^2 < R R > = (2pi^2) k^-3 (source_m)^2 P_R(k)
+  k_size_sources = MIN(k_size,pfo->k_size_sources);
 
-        For isocurvature or cross adiabatic-isocurvature parts,
-        one would just replace one or two 'R' by 'S_i's */
+  for (index_ic1 = 0; index_ic1 < pfo->ic_size; index_ic1++) {
 
-    /** --> get contributions to P(k) diagonal in the initial conditions */
-    for (index_ic1 = 0; index_ic1 < pfo->ic_size; index_ic1++) {
+    source_ic = ppt->sources[pfo->index_md_scalars][index_ic1 * ppt->tp_size[pfo->index_md_scalars] + index_tp] + index_tau * pfo->k_size_sources;
 
-      index_ic1_ic1 = index_symmetric_matrix(index_ic1,index_ic1,pfo->ic_size);
+    for (index_k=0; index_k<k_size_sources; index_k++) {
+      source[index_ic1 * k_size + index_k] = source_ic[index_k];
+    }
+
+    /* the fit used by the analytic extension only depends on the time and initial condition */
+    if ((k_size > k_size_sources) && (pfo->k_size > pfo->k_size_sources)) {
+      class_call(fourier_source_fit(ppt,
+                                    pfo,
+                                    index_ic1,
+                                    index_tp,
+                                    index_tau,
+                                    pfo->index_k_fit,
+                                    pfo->k_size_sources,
+                                    ppt->sources[pfo->index_md_scalars],
+                                    fit_coefficients),
+                 pfo->error_message,
+                 pfo->error_message);
+    }
 
+    for (index_k=k_size_sources; index_k<k_size; index_k++) {
       class_call(fourier_get_source(pba,
                                     ppt,
                                     pfo,
@@ -2194,83 +2809,531 @@ int fourier_pk_linear(
                                     index_tp,
                                     index_tau,
                                     ppt->sources[pfo->index_md_scalars],
-                                    &source_ic1),
+                                    fit_coefficients,
+                                    &(source[index_ic1 * k_size + index_k])),
                  pfo->error_message,
                  pfo->error_message);
 
-      pk_ic[index_ic1_ic1] = 2.*_PI_*_PI_/exp(3.*pfo->ln_k[index_k])
-        *source_ic1*source_ic1
-        *exp(primordial_pk[index_ic1_ic1]);
+      class_test((index_k < pfo->k_size) && (source[index_ic1 * k_size + index_k]*source_ic[k_size_sources-1] <= 0.),
+                 pfo->error_message,
+                 "the analytic extension of the sources changes sign at k=%e: increase perturbations_P_k_max_h/Mpc (or _1/Mpc)",
+                 pfo->k[index_k]);
+    }
+  }
+
+  /** - here we recall the relations relevant for the nomalization fo the power spectrum:
+      For adiabatic modes, the curvature primordial spectrum thnat we just read was:
+      P_R(k) = 1/(2pi^2) k^3 < R R >
+      Thus the primordial curvature correlator is given by:
+      < R R > = (2pi^2) k^-3 P_R(k)
+      So the delta_m correlator reads:
+      P(k) = < delta_m delta_m > = (source_m)^2 < R R > = (2pi^2) k^-3 (source_m)^2 P_R(k)
+
+      For isocurvature or cross adiabatic-isocurvature parts,
+      one would just replace one or two 'R' by 'S_i's.
+
+      The total P_m(k) or P_cb(k) is accumulated in lnpk before taking its logarithm. */
+
+  for (index_k=0; index_k<k_size; index_k++) {
+    lnpk[index_k] = 0.;
+  }
+
+  /** - get contributions to P(k) diagonal in the initial conditions */
+  for (index_ic1 = 0; index_ic1 < pfo->ic_size; index_ic1++) {
+
+    index_ic1_ic1 = index_symmetric_matrix(index_ic1,index_ic1,pfo->ic_size);
+
+    for (index_k=0; index_k<k_size; index_k++) {
 
-      pk += pk_ic[index_ic1_ic1];
+      pk_ic[index_ic1_ic1 * k_size + index_k] = pk_primordial[index_ic1_ic1 * pfo->k_size_extra + index_k]
+        *source[index_ic1 * k_size + index_k]
+        *source[index_ic1 * k_size + index_k];
 
-      if (lnpk_ic != NULL) {
-        lnpk_ic[index_k * pfo->ic_ic_size + index_ic1_ic1] = log(pk_ic[index_ic1_ic1]);
+      lnpk[index_k] += pk_ic[index_ic1_ic1 * k_size + index_k];
+    }
+
+    if (lnpk_ic != NULL) {
+      for (index_k=0; index_k<k_size; index_k++) {
+        lnpk_ic[index_k * pfo->ic_ic_size + index_ic1_ic1] = log(pk_ic[index_ic1_ic1 * k_size + index_k]);
       }
     }
+  }
 
-    /** --> get contributions to P(k) non-diagonal in the initial conditions */
-    for (index_ic1 = 0; index_ic1 < pfo->ic_size; index_ic1++) {
-      for (index_ic2 = index_ic1+1; index_ic2 < pfo->ic_size; index_ic2++) {
+  /** - get contributions to P(k) non-diagonal in the initial conditions */
+  for (index_ic1 = 0; index_ic1 < pfo->ic_size; index_ic1++) {
+    for (index_ic2 = index_ic1+1; index_ic2 < pfo->ic_size; index_ic2++) {
 
-        index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic2,pfo->ic_size);
-        index_ic1_ic1 = index_symmetric_matrix(index_ic1,index_ic1,pfo->ic_size);
-        index_ic2_ic2 = index_symmetric_matrix(index_ic2,index_ic2,pfo->ic_size);
-
-        if (pfo->is_non_zero[index_ic1_ic2] == _TRUE_) {
-
-          class_call(fourier_get_source(pba,
-                                        ppt,
-                                        pfo,
-                                        index_k,
-                                        index_ic1,
-                                        index_tp,
-                                        index_tau,
-                                        ppt->sources[pfo->index_md_scalars],
-                                        &source_ic1),
-                     pfo->error_message,
-                     pfo->error_message);
+      index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic2,pfo->ic_size);
+      index_ic1_ic1 = index_symmetric_matrix(index_ic1,index_ic1,pfo->ic_size);
+      index_ic2_ic2 = index_symmetric_matrix(index_ic2,index_ic2,pfo->ic_size);
 
-          class_call(fourier_get_source(pba,
-                                        ppt,
-                                        pfo,
-                                        index_k,
-                                        index_ic2,
-                                        index_tp,
-                                        index_tau,
-                                        ppt->sources[pfo->index_md_scalars],
-                                        &source_ic2),
-                     pfo->error_message,
-                     pfo->error_message);
+      if (pfo->is_non_zero[index_ic1_ic2] == _TRUE_) {
 
-          cosine_correlation = primordial_pk[index_ic1_ic2]*SIGN(source_ic1)*SIGN(source_ic2);
+        for (index_k=0; index_k<k_size; index_k++) {
 
-          pk_ic[index_ic1_ic2] = cosine_correlation * sqrt(pk_ic[index_ic1_ic1]*pk_ic[index_ic2_ic2]);
+          cosine_correlation = pk_primordial[index_ic1_ic2 * pfo->k_size_extra + index_k]
+            *SIGN(source[index_ic1 * k_size + index_k])
+            *SIGN(source[index_ic2 * k_size + index_k]);
 
-          pk += 2.*pk_ic[index_ic1_ic2];
+          lnpk[index_k] += 2.*cosine_correlation*sqrt(pk_ic[index_ic1_ic1 * k_size + index_k]*pk_ic[index_ic2_ic2 * k_size + index_k]);
 
           if (lnpk_ic != NULL) {
             lnpk_ic[index_k * pfo->ic_ic_size + index_ic1_ic2] = cosine_correlation;
           }
         }
-        else {
-          if (lnpk_ic != NULL) {
+      }
+      else {
+        if (lnpk_ic != NULL) {
+          for (index_k=0; index_k<k_size; index_k++) {
             lnpk_ic[index_k * pfo->ic_ic_size + index_ic1_ic2] = 0.;
           }
         }
       }
     }
+  }
 
-    lnpk[index_k] = log(pk);
+  for (index_k=0; index_k<k_size; index_k++) {
+    lnpk[index_k] = log(lnpk[index_k]);
   }
 
-  free(primordial_pk);
+  free(source);
   free(pk_ic);
 
   return _SUCCESS_;
 
 }
 
+/**
+ * Fill the table of primordial spectra needed by fourier_pk_linear(),
+ * for all wavenumbers pfo->k[index_k] with index_k < pfo->k_size_extra.
+ *
+ * For diagonal elements (index_ic1 = index_ic2), the table contains
+ * the factor relating P(k) to the square of the source function,
+ * (2pi^2) k^-3 P_prim(k). For non-diagonal elements, it contains the
+ * cosine of the correlation angle of the primordial spectrum.
+ *
+ * @param ppm           Input: pointer to primordial structure
+ * @param pfo           Input: pointer to fourier structure
+ * @param pk_primordial Output: table pk_primordial[index_ic1_ic2 * pfo->k_size_extra + index_k], allocated by the caller
+ * @return the error status
+ */
+
+int fourier_pk_primordial(
+                          struct primordial *ppm,
+                          struct fourier *pfo,
+                          double * pk_primordial
+                          ) {
+
+  int index_k;
+  int index_ic1,index_ic2,index_ic1_ic2;
+  double * primordial_pk;
+
+  class_alloc(primordial_pk,pfo->ic_ic_size*sizeof(double),pfo->error_message);
+
+  for (index_k=0; index_k<pfo->k_size_extra; index_k++) {
+
+    class_call(primordial_spectrum_at_k(ppm,pfo->index_md_scalars,logarithmic,pfo->ln_k[index_k],primordial_pk),
+               ppm->error_message,
+               pfo->error_message);
+
+    for (index_ic1 = 0; index_ic1 < pfo->ic_size; index_ic1++) {
+      for (index_ic2 = index_ic1; index_ic2 < pfo->ic_size; index_ic2++) {
+
+        index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic2,pfo->ic_size);
+
+        if (index_ic1 == index_ic2) {
+          pk_primordial[index_ic1_ic2 * pfo->k_size_extra + index_k] = 2.*_PI_*_PI_/exp(3.*pfo->ln_k[index_k])*exp(primordial_pk[index_ic1_ic2]);
+        }
+        else {
+          pk_primordial[index_ic1_ic2 * pfo->k_size_extra + index_k] = primordial_pk[index_ic1_ic2];
+        }
+      }
+    }
+  }
+
+  free(primordial_pk);
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Store or apply a multi-fidelity correction of the linear spectra.
+ *
+ * The correction file contains the spectra of a fiducial model
+ * computed twice, with reference precision and with fast precision.
+ * In 'reference' or 'fast' mode, the linear P(k) at z=0 of the
+ * current run is stored in the corresponding slot of the file. In
+ * 'apply' mode, the linear P(k,z) of the current (fast) run is
+ * multiplied at all redshifts by the ratio reference/fast of the
+ * fiducial model at z=0. This is done before computing sigma8 and the
+ * non-linear spectra, which are then inferred from the corrected
+ * linear spectra.
+ *
+ * In 'apply' mode, the run stops with an error if the file does not
+ * contain both fiducial spectra, or if the input parameters differ
+ * from those of the fiducial fast run by more than
+ * correction_max_drift (the input module refreshes the file before,
+ * if it can).
+ *
+ * @param pfo Input/Output: pointer to fourier structure (corrected in 'apply' mode)
+ * @return the error status
+ */
+
+int fourier_correction(
+                       struct fourier *pfo
+                       ) {
+
+  char * slot[2] = {NULL,NULL};
+  size_t slot_size[2] = {0,0};
+  short is_usable;
+
+  if ((pfo->correction_mode == correction_reference) || (pfo->correction_mode == correction_fast)) {
+
+    /** - store the spectra of this run in the relevant slot */
+    class_call(fourier_correction_pack(pfo,&(slot[0]),&(slot_size[0])),
+               pfo->error_message,
+               pfo->error_message);
+
+    class_call_except(correction_store(pfo->correction_file,
+                                       correction_fourier,
+                                       pfo->correction_mode,
+                                       slot[0],
+                                       slot_size[0],
+                                       pfo->error_message),
+                      pfo->error_message,
+                      pfo->error_message,
+                      free(slot[0]));
+
+    free(slot[0]);
+
+    if (pfo->fourier_verbose > 0)
+      printf(" -> stored %s linear P(k) in correction file %s\n",
+             (pfo->correction_mode == correction_reference) ? "reference" : "fast",
+             pfo->correction_file);
+  }
+  else if (pfo->correction_mode == correction_apply) {
+
+    /** - apply the correction if the fiducial pair is complete and close enough */
+    class_call(correction_fetch(pfo->correction_file,correction_fourier,slot,slot_size,pfo->error_message),
+               pfo->error_message,
+               pfo->error_message);
+
+    class_call_except(correction_check(slot,
+                                       slot_size,
+                                       pfo->correction_parameters,
+                                       pfo->correction_max_drift,
+                                       pfo->correction_file,
+                                       &(pfo->correction_drift),
+                                       &is_usable,
+                                       pfo->error_message),
+                      pfo->error_message,
+                      pfo->error_message,
+                      free(slot[0]);free(slot[1]));
+
+    class_test_except((slot[0] == NULL) || (slot[1] == NULL),
+                      pfo->error_message,
+                      free(slot[0]);free(slot[1]),
+                      "correction file %s does not contain both reference and fast P(k): compute them with correction_mode = reference and fast, or give correction_reference_precision",
+                      pfo->correction_file);
+
+    class_test_except(is_usable == _FALSE_,
+                      pfo->error_message,
+                      free(slot[0]);free(slot[1]),
+                      "parameter drift %e from the fiducial model of %s exceeds correction_max_drift = %e: compute the fiducial pair again, or give correction_reference_precision",
+                      pfo->correction_drift,pfo->correction_file,pfo->correction_max_drift);
+
+    class_call_except(fourier_correction_apply(pfo,slot,slot_size),
+                      pfo->error_message,
+                      pfo->error_message,
+                      free(slot[0]);free(slot[1]));
+
+    free(slot[0]);
+    free(slot[1]);
+
+    if (pfo->fourier_verbose > 0)
+      printf(" -> corrected linear P(k) with file %s (parameter drift %e)\n",
+             pfo->correction_file,pfo->correction_drift);
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Pack the input parameters and the linear matter power spectra at
+ * z=0 of the current run into a slot of the correction file. The slot
+ * contains, after the parameters: pk_size, k_size, ln(k) and
+ * ln(P_L(k)) for each pk type.
+ *
+ * @param pfo       Input: pointer to fourier structure
+ * @param slot      Output: allocated slot
+ * @param slot_size Output: size in bytes of the slot
+ * @return the error status
+ */
+
+int fourier_correction_pack(
+                            struct fourier *pfo,
+                            char ** slot,
+                            size_t * slot_size
+                            ) {
+
+  int index_pk;
+  char * position;
+
+  *slot_size = sizeof(int) + strlen(pfo->correction_parameters)
+    + 2*sizeof(int) + pfo->k_size*(1+pfo->pk_size)*sizeof(double);
+
+  class_alloc(*slot,*slot_size,pfo->error_message);
+  position = *slot;
+
+  correction_pack_parameters(pfo->correction_parameters,&position);
+
+  class_correction_pack(position,&(pfo->pk_size),sizeof(int));
+  class_correction_pack(position,&(pfo->k_size),sizeof(int));
+  class_correction_pack(position,pfo->ln_k,pfo->k_size*sizeof(double));
+
+  /* the spectra are not factorised yet: z=0 is the last time */
+  for (index_pk = 0; index_pk < pfo->pk_size; index_pk++)
+    class_correction_pack(position,&(pfo->ln_pk_l[index_pk][(pfo->ln_tau_size-1)*pfo->k_size]),pfo->k_size*sizeof(double));
+
+  return _SUCCESS_;
+}
+
+/**
+ * Correct ln P_L(k,z) at all z, for all pk types and initial
+ * conditions, by the z=0 log-ratio of the reference and fast fiducial
+ * spectra, interpolated linearly in ln(k). There is no correction
+ * outside of the range of both fiducial runs.
+ *
+ * @param pfo       Input/Output: pointer to fourier structure
+ * @param slot      Input: content of each slot (reference, fast)
+ * @param slot_size Input: size in bytes of each slot
+ * @return the error status
+ */
+
+int fourier_correction_apply(
+                             struct fourier *pfo,
+                             char ** slot,
+                             size_t * slot_size
+                             ) {
+
+  /* fields of each slot, in the order of fourier_correction_pack() */
+  int pk_size[2],k_size[2];
+  double * ln_k[2];
+  double * ln_pk_l[2];
+  char * parameters;
+  int parameters_size;
+  int * pint;
+  char * position;
+  char * end;
+
+  int index_slot,index_pk,index_k,index_tau,index_ic,index_ic_ic;
+  double ln_k_min,ln_k_max,ln_pk[2],ln_pk_correction;
+
+  /** - unpack both slots */
+  for (index_slot=0; index_slot<2; index_slot++) {
+    position = slot[index_slot];
+    end = slot[index_slot]+slot_size[index_slot];
+    class_call(correction_unpack_parameters(&position,end,&parameters,&parameters_size,pfo->correction_file,pfo->error_message),
+               pfo->error_message,
+               pfo->error_message);
+    class_correction_unpack(position,end,pint,int,1,pfo->correction_file,pfo->error_message);
+    pk_size[index_slot] = *pint;
+    class_correction_unpack(position,end,pint,int,1,pfo->correction_file,pfo->error_message);
+    k_size[index_slot] = *pint;
+    class_correction_unpack(position,end,ln_k[index_slot],double,k_size[index_slot],pfo->correction_file,pfo->error_message);
+    class_correction_unpack(position,end,ln_pk_l[index_slot],double,k_size[index_slot]*pk_size[index_slot],pfo->correction_file,pfo->error_message);
+  }
+
+  class_test((pk_size[0] != pfo->pk_size) || (pk_size[1] != pfo->pk_size),
+             pfo->error_message,
+             "correction file %s was computed with other matter spectra (pk_size=%d,%d instead of %d)",
+             pfo->correction_file,pk_size[0],pk_size[1],pfo->pk_size);
+
+  class_test((k_size[0] < 2) || (k_size[1] < 2),
+             pfo->error_message,
+             "correction file %s contains less than two wavenumbers",
+             pfo->correction_file);
+
+  ln_k_min = MAX(ln_k[0][0],ln_k[1][0]);
+  ln_k_max = MIN(ln_k[0][k_size[0]-1],ln_k[1][k_size[1]-1]);
+
+  /** - correct ln P(k,z) by a k-dependent shift, which does not change
+      its second derivative with respect to ln(tau) */
+  for (index_pk = 0; index_pk < pfo->pk_size; index_pk++) {
+    for (index_k = 0; index_k < pfo->k_size; index_k++) {
+
+      if ((pfo->ln_k[index_k] < ln_k_min) || (pfo->ln_k[index_k] > ln_k_max))
+        continue;
+
+      for (index_slot=0; index_slot<2; index_slot++) {
+        class_call(correction_interpolate(ln_k[index_slot],
+                                          ln_pk_l[index_slot]+index_pk*k_size[index_slot],
+                                          k_size[index_slot],
+                                          pfo->ln_k[index_k],
+                                          &(ln_pk[index_slot])),
+                   pfo->error_message,
+                   pfo->error_message);
+      }
+      ln_pk_correction = ln_pk[0]-ln_pk[1];
+
+      for (index_tau = 0; index_tau < pfo->ln_tau_size; index_tau++) {
+        pfo->ln_pk_l[index_pk][index_tau*pfo->k_size+index_k] += ln_pk_correction;
+        /* the cross-correlations are stored as angles, not affected by a common factor */
+        for (index_ic = 0; index_ic < pfo->ic_size; index_ic++) {
+          index_ic_ic = index_symmetric_matrix(index_ic,index_ic,pfo->ic_size);
+          pfo->ln_pk_ic_l[index_pk][(index_tau*pfo->k_size+index_k)*pfo->ic_ic_size+index_ic_ic] += ln_pk_correction;
+        }
+      }
+    }
+  }
+
+  pfo->correction_is_applied = _TRUE_;
+
+  return _SUCCESS_;
+}
+
+/**
+ * Replace the table of linear spectra P_L(k,tau) by the spectra today
+ * and a scale-independent growth factor, P_L(k,tau) = D^2(tau)
+ * P_L(k,tau_0), if this factorisation reproduces the full table within
+ * ppr->pk_growth_factorisation_tolerance.
+ *
+ * ln[D^2(tau)/D^2(tau_0)] is defined as the median over k of
+ * ln[P_L(k,tau)/P_L(k,tau_0)] for the total matter spectrum, so that
+ * it is not biased by the few super-horizon wavenumbers, whose growth
+ * differs by up to about one percent at z~5 even in LCDM. The
+ * validity check compares the factorised form with the full table of
+ * each pk type at all tabulated k and tau. If it fails, or if there
+ * are massive neutrinos or several initial conditions, the full table is kept and
+ * pfo->pk_is_growth_factorised remains _FALSE_.
+ *
+ * @param ppr Input: pointer to precision structure
+ * @param pba Input: pointer to background structure
+ * @param pfo Input/Output: pointer to fourier structure
+ * @return the error status
+ */
+
+int fourier_pk_growth_factorise(
+                                struct precision *ppr,
+                                struct background *pba,
+                                struct fourier *pfo
+                                ) {
+
+  int index_pk;
+  int index_tau;
+  int index_k;
+  int index_tau_0;
+  double * ln_pk_l_0;
+  double * ln_pk_ic_l_0;
+  double * ln_ratio;
+  double error;
+
+  pfo->pk_is_growth_factorised = _FALSE_;
+
+  /** - nothing to do if P(k) is only stored today, or if there is no linear P(k) */
+  if ((pfo->has_pk_matter == _FALSE_) || (pfo->ln_tau_size == 1))
+    return _SUCCESS_;
+
+  /** - the free-streaming of massive neutrinos makes the growth
+      scale-dependent, and the contributions of several initial
+      conditions may grow differently */
+  if ((pba->has_ncdm == _TRUE_) || (pfo->ic_size > 1)) {
+    if (pfo->fourier_verbose > 0)
+      printf(" -> linear P(k,z) not factorised as D^2(z) P(k,0), because there are %s\n",
+             (pba->has_ncdm == _TRUE_) ? "massive neutrinos" : "several initial conditions");
+    return _SUCCESS_;
+  }
+
+  index_tau_0 = pfo->ln_tau_size-1;
+
+  /** - infer ln[D^2(tau)/D^2(tau_0)] from the total matter spectrum */
+
+  class_alloc(pfo->ln_D2,pfo->ln_tau_size*sizeof(double),pfo->error_message);
+  class_alloc(ln_ratio,pfo->k_size*sizeof(double),pfo->error_message);
+
+  for (index_tau=0; index_tau<pfo->ln_tau_size; index_tau++) {
+    for (index_k=0; index_k<pfo->k_size; index_k++) {
+      ln_ratio[index_k] = pfo->ln_pk_l[pfo->index_pk_total][index_tau*pfo->k_size+index_k]
+        - pfo->ln_pk_l[pfo->index_pk_total][index_tau_0*pfo->k_size+index_k];
+    }
+    qsort(ln_ratio,pfo->k_size,sizeof(double),compare_doubles);
+    pfo->ln_D2[index_tau] = 0.5*(ln_ratio[(pfo->k_size-1)/2]+ln_ratio[pfo->k_size/2]);
+  }
+
+  free(ln_ratio);
+
+  /** - check the factorised form against the full table of each pk type */
+
+  error = 0.;
+
+  for (index_pk=0; index_pk<pfo->pk_size; index_pk++) {
+    for (index_tau=0; index_tau<pfo->ln_tau_size; index_tau++) {
+      for (index_k=0; index_k<pfo->k_size; index_k++) {
+        error = MAX(error,fabs(pfo->ln_pk_l[index_pk][index_tau*pfo->k_size+index_k]
+                               - pfo->ln_pk_l[index_pk][index_tau_0*pfo->k_size+index_k]
+                               - pfo->ln_D2[index_tau]));
+      }
+    }
+  }
+
+  pfo->pk_growth_factorisation_error = error;
+
+  if (error > ppr->pk_growth_factorisation_tolerance) {
+    if (pfo->fourier_verbose > 0)
+      printf(" -> linear P(k,z) not factorised as D^2(z) P(k,0): the growth is scale-dependent (error %e on ln P larger than pk_growth_factorisation_tolerance=%e)\n",
+             error,ppr->pk_growth_factorisation_tolerance);
+    free(pfo->ln_D2);
+    return _SUCCESS_;
+  }
+
+  /** - keep only the spectra today, and the spline of ln D^2 */
+
+  for (index_pk=0; index_pk<pfo->pk_size; index_pk++) {
+
+    class_alloc(ln_pk_l_0,pfo->k_size*sizeof(double),pfo->error_message);
+    class_alloc(ln_pk_ic_l_0,pfo->k_size*pfo->ic_ic_size*sizeof(double),pfo->error_message);
+
+    memcpy(ln_pk_l_0,
+           pfo->ln_pk_l[index_pk]+index_tau_0*pfo->k_size,
+           pfo->k_size*sizeof(double));
+    memcpy(ln_pk_ic_l_0,
+           pfo->ln_pk_ic_l[index_pk]+index_tau_0*pfo->k_size*pfo->ic_ic_size,
+           pfo->k_size*pfo->ic_ic_size*sizeof(double));
+
+    free(pfo->ln_pk_l[index_pk]);
+    free(pfo->ln_pk_ic_l[index_pk]);
+    free(pfo->ddln_pk_l[index_pk]);
+    free(pfo->ddln_pk_ic_l[index_pk]);
+
+    pfo->ln_pk_l[index_pk] = ln_pk_l_0;
+    pfo->ln_pk_ic_l[index_pk] = ln_pk_ic_l_0;
+  }
+
+  free(pfo->ddln_pk_l);
+  free(pfo->ddln_pk_ic_l);
+
+  class_alloc(pfo->ddln_D2,pfo->ln_tau_size*sizeof(double),pfo->error_message);
+
+  class_call(array_spline_table_lines(pfo->ln_tau,
+                                      pfo->ln_tau_size,
+                                      pfo->ln_D2,
+                                      1,
+                                      pfo->ddln_D2,
+                                      _SPLINE_EST_DERIV_,
+                                      pfo->error_message),
+             pfo->error_message,
+             pfo->error_message);
+
+  pfo->pk_is_growth_factorised = _TRUE_;
+
+  if (pfo->fourier_verbose > 0)
+    printf(" -> linear P(k,z) factorised as D^2(z) P(k,0) (error %e on ln P)\n",error);
+
+  return _SUCCESS_;
+
+}
+
 /**
  * Calculate intermediate quantities for hmcode (sigma, sigma', ...)
  * for a given scale R and a given input P(k).
@@ -271,6 +271,9 @@ int harmonic_init(
 
   /** Summary: */
 
+  phr->correction_is_applied = _FALSE_;
+  phr->correction_drift = 0.;
+
   /** - check that we really want to compute at least one spectrum */
 
   if (ppt->has_cls == _FALSE_) {
@@ -304,6 +307,15 @@ int harmonic_init(
     phr->ct_size=0;
   }
 
+  /** - store or apply a multi-fidelity correction, if requested (before
+      lensing, so that lensed spectra are corrected as well) */
+
+  if (phr->correction_mode != correction_none) {
+    class_call(harmonic_correction(phr),
+               phr->error_message,
+               phr->error_message);
+  }
+
   /** - a pointer to the fourier structure is stored in the spectra
       structure. This odd, unusual and unelegant feature has been
       introduced in v2.8 in order to keep in use some deprecated
@@ -360,10 +372,31 @@ int harmonic_free(
   }
   phr->is_allocated = _FALSE_;
 
+  harmonic_free_input(phr);
+
   return _SUCCESS_;
 
 }
 
+/**
+ * Free all memory space allocated by input.
+ *
+ * Called by harmonic_free(), and during shooting
+ *
+ * @param phr Input: harmonic structure with input pointers to be freed
+ * @return the error status
+ */
+
+int harmonic_free_input(
+                        struct harmonic * phr
+                        ) {
+
+  free(phr->correction_parameters);
+  phr->correction_parameters = NULL;
+
+  return _SUCCESS_;
+}
+
 /**
  * This routine defines indices and allocates tables in the harmonic structure
  *
@@ -676,10 +709,18 @@ int harmonic_cls(
   /** - define local variables */
 
   int index_md;
-  int index_ic1,index_ic2,index_ic1_ic2;
   int index_l;
-  int index_ct;
   int cl_integrand_num_columns;
+  int mpi_rank, mpi_size;
+  size_t * mpi_sizes;
+  int status = _SUCCESS_;
+
+  /** - get the rank of this process and the number of processes
+      (multipoles are distributed among MPI processes, if any) */
+
+  class_call(class_mpi_rank_and_size(&mpi_rank,&mpi_size),
+             phr->error_message,
+             phr->error_message);
 
   /** - allocate pointers to arrays where results will be stored */
 
@@ -707,110 +748,111 @@ int harmonic_cls(
 
     class_alloc(phr->cl[index_md],sizeof(double)*phr->l_size[index_md]*phr->ct_size*phr->ic_ic_size[index_md],phr->error_message);
     class_alloc(phr->ddcl[index_md],sizeof(double)*phr->l_size[index_md]*phr->ct_size*phr->ic_ic_size[index_md],phr->error_message);
-    cl_integrand_num_columns = 1+phr->ct_size*2; /* one for k, ct_size for each type, ct_size for each second derivative of each type */
-
-    /** - --> (c) loop over initial conditions */
-
-    class_setup_parallel();
+    cl_integrand_num_columns = 1+phr->ic_ic_size[index_md]*phr->ct_size*2; /* one for k, ct_size for each type of each pair of ic's, ct_size for each second derivative of each type of each pair */
 
-    for (index_ic1 = 0; index_ic1 < phr->ic_size[index_md]; index_ic1++) {
-      for (index_ic2 = index_ic1; index_ic2 < phr->ic_size[index_md]; index_ic2++) {
-        index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic2,phr->ic_size[index_md]);
+    /* multipoles not computed by this process must be zero for the sum over processes */
+    if (mpi_size > 1)
+      memset(phr->cl[index_md],0,sizeof(double)*phr->l_size[index_md]*phr->ct_size*phr->ic_ic_size[index_md]);
 
-        /* non-diagonal coefficients should be computed only if non-zero correlation */
-        if (phr->is_non_zero[index_md][index_ic1_ic2] == _TRUE_) {
+    /** - --> (c) loop over l values defined in the transfer module.
+        For each l, compute the \f$ C_l\f$'s for all pairs of initial
+        conditions and all types (TT, TE, ...) by convolving primordial
+        spectra with transfer functions. This elementary task is
+        assigned to harmonic_compute_cl() */
 
-          /** - ---> loop over l values defined in the transfer module.
-              For each l, compute the \f$ C_l\f$'s for all types (TT, TE, ...)
-              by convolving primordial spectra with transfer  functions.
-              This elementary task is assigned to harmonic_compute_cl() */
+    class_setup_parallel();
 
-          for (index_l=0; index_l < ptr->l_size[index_md]; index_l++) {
+    for (index_l=0; index_l < ptr->l_size[index_md]; index_l++) {
 
-            class_run_parallel(=,
+      /* multipoles are dealt cyclically to MPI processes */
+      if (index_l % mpi_size != mpi_rank)
+        continue;
 
-              double * cl_integrand; /* array with argument cl_integrand[index_k*cl_integrand_num_columns+1+phr->index_ct] */
-              double * cl_integrand_limber; /* similar array with same columns but different number of lines (less k values) */
-              double * transfer_ic1; /* array with argument transfer_ic1[index_tt] */
-              double * transfer_ic2; /* idem */
-              double * primordial_pk;  /* array with argument primordial_pk[index_ic_ic]*/
+      class_run_parallel(=,
 
+        double * cl_integrand; /* array with argument cl_integrand[index_k*cl_integrand_num_columns+1+index_ic1_ic2*phr->ct_size+phr->index_ct] */
+        double * cl_integrand_limber; /* similar array with same columns but different number of lines (less k values) */
+        double * transfer; /* array with argument transfer[index_ic*tt_size+index_tt] */
+        double * primordial_pk;  /* array with argument primordial_pk[index_ic_ic]*/
 
-              class_alloc(cl_integrand,
-                          ptr->q_size*cl_integrand_num_columns*sizeof(double),
-                          phr->error_message);
+        class_alloc(cl_integrand,
+                    ptr->q_size*cl_integrand_num_columns*sizeof(double),
+                    phr->error_message);
 
-              cl_integrand_limber = NULL;
-              if (ptr->do_lcmb_full_limber == _TRUE_) {
-                class_alloc(cl_integrand_limber,
-                            ptr->q_size_limber*cl_integrand_num_columns*sizeof(double),
-                            phr->error_message);
-              }
+        cl_integrand_limber = NULL;
+        if (ptr->do_lcmb_full_limber == _TRUE_) {
+          class_alloc(cl_integrand_limber,
+                      ptr->q_size_limber*cl_integrand_num_columns*sizeof(double),
+                      phr->error_message);
+        }
 
-              class_alloc(primordial_pk,
-                          phr->ic_ic_size[index_md]*sizeof(double),
-                          phr->error_message);
-
-              class_alloc(transfer_ic1,
-                          ptr->tt_size[index_md]*sizeof(double),
-                          phr->error_message);
-
-              class_alloc(transfer_ic2,
-                          ptr->tt_size[index_md]*sizeof(double),
-                          phr->error_message);
-
-              class_call(harmonic_compute_cl(ppr,
-                                             pba,
-                                             ppt,
-                                             ptr,
-                                             ppm,
-                                             phr,
-                                             index_md,
-                                             index_ic1,
-                                             index_ic2,
-                                             index_l,
-                                             cl_integrand_num_columns,
-                                             cl_integrand,
-                                             cl_integrand_limber,
-                                             primordial_pk,
-                                             transfer_ic1,
-                                             transfer_ic2),
-                         phr->error_message,
-                         phr->error_message);
-
-              free(cl_integrand);
-              if (ptr->do_lcmb_full_limber == _TRUE_) {
-                free(cl_integrand_limber);
-              }
-              free(primordial_pk);
-              free(transfer_ic1);
-              free(transfer_ic2);
+        class_alloc(primordial_pk,
+                    phr->ic_ic_size[index_md]*sizeof(double),
+                    phr->error_message);
+
+        class_alloc(transfer,
+                    phr->ic_size[index_md]*ptr->tt_size[index_md]*sizeof(double),
+                    phr->error_message);
+
+        class_call(harmonic_compute_cl(ppr,
+                                       pba,
+                                       ppt,
+                                       ptr,
+                                       ppm,
+                                       phr,
+                                       index_md,
+                                       index_l,
+                                       cl_integrand_num_columns,
+                                       cl_integrand,
+                                       cl_integrand_limber,
+                                       primordial_pk,
+                                       transfer),
+                   phr->error_message,
+                   phr->error_message);
+
+        free(cl_integrand);
+        if (ptr->do_lcmb_full_limber == _TRUE_) {
+          free(cl_integrand_limber);
+        }
+        free(primordial_pk);
+        free(transfer);
 
-              return _SUCCESS_;
-            );
-          } /* end of loop over l */
+        return _SUCCESS_;
+      );
+    } /* end of loop over l */
 
-        }
-        else {
+    class_finish_parallel_status(status);
 
-          /* set non-diagonal coefficients to zero if pair of ic's uncorrelated */
+    if (status == _FAILURE_)
+      break;
+  }
 
-          for (index_l=0; index_l < ptr->l_size[index_md]; index_l++) {
-            for (index_ct=0; index_ct<phr->ct_size; index_ct++) {
-              phr->cl[index_md]
-                [(index_l * phr->ic_ic_size[index_md] + index_ic1_ic2) * phr->ct_size + index_ct]
-                = 0.;
-            }
-          }
-        }
-      }
-    }
+  /** - stop all MPI processes together if any of them failed (nothing to do without MPI) */
+
+  if (class_mpi_check_status(status,phr->error_message) == _FAILURE_)
+    return _FAILURE_;
+
+  /** - gather the \f$ C_l\f$'s of all modes computed by all MPI processes (nothing to do without MPI) */
+
+  if (mpi_size > 1) {
+    class_alloc(mpi_sizes,phr->md_size*sizeof(size_t),phr->error_message);
+    for (index_md = 0; index_md < phr->md_size; index_md++)
+      mpi_sizes[index_md] = (size_t)phr->l_size[index_md]*phr->ct_size*phr->ic_ic_size[index_md];
+    class_call_except(class_mpi_sum(phr->cl,
+                                    mpi_sizes,
+                                    phr->md_size,
+                                    phr->error_message),
+                      phr->error_message,
+                      phr->error_message,
+                      free(mpi_sizes));
+    free(mpi_sizes);
+  }
 
-    class_finish_parallel();
+  /** - for each mode, now that all possible \f$ C_l\f$'s have been computed,
+      compute second derivative of the array in which they are stored,
+      in view of spline interpolation. */
 
-    /** - --> (d) now that for a given mode, all possible \f$ C_l\f$'s have been computed,
-        compute second derivative of the array in which they are stored,
-        in view of spline interpolation. */
+  for (index_md = 0; index_md < phr->md_size; index_md++) {
 
     class_call(array_spline_table_lines(phr->l,
                                         phr->l_size[index_md],
@@ -828,9 +870,16 @@ int harmonic_cls(
 }
 
 /**
- * This routine computes the \f$ C_l\f$'s for a given mode, pair of initial conditions
- * and multipole, but for all types (TT, TE...), by convolving the
- * transfer functions with the primordial spectra.
+ * This routine computes the \f$ C_l\f$'s for a given mode and
+ * multipole, but for all pairs of initial conditions and all types
+ * (TT, TE...), by convolving the transfer functions with the
+ * primordial spectra.
+ *
+ * For each wavenumber, the primordial spectra of all pairs and the
+ * transfer functions of all initial conditions are read once, and
+ * the integrands of all pairs are filled from them. Then each
+ * integrand is integrated over q. Pairs of uncorrelated initial
+ * conditions get zero.
  *
  * @param ppr           Input: pointer to precision structure
  * @param pba           Input: pointer to background structure
@@ -839,15 +888,12 @@ int harmonic_cls(
  * @param ppm           Input: pointer to primordial structure
  * @param phr           Input/Output: pointer to harmonic structure (result stored here)
  * @param index_md      Input: index of mode under consideration
- * @param index_ic1     Input: index of first initial condition in the correlator
- * @param index_ic2     Input: index of second initial condition in the correlator
  * @param index_l       Input: index of multipole under consideration
- * @param cl_integrand_num_columns Input: number of columns in cl_integrand
+ * @param cl_integrand_num_columns Input: number of columns in cl_integrand (1+2*ic_ic_size*ct_size)
  * @param cl_integrand  Input: an allocated workspace
  * @param cl_integrand_limber  Input: an allocated workspace for full Limber calculation
  * @param primordial_pk Input: table of primordial spectrum values
- * @param transfer_ic1  Input: table of transfer function values for first initial condition
- * @param transfer_ic2  Input: table of transfer function values for second initial condition
+ * @param transfer      Input: table of transfer function values, transfer[index_ic*tt_size+index_tt]
  * @return the error status
  */
 
@@ -859,15 +905,12 @@ int harmonic_compute_cl(
                         struct primordial * ppm,
                         struct harmonic * phr,
                         int index_md,
-                        int index_ic1,
-                        int index_ic2,
                         int index_l,
                         int cl_integrand_num_columns,
                         double * cl_integrand,
                         double * cl_integrand_limber,
                         double * primordial_pk,
-                        double * transfer_ic1,
-                        double * transfer_ic2
+                        double * transfer
                         ) {
 
   int index_q;
@@ -876,7 +919,12 @@ int harmonic_compute_cl(
   int index_d1,index_d2;
   double k;
   double clvalue;
-  int index_ic1_ic2;
+  int index_ic,index_ic1,index_ic2,index_ic1_ic2;
+  int column_ic1_ic2;
+  double * transfer_ic1;
+  double * transfer_ic2;
+  double * transfer_temp; /* transfer_temp[index_ic] */
+  double * transfer_nc=NULL; /* transfer_nc[index_ic*phr->d_size+index_d] */
   double transfer_ic1_temp=0.;
   double transfer_ic2_temp=0.;
   double * transfer_ic1_nc=NULL;
@@ -896,11 +944,13 @@ int harmonic_compute_cl(
 
   l = phr->l[index_l];
 
-  index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic2,phr->ic_size[index_md]);
+  class_alloc(transfer_temp,phr->ic_size[index_md]*sizeof(double),phr->error_message);
+  for (index_ic=0; index_ic<phr->ic_size[index_md]; index_ic++) {
+    transfer_temp[index_ic] = 0.;
+  }
 
   if (ppt->has_cl_number_count == _TRUE_ && _scalars_) {
-    class_alloc(transfer_ic1_nc,phr->d_size*sizeof(double),phr->error_message);
-    class_alloc(transfer_ic2_nc,phr->d_size*sizeof(double),phr->error_message);
+    class_alloc(transfer_nc,phr->ic_size[index_md]*phr->d_size*sizeof(double),phr->error_message);
   }
 
   /* Technical point: here, we will do a spline integral over the
@@ -934,96 +984,68 @@ int harmonic_compute_cl(
 
     /* above routine checks that k>0: no possible division by zero below */
 
-    for (index_tt=0; index_tt < ptr->tt_size[index_md]; index_tt++) {
+    /* gather transfer functions of each initial condition, and define their combinations */
 
-      transfer_ic1[index_tt] =
-        ptr->transfer[index_md]
-        [((index_ic1 * ptr->tt_size[index_md] + index_tt)
-          * ptr->l_size[index_md] + index_l)
-         * ptr->q_size + index_q];
+    for (index_ic=0; index_ic < phr->ic_size[index_md]; index_ic++) {
 
-      if (index_ic1 == index_ic2) {
-        transfer_ic2[index_tt] = transfer_ic1[index_tt];
-      }
-      else {
-        transfer_ic2[index_tt] = ptr->transfer[index_md]
-          [((index_ic2 * ptr->tt_size[index_md] + index_tt)
+      transfer_ic1 = transfer + index_ic*ptr->tt_size[index_md];
+
+      for (index_tt=0; index_tt < ptr->tt_size[index_md]; index_tt++) {
+        transfer_ic1[index_tt] =
+          ptr->transfer[index_md]
+          [((index_ic * ptr->tt_size[index_md] + index_tt)
             * ptr->l_size[index_md] + index_l)
            * ptr->q_size + index_q];
       }
-    }
-
-    /* define combinations of transfer functions */
-
-    if (ppt->has_cl_cmb_temperature == _TRUE_) {
 
-      if (_scalars_) {
+      if (ppt->has_cl_cmb_temperature == _TRUE_) {
 
-        transfer_ic1_temp = transfer_ic1[ptr->index_tt_t0] + transfer_ic1[ptr->index_tt_t1] + transfer_ic1[ptr->index_tt_t2];
-        transfer_ic2_temp = transfer_ic2[ptr->index_tt_t0] + transfer_ic2[ptr->index_tt_t1] + transfer_ic2[ptr->index_tt_t2];
-
-      }
-
-      if (_vectors_) {
+        if (_scalars_) {
+          transfer_temp[index_ic] = transfer_ic1[ptr->index_tt_t0] + transfer_ic1[ptr->index_tt_t1] + transfer_ic1[ptr->index_tt_t2];
+        }
 
-        transfer_ic1_temp = transfer_ic1[ptr->index_tt_t1] + transfer_ic1[ptr->index_tt_t2];
-        transfer_ic2_temp = transfer_ic2[ptr->index_tt_t1] + transfer_ic2[ptr->index_tt_t2];
+        if (_vectors_) {
+          transfer_temp[index_ic] = transfer_ic1[ptr->index_tt_t1] + transfer_ic1[ptr->index_tt_t2];
+        }
 
+        if (_tensors_) {
+          transfer_temp[index_ic] = transfer_ic1[ptr->index_tt_t2];
+        }
       }
 
-      if (_tensors_) {
-
-        transfer_ic1_temp = transfer_ic1[ptr->index_tt_t2];
-        transfer_ic2_temp = transfer_ic2[ptr->index_tt_t2];
-
-      }
-    }
+      if (ppt->has_cl_number_count == _TRUE_ && _scalars_) {
 
-    if (ppt->has_cl_number_count == _TRUE_ && _scalars_) {
+        transfer_ic1_nc = transfer_nc + index_ic*phr->d_size;
 
-      for (index_d1=0; index_d1<phr->d_size; index_d1++) {
+        for (index_d1=0; index_d1<phr->d_size; index_d1++) {
 
-        transfer_ic1_nc[index_d1] = 0.;
-        transfer_ic2_nc[index_d1] = 0.;
+          transfer_ic1_nc[index_d1] = 0.;
 
-        if (ppt->has_nc_density == _TRUE_) {
-          transfer_ic1_nc[index_d1] += transfer_ic1[ptr->index_tt_density+index_d1];
-          transfer_ic2_nc[index_d1] += transfer_ic2[ptr->index_tt_density+index_d1];
-        }
+          if (ppt->has_nc_density == _TRUE_) {
+            transfer_ic1_nc[index_d1] += transfer_ic1[ptr->index_tt_density+index_d1];
+          }
 
-        if (ppt->has_nc_rsd     == _TRUE_) {
-          transfer_ic1_nc[index_d1]
-            += transfer_ic1[ptr->index_tt_rsd+index_d1]
-            + transfer_ic1[ptr->index_tt_d0+index_d1]
-            + transfer_ic1[ptr->index_tt_d1+index_d1];
-          transfer_ic2_nc[index_d1]
-            += transfer_ic2[ptr->index_tt_rsd+index_d1]
-            + transfer_ic2[ptr->index_tt_d0+index_d1]
-            + transfer_ic2[ptr->index_tt_d1+index_d1];
-        }
+          if (ppt->has_nc_rsd     == _TRUE_) {
+            transfer_ic1_nc[index_d1]
+              += transfer_ic1[ptr->index_tt_rsd+index_d1]
+              + transfer_ic1[ptr->index_tt_d0+index_d1]
+              + transfer_ic1[ptr->index_tt_d1+index_d1];
+          }
 
-        if (ppt->has_nc_lens == _TRUE_) {
-          transfer_ic1_nc[index_d1] +=
-            l*(l+1.)*transfer_ic1[ptr->index_tt_nc_lens+index_d1];
-          transfer_ic2_nc[index_d1] +=
-            l*(l+1.)*transfer_ic2[ptr->index_tt_nc_lens+index_d1];
-        }
+          if (ppt->has_nc_lens == _TRUE_) {
+            transfer_ic1_nc[index_d1] +=
+              l*(l+1.)*transfer_ic1[ptr->index_tt_nc_lens+index_d1];
+          }
 
-        if (ppt->has_nc_gr == _TRUE_) {
-          transfer_ic1_nc[index_d1]
-            += transfer_ic1[ptr->index_tt_nc_g1+index_d1]
-            + transfer_ic1[ptr->index_tt_nc_g2+index_d1]
-            + transfer_ic1[ptr->index_tt_nc_g3+index_d1]
-            + transfer_ic1[ptr->index_tt_nc_g4+index_d1]
-            + transfer_ic1[ptr->index_tt_nc_g5+index_d1];
-          transfer_ic2_nc[index_d1]
-            += transfer_ic2[ptr->index_tt_nc_g1+index_d1]
-            + transfer_ic2[ptr->index_tt_nc_g2+index_d1]
-            + transfer_ic2[ptr->index_tt_nc_g3+index_d1]
-            + transfer_ic2[ptr->index_tt_nc_g4+index_d1]
-            + transfer_ic2[ptr->index_tt_nc_g5+index_d1];
+          if (ppt->has_nc_gr == _TRUE_) {
+            transfer_ic1_nc[index_d1]
+              += transfer_ic1[ptr->index_tt_nc_g1+index_d1]
+              + transfer_ic1[ptr->index_tt_nc_g2+index_d1]
+              + transfer_ic1[ptr->index_tt_nc_g3+index_d1]
+              + transfer_ic1[ptr->index_tt_nc_g4+index_d1]
+              + transfer_ic1[ptr->index_tt_nc_g5+index_d1];
+          }
         }
-
       }
     }
 
@@ -1072,122 +1094,144 @@ int harmonic_compute_cl(
 
     factor = 4. * _PI_ / k;
 
-    if (phr->has_tt == _TRUE_)
-      cl_integrand[index_q*cl_integrand_num_columns+1+phr->index_ct_tt]=
-        primordial_pk[index_ic1_ic2]
-        * transfer_ic1_temp
-        * transfer_ic2_temp
-        * factor;
-
-    if (phr->has_ee == _TRUE_)
-      cl_integrand[index_q*cl_integrand_num_columns+1+phr->index_ct_ee]=
-        primordial_pk[index_ic1_ic2]
-        * transfer_ic1[ptr->index_tt_e]
-        * transfer_ic2[ptr->index_tt_e]
-        * factor;
-
-    if (phr->has_te == _TRUE_)
-      cl_integrand[index_q*cl_integrand_num_columns+1+phr->index_ct_te]=
-        primordial_pk[index_ic1_ic2]
-        * 0.5*(transfer_ic1_temp * transfer_ic2[ptr->index_tt_e] +
-               transfer_ic1[ptr->index_tt_e] * transfer_ic2_temp)
-        * factor;
-
-    if (_tensors_ && (phr->has_bb == _TRUE_))
-      cl_integrand[index_q*cl_integrand_num_columns+1+phr->index_ct_bb]=
-        primordial_pk[index_ic1_ic2]
-        * transfer_ic1[ptr->index_tt_b]
-        * transfer_ic2[ptr->index_tt_b]
-        * factor;
-
-    if (_scalars_ && (phr->has_pp == _TRUE_))
-      cl_integrand[index_q*cl_integrand_num_columns+1+phr->index_ct_pp]=
-        primordial_pk[index_ic1_ic2]
-        * transfer_ic1[ptr->index_tt_lcmb]
-        * transfer_ic2[ptr->index_tt_lcmb]
-        * factor;
-
-    if (_scalars_ && (phr->has_tp == _TRUE_))
-      cl_integrand[index_q*cl_integrand_num_columns+1+phr->index_ct_tp]=
-        primordial_pk[index_ic1_ic2]
-        * 0.5*(transfer_ic1_temp * transfer_ic2[ptr->index_tt_lcmb] +
-               transfer_ic1[ptr->index_tt_lcmb] * transfer_ic2_temp)
-        * factor;
-
-    if (_scalars_ && (phr->has_ep == _TRUE_))
-      cl_integrand[index_q*cl_integrand_num_columns+1+phr->index_ct_ep]=
-        primordial_pk[index_ic1_ic2]
-        * 0.5*(transfer_ic1[ptr->index_tt_e] * transfer_ic2[ptr->index_tt_lcmb] +
-               transfer_ic1[ptr->index_tt_lcmb] * transfer_ic2[ptr->index_tt_e])
-        * factor;
-
-    if (_scalars_ && (phr->has_dd == _TRUE_)) {
-      index_ct=0;
-      for (index_d1=0; index_d1<phr->d_size; index_d1++) {
-        for (index_d2=index_d1; index_d2<=MIN(index_d1+phr->non_diag,phr->d_size-1); index_d2++) {
-          cl_integrand[index_q*cl_integrand_num_columns+1+phr->index_ct_dd+index_ct]=
+    /* fill the integrand of each pair of correlated initial conditions */
+
+    for (index_ic1 = 0; index_ic1 < phr->ic_size[index_md]; index_ic1++) {
+      for (index_ic2 = index_ic1; index_ic2 < phr->ic_size[index_md]; index_ic2++) {
+        index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic2,phr->ic_size[index_md]);
+
+        if (phr->is_non_zero[index_md][index_ic1_ic2] == _FALSE_)
+          continue;
+
+        column_ic1_ic2 = 1+index_ic1_ic2*phr->ct_size;
+
+        transfer_ic1 = transfer + index_ic1*ptr->tt_size[index_md];
+        transfer_ic2 = transfer + index_ic2*ptr->tt_size[index_md];
+        transfer_ic1_temp = transfer_temp[index_ic1];
+        transfer_ic2_temp = transfer_temp[index_ic2];
+        if (ppt->has_cl_number_count == _TRUE_ && _scalars_) {
+          transfer_ic1_nc = transfer_nc + index_ic1*phr->d_size;
+          transfer_ic2_nc = transfer_nc + index_ic2*phr->d_size;
+        }
+
+        if (phr->has_tt == _TRUE_)
+          cl_integrand[index_q*cl_integrand_num_columns+column_ic1_ic2+phr->index_ct_tt]=
             primordial_pk[index_ic1_ic2]
-            * transfer_ic1_nc[index_d1]
-            * transfer_ic2_nc[index_d2]
+            * transfer_ic1_temp
+            * transfer_ic2_temp
             * factor;
-          index_ct++;
-        }
-      }
-    }
 
-    if (_scalars_ && (phr->has_td == _TRUE_)) {
-      for (index_d1=0; index_d1<phr->d_size; index_d1++) {
-        cl_integrand[index_q*cl_integrand_num_columns+1+phr->index_ct_td+index_d1]=
-          primordial_pk[index_ic1_ic2]
-          * 0.5*(transfer_ic1_temp * transfer_ic2_nc[index_d1] +
-                 transfer_ic1_nc[index_d1] * transfer_ic2_temp)
-          * factor;
-      }
-    }
+        if (phr->has_ee == _TRUE_)
+          cl_integrand[index_q*cl_integrand_num_columns+column_ic1_ic2+phr->index_ct_ee]=
+            primordial_pk[index_ic1_ic2]
+            * transfer_ic1[ptr->index_tt_e]
+            * transfer_ic2[ptr->index_tt_e]
+            * factor;
 
-    if (_scalars_ && (phr->has_pd == _TRUE_)) {
-      for (index_d1=0; index_d1<phr->d_size; index_d1++) {
-        cl_integrand[index_q*cl_integrand_num_columns+1+phr->index_ct_pd+index_d1]=
-          primordial_pk[index_ic1_ic2]
-          * 0.5*(transfer_ic1[ptr->index_tt_lcmb] * transfer_ic2_nc[index_d1] +
-                 transfer_ic1_nc[index_d1] * transfer_ic2[ptr->index_tt_lcmb])
-          * factor;
-      }
-    }
+        if (phr->has_te == _TRUE_)
+          cl_integrand[index_q*cl_integrand_num_columns+column_ic1_ic2+phr->index_ct_te]=
+            primordial_pk[index_ic1_ic2]
+            * 0.5*(transfer_ic1_temp * transfer_ic2[ptr->index_tt_e] +
+                   transfer_ic1[ptr->index_tt_e] * transfer_ic2_temp)
+            * factor;
 
-    if (_scalars_ && (phr->has_ll == _TRUE_)) {
-      index_ct=0;
-      for (index_d1=0; index_d1<phr->d_size; index_d1++) {
-        for (index_d2=index_d1; index_d2<=MIN(index_d1+phr->non_diag,phr->d_size-1); index_d2++) {
-          cl_integrand[index_q*cl_integrand_num_columns+1+phr->index_ct_ll+index_ct]=
+        if (_tensors_ && (phr->has_bb == _TRUE_))
+          cl_integrand[index_q*cl_integrand_num_columns+column_ic1_ic2+phr->index_ct_bb]=
             primordial_pk[index_ic1_ic2]
-            * transfer_ic1[ptr->index_tt_lensing+index_d1]
-            * transfer_ic2[ptr->index_tt_lensing+index_d2]
+            * transfer_ic1[ptr->index_tt_b]
+            * transfer_ic2[ptr->index_tt_b]
             * factor;
-          index_ct++;
-        }
-      }
-    }
 
-    if (_scalars_ && (phr->has_tl == _TRUE_)) {
-      for (index_d1=0; index_d1<phr->d_size; index_d1++) {
-        cl_integrand[index_q*cl_integrand_num_columns+1+phr->index_ct_tl+index_d1]=
-          primordial_pk[index_ic1_ic2]
-          * 0.5*(transfer_ic1_temp * transfer_ic2[ptr->index_tt_lensing+index_d1] +
-                 transfer_ic1[ptr->index_tt_lensing+index_d1] * transfer_ic2_temp)
-          * factor;
-      }
-    }
+        if (_scalars_ && (phr->has_pp == _TRUE_))
+          cl_integrand[index_q*cl_integrand_num_columns+column_ic1_ic2+phr->index_ct_pp]=
+            primordial_pk[index_ic1_ic2]
+            * transfer_ic1[ptr->index_tt_lcmb]
+            * transfer_ic2[ptr->index_tt_lcmb]
+            * factor;
+
+        if (_scalars_ && (phr->has_tp == _TRUE_))
+          cl_integrand[index_q*cl_integrand_num_columns+column_ic1_ic2+phr->index_ct_tp]=
+            primordial_pk[index_ic1_ic2]
+            * 0.5*(transfer_ic1_temp * transfer_ic2[ptr->index_tt_lcmb] +
+                   transfer_ic1[ptr->index_tt_lcmb] * transfer_ic2_temp)
+            * factor;
 
-    if (_scalars_ && (phr->has_dl == _TRUE_)) {
-      index_ct=0;
-      for (index_d1=0; index_d1<phr->d_size; index_d1++) {
-        for (index_d2=MAX(index_d1-phr->non_diag,0); index_d2<=MIN(index_d1+phr->non_diag,phr->d_size-1); index_d2++) {
-          cl_integrand[index_q*cl_integrand_num_columns+1+phr->index_ct_dl+index_ct]=
+        if (_scalars_ && (phr->has_ep == _TRUE_))
+          cl_integrand[index_q*cl_integrand_num_columns+column_ic1_ic2+phr->index_ct_ep]=
             primordial_pk[index_ic1_ic2]
-            * transfer_ic1_nc[index_d1] * transfer_ic2[ptr->index_tt_lensing+index_d2]
+            * 0.5*(transfer_ic1[ptr->index_tt_e] * transfer_ic2[ptr->index_tt_lcmb] +
+                   transfer_ic1[ptr->index_tt_lcmb] * transfer_ic2[ptr->index_tt_e])
             * factor;
-          index_ct++;
+
+        if (_scalars_ && (phr->has_dd == _TRUE_)) {
+          index_ct=0;
+          for (index_d1=0; index_d1<phr->d_size; index_d1++) {
+            for (index_d2=index_d1; index_d2<=MIN(index_d1+phr->non_diag,phr->d_size-1); index_d2++) {
+              cl_integrand[index_q*cl_integrand_num_columns+column_ic1_ic2+phr->index_ct_dd+index_ct]=
+                primordial_pk[index_ic1_ic2]
+                * transfer_ic1_nc[index_d1]
+                * transfer_ic2_nc[index_d2]
+                * factor;
+              index_ct++;
+            }
+          }
+        }
+
+        if (_scalars_ && (phr->has_td == _TRUE_)) {
+          for (index_d1=0; index_d1<phr->d_size; index_d1++) {
+            cl_integrand[index_q*cl_integrand_num_columns+column_ic1_ic2+phr->index_ct_td+index_d1]=
+              primordial_pk[index_ic1_ic2]
+              * 0.5*(transfer_ic1_temp * transfer_ic2_nc[index_d1] +
+                     transfer_ic1_nc[index_d1] * transfer_ic2_temp)
+              * factor;
+          }
+        }
+
+        if (_scalars_ && (phr->has_pd == _TRUE_)) {
+          for (index_d1=0; index_d1<phr->d_size; index_d1++) {
+            cl_integrand[index_q*cl_integrand_num_columns+column_ic1_ic2+phr->index_ct_pd+index_d1]=
+              primordial_pk[index_ic1_ic2]
+              * 0.5*(transfer_ic1[ptr->index_tt_lcmb] * transfer_ic2_nc[index_d1] +
+                     transfer_ic1_nc[index_d1] * transfer_ic2[ptr->index_tt_lcmb])
+              * factor;
+          }
+        }
+
+        if (_scalars_ && (phr->has_ll == _TRUE_)) {
+          index_ct=0;
+          for (index_d1=0; index_d1<phr->d_size; index_d1++) {
+            for (index_d2=index_d1; index_d2<=MIN(index_d1+phr->non_diag,phr->d_size-1); index_d2++) {
+              cl_integrand[index_q*cl_integrand_num_columns+column_ic1_ic2+phr->index_ct_ll+index_ct]=
+                primordial_pk[index_ic1_ic2]
+                * transfer_ic1[ptr->index_tt_lensing+index_d1]
+                * transfer_ic2[ptr->index_tt_lensing+index_d2]
+                * factor;
+              index_ct++;
+            }
+          }
+        }
+
+        if (_scalars_ && (phr->has_tl == _TRUE_)) {
+          for (index_d1=0; index_d1<phr->d_size; index_d1++) {
+            cl_integrand[index_q*cl_integrand_num_columns+column_ic1_ic2+phr->index_ct_tl+index_d1]=
+              primordial_pk[index_ic1_ic2]
+              * 0.5*(transfer_ic1_temp * transfer_ic2[ptr->index_tt_lensing+index_d1] +
+                     transfer_ic1[ptr->index_tt_lensing+index_d1] * transfer_ic2_temp)
+              * factor;
+          }
+        }
+
+        if (_scalars_ && (phr->has_dl == _TRUE_)) {
+          index_ct=0;
+          for (index_d1=0; index_d1<phr->d_size; index_d1++) {
+            for (index_d2=MAX(index_d1-phr->non_diag,0); index_d2<=MIN(index_d1+phr->non_diag,phr->d_size-1); index_d2++) {
+              cl_integrand[index_q*cl_integrand_num_columns+column_ic1_ic2+phr->index_ct_dl+index_ct]=
+                primordial_pk[index_ic1_ic2]
+                * transfer_ic1_nc[index_d1] * transfer_ic2[ptr->index_tt_lensing+index_d2]
+                * factor;
+              index_ct++;
+            }
+          }
         }
       }
     }
@@ -1217,134 +1261,446 @@ int harmonic_compute_cl(
         index_tt = ptr->index_tt_lcmb;
         index_ct = phr->index_ct_pp;
 
-        transfer_ic1[index_tt] =
-          ptr->transfer_limber[index_md]
-          [((index_ic1 * ptr->tt_size[index_md] + ptr->index_tt_lcmb)
-            * ptr->l_size[index_md] + index_l)
-           * ptr->q_size_limber + index_q];
-
-        if (index_ic1 == index_ic2) {
-          transfer_ic2[index_tt] = transfer_ic1[ptr->index_tt_lcmb];
-        }
-        else {
-          transfer_ic2[index_tt] = ptr->transfer_limber[index_md]
-            [((index_ic2 * ptr->tt_size[index_md] + ptr->index_tt_lcmb)
+        for (index_ic=0; index_ic < phr->ic_size[index_md]; index_ic++) {
+          transfer[index_ic*ptr->tt_size[index_md]+index_tt] =
+            ptr->transfer_limber[index_md]
+            [((index_ic * ptr->tt_size[index_md] + index_tt)
               * ptr->l_size[index_md] + index_l)
              * ptr->q_size_limber + index_q];
         }
 
         factor = 4. * _PI_ / k;
 
-        cl_integrand_limber[index_q*cl_integrand_num_columns+1+phr->index_ct_pp]=
-          primordial_pk[index_ic1_ic2]
-          * transfer_ic1[index_tt]
-          * transfer_ic2[index_tt]
-          * factor;
+        for (index_ic1 = 0; index_ic1 < phr->ic_size[index_md]; index_ic1++) {
+          for (index_ic2 = index_ic1; index_ic2 < phr->ic_size[index_md]; index_ic2++) {
+            index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic2,phr->ic_size[index_md]);
+
+            if (phr->is_non_zero[index_md][index_ic1_ic2] == _FALSE_)
+              continue;
+
+            cl_integrand_limber[index_q*cl_integrand_num_columns+1+index_ic1_ic2*phr->ct_size+index_ct]=
+              primordial_pk[index_ic1_ic2]
+              * transfer[index_ic1*ptr->tt_size[index_md]+index_tt]
+              * transfer[index_ic2*ptr->tt_size[index_md]+index_tt]
+              * factor;
+          }
+        }
       }
     }
   }
 
-  for (index_ct=0; index_ct<phr->ct_size; index_ct++) {
+  for (index_ic1 = 0; index_ic1 < phr->ic_size[index_md]; index_ic1++) {
+    for (index_ic2 = index_ic1; index_ic2 < phr->ic_size[index_md]; index_ic2++) {
+      index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic2,phr->ic_size[index_md]);
+      column_ic1_ic2 = 1+index_ic1_ic2*phr->ct_size;
+
+      for (index_ct=0; index_ct<phr->ct_size; index_ct++) {
+
+        /* treat null spectra (uncorrelated initial conditions, C_l^BB of scalars, C_l^pp of tensors, etc.) */
+
+        if ((phr->is_non_zero[index_md][index_ic1_ic2] == _FALSE_) ||
+            (_scalars_ && (phr->has_bb == _TRUE_) && (index_ct == phr->index_ct_bb)) ||
+            (_tensors_ && (phr->has_pp == _TRUE_) && (index_ct == phr->index_ct_pp)) ||
+            (_tensors_ && (phr->has_tp == _TRUE_) && (index_ct == phr->index_ct_tp)) ||
+            (_tensors_ && (phr->has_ep == _TRUE_) && (index_ct == phr->index_ct_ep)) ||
+            (_tensors_ && (phr->has_dd == _TRUE_) && (index_ct == phr->index_ct_dd)) ||
+            (_tensors_ && (phr->has_td == _TRUE_) && (index_ct == phr->index_ct_td)) ||
+            (_tensors_ && (phr->has_pd == _TRUE_) && (index_ct == phr->index_ct_pd)) ||
+            (_tensors_ && (phr->has_ll == _TRUE_) && (index_ct == phr->index_ct_ll)) ||
+            (_tensors_ && (phr->has_tl == _TRUE_) && (index_ct == phr->index_ct_tl)) ||
+            (_tensors_ && (phr->has_dl == _TRUE_) && (index_ct == phr->index_ct_dl))
+            ) {
+
+          phr->cl[index_md]
+            [(index_l * phr->ic_ic_size[index_md] + index_ic1_ic2) * phr->ct_size + index_ct] = 0.;
+
+        }
+        /* for non-zero spectra, integrate over q */
+        else {
+
+          /* spline the integrand over the whole range of k's. This is
+             where we decide which of the normal or full Limber scheme
+             will be used at the end. */
+
+          if (_scalars_ && (ptr->do_lcmb_full_limber == _TRUE_) && (phr->has_pp == _TRUE_) && (index_ct == phr->index_ct_pp) && (l>ppr->l_switch_limber)) {
+            integrand = cl_integrand_limber;
+            num_columns = cl_integrand_num_columns;
+            num_k = ptr->q_size_limber;
+            index_spline = 0;
+            q_min = ptr->q_limber[0];
+            k_min = ptr->k_limber[0][0];
+          }
+          else{
+            integrand = cl_integrand;
+            num_columns = cl_integrand_num_columns;
+            num_k = ptr->q_size;
+            index_spline = index_q_spline;
+            q_min = ptr->q[0];
+            k_min = ptr->k[0][0];
+          }
+
+          column_k = 0;
+          column_integrand = column_ic1_ic2+index_ct;
+          column_derivative = column_ic1_ic2+phr->ic_ic_size[index_md]*phr->ct_size+index_ct;
+
+          class_call(array_spline(integrand,
+                                  num_columns,
+                                  num_k,
+                                  column_k,
+                                  column_integrand,
+                                  column_derivative,
+                                  _SPLINE_EST_DERIV_,
+                                  phr->error_message),
+                     phr->error_message,
+                     phr->error_message);
+
+          class_call(array_integrate_all_trapzd_or_spline(integrand,
+                                                          num_columns,
+                                                          num_k,
+                                                          index_spline,
+                                                          column_k,
+                                                          column_integrand,
+                                                          column_derivative,
+                                                          &clvalue,
+                                                          phr->error_message),
+                     phr->error_message,
+                     phr->error_message);
 
-    /* treat null spectra (C_l^BB of scalars, C_l^pp of tensors, etc. */
+          /* in the closed case, instead of an integral, we have a
+             discrete sum. In practice, this does not matter: the previous
+             routine does give a correct approximation of the discrete
+             sum, both in the trapezoidal and spline regions. The only
+             error comes from the first point: the previous routine
+             assumes a weight for the first point which is too small
+             compared to what it would be in the an actual discrete
+             sum. The line below correct this problem in an exact way.
+          */
+
+          if (pba->sgnK == 1) {
+            clvalue += integrand[column_integrand] * q_min/k_min*sqrt(pba->K)/2.;
+          }
 
-    if ((_scalars_ && (phr->has_bb == _TRUE_) && (index_ct == phr->index_ct_bb)) ||
-        (_tensors_ && (phr->has_pp == _TRUE_) && (index_ct == phr->index_ct_pp)) ||
-        (_tensors_ && (phr->has_tp == _TRUE_) && (index_ct == phr->index_ct_tp)) ||
-        (_tensors_ && (phr->has_ep == _TRUE_) && (index_ct == phr->index_ct_ep)) ||
-        (_tensors_ && (phr->has_dd == _TRUE_) && (index_ct == phr->index_ct_dd)) ||
-        (_tensors_ && (phr->has_td == _TRUE_) && (index_ct == phr->index_ct_td)) ||
-        (_tensors_ && (phr->has_pd == _TRUE_) && (index_ct == phr->index_ct_pd)) ||
-        (_tensors_ && (phr->has_ll == _TRUE_) && (index_ct == phr->index_ct_ll)) ||
-        (_tensors_ && (phr->has_tl == _TRUE_) && (index_ct == phr->index_ct_tl)) ||
-        (_tensors_ && (phr->has_dl == _TRUE_) && (index_ct == phr->index_ct_dl))
-        ) {
+          /* we have the correct C_l now. We can store it in the transfer structure. */
 
-      phr->cl[index_md]
-        [(index_l * phr->ic_ic_size[index_md] + index_ic1_ic2) * phr->ct_size + index_ct] = 0.;
+          phr->cl[index_md]
+            [(index_l * phr->ic_ic_size[index_md] + index_ic1_ic2) * phr->ct_size + index_ct]
+            = clvalue;
 
+        }
+      }
     }
-    /* for non-zero spectra, integrate over q */
-    else {
+  }
+
+  free(transfer_temp);
+  if (ppt->has_cl_number_count == _TRUE_ && _scalars_) {
+    free(transfer_nc);
+  }
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Store or apply a multi-fidelity correction of the \f$ C_l\f$'s.
+ *
+ * The correction file contains the spectra of a fiducial model
+ * computed twice, with reference precision and with fast precision.
+ * In 'reference' or 'fast' mode, the unlensed \f$ C_l\f$'s of the
+ * current run (for each integer l, mode and pair of initial
+ * conditions) are stored in the corresponding slot of the file. In
+ * 'apply' mode, each \f$ C_l\f$ of the current (fast) run is
+ * multiplied by the ratio reference/fast of the same mode, pair of
+ * initial conditions and type in the fiducial model, or, for spectra
+ * which are not positive definite (e.g. TE), shifted by the
+ * difference reference-fast. The correction is applied to the
+ * unlensed \f$ C_l\f$'s, so that lensed spectra computed afterwards
+ * are corrected as well. The matter power spectra are corrected by
+ * fourier_init().
+ *
+ * In 'apply' mode, the run stops with an error if the file does not
+ * contain both fiducial spectra, or if the input parameters differ
+ * from those of the fiducial fast run by more than
+ * correction_max_drift (the input module refreshes the file before,
+ * if it can).
+ *
+ * @param phr Input/Output: pointer to harmonic structure (corrected in 'apply' mode)
+ * @return the error status
+ */
+
+int harmonic_correction(
+                        struct harmonic * phr
+                        ) {
+
+  char * slot[2] = {NULL,NULL};
+  size_t slot_size[2] = {0,0};
+  short is_usable;
+
+  if ((phr->correction_mode == correction_reference) || (phr->correction_mode == correction_fast)) {
+
+    /** - store the spectra of this run in the relevant slot */
+    class_call(harmonic_correction_pack(phr,&(slot[0]),&(slot_size[0])),
+               phr->error_message,
+               phr->error_message);
+
+    class_call_except(correction_store(phr->correction_file,
+                                       correction_harmonic,
+                                       phr->correction_mode,
+                                       slot[0],
+                                       slot_size[0],
+                                       phr->error_message),
+                      phr->error_message,
+                      phr->error_message,
+                      free(slot[0]));
 
-      /* spline the integrand over the whole range of k's. This is
-         where we decide which of the normal or full Limber scheme
-         will be used at the end. */
-
-      if (_scalars_ && (ptr->do_lcmb_full_limber == _TRUE_) && (phr->has_pp == _TRUE_) && (index_ct == phr->index_ct_pp) && (l>ppr->l_switch_limber)) {
-        integrand = cl_integrand_limber;
-        num_columns = cl_integrand_num_columns;
-        num_k = ptr->q_size_limber;
-        index_spline = 0;
-        q_min = ptr->q_limber[0];
-        k_min = ptr->k_limber[0][0];
+    free(slot[0]);
+
+    if (phr->harmonic_verbose > 0)
+      printf(" -> stored %s C_l's in correction file %s\n",
+             (phr->correction_mode == correction_reference) ? "reference" : "fast",
+             phr->correction_file);
+  }
+  else if (phr->correction_mode == correction_apply) {
+
+    /** - apply the correction if the fiducial pair is complete and close enough */
+    class_call(correction_fetch(phr->correction_file,correction_harmonic,slot,slot_size,phr->error_message),
+               phr->error_message,
+               phr->error_message);
+
+    class_call_except(correction_check(slot,
+                                       slot_size,
+                                       phr->correction_parameters,
+                                       phr->correction_max_drift,
+                                       phr->correction_file,
+                                       &(phr->correction_drift),
+                                       &is_usable,
+                                       phr->error_message),
+                      phr->error_message,
+                      phr->error_message,
+                      free(slot[0]);free(slot[1]));
+
+    class_test_except((slot[0] == NULL) || (slot[1] == NULL),
+                      phr->error_message,
+                      free(slot[0]);free(slot[1]),
+                      "correction file %s does not contain both reference and fast C_l's: compute them with correction_mode = reference and fast, or give correction_reference_precision",
+                      phr->correction_file);
+
+    class_test_except(is_usable == _FALSE_,
+                      phr->error_message,
+                      free(slot[0]);free(slot[1]),
+                      "parameter drift %e from the fiducial model of %s exceeds correction_max_drift = %e: compute the fiducial pair again, or give correction_reference_precision",
+                      phr->correction_drift,phr->correction_file,phr->correction_max_drift);
+
+    class_call_except(harmonic_correction_apply(phr,slot,slot_size),
+                      phr->error_message,
+                      phr->error_message,
+                      free(slot[0]);free(slot[1]));
+
+    free(slot[0]);
+    free(slot[1]);
+
+    if (phr->harmonic_verbose > 0)
+      printf(" -> corrected C_l's with file %s (parameter drift %e)\n",
+             phr->correction_file,phr->correction_drift);
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Pack the input parameters and the unlensed \f$ C_l\f$'s of the
+ * current run into a slot of the correction file. The slot contains,
+ * after the parameters: md_size, ct_size, l_max, ic_ic_size for each
+ * mode, and for each l=2..l_max and each mode the \f$ C_l\f$'s
+ * phr->cl[index_md] interpolated at l (zero beyond the l_max of the
+ * mode and type).
+ *
+ * @param phr       Input: pointer to harmonic structure
+ * @param slot      Output: allocated slot
+ * @param slot_size Output: size in bytes of the slot
+ * @return the error status
+ */
+
+int harmonic_correction_pack(
+                             struct harmonic * phr,
+                             char ** slot,
+                             size_t * slot_size
+                             ) {
+
+  int index_md,index_ic_ic,index_ct,l,last_index;
+  int cl_size=0,cl_size_max=0;
+  double * cl;
+  char * position;
+
+  for (index_md = 0; index_md < phr->md_size; index_md++) {
+    cl_size += phr->ic_ic_size[index_md]*phr->ct_size;
+    cl_size_max = MAX(cl_size_max,phr->ic_ic_size[index_md]*phr->ct_size);
+  }
+
+  *slot_size = sizeof(int) + strlen(phr->correction_parameters)
+    + (3+phr->md_size)*sizeof(int) + (phr->l_max_tot-1)*cl_size*sizeof(double);
+
+  class_alloc(*slot,*slot_size,phr->error_message);
+  class_alloc(cl,MAX(cl_size_max,1)*sizeof(double),phr->error_message);
+  position = *slot;
+
+  correction_pack_parameters(phr->correction_parameters,&position);
+
+  class_correction_pack(position,&(phr->md_size),sizeof(int));
+  class_correction_pack(position,&(phr->ct_size),sizeof(int));
+  class_correction_pack(position,&(phr->l_max_tot),sizeof(int));
+  class_correction_pack(position,phr->ic_ic_size,phr->md_size*sizeof(int));
+
+  for (l = 2; l <= phr->l_max_tot; l++) {
+    for (index_md = 0; index_md < phr->md_size; index_md++) {
+
+      if (l <= phr->l[phr->l_size[index_md]-1]) {
+        class_call_except(array_interpolate_spline(phr->l,
+                                                   phr->l_size[index_md],
+                                                   phr->cl[index_md],
+                                                   phr->ddcl[index_md],
+                                                   phr->ic_ic_size[index_md]*phr->ct_size,
+                                                   (double)l,
+                                                   &last_index,
+                                                   cl,
+                                                   phr->ic_ic_size[index_md]*phr->ct_size,
+                                                   phr->error_message),
+                          phr->error_message,
+                          phr->error_message,
+                          free(cl);free(*slot));
       }
-      else{
-        integrand = cl_integrand;
-        num_columns = cl_integrand_num_columns;
-        num_k = ptr->q_size;
-        index_spline = index_q_spline;
-        q_min = ptr->q[0];
-        k_min = ptr->k[0][0];
+
+      for (index_ic_ic = 0; index_ic_ic < phr->ic_ic_size[index_md]; index_ic_ic++) {
+        for (index_ct = 0; index_ct < phr->ct_size; index_ct++) {
+          if ((l > phr->l[phr->l_size[index_md]-1]) || (l > phr->l_max_ct[index_md][index_ct]))
+            cl[index_ic_ic*phr->ct_size+index_ct] = 0.;
+        }
       }
 
-      column_k = 0;
-      column_integrand = 1+index_ct;
-      column_derivative = 1+phr->ct_size+index_ct;
-
-      class_call(array_spline(integrand,
-                              num_columns,
-                              num_k,
-                              column_k,
-                              column_integrand,
-                              column_derivative,
-                              _SPLINE_EST_DERIV_,
-                              phr->error_message),
-                 phr->error_message,
-                 phr->error_message);
+      class_correction_pack(position,cl,phr->ic_ic_size[index_md]*phr->ct_size*sizeof(double));
+    }
+  }
 
-      class_call(array_integrate_all_trapzd_or_spline(integrand,
-                                                      num_columns,
-                                                      num_k,
-                                                      index_spline,
-                                                      column_k,
-                                                      column_integrand,
-                                                      column_derivative,
-                                                      &clvalue,
-                                                      phr->error_message),
-                 phr->error_message,
-                 phr->error_message);
+  free(cl);
 
-      /* in the closed case, instead of an integral, we have a
-         discrete sum. In practice, this does not matter: the previous
-         routine does give a correct approximation of the discrete
-         sum, both in the trapezoidal and spline regions. The only
-         error comes from the first point: the previous routine
-         assumes a weight for the first point which is too small
-         compared to what it would be in the an actual discrete
-         sum. The line below correct this problem in an exact way.
-      */
-
-      if (pba->sgnK == 1) {
-        clvalue += integrand[1+index_ct] * q_min/k_min*sqrt(pba->K)/2.;
-      }
+  return _SUCCESS_;
+}
 
-      /* we have the correct C_l now. We can store it in the transfer structure. */
+/**
+ * Correct the \f$ C_l\f$'s of each mode, pair of initial conditions
+ * and type by the reference and fast \f$ C_l\f$'s of the fiducial
+ * model: by their ratio if the fast one is positive for all l, and by
+ * their difference otherwise.
+ *
+ * @param phr       Input/Output: pointer to harmonic structure
+ * @param slot      Input: content of each slot (reference, fast)
+ * @param slot_size Input: size in bytes of each slot
+ * @return the error status
+ */
 
-      phr->cl[index_md]
-        [(index_l * phr->ic_ic_size[index_md] + index_ic1_ic2) * phr->ct_size + index_ct]
-        = clvalue;
+int harmonic_correction_apply(
+                              struct harmonic * phr,
+                              char ** slot,
+                              size_t * slot_size
+                              ) {
 
+  /* fields of each slot, in the order of harmonic_correction_pack() */
+  int md_size[2],ct_size[2],l_max[2],cl_size[2];
+  int * ic_ic_size[2];
+  double * cl[2];
+  char * parameters;
+  int parameters_size;
+  int * pint;
+  char * position;
+  char * end;
+
+  int index_slot,index_md,index_ic_ic,index_ct,index_l,index_cl,offset_md;
+  int l,l_max_common,l_max_md_ct;
+  short is_positive;
+  double cl_ref,cl_fast;
+
+  /** - unpack both slots */
+  for (index_slot=0; index_slot<2; index_slot++) {
+    position = slot[index_slot];
+    end = slot[index_slot]+slot_size[index_slot];
+    class_call(correction_unpack_parameters(&position,end,&parameters,&parameters_size,phr->correction_file,phr->error_message),
+               phr->error_message,
+               phr->error_message);
+    class_correction_unpack(position,end,pint,int,1,phr->correction_file,phr->error_message);
+    md_size[index_slot] = *pint;
+    class_correction_unpack(position,end,pint,int,1,phr->correction_file,phr->error_message);
+    ct_size[index_slot] = *pint;
+    class_correction_unpack(position,end,pint,int,1,phr->correction_file,phr->error_message);
+    l_max[index_slot] = *pint;
+    class_correction_unpack(position,end,ic_ic_size[index_slot],int,md_size[index_slot],phr->correction_file,phr->error_message);
+    cl_size[index_slot] = 0;
+    for (index_md = 0; index_md < md_size[index_slot]; index_md++)
+      cl_size[index_slot] += ic_ic_size[index_slot][index_md]*ct_size[index_slot];
+    class_correction_unpack(position,end,cl[index_slot],double,(l_max[index_slot]-1)*cl_size[index_slot],phr->correction_file,phr->error_message);
+  }
+
+  /** - check that the fiducial runs have the same modes, pairs of initial conditions and types */
+  for (index_slot=0; index_slot<2; index_slot++) {
+    class_test((md_size[index_slot] != phr->md_size) || (ct_size[index_slot] != phr->ct_size),
+               phr->error_message,
+               "correction file %s was computed with other spectra (%d modes and %d types instead of %d and %d)",
+               phr->correction_file,md_size[index_slot],ct_size[index_slot],phr->md_size,phr->ct_size);
+    for (index_md = 0; index_md < phr->md_size; index_md++) {
+      class_test(ic_ic_size[index_slot][index_md] != phr->ic_ic_size[index_md],
+                 phr->error_message,
+                 "correction file %s was computed with other initial conditions (%d pairs instead of %d for mode %d)",
+                 phr->correction_file,ic_ic_size[index_slot][index_md],phr->ic_ic_size[index_md],index_md);
     }
   }
 
-  if (ppt->has_cl_number_count == _TRUE_ && _scalars_) {
-    free(transfer_ic1_nc);
-    free(transfer_ic2_nc);
+  l_max_common = MIN(l_max[0],l_max[1]);
+
+  /** - correct each mode, pair of initial conditions and type */
+  offset_md = 0;
+
+  for (index_md = 0; index_md < phr->md_size; index_md++) {
+    for (index_ic_ic = 0; index_ic_ic < phr->ic_ic_size[index_md]; index_ic_ic++) {
+      for (index_ct = 0; index_ct < phr->ct_size; index_ct++) {
+
+        index_cl = offset_md + index_ic_ic*phr->ct_size + index_ct;
+        l_max_md_ct = MIN(l_max_common,phr->l_max_ct[index_md][index_ct]);
+
+        /* ratio if the fast spectrum is positive, difference otherwise */
+        is_positive = _TRUE_;
+        for (l = 2; l <= l_max_md_ct; l++) {
+          if (cl[1][(l-2)*cl_size[1]+index_cl] <= 0.)
+            is_positive = _FALSE_;
+        }
+
+        for (index_l = 0; index_l < phr->l_size[index_md]; index_l++) {
+          l = (int)phr->l[index_l];
+          if ((l < 2) || (l > l_max_md_ct))
+            continue;
+          cl_ref = cl[0][(l-2)*cl_size[0]+index_cl];
+          cl_fast = cl[1][(l-2)*cl_size[1]+index_cl];
+          if (is_positive == _TRUE_)
+            phr->cl[index_md][(index_l*phr->ic_ic_size[index_md]+index_ic_ic)*phr->ct_size+index_ct] *= cl_ref/cl_fast;
+          else
+            phr->cl[index_md][(index_l*phr->ic_ic_size[index_md]+index_ic_ic)*phr->ct_size+index_ct] += cl_ref-cl_fast;
+        }
+      }
+    }
+
+    class_call(array_spline_table_lines(phr->l,
+                                        phr->l_size[index_md],
+                                        phr->cl[index_md],
+                                        phr->ic_ic_size[index_md]*phr->ct_size,
+                                        phr->ddcl[index_md],
+                                        _SPLINE_EST_DERIV_,
+                                        phr->error_message),
+               phr->error_message,
+               phr->error_message);
+
+    offset_md += phr->ic_ic_size[index_md]*phr->ct_size;
   }
 
-  return _SUCCESS_;
+  phr->correction_is_applied = _TRUE_;
 
+  return _SUCCESS_;
 }
 
 /* deprecated functions (since v2.8) */
@@ -399,21 +399,38 @@ int input_read_from_file(struct file_content * pfc,
   /** - Define local variables */
   int input_verbose = 0;
   int has_shooting;
+  int shooting_failed;
+  int input_size;
+  double max_run_time = 0.;
 
   /** Set default values
       Before getting into the assignment of parameters and the shooting, we want
       to already fix our precision parameters. No precision parameter should
-      depend on any input parameter  */
+      depend on any input parameter (except in input_auto_precision(), called
+      once all input parameters are known) */
   class_call(input_read_precisions(pfc,ppr,pba,pth,ppt,ptr,ppm,phr,pfo,ple,psd,pop,
                                    errmsg),
              errmsg,
              errmsg);
 
+  /** Start the clock if the run has a maximum duration, such that the
+      deadline also applies to the shooting */
+  class_read_double("max_run_time",max_run_time);
+  class_test(max_run_time < 0.,
+             errmsg,
+             "max_run_time = %e < 0",
+             max_run_time);
+  if (max_run_time > 0.)
+    ppr->deadline = class_wall_time() + max_run_time;
+
   class_read_int("input_verbose",input_verbose);
   if (input_verbose >0) printf("Reading input parameters\n");
 
   /** Find out if shooting necessary and, eventually, shoot and initialize
-      read parameters */
+      read parameters (the shooting appends the unknown parameters it
+      finds after the input_size parameters of the input) */
+  input_size = pfc->size;
+
   class_call(input_shooting(pfc,ppr,pba,pth,ppt,ptr,ppm,phr,pfo,ple,psd,pop,
                             input_verbose,
                             &has_shooting,
@@ -421,18 +438,43 @@ int input_read_from_file(struct file_content * pfc,
              errmsg,
              errmsg);
 
-  /** Update structs with input that is potentially updated after shooting */
+  /** Update structs with input that is potentially updated after shooting
+      (input_read_parameters() resets all input parameters to their default
+      values, so remember whether the shooting failed) */
+  shooting_failed = pba->shooting_failed;
+
   class_call(input_read_parameters(pfc,ppr,pba,pth,ppt,ptr,ppm,phr,pfo,ple,psd,pop,
                                     errmsg),
               errmsg,
               errmsg);
 
+  pba->shooting_failed = shooting_failed;
+
+  /** Lower the precision parameters which do not matter for the requested
+      outputs, if asked to (this is the only place where precision
+      parameters depend on input parameters) */
+  class_call(input_auto_precision(pfc,ppr,ppt,
+                                  input_verbose,
+                                  errmsg),
+             errmsg,
+             errmsg);
+
   if (has_shooting == _TRUE_ && pba->shooting_failed == _TRUE_) {
     // Shooting failed, but error must be thrown in background in order to trigger a
     // runtime error, so here we skip the rest and go straight to background
     return _SUCCESS_;
   }
 
+  /** Check that a multi-fidelity correction can be applied, and
+      compute its fiducial model again if needed and possible (before
+      writing the info on the parameters, which the fiducial runs would
+      otherwise overwrite) */
+  class_call(input_correction(pfc,input_size,ppr,ppt,pfo,phr,
+                              input_verbose,
+                              errmsg),
+             errmsg,
+             errmsg);
+
   /** Write info on the read/unread parameters. This is the correct place to do it,
       since we want it to happen after all the shooting business,
       and after the final reading of all parameters */
@@ -458,6 +500,288 @@ int input_read_from_file(struct file_content * pfc,
 }
 
 
+/**
+ * In 'apply' mode of the multi-fidelity correction, check that the
+ * correction file can correct the spectra of this run: it must
+ * contain the reference and fast spectra of each module needed by the
+ * requested output, and the input parameters must not differ from
+ * those of its fiducial model by more than correction_max_drift.
+ *
+ * If it cannot, and the input parameters give a file of reference
+ * precision parameters 'correction_reference_precision', the current
+ * parameters become the new fiducial model: they are computed once
+ * with these reference precision parameters and once with the current
+ * ones, and their spectra replace those of the file. Otherwise, the
+ * run stops with an error.
+ *
+ * @param pfc           Input: pointer to file content, with the input parameters of this run
+ * @param input_size    Input: number of these parameters given in input, before those found by the shooting
+ * @param ppr           Input: pointer to precision structure
+ * @param ppt           Input: pointer to perturbation structure
+ * @param pfo           Input: pointer to fourier structure
+ * @param phr           Input: pointer to harmonic structure
+ * @param input_verbose Input: verbosity of input
+ * @param errmsg        Input/Output: Error message
+ * @return the error status
+ */
+
+int input_correction(struct file_content * pfc,
+                     int input_size,
+                     struct precision * ppr,
+                     struct perturbations * ppt,
+                     struct fourier * pfo,
+                     struct harmonic * phr,
+                     int input_verbose,
+                     ErrorMsg errmsg) {
+
+  /** Summary: */
+
+  /** Define local variables */
+  char * slot[2];
+  size_t slot_size[2];
+  short has_module[correction_modules];
+  char * parameters[correction_modules] = {pfo->correction_parameters,phr->correction_parameters};
+  int index_module,index_attempt;
+  double drift,max_drift;
+  short is_usable,is_complete;
+  int flag1;
+  char string1[_ARGUMENT_LENGTH_MAX_];
+
+  /** - Read the file of reference precision parameters, if any */
+  class_call(parser_read_string(pfc,"correction_reference_precision",&string1,&flag1,errmsg),
+             errmsg,
+             errmsg);
+
+  if (phr->correction_mode != correction_apply)
+    return _SUCCESS_;
+
+  /** - Find the modules storing spectra in the file */
+  has_module[correction_fourier] = ((ppt->has_scalars == _TRUE_) &&
+                                    ((ppt->has_pk_matter == _TRUE_) || (pfo->method > nl_none)));
+  has_module[correction_harmonic] = ppt->has_cls;
+
+  /** - Check the file, and refresh it once if it cannot be applied */
+  for (index_attempt=0; index_attempt<2; index_attempt++) {
+
+    is_complete = _TRUE_;
+    max_drift = 0.;
+
+    for (index_module=0; index_module<correction_modules; index_module++) {
+      if (has_module[index_module] == _FALSE_)
+        continue;
+      class_call(correction_fetch(phr->correction_file,(enum correction_module)index_module,slot,slot_size,errmsg),
+                 errmsg,
+                 errmsg);
+      class_call_except(correction_check(slot,
+                                         slot_size,
+                                         parameters[index_module],
+                                         phr->correction_max_drift,
+                                         phr->correction_file,
+                                         &drift,
+                                         &is_usable,
+                                         errmsg),
+                        errmsg,
+                        errmsg,
+                        free(slot[0]);free(slot[1]));
+      if ((slot[0] == NULL) || (slot[1] == NULL))
+        is_complete = _FALSE_;
+      else
+        max_drift = MAX(max_drift,drift);
+      free(slot[0]);
+      free(slot[1]);
+    }
+
+    if ((is_complete == _TRUE_) && ((phr->correction_max_drift <= 0.) || (max_drift <= phr->correction_max_drift)))
+      return _SUCCESS_;
+
+    class_test(index_attempt > 0,
+               errmsg,
+               "the correction file %s cannot correct the spectra of this run, even after computing its fiducial model again",
+               phr->correction_file);
+
+    class_test((flag1 == _FALSE_) && (is_complete == _FALSE_),
+               errmsg,
+               "the correction file %s does not contain both reference and fast spectra: compute them with correction_mode = reference and fast, or give correction_reference_precision to compute them automatically",
+               phr->correction_file);
+
+    class_test(flag1 == _FALSE_,
+               errmsg,
+               "parameter drift %e from the fiducial model of %s exceeds correction_max_drift = %e: compute the fiducial pair again, or give correction_reference_precision to compute it automatically",
+               max_drift,phr->correction_file,phr->correction_max_drift);
+
+    if (input_verbose > 0) {
+      if (is_complete == _FALSE_)
+        printf(" -> correction file %s incomplete, computing the fiducial model\n",phr->correction_file);
+      else
+        printf(" -> parameter drift %e from the fiducial model of %s exceeds %e, computing the new fiducial model\n",
+               max_drift,phr->correction_file,phr->correction_max_drift);
+    }
+
+    class_call(input_correction_refresh(pfc,input_size,ppr,string1,input_verbose,errmsg),
+               errmsg,
+               errmsg);
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Compute the fiducial model of a correction file with the current
+ * input parameters, once with reference precision and once with the
+ * current precision, in modes 'reference' and 'fast'. Only the
+ * modules storing spectra in the file are run, and no output file is
+ * written.
+ *
+ * @param pfc            Input: pointer to file content, with the input parameters of this run
+ * @param input_size     Input: number of these parameters given in input, before those found by the shooting
+ * @param ppr            Input: pointer to precision structure (for the deadline of the run)
+ * @param precision_file Input: file with the reference precision parameters
+ * @param input_verbose  Input: verbosity of input
+ * @param errmsg         Input/Output: Error message
+ * @return the error status
+ */
+
+int input_correction_refresh(struct file_content * pfc,
+                             int input_size,
+                             struct precision * ppr,
+                             char * precision_file,
+                             int input_verbose,
+                             ErrorMsg errmsg) {
+
+  /** Summary: */
+
+  /** Define local variables */
+  struct precision pr;        /* for precision parameters */
+  struct background ba;       /* for cosmological background */
+  struct thermodynamics th;           /* for thermodynamics */
+  struct perturbations pt;         /* for source functions */
+  struct transfer tr;        /* for transfer functions */
+  struct primordial pm;       /* for primordial spectra */
+  struct harmonic hr;          /* for output spectra */
+  struct fourier fo;        /* for non-linear spectra */
+  struct lensing le;          /* for lensed spectra */
+  struct distortions sd;      /* for spectral distortions */
+  struct output op;           /* for output files */
+  struct file_content fc;     /* input parameters of the fiducial runs */
+  struct file_content fc_precision; /* reference precision parameters */
+  int index_run,i;
+
+  for (index_run=0; index_run<2; index_run++) {
+
+    /** - Input parameters of the fiducial run: the current ones in
+        mode 'reference' (overridden by the reference precision
+        parameters) or 'fast', without output files. The unknown
+        parameters found by the shooting are dropped: the fiducial
+        runs find them again, and would otherwise read them twice */
+    class_call(parser_init_from_pfc(pfc,&fc,errmsg),
+               errmsg,
+               errmsg);
+    fc.size = input_size;
+
+    class_call_except(input_correction_set(&fc,"correction_mode",(index_run == 0) ? "reference" : "fast",errmsg),
+                      errmsg,
+                      errmsg,
+                      parser_free(&fc));
+    class_call_except(input_correction_set(&fc,"write_parameters","no",errmsg),
+                      errmsg,
+                      errmsg,
+                      parser_free(&fc));
+    class_call_except(input_correction_set(&fc,"write_warnings","no",errmsg),
+                      errmsg,
+                      errmsg,
+                      parser_free(&fc));
+
+    if (index_run == 0) {
+      class_call_except(parser_read_file(precision_file,&fc_precision,errmsg),
+                        errmsg,
+                        errmsg,
+                        parser_free(&fc));
+      for (i=0; i<fc_precision.size; i++) {
+        class_call_except(input_correction_set(&fc,fc_precision.name[i],fc_precision.value[i],errmsg),
+                          errmsg,
+                          errmsg,
+                          parser_free(&fc);parser_free(&fc_precision));
+      }
+      parser_free(&fc_precision);
+    }
+
+    if (input_verbose > 0)
+      printf(" -> computing the fiducial model with %s precision\n",(index_run == 0) ? "reference" : "fast");
+
+    /** - Run all modules up to the harmonic one */
+    class_call_except(input_read_from_file(&fc,&pr,&ba,&th,&pt,&tr,&pm,&hr,&fo,&le,&sd,&op,errmsg),
+                      errmsg,
+                      errmsg,
+                      parser_free(&fc);if (pr.aborted == _TRUE_) ppr->aborted = _TRUE_);
+
+    parser_free(&fc);
+
+    /* the fiducial runs are part of this run */
+    pr.deadline = ppr->deadline;
+    pr.cancel = ppr->cancel;
+    pr.main_run = ppr;
+
+    class_call_except(background_init(&pr,&ba), ba.error_message, errmsg, background_free_input(&ba);thermodynamics_free_input(&th);perturbations_free_input(&pt);fourier_free_input(&fo);harmonic_free_input(&hr));
+    class_call_except(thermodynamics_init(&pr,&ba,&th), th.error_message, errmsg, background_free(&ba);thermodynamics_free_input(&th);perturbations_free_input(&pt);fourier_free_input(&fo);harmonic_free_input(&hr));
+    class_call_except(perturbations_init(&pr,&ba,&th,&pt), pt.error_message, errmsg, thermodynamics_free(&th);background_free(&ba);perturbations_free_input(&pt);fourier_free_input(&fo);harmonic_free_input(&hr));
+    class_call_except(primordial_init(&pr,&pt,&pm), pm.error_message, errmsg, perturbations_free(&pt);thermodynamics_free(&th);background_free(&ba);fourier_free_input(&fo);harmonic_free_input(&hr));
+    class_call_except(fourier_init(&pr,&ba,&th,&pt,&pm,&fo), fo.error_message, errmsg, primordial_free(&pm);perturbations_free(&pt);thermodynamics_free(&th);background_free(&ba);fourier_free_input(&fo);harmonic_free_input(&hr));
+    class_call_except(transfer_init(&pr,&ba,&th,&pt,&fo,&tr), tr.error_message, errmsg, fourier_free(&fo);primordial_free(&pm);perturbations_free(&pt);thermodynamics_free(&th);background_free(&ba);harmonic_free_input(&hr));
+    class_call_except(harmonic_init(&pr,&ba,&pt,&pm,&fo,&tr,&hr), hr.error_message, errmsg, transfer_free(&tr);fourier_free(&fo);primordial_free(&pm);perturbations_free(&pt);thermodynamics_free(&th);background_free(&ba);harmonic_free_input(&hr));
+
+    /** - Free all structures */
+    class_call(harmonic_free(&hr), hr.error_message, errmsg);
+    class_call(transfer_free(&tr), tr.error_message, errmsg);
+    class_call(fourier_free(&fo), fo.error_message, errmsg);
+    class_call(primordial_free(&pm), pm.error_message, errmsg);
+    class_call(perturbations_free(&pt), pt.error_message, errmsg);
+    class_call(thermodynamics_free(&th), th.error_message, errmsg);
+    class_call(background_free(&ba), ba.error_message, errmsg);
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Set the value of an input parameter in a file content, replacing
+ * its previous value or adding it.
+ *
+ * @param pfc    Input/Output: pointer to file content
+ * @param name   Input: name of the parameter
+ * @param value  Input: value of the parameter
+ * @param errmsg Input/Output: Error message
+ * @return the error status
+ */
+
+int input_correction_set(struct file_content * pfc,
+                         char * name,
+                         char * value,
+                         ErrorMsg errmsg) {
+
+  int index;
+
+  class_test((strlen(name) >= _ARGUMENT_LENGTH_MAX_) || (strlen(value) >= _ARGUMENT_LENGTH_MAX_),
+             errmsg,
+             "parameter %s or its value is too long",name);
+
+  for (index=0; index<pfc->size; index++) {
+    if (strcmp(pfc->name[index],name) == 0)
+      break;
+  }
+
+  if (index == pfc->size) {
+    class_call(parser_extend(pfc,1,errmsg),
+               errmsg,
+               errmsg);
+    strcpy(pfc->name[index],name);
+  }
+
+  strcpy(pfc->value[index],value);
+
+  return _SUCCESS_;
+}
+
+
 /**
  * In CLASS, we call 'shooting' the process of doing preliminary runs
  * of parts of the code in order to find numerically the value of an
@@ -559,6 +883,12 @@ int input_shooting(struct file_content * pfc,
   struct fzerofun_workspace fzw;
 
   *has_shooting=_FALSE_;
+  pba->shooting_failed=_FALSE_;
+
+  /* the preliminary runs stop at the deadline of the main run */
+  fzw.deadline = ppr->deadline;
+  fzw.cancel = ppr->cancel;
+  fzw.main_run = ppr;
 
   /** Do we need to fix unknown parameters? */
   unknown_parameters_size = 0;
@@ -1272,6 +1602,7 @@ int input_get_guess(double *xguess,
   background_free_input(&ba);
   thermodynamics_free_input(&th);
   perturbations_free_input(&pt);
+  harmonic_free_input(&hr);
 
   return _SUCCESS_;
 
@@ -1283,6 +1614,12 @@ int input_get_guess(double *xguess,
  * of unknown parameters; obtain the corresponding target parameters;
  * and return the vector of each [target - targeted_value].
  *
+ * The workspace is only read, never written: the unknown parameters
+ * are set in a private copy of the file content and all structures
+ * are local. Hence this function can be called simultaneously from
+ * several threads (e.g. for the columns of the jacobian in
+ * fzero_Newton()).
+ *
  * @param unknown_parameter       Input: vector of unkownn parameters x
  * @param unknown_parameters_size Input: size of this vector
  * @param voidpfzw                Input: pointer to workspace containing targets, unkown parameters and other relevant information
@@ -1310,6 +1647,7 @@ int input_try_unknown_parameters(double * unknown_parameter,
   struct lensing le;          /* for lensed spectra */
   struct distortions sd;      /* for spectral distortions */
   struct output op;           /* for output files */
+  struct file_content fc;     /* private copy of the input file content */
 
   int i;
   double rho_dcdm_today, rho_dr_today;
@@ -1320,24 +1658,54 @@ int input_try_unknown_parameters(double * unknown_parameter,
   short compute_sigma8 = _FALSE_;
 
   pfzw = (struct fzerofun_workspace *) voidpfzw;
+
+  /** Copy the file content, such that concurrent calls do not share it */
+  class_call(parser_init_from_pfc(&(pfzw->fc), &fc, errmsg),
+             errmsg,
+             errmsg);
+
   /** Read input parameters */
   // This needs to be done with enough accuracy. A standard double has a relative
   // precision of around 1e-16, so 1e-20 should be good enough for the shooting
   for (i=0; i < unknown_parameters_size; i++) {
-    class_sprintf(pfzw->fc.value[pfzw->unknown_parameters_index[i]],"%.20e",unknown_parameter[i]);
+    class_sprintf(fc.value[pfzw->unknown_parameters_index[i]],"%.20e",unknown_parameter[i]);
   }
 
-  class_call(input_read_precisions(&(pfzw->fc),&pr,&ba,&th,&pt,&tr,&pm,&hr,&fo,&le,&sd,&op,
-                                   errmsg),
-             errmsg,
-             errmsg);
+  class_call_except(input_read_precisions(&fc,&pr,&ba,&th,&pt,&tr,&pm,&hr,&fo,&le,&sd,&op,
+                                          errmsg),
+                    errmsg,
+                    errmsg,
+                    parser_free(&fc));
 
-  class_call(input_read_parameters(&(pfzw->fc),&pr,&ba,&th,&pt,&tr,&pm,&hr,&fo,&le,&sd,&op,
-                                   errmsg),
+  pr.deadline = pfzw->deadline;
+  pr.cancel = pfzw->cancel;
+  pr.main_run = pfzw->main_run;
+
+  class_call_except(class_check_deadline(&pr,errmsg),
+                    errmsg,
+                    errmsg,
+                    parser_free(&fc));
+
+  class_call_except(input_read_parameters(&fc,&pr,&ba,&th,&pt,&tr,&pm,&hr,&fo,&le,&sd,&op,
+                                          errmsg),
+                    errmsg,
+                    errmsg,
+                    parser_free(&fc));
+
+  /* same precision as in the final run */
+  class_call_except(input_auto_precision(&fc,&pr,&pt,
+                                         0,
+                                         errmsg),
+                    errmsg,
+                    errmsg,
+                    parser_free(&fc));
+
+  class_call(parser_read_int(&fc,"input_verbose",&param,&flag,errmsg),
              errmsg,
              errmsg);
 
-  class_call(parser_read_int(&(pfzw->fc),"input_verbose",&param,&flag,errmsg),
+  /** The private copy is not needed anymore once all parameters are read */
+  class_call(parser_free(&fc),
              errmsg,
              errmsg);
 
@@ -1346,6 +1714,17 @@ int input_try_unknown_parameters(double * unknown_parameter,
   else
     input_verbose = 0;
 
+  /** The preliminary runs do not checkpoint: their parameters differ at each
+      iteration, so they would discard the records of the final run */
+  pt.has_checkpoint = _FALSE_;
+  tr.has_checkpoint = _FALSE_;
+
+  /** Nor do they store or apply a multi-fidelity correction */
+  fourier_free_input(&fo);
+  fo.correction_mode = correction_none;
+  harmonic_free_input(&hr);
+  hr.correction_mode = correction_none;
+
   /** Optimise flags for sigma8 calculation.*/
   for (i=0; i < unknown_parameters_size; i++) {
     if (pfzw->target_name[i] == sigma8) {
@@ -1501,11 +1880,6 @@ int input_try_unknown_parameters(double * unknown_parameter,
     class_call(background_free(&ba), ba.error_message, errmsg);
   }
 
-  /** Set filecontent to unread */
-  for (i=0; i<pfzw->fc.size; i++) {
-    pfzw->fc.read[i] = _FALSE_;
-  }
-
   /** Free pointers allocated on input if neccessary */
   if (pfzw->required_computation_stage < cs_perturbations) {
     /** Some pointers in ppt may not be allocated if has_perturbations is _FALSE_, but this is handled in perturbations_free_input as neccessary. */
@@ -1564,17 +1938,21 @@ int input_read_precisions(struct file_content * pfc,
   /** - Automatic estimate of machine precision */
   ppr->smallest_allowed_variation = DBL_EPSILON;
 
+  /** - No deadline nor cancellation flag by default (see input_read_from_file()) */
+  ppr->deadline = 0.;
+  ppr->cancel = NULL;
+  ppr->aborted = _FALSE_;
+  ppr->main_run = NULL;
+
   class_test(ppr->smallest_allowed_variation < 0,
              ppr->error_message,
              "smallest_allowed_variation = %e < 0",
              ppr->smallest_allowed_variation);
 
-  /* Assign the default precision settings (these very concise lines
-     assign all precision parameters thanks to the macros defined in
-     macros_precision.h) */
-#define __ASSIGN_DEFAULT_PRECISION__
-#include "precisions.h"
-#undef __ASSIGN_DEFAULT_PRECISION__
+  /* Assign the default precision settings */
+  class_call(input_default_precisions(ppr),
+             errmsg,
+             errmsg);
 
   /** Read all precision parameters from input (these very concise
       lines parse all precision parameters thanks to the macros
@@ -1588,6 +1966,25 @@ int input_read_precisions(struct file_content * pfc,
 }
 
 
+/**
+ * Assign to all precision parameters their default value
+ *
+ * @param ppr     Output: pointer to precision structure
+ * @return the error status
+ */
+
+int input_default_precisions(struct precision * ppr){
+
+  /* these very concise lines assign all precision parameters thanks
+     to the macros defined in macros_precision.h */
+#define __ASSIGN_DEFAULT_PRECISION__
+#include "precisions.h"
+#undef __ASSIGN_DEFAULT_PRECISION__
+
+  return _SUCCESS_;
+
+}
+
 /**
  * If entries are passed in file_content structure, carefully read and
  * interpret each of them, and tune the relevant input parameters
@@ -1679,6 +2076,12 @@ int input_read_parameters(struct file_content * pfc,
              errmsg,
              errmsg);
 
+  /** Read parameters for the multi-fidelity correction */
+  class_call(input_read_parameters_correction(pfc,pfo,phr,
+                                              errmsg),
+             errmsg,
+             errmsg);
+
   /** Read parameters for lensing quantities */
   class_call(input_read_parameters_lensing(pfc,ppr,ppt,ptr,ple,
                                            errmsg),
@@ -3771,6 +4174,10 @@ int input_read_parameters_nonlinear(struct file_content * pfc,
     }
   }
 
+  /** 2) Factorised storage of the linear P(k,z) = D^2(z) P(k,0) */
+  /* Read */
+  class_read_flag("pk_growth_factorisation",pfo->pk_growth_factorisation);
+
   return _SUCCESS_;
 }
 
@@ -4860,6 +5267,31 @@ int input_read_parameters_spectra(struct file_content * pfc,
       ppm->has_k_max_for_primordial_pk = _TRUE_;
     }
 
+    /** 3.a.2) Maximum k in the sources of P(k), beyond which P(k) is extended analytically */
+    /* Read */
+    class_call(parser_read_double(pfc,"perturbations_P_k_max_h/Mpc",&param1,&flag1,errmsg),
+               errmsg,
+               errmsg);
+    class_call(parser_read_double(pfc,"perturbations_P_k_max_1/Mpc",&param2,&flag2,errmsg),
+               errmsg,
+               errmsg);
+    /* Test */
+    class_test((flag1 == _TRUE_) && (flag2 == _TRUE_),
+               errmsg,
+               "You can only enter one of 'perturbations_P_k_max_h/Mpc' or 'perturbations_P_k_max_1/Mpc'.");
+    class_test(((flag1 == _TRUE_) && (param1 <= 0.)) || ((flag2 == _TRUE_) && (param2 <= 0.)),
+               errmsg,
+               "'perturbations_P_k_max_h/Mpc' or 'perturbations_P_k_max_1/Mpc' must be positive.");
+    /* Complete set of parameters */
+    if (flag1 == _TRUE_){
+      ppt->k_max_for_pk_sources=param1*pba->h;
+      ppt->has_k_max_for_pk_sources = _TRUE_;
+    }
+    if (flag2 == _TRUE_){
+      ppt->k_max_for_pk_sources=param2;
+      ppt->has_k_max_for_pk_sources = _TRUE_;
+    }
+
     /** 3.b) Redshift values */
     /* Read */
     class_call(parser_read_list_of_doubles(pfc,"z_pk",&int1,&pointer1,&flag1,errmsg),
@@ -4930,6 +5362,106 @@ int input_read_parameters_spectra(struct file_content * pfc,
 }
 
 
+/**
+ * Read the parameters of the multi-fidelity correction, shared by the
+ * fourier and harmonic structures.
+ *
+ * @param pfc     Input: pointer to local structure
+ * @param pfo     Input: pointer to fourier structure
+ * @param phr     Input: pointer to harmonic structure
+ * @param errmsg  Input: Error message
+ * @return the error status
+ */
+
+int input_read_parameters_correction(struct file_content * pfc,
+                                     struct fourier * pfo,
+                                     struct harmonic * phr,
+                                     ErrorMsg errmsg){
+
+  /** Summary: */
+
+  /** Define local variables */
+  int flag1;
+  char string1[_ARGUMENT_LENGTH_MAX_];
+  int i;
+  size_t length;
+
+  /** 1) Mode */
+  /* Read */
+  class_call(parser_read_string(pfc,"correction_mode",&string1,&flag1,errmsg),
+             errmsg,
+             errmsg);
+  /* Complete set of parameters */
+  if (flag1 == _TRUE_) {
+    if (strcmp(string1,"reference") == 0) {
+      phr->correction_mode = correction_reference;
+    }
+    else if (strcmp(string1,"fast") == 0) {
+      phr->correction_mode = correction_fast;
+    }
+    else if (strcmp(string1,"apply") == 0) {
+      phr->correction_mode = correction_apply;
+    }
+    else if (strcmp(string1,"none") != 0) {
+      class_stop(errmsg,
+                 "You specified 'correction_mode' as '%s'. It has to be one of {'none','reference','fast','apply'}.",string1);
+    }
+  }
+
+  if (phr->correction_mode != correction_none) {
+
+    /** 2) File */
+    /* Read */
+    class_call(parser_read_string(pfc,"correction_file",&string1,&flag1,errmsg),
+               errmsg,
+               errmsg);
+    /* Test */
+    class_test(flag1 == _FALSE_,
+               errmsg,
+               "You asked for a multi-fidelity correction, please specify the 'correction_file'.");
+    class_test(strlen(string1)>_FILENAMESIZE_-1,errmsg,"Correction file name is too long. Please use a shorter path, or increase _FILENAMESIZE_ in common.h");
+    /* Complete set of parameters */
+    strcpy(phr->correction_file,string1);
+
+    /** 3) Maximum drift from the fiducial model */
+    /* Read */
+    class_read_double("correction_max_drift",phr->correction_max_drift);
+
+    /** 4) List of input parameters, to be compared with those of the fiducial model */
+    /* allocated for all parameters, even if some are skipped */
+    length = 1;
+    for (i=0; i<pfc->size; i++)
+      length += strlen(pfc->name[i])+strlen(pfc->value[i])+2;
+    class_alloc(phr->correction_parameters,length*sizeof(char),errmsg);
+    phr->correction_parameters[0] = '\0';
+    for (i=0; i<pfc->size; i++) {
+      if ((strcmp(pfc->name[i],"root") == 0) ||
+          (strcmp(pfc->name[i],"overwrite_root") == 0) ||
+          (strcmp(pfc->name[i],"checkpoint_root") == 0) ||
+          (strcmp(pfc->name[i],"max_run_time") == 0) ||
+          (strncmp(pfc->name[i],"correction_",11) == 0) ||
+          (strncmp(pfc->name[i],"write_",6) == 0) ||
+          (strstr(pfc->name[i],"verbose") != NULL))
+        continue;
+      strcat(phr->correction_parameters,pfc->name[i]);
+      strcat(phr->correction_parameters,"=");
+      strcat(phr->correction_parameters,pfc->value[i]);
+      strcat(phr->correction_parameters,"\n");
+    }
+
+    /** 5) The fourier structure corrects the matter power spectra with the same file */
+    pfo->correction_mode = phr->correction_mode;
+    strcpy(pfo->correction_file,phr->correction_file);
+    pfo->correction_max_drift = phr->correction_max_drift;
+    class_alloc(pfo->correction_parameters,length*sizeof(char),errmsg);
+    strcpy(pfo->correction_parameters,phr->correction_parameters);
+  }
+
+  return _SUCCESS_;
+
+}
+
+
 /**
  * Read the parameters of perturbations, transfer and lensing
  * structures that are relevant for lensing.
@@ -5450,6 +5982,37 @@ int input_read_parameters_output(struct file_content * pfc,
   /* Read */
   class_read_flag_or_deprecated("write_distortions","write distortions",pop->write_distortions);
 
+  /** 1.n) Checkpoint files for perturbations and transfer functions */
+  /* Read */
+  class_call(parser_read_string(pfc,"checkpoint_root",&string1,&flag1,errmsg),
+             errmsg,
+             errmsg);
+  /* Complete set of parameters */
+  if (flag1 == _TRUE_){
+    class_test(strlen(string1)>_FILENAMESIZE_-48,errmsg,"Checkpoint root name is too long. Please use a shorter path, or increase _FILENAMESIZE_ in common.h");
+    ppt->has_checkpoint = _TRUE_;
+    ptr->has_checkpoint = _TRUE_;
+    /* Identify the run with a hash of the version and of all input
+       parameters, except those which cannot affect the results. The
+       hash is part of the file names, such that runs with different
+       parameters sharing a checkpoint root keep their own files */
+    ppt->checkpoint_hash = checkpoint_hash(14695981039346656037ULL,_VERSION_);
+    for (i=0; i<pfc->size; i++) {
+      if ((strcmp(pfc->name[i],"root") != 0) &&
+          (strcmp(pfc->name[i],"overwrite_root") != 0) &&
+          (strcmp(pfc->name[i],"checkpoint_root") != 0) &&
+          (strstr(pfc->name[i],"verbose") == NULL)) {
+        ppt->checkpoint_hash = checkpoint_hash(ppt->checkpoint_hash,pfc->name[i]);
+        ppt->checkpoint_hash = checkpoint_hash(ppt->checkpoint_hash,"=");
+        ppt->checkpoint_hash = checkpoint_hash(ppt->checkpoint_hash,pfc->value[i]);
+        ppt->checkpoint_hash = checkpoint_hash(ppt->checkpoint_hash,"\n");
+      }
+    }
+    ptr->checkpoint_hash = ppt->checkpoint_hash;
+    class_sprintf(ppt->checkpoint_file,"%sperturbations_%016llx.chk",string1,ppt->checkpoint_hash);
+    class_sprintf(ptr->checkpoint_file,"%stransfer_%016llx.chk",string1,ptr->checkpoint_hash);
+  }
+
   /** 2) Verbosity */
   /* Read */
   class_read_int("background_verbose",pba->background_verbose);
@@ -5468,6 +6031,139 @@ int input_read_parameters_output(struct file_content * pfc,
 
 }
 
+/**
+ * Automatic precision: when 'auto_precision' is set to 'standard' or
+ * 'fast', lower the precision parameters which do not matter much for
+ * the requested outputs, down to the values for which the error
+ * remains below the one targeted by the tier (below 1e-3 for
+ * 'standard', a few 1e-3 for 'fast', calibrated against the default
+ * precision on LCDM). Parameters passed by the user (in the .ini or
+ * .pre files, under their current or deprecated name) are never
+ * overwritten. Each choice is logged when input_verbose > 0.
+ *
+ * This must be called after input_read_parameters(), since the
+ * choices depend on the requested outputs.
+ *
+ * @param pfc           Input: pointer to local structure
+ * @param ppr           Input/Output: pointer to precision structure
+ * @param ppt           Input/Output: pointer to perturbation structure
+ * @param input_verbose Input: verbosity of input
+ * @param errmsg        Input: Error message
+ * @return the error status
+ */
+
+int input_auto_precision(struct file_content * pfc,
+                         struct precision * ppr,
+                         struct perturbations * ppt,
+                         int input_verbose,
+                         ErrorMsg errmsg){
+
+  /** Summary: */
+
+  /** Define local variables */
+  enum auto_precision_tier tier = auto_precision_no;
+  char string1[_ARGUMENT_LENGTH_MAX_];
+  int flag1;
+  short has_cmb;
+  struct precision pr_default;
+  struct precision * ppr_default = &pr_default;
+
+  /** - read the accuracy tier */
+  class_call(parser_read_string(pfc,"auto_precision",&string1,&flag1,errmsg),
+             errmsg,
+             errmsg);
+
+  if (flag1 == _TRUE_) {
+    if ((strstr(string1,"standard") != NULL) || (strstr(string1,"STANDARD") != NULL)) {
+      tier = auto_precision_standard;
+    }
+    else if ((strstr(string1,"fast") != NULL) || (strstr(string1,"FAST") != NULL)) {
+      tier = auto_precision_fast;
+    }
+    else {
+      class_test(string_begins_with(string1,'n') == _FALSE_ && string_begins_with(string1,'N') == _FALSE_,
+                 errmsg,
+                 "could not identify auto_precision value '%s', check that it is one of 'no', 'standard', 'fast'.",
+                 string1);
+    }
+  }
+
+  if ((tier == auto_precision_no) || (ppt->has_perturbations == _FALSE_)) {
+    return _SUCCESS_;
+  }
+
+  if (input_verbose > 0) {
+    printf("Choosing precision parameters automatically ('%s' tier)\n",
+           (tier == auto_precision_fast) ? "fast" : "standard");
+  }
+
+  /** - default values, to recognise the parameters passed under a
+      deprecated name (see input_read_parameters_additional()) */
+  class_call(input_default_precisions(ppr_default),
+             errmsg,
+             errmsg);
+
+  /** - CMB temperature or polarization spectra are the only outputs
+      depending on the photon hierarchies beyond their first multipoles */
+  has_cmb = (ppt->has_cl_cmb_temperature == _TRUE_ || ppt->has_cl_cmb_polarization == _TRUE_) ? _TRUE_ : _FALSE_;
+
+  /** - 'standard' tier: photon polarization hierarchy, integrator
+      tolerance and wavenumber sampling of the CMB sources (relative
+      error of 7e-4 on P(k), 2.4e-4 on the lensed C_l, for 30% less
+      time) */
+  if (has_cmb == _FALSE_) {
+    class_auto_precision_parameter(l_max_pol_g,4,"no CMB spectra");
+  }
+  else if (ppt->has_cl_cmb_polarization == _FALSE_) {
+    class_auto_precision_parameter(l_max_pol_g,6,"no CMB polarization spectra");
+  }
+
+  class_auto_precision_parameter(tol_perturbations_integration,1.e-4,"accuracy tier");
+
+  if (has_cmb == _TRUE_) {
+    class_auto_precision_parameter(k_step_sub,0.075,"CMB spectra");
+  }
+
+  /** - logarithmic sampling in k of the matter sources, inside and
+      outside the BAO region (relative error of 7e-4 on P(k), 1.3e-3
+      for 'fast'; for mPk alone, 15% to 20% less time, the more for
+      the smaller P_k_max) */
+  if (ppt->has_pk_matter == _TRUE_) {
+    class_auto_precision_parameter(k_per_decade_for_pk,(tier == auto_precision_fast) ? 7 : 8,"matter power spectrum");
+    class_auto_precision_parameter(k_per_decade_for_bao,(tier == auto_precision_fast) ? 45 : 50,"matter power spectrum");
+  }
+
+  /** - 'fast' tier: on top of that, photon temperature hierarchy and
+      sampling in l (relative error of 2e-3 on P(k), 2.5e-3 on the
+      lensed EE spectrum), and a shorter range of wavenumbers for the
+      matter sources, beyond which P(k) is extended analytically
+      (relative error below 3e-3 up to 30/Mpc) */
+  if (tier == auto_precision_fast) {
+
+    if (has_cmb == _FALSE_) {
+      class_auto_precision_parameter(l_max_g,8,"no CMB spectra");
+    }
+    else {
+      class_auto_precision_parameter(l_logstep,1.15,"CMB spectra");
+    }
+
+    if ((ppt->has_pk_matter == _TRUE_) &&
+        (ppt->has_k_max_for_pk_sources == _FALSE_) &&
+        (ppt->k_max_for_pk >= 10.) &&
+        (ppt->k_max_for_pk <= 30.)) {
+      ppt->has_k_max_for_pk_sources = _TRUE_;
+      ppt->k_max_for_pk_sources = MAX(5.,ppt->k_max_for_pk/4.);
+      if (input_verbose > 0) {
+        printf(" -> auto precision: perturbations_P_k_max_1/Mpc = %g (P(k) extended analytically up to %g/Mpc)\n",
+               ppt->k_max_for_pk_sources,ppt->k_max_for_pk);
+      }
+    }
+  }
+
+  return _SUCCESS_;
+
+}
+
 /**
  * Write the info related to the used and unused parameters
  * Additionally, write the warnings for unused parameters
@@ -5487,6 +6183,7 @@ int input_write_info(struct file_content * pfc,
   /** Define local variables */
   int i;
   int flag1, flag2;
+  int mpi_rank, mpi_size;
   FILE * param_output;
   FILE * param_unused;
   char param_output_name[_LINE_LENGTH_MAX_];
@@ -5506,8 +6203,14 @@ int input_write_info(struct file_content * pfc,
     }
   }
 
-  /* Finally, since all variables are read, we can also print the parameters.ini and unused_parameters files */
-  if (flag1 == _TRUE_) {
+  /* Finally, since all variables are read, we can also print the
+     parameters.ini and unused_parameters files (only from the root
+     process when running with MPI) */
+  class_call(class_mpi_rank_and_size(&mpi_rank,&mpi_size),
+             errmsg,
+             errmsg);
+
+  if ((flag1 == _TRUE_) && (mpi_rank == 0)) {
     class_sprintf(param_output_name,"%s%s",pop->root,"parameters.ini");
     class_open(param_output,param_output_name,"w",errmsg);
     fprintf(param_output,"# List of input/precision parameters actually read\n");
@@ -5892,6 +6595,7 @@ int input_default_params(struct background *pba,
   ppt->has_nl_corrections_based_on_delta_m = _FALSE_;
   pfo->method = nl_none;
   pfo->has_pk_eq = _FALSE_;
+  pfo->pk_growth_factorisation = _FALSE_;
   pfo->extrapolation_method = extrap_max_scaled;
   pfo->feedback = nl_emu_dmonly;
   pfo->z_infinity = 10.;
@@ -6030,12 +6734,22 @@ int input_default_params(struct background *pba,
   ppt->k_max_for_pk=1.;
   /** 3.a) Maximum k in P(k) primordial */
   ppm->has_k_max_for_primordial_pk = _FALSE_;
+  /** 3.a.2) Maximum k in the sources of P(k) */
+  ppt->has_k_max_for_pk_sources = _FALSE_;
   /** 3.b) Redshift values */
   pop->z_pk_num = 1;
   pop->z_pk[0] = 0.;
   /** 3.c) Maximum redshift */
   ppt->z_max_pk=0.;
 
+  /** 4) Multi-fidelity correction */
+  phr->correction_mode = correction_none;
+  phr->correction_max_drift = 0.;
+  phr->correction_parameters = NULL;
+  pfo->correction_mode = correction_none;
+  pfo->correction_max_drift = 0.;
+  pfo->correction_parameters = NULL;
+
   /**
    * Default to input_read_parameters_lensing
    */
@@ -6120,6 +6834,9 @@ int input_default_params(struct background *pba,
   pop->write_noninjection = _FALSE_;
   /** 1.i) Spectral distortions */
   pop->write_distortions = _FALSE_;
+  /** 1.n) Checkpoint files */
+  ppt->has_checkpoint = _FALSE_;
+  ptr->has_checkpoint = _FALSE_;
 
 
   /** 2) Verbosity */
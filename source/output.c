@@ -1471,17 +1471,19 @@ int output_print_data(FILE *out,
   int index_title, index_tau;
   char thetitle[_MAXTITLESTRINGLENGTH_];
   char *pch;
+  char *saveptr;
 
   /** Summary*/
 
-  /** - First we print the titles */
+  /** - First we print the titles (with the reentrant strtok_r, since
+      several runs may write their output at the same time) */
   fprintf(out,"#");
 
   strcpy(thetitle,titles);
-  pch = strtok(thetitle,_DELIMITER_);
+  pch = strtok_r(thetitle,_DELIMITER_,&saveptr);
   while (pch != NULL){
     class_fprintf_columntitle(out, pch, _TRUE_, colnum);
-    pch = strtok(NULL,_DELIMITER_);
+    pch = strtok_r(NULL,_DELIMITER_,&saveptr);
   }
   fprintf(out,"\n");
 
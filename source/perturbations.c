@@ -708,6 +708,21 @@ int perturbations_init(
   int index_k;
   /* running index for type of perturbation */
   int index_tp;
+  /* running index for wavenumbers with printed perturbations */
+  int index_ikout;
+  /* rank of this process, number of processes, and process evolving a given wavenumber */
+  int mpi_rank, mpi_size, mpi_owner;
+  double ** mpi_arrays;
+  size_t * mpi_sizes;
+  int number_of_arrays;
+  /* status of the loop over wavenumbers on this process */
+  int status = _SUCCESS_;
+  /* are perturbations printed for a given wavenumber? */
+  short is_output;
+  /* checkpoint file, and flags for wavenumbers recovered from it, is_restored[index_md][index_ic*k_size+index_k] */
+  struct checkpoint checkpoint;
+  struct checkpoint * pch = &checkpoint;
+  short ** is_restored = NULL;
   /* background quantities */
   double w_fld_ini, w_fld_0,dw_over_da_fld,integral_fld;
 
@@ -891,6 +906,37 @@ int perturbations_init(
              ppt->error_message,
              ppt->error_message);
 
+  /** - if the run is distributed over several MPI processes, each
+      of them evolves only its share of wavenumbers, and the source
+      arrays are then summed over processes. Non-evolved wavenumbers
+      must be set to zero for this sum to be exact. */
+  class_call(class_mpi_rank_and_size(&mpi_rank,&mpi_size),
+             ppt->error_message,
+             ppt->error_message);
+
+  if (mpi_size > 1) {
+    for (index_md = 0; index_md < ppt->md_size; index_md++)
+      for (index_ic = 0; index_ic < ppt->ic_size[index_md]; index_ic++)
+        for (index_tp = 0; index_tp < ppt->tp_size[index_md]; index_tp++)
+          memset(ppt->sources[index_md][index_ic*ppt->tp_size[index_md]+index_tp],
+                 0,
+                 ppt->k_size[index_md]*ppt->tau_size*sizeof(double));
+  }
+
+  /** - if checkpointing is requested, recover the sources of the
+      wavenumbers evolved by a previous run with the same input, and
+      open the checkpoint file for appending new ones */
+
+  if (ppt->has_checkpoint == _TRUE_) {
+    class_call(perturbations_checkpoint_init(ppt,
+                                             mpi_rank,
+                                             mpi_size,
+                                             pch,
+                                             &is_restored),
+               ppt->error_message,
+               ppt->error_message);
+  }
+
   /* Setup task system */
   class_setup_parallel();
   /** - loop over modes (scalar, tensors, etc). For each mode: */
@@ -912,7 +958,26 @@ int perturbations_init(
       //for (index_k = 0; index_k < ppt->k_size; index_k++) {
       for (index_k = ppt->k_size[index_md]-1; index_k >=0; index_k--) {
 
-        class_run_parallel(with_arguments(ppr,pba,pth,ppt,index_md,index_ic,index_k),
+        /* wavenumbers are dealt cyclically to MPI processes, except
+           those for which perturbations are printed: they are evolved
+           by the root process, which writes the output files */
+        is_output = _FALSE_;
+        for (index_ikout=0; index_ikout<ppt->k_output_values_num; index_ikout++) {
+          if (ppt->index_k_output_values[index_md*ppt->k_output_values_num+index_ikout] == index_k)
+            is_output = _TRUE_;
+        }
+        mpi_owner = (is_output == _TRUE_) ? 0 : index_k % mpi_size;
+        if (mpi_owner != mpi_rank)
+          continue;
+
+        /* wavenumbers recovered from the checkpoint file are not
+           evolved again, unless their perturbations must be printed */
+        if ((ppt->has_checkpoint == _TRUE_) &&
+            (is_output == _FALSE_) &&
+            (is_restored[index_md][index_ic*ppt->k_size[index_md]+index_k] == _TRUE_))
+          continue;
+
+        class_run_parallel(with_arguments(ppr,pba,pth,ppt,index_md,index_ic,index_k,pch),
 
           if (ppt->perturbations_verbose > 2) {
             printf("evolving mode k=%e /Mpc  (%d/%d)",ppt->k[index_md][index_k],index_k+1,ppt->k_size[index_md]);
@@ -921,6 +986,11 @@ int perturbations_init(
             printf("\n");
           }
 
+          /* skip the remaining wavenumbers if the run is over its deadline or was cancelled */
+          class_call(class_check_deadline(ppr,ppt->error_message),
+                     ppt->error_message,
+                     ppt->error_message);
+
           struct perturbations_workspace pw;
           class_call(perturbations_workspace_init(ppr,
                                                   pba,
@@ -931,16 +1001,28 @@ int perturbations_init(
                      ppt->error_message,
                      ppt->error_message);
 
-          class_call(perturbations_solve(ppr,
-                                         pba,
-                                         pth,
-                                         ppt,
-                                         index_md,
-                                         index_ic,
-                                         index_k,
-                                         &pw),
-                     ppt->error_message,
-                     ppt->error_message);
+          class_call_except(perturbations_solve(ppr,
+                                                pba,
+                                                pth,
+                                                ppt,
+                                                index_md,
+                                                index_ic,
+                                                index_k,
+                                                &pw),
+                            ppt->error_message,
+                            ppt->error_message,
+                            perturbations_workspace_free(ppt,index_md,&pw));
+
+          if (ppt->has_checkpoint == _TRUE_) {
+            class_call_except(perturbations_checkpoint_write(ppt,
+                                                             pch,
+                                                             index_md,
+                                                             index_ic,
+                                                             index_k),
+                              ppt->error_message,
+                              ppt->error_message,
+                              perturbations_workspace_free(ppt,index_md,&pw));
+          }
 
           class_call(perturbations_workspace_free(ppt,index_md,&pw),
                      ppt->error_message,
@@ -955,8 +1037,54 @@ int perturbations_init(
 
   } /* end loop over modes */
 
-  class_finish_parallel();
+  class_finish_parallel_status(status);
+
+  /* the records written before a failure are kept for the next run */
+  if (ppt->has_checkpoint == _TRUE_) {
+    if (checkpoint_close(pch,ppt->error_message) == _FAILURE_)
+      status = _FAILURE_;
+    for (index_md = 0; index_md < ppt->md_size; index_md++)
+      free(is_restored[index_md]);
+    free(is_restored);
+  }
+
+  /** - stop all MPI processes together if any of them failed (nothing to do without MPI) */
+
+  status = class_mpi_check_status(status,ppt->error_message);
+
+  /** - if the run failed or was aborted, free the partially filled
+      tables, since callers only free complete structures */
 
+  if (status == _FAILURE_) {
+    perturbations_free(ppt);
+    return _FAILURE_;
+  }
+
+  /** - gather the source functions evolved by all MPI processes (nothing to do without MPI) */
+
+  if (mpi_size > 1) {
+    number_of_arrays = 0;
+    for (index_md = 0; index_md < ppt->md_size; index_md++)
+      number_of_arrays += ppt->ic_size[index_md]*ppt->tp_size[index_md];
+    class_alloc(mpi_arrays,number_of_arrays*sizeof(double*),ppt->error_message);
+    class_alloc(mpi_sizes,number_of_arrays*sizeof(size_t),ppt->error_message);
+    number_of_arrays = 0;
+    for (index_md = 0; index_md < ppt->md_size; index_md++) {
+      for (index_ic = 0; index_ic < ppt->ic_size[index_md]; index_ic++) {
+        for (index_tp = 0; index_tp < ppt->tp_size[index_md]; index_tp++) {
+          mpi_arrays[number_of_arrays] = ppt->sources[index_md][index_ic*ppt->tp_size[index_md]+index_tp];
+          mpi_sizes[number_of_arrays] = (size_t)ppt->k_size[index_md]*ppt->tau_size;
+          number_of_arrays++;
+        }
+      }
+    }
+    class_call_except(class_mpi_sum(mpi_arrays,mpi_sizes,number_of_arrays,ppt->error_message),
+                      ppt->error_message,
+                      ppt->error_message,
+                      free(mpi_arrays);free(mpi_sizes));
+    free(mpi_arrays);
+    free(mpi_sizes);
+  }
 
   /** - spline the source array with respect to the time variable */
 
@@ -1008,10 +1136,10 @@ int perturbations_init(
 
 int perturbations_free_input(struct perturbations* ppt) {
 
-  if (ppt->alpha_idm_dr != NULL)
-    free(ppt->alpha_idm_dr);
-  if (ppt->beta_idr != NULL)
-    free(ppt->beta_idr);
+  free(ppt->alpha_idm_dr);
+  ppt->alpha_idm_dr = NULL;
+  free(ppt->beta_idr);
+  ppt->beta_idr = NULL;
 
   return _SUCCESS_;
 }
@@ -1059,6 +1187,8 @@ int perturbations_free(
     }
 
     free(ppt->tau_sampling);
+    free(ppt->tau_sampling_pvecback);
+    free(ppt->tau_sampling_pvecthermo);
     if (ppt->ln_tau_size > 1)
       free(ppt->ln_tau);
 
@@ -1100,6 +1230,277 @@ int perturbations_free(
 
 }
 
+/**
+ * Reduce the source table to its late-time part, once the modules
+ * needing the full time sampling (fourier and transfer) are done.
+ *
+ * After this call, the arrays tau_sampling and sources only cover
+ * the ln_tau_size late times spanned by ln_tau (or just today if
+ * z_max_pk=0). This is all that perturbations_sources_at_tau() and
+ * perturbations_output_data_at_z() need for redshifts z <= z_max_pk.
+ * The table of background and thermodynamics quantities at each
+ * sampling time is released. Front-ends that access the full source
+ * table afterwards (like classy's get_sources()) should not call
+ * this function.
+ *
+ * @param ppt Input/Output: perturbation structure to be downsized
+ * @return the error status
+ */
+
+int perturbations_downsize_sources(
+                                   struct perturbations * ppt
+                                   ) {
+
+  int index_md,index_ic,index_tp;
+  int tau_size_new,index_tau_min;
+  double * sources_new;
+  double * tau_sampling_new;
+
+  if ((ppt->has_perturbations == _FALSE_) || (ppt->is_allocated == _FALSE_))
+    return _SUCCESS_;
+
+  free(ppt->tau_sampling_pvecback);
+  free(ppt->tau_sampling_pvecthermo);
+  ppt->tau_sampling_pvecback = NULL;
+  ppt->tau_sampling_pvecthermo = NULL;
+
+  if (ppt->ln_tau_size > 1)
+    tau_size_new = ppt->ln_tau_size;
+  else
+    tau_size_new = 1;
+
+  if (tau_size_new >= ppt->tau_size)
+    return _SUCCESS_;
+
+  index_tau_min = ppt->tau_size - tau_size_new;
+
+  /** - keep only the late part of each source array */
+  for (index_md = 0; index_md < ppt->md_size; index_md++) {
+    for (index_ic = 0; index_ic < ppt->ic_size[index_md]; index_ic++) {
+      for (index_tp = 0; index_tp < ppt->tp_size[index_md]; index_tp++) {
+
+        class_alloc(sources_new,
+                    ppt->k_size[index_md] * tau_size_new * sizeof(double),
+                    ppt->error_message);
+
+        memcpy(sources_new,
+               ppt->sources[index_md][index_ic*ppt->tp_size[index_md]+index_tp] + index_tau_min * ppt->k_size[index_md],
+               ppt->k_size[index_md] * tau_size_new * sizeof(double));
+
+        free(ppt->sources[index_md][index_ic*ppt->tp_size[index_md]+index_tp]);
+        ppt->sources[index_md][index_ic*ppt->tp_size[index_md]+index_tp] = sources_new;
+
+        /* late_sources now points to the beginning of the (shorter) sources array */
+        if (ppt->ln_tau_size > 1)
+          ppt->late_sources[index_md][index_ic*ppt->tp_size[index_md]+index_tp] = sources_new;
+      }
+    }
+  }
+
+  /** - keep only the corresponding times */
+  class_alloc(tau_sampling_new,tau_size_new * sizeof(double),ppt->error_message);
+  memcpy(tau_sampling_new,ppt->tau_sampling+index_tau_min,tau_size_new * sizeof(double));
+  free(ppt->tau_sampling);
+  ppt->tau_sampling = tau_sampling_new;
+  ppt->tau_size = tau_size_new;
+
+  return _SUCCESS_;
+}
+
+/**
+ * Open the checkpoint file of the perturbation module and recover the
+ * source functions of all wavenumbers already evolved by a previous
+ * run with the same input parameters.
+ *
+ * Each record contains the indices (index_md, index_ic, index_k) and
+ * the sources of all types at all sampling times for this wavenumber.
+ * When the run is distributed over several MPI processes, each of
+ * them uses its own file, so a restarted run should use the same
+ * number of processes.
+ *
+ * @param ppt         Input/Output: pointer to perturbation structure (sources filled for recovered wavenumbers)
+ * @param mpi_rank    Input: rank of this process
+ * @param mpi_size    Input: number of processes
+ * @param pch         Output: checkpoint structure, open for appending new records
+ * @param is_restored Output: allocated array of flags, is_restored[index_md][index_ic*k_size+index_k]
+ * @return the error status
+ */
+
+int perturbations_checkpoint_init(
+                                  struct perturbations * ppt,
+                                  int mpi_rank,
+                                  int mpi_size,
+                                  struct checkpoint * pch,
+                                  short *** is_restored
+                                  ) {
+
+  FileName filename;
+  int * header;
+  int header_size;
+  int tp_size_max=0;
+  int index_md,index_ic,index_k,index_tp,index_tau;
+  int ints[3];
+  double * doubles;
+  int has_record;
+  int restored_num=0;
+
+  /** - describe the size of the source arrays in the file header */
+  header_size = 3+3*ppt->md_size;
+  class_alloc(header,header_size*sizeof(int),ppt->error_message);
+  header[0] = mpi_size;
+  header[1] = ppt->md_size;
+  header[2] = ppt->tau_size;
+  for (index_md = 0; index_md < ppt->md_size; index_md++) {
+    header[3+3*index_md] = ppt->ic_size[index_md];
+    header[4+3*index_md] = ppt->tp_size[index_md];
+    header[5+3*index_md] = ppt->k_size[index_md];
+    tp_size_max = MAX(tp_size_max,ppt->tp_size[index_md]);
+  }
+
+  if (mpi_size > 1)
+    class_sprintf(filename,"%s_%d",ppt->checkpoint_file,mpi_rank);
+  else
+    class_sprintf(filename,"%s",ppt->checkpoint_file);
+
+  class_call(checkpoint_open(filename,
+                             ppt->checkpoint_hash,
+                             header,
+                             header_size,
+                             3,
+                             tp_size_max*ppt->tau_size,
+                             pch,
+                             ppt->error_message),
+             ppt->error_message,
+             ppt->error_message);
+
+  free(header);
+
+  /** - read all complete records */
+  class_alloc(*is_restored,ppt->md_size*sizeof(short *),ppt->error_message);
+  for (index_md = 0; index_md < ppt->md_size; index_md++) {
+    class_alloc((*is_restored)[index_md],ppt->ic_size[index_md]*ppt->k_size[index_md]*sizeof(short),ppt->error_message);
+    for (index_k = 0; index_k < ppt->ic_size[index_md]*ppt->k_size[index_md]; index_k++)
+      (*is_restored)[index_md][index_k] = _FALSE_;
+  }
+
+  class_alloc(doubles,tp_size_max*ppt->tau_size*sizeof(double),ppt->error_message);
+
+  do {
+    class_call_except(checkpoint_read(pch,ints,doubles,&has_record,ppt->error_message),
+                      ppt->error_message,
+                      ppt->error_message,
+                      perturbations_checkpoint_free(ppt,pch,doubles,*is_restored));
+
+    if (has_record == _TRUE_) {
+      index_md = ints[0];
+      index_ic = ints[1];
+      index_k = ints[2];
+
+      class_test_except((index_md < 0) || (index_md >= ppt->md_size) ||
+                        (index_ic < 0) || (index_ic >= ppt->ic_size[index_md]) ||
+                        (index_k < 0) || (index_k >= ppt->k_size[index_md]),
+                        ppt->error_message,
+                        perturbations_checkpoint_free(ppt,pch,doubles,*is_restored),
+                        "corrupted record in checkpoint file %s",filename);
+
+      for (index_tp = 0; index_tp < ppt->tp_size[index_md]; index_tp++)
+        for (index_tau = 0; index_tau < ppt->tau_size; index_tau++)
+          ppt->sources[index_md][index_ic*ppt->tp_size[index_md]+index_tp][index_tau*ppt->k_size[index_md]+index_k]
+            = doubles[index_tp*ppt->tau_size+index_tau];
+
+      if ((*is_restored)[index_md][index_ic*ppt->k_size[index_md]+index_k] == _FALSE_)
+        restored_num++;
+      (*is_restored)[index_md][index_ic*ppt->k_size[index_md]+index_k] = _TRUE_;
+    }
+  } while (has_record == _TRUE_);
+
+  free(doubles);
+
+  if ((ppt->perturbations_verbose > 0) && (restored_num > 0))
+    printf(" -> recovered sources for %d wavenumbers from checkpoint file %s\n",restored_num,filename);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Close the checkpoint file and free the arrays of
+ * perturbations_checkpoint_init(), when the recovery of records
+ * failed.
+ *
+ * @param ppt         Input: pointer to perturbation structure
+ * @param pch         Input: checkpoint structure
+ * @param doubles     Input: buffer for the doubles of one record
+ * @param is_restored Input: array of flags, is_restored[index_md][index_ic*k_size+index_k]
+ * @return the error status
+ */
+
+int perturbations_checkpoint_free(
+                                   struct perturbations * ppt,
+                                   struct checkpoint * pch,
+                                   double * doubles,
+                                   short ** is_restored
+                                   ) {
+
+  int index_md;
+
+  for (index_md = 0; index_md < ppt->md_size; index_md++)
+    free(is_restored[index_md]);
+  free(is_restored);
+  free(doubles);
+
+  class_call(checkpoint_close(pch,ppt->error_message),
+             ppt->error_message,
+             ppt->error_message);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Append the source functions of one evolved wavenumber to the
+ * checkpoint file. Called from parallel tasks once
+ * perturbations_solve() has filled the sources for this wavenumber.
+ *
+ * @param ppt      Input: pointer to perturbation structure
+ * @param pch      Input: checkpoint structure
+ * @param index_md Input: index of mode
+ * @param index_ic Input: index of initial condition
+ * @param index_k  Input: index of wavenumber
+ * @return the error status
+ */
+
+int perturbations_checkpoint_write(
+                                   struct perturbations * ppt,
+                                   struct checkpoint * pch,
+                                   int index_md,
+                                   int index_ic,
+                                   int index_k
+                                   ) {
+
+  int ints[3];
+  double * doubles;
+  int index_tp,index_tau;
+
+  ints[0] = index_md;
+  ints[1] = index_ic;
+  ints[2] = index_k;
+
+  /* the padding for modes with less source types than the maximum is written as zeros */
+  class_calloc(doubles,pch->record_doubles,sizeof(double),ppt->error_message);
+
+  for (index_tp = 0; index_tp < ppt->tp_size[index_md]; index_tp++)
+    for (index_tau = 0; index_tau < ppt->tau_size; index_tau++)
+      doubles[index_tp*ppt->tau_size+index_tau]
+        = ppt->sources[index_md][index_ic*ppt->tp_size[index_md]+index_tp][index_tau*ppt->k_size[index_md]+index_k];
+
+  class_call(checkpoint_write(pch,ints,doubles,ppt->error_message),
+             ppt->error_message,
+             ppt->error_message);
+
+  free(doubles);
+
+  return _SUCCESS_;
+}
+
 /**
  * Initialize all indices and allocate most arrays in perturbations structure.
  *
@@ -1918,6 +2319,46 @@ int perturbations_timesampling_for_sources(
   free(pvecback);
   free(pvecthermo);
 
+  /** - store background and thermodynamics quantities at each
+      sampling point. They do not depend on the wavenumber, so
+      perturbations_sources() can read them from this table instead
+      of interpolating them again for each k */
+
+  class_alloc(ppt->tau_sampling_pvecback,
+              ppt->tau_size*pba->bg_size_normal*sizeof(double),
+              ppt->error_message);
+  class_alloc(ppt->tau_sampling_pvecthermo,
+              ppt->tau_size*pth->th_size*sizeof(double),
+              ppt->error_message);
+
+  last_index_back = first_index_back;
+  last_index_thermo = first_index_thermo;
+
+  for (index_tau=0; index_tau < ppt->tau_size; index_tau++) {
+
+    pvecback = ppt->tau_sampling_pvecback + index_tau*pba->bg_size_normal;
+    pvecthermo = ppt->tau_sampling_pvecthermo + index_tau*pth->th_size;
+
+    class_call(background_at_tau(pba,
+                                 ppt->tau_sampling[index_tau],
+                                 normal_info,
+                                 inter_closeby,
+                                 &last_index_back,
+                                 pvecback),
+               pba->error_message,
+               ppt->error_message);
+
+    class_call(thermodynamics_at_z(pba,
+                                   pth,
+                                   1./pvecback[pba->index_bg_a]-1.,  /* redshift z=1/a-1 */
+                                   inter_closeby,
+                                   &last_index_thermo,
+                                   pvecback,
+                                   pvecthermo),
+               pth->error_message,
+               ppt->error_message);
+  }
+
   /** - check the maximum redshift z_max_pk at which the Fourier
       transfer functions \f$ T_i(k,z)\f$ should be computable by
       interpolation. If it is equal to zero, only \f$ T_i(k,z=0)\f$
@@ -2136,11 +2577,21 @@ int perturbations_get_k_list(
 
     /* find k_max: */
 
-    if ((ppt->has_pk_matter == _TRUE_) || (ppt->has_density_transfers == _TRUE_) || (ppt->has_velocity_transfers == _TRUE_))
+    /* when the sources of P(k) stop at k_max_for_pk_sources, the
+       fourier module extends P(k) analytically until k_max_for_pk
+       (and until nonlinear_min_k_max for non-linear corrections);
+       the transfer functions T(k,z) cannot be extended this way */
+
+    if ((ppt->has_density_transfers == _TRUE_) || (ppt->has_velocity_transfers == _TRUE_) ||
+        ((ppt->has_pk_matter == _TRUE_) && (ppt->has_k_max_for_pk_sources == _FALSE_)))
       k_max = MAX(k_max,ppt->k_max_for_pk);
+    else if (ppt->has_pk_matter == _TRUE_)
+      k_max = MAX(k_max,MIN(ppt->k_max_for_pk,ppt->k_max_for_pk_sources));
 
-    if (ppt->has_nl_corrections_based_on_delta_m == _TRUE_)
+    if ((ppt->has_nl_corrections_based_on_delta_m == _TRUE_) && (ppt->has_k_max_for_pk_sources == _FALSE_))
       k_max = MAX(k_max,ppr->nonlinear_min_k_max);
+    else if (ppt->has_nl_corrections_based_on_delta_m == _TRUE_)
+      k_max = MAX(k_max,MIN(ppr->nonlinear_min_k_max,ppt->k_max_for_pk_sources));
 
     if ((ppt->has_cl_cmb_lensing_potential == _TRUE_) && (ppt->want_lcmb_full_limber == _TRUE_))
       k_max = MAX(k_max, ppr->k_max_limber_over_l_max_scalars * ppt->l_scalar_max);
@@ -2276,6 +2727,12 @@ int perturbations_get_k_list(
         ppt->k_size_pk = index_k;
     }
 
+    /* if the sources stop before k_max_for_pk, the output of P(k)
+       will be extended by the fourier module: here we only keep
+       track of the computed values */
+    if ((ppt->has_k_max_for_pk_sources == _TRUE_) && (ppt->k_size_pk == 0))
+      ppt->k_size_pk = index_k;
+
     ppt->k_size[ppt->index_md_scalars] = index_k;
 
     class_realloc(ppt->k[ppt->index_md_scalars],
@@ -2778,6 +3235,7 @@ int perturbations_workspace_init(
     class_define_index(ppw->index_ap_ncdmfa,pba->has_ncdm,index_ap,1);
     class_define_index(ppw->index_ap_tca_idm_dr,pba->has_idr,index_ap,1);
     class_define_index(ppw->index_ap_rsa_idr,pba->has_idr,index_ap,1);
+    class_define_index(ppw->index_ap_hta,ppr->hierarchy_truncation_approximation != hta_none,index_ap,1);
   }
 
   ppw->ap_size=index_ap;
@@ -2785,6 +3243,26 @@ int perturbations_workspace_init(
   if (ppw->ap_size > 0)
     class_alloc(ppw->approx,ppw->ap_size*sizeof(int),ppt->error_message);
 
+  /** - for the hierarchy truncation approximation, infer the value of
+      \f$ k \tau \f$ at which the full hierarchies must be restored.
+      For free-streaming species and \f$ k \tau \ll l \f$, the
+      multipoles scale like \f$ F_{l+1}/F_l \simeq k \tau / (2l+3)
+      \f$, so the amplitude of the first neglected multipole relative
+      to the shear is \f$ \prod_{l=3}^{l_{max}+1} k \tau/(2l+1) \f$.
+      We switch when it reaches hierarchy_truncation_tolerance. */
+
+  if ((_scalars_) && (ppr->hierarchy_truncation_approximation != hta_none)) {
+
+    class_test(ppr->l_max_hta < 4,
+               ppt->error_message,
+               "ppr->l_max_hta=%d should be at least 4",ppr->l_max_hta);
+
+    ppw->hta_trigger_tau_over_tau_k = ppr->hierarchy_truncation_tolerance;
+    for (l=3; l<=ppr->l_max_hta+1; l++)
+      ppw->hta_trigger_tau_over_tau_k *= (2.*l+1.);
+    ppw->hta_trigger_tau_over_tau_k = pow(ppw->hta_trigger_tau_over_tau_k,1./(ppr->l_max_hta-1.));
+  }
+
   /** - For definiteness, initialize approximation flags to arbitrary
       values (correct values are overwritten in
       pertub_find_approximation_switches) */
@@ -2807,6 +3285,9 @@ int perturbations_workspace_init(
     if (pba->has_ncdm == _TRUE_) {
       ppw->approx[ppw->index_ap_ncdmfa]=(int)ncdmfa_off;
     }
+    if (ppr->hierarchy_truncation_approximation != hta_none) {
+      ppw->approx[ppw->index_ap_hta]=(int)hta_on;
+    }
   }
 
   if (_tensors_) {
@@ -3224,24 +3705,30 @@ int perturbations_solve(
       generic_evolver = evolver_ndf15;
     }
 
-    class_call(generic_evolver(perturbations_derivs,
-                               interval_limit[index_interval],
-                               interval_limit[index_interval+1],
-                               ppw->pv->y,
-                               ppw->pv->used_in_sources,
-                               ppw->pv->pt_size,
-                               &ppaw,
-                               ppr->tol_perturbations_integration,
-                               ppr->smallest_allowed_variation,
-                               perturbations_timescale,
-                               ppr->perturbations_integration_stepsize,
-                               ppt->tau_sampling,
-                               tau_actual_size,
-                               perturbations_sources,
-                               perhaps_print_variables,
-                               ppt->error_message),
-               ppt->error_message,
-               ppt->error_message);
+    /* on failure (e.g. when the run is aborted), free what was allocated here */
+    class_call_except(generic_evolver(perturbations_derivs,
+                                      interval_limit[index_interval],
+                                      interval_limit[index_interval+1],
+                                      ppw->pv->y,
+                                      ppw->pv->used_in_sources,
+                                      ppw->pv->pt_size,
+                                      &ppaw,
+                                      ppr->tol_perturbations_integration,
+                                      ppr->smallest_allowed_variation,
+                                      perturbations_timescale,
+                                      ppr->perturbations_integration_stepsize,
+                                      ppt->tau_sampling,
+                                      tau_actual_size,
+                                      perturbations_sources,
+                                      perhaps_print_variables,
+                                      ppr,
+                                      ppt->error_message),
+                      ppt->error_message,
+                      ppt->error_message,
+                      perturbations_vector_free(ppw->pv);
+                      for (index_interval=0; index_interval<interval_number; index_interval++) free(interval_approx[index_interval]);
+                      free(interval_approx);
+                      free(interval_limit));
 
   }
 
@@ -3738,6 +4225,12 @@ int perturbations_find_approximation_switches(
               fprintf(stdout,"Mode k=%e: will switch on ncdm fluid approximation at tau=%e\n",k,interval_limit[index_switch]);
             }
           }
+          if (ppr->hierarchy_truncation_approximation != hta_none) {
+            if ((interval_approx[index_switch-1][ppw->index_ap_hta]==(int)hta_on) &&
+                (interval_approx[index_switch][ppw->index_ap_hta]==(int)hta_off)) {
+              fprintf(stdout,"Mode k=%e: will switch off hierarchy truncation approximation at tau=%e\n",k,interval_limit[index_switch]);
+            }
+          }
         }
 
         if (_tensors_) {
@@ -3837,6 +4330,7 @@ int perturbations_vector_init(
   int l;
   int n_ncdm,index_q,ncdm_l_size;
   double rho_plus_p_ncdm,q,q2,epsilon,a,factor;
+  int index_pt_old,l_max_hta;
 
   /** - allocate a new perturbations_vector structure to which ppw-->pv will point at the end of the routine */
 
@@ -3883,13 +4377,21 @@ int perturbations_vector_init(
                  "ppr->l_max_idr should be at least 4, i.e. we must integrate at least over interacting dark radiation density, velocity, shear, third and fourth momentum");
     }
 
+    /* while the hierarchy truncation approximation is on, the photon,
+       ur and ncdm hierarchies stop at l_max_hta (or at their usual
+       l_max if it is smaller) */
+
+    l_max_hta = ppw->max_l_max;
+    if ((ppr->hierarchy_truncation_approximation != hta_none) && (ppw->approx[ppw->index_ap_hta] == (int)hta_on))
+      l_max_hta = ppr->l_max_hta;
+
     /* photons */
 
     if (ppw->approx[ppw->index_ap_rsa] == (int)rsa_off) { /* if radiation streaming approximation is off */
 
       /* temperature */
 
-      ppv->l_max_g = ppr->l_max_g;
+      ppv->l_max_g = MIN(ppr->l_max_g,l_max_hta);
 
       class_define_index(ppv->index_pt_delta_g,_TRUE_,index_pt,1); /* photon density */
       class_define_index(ppv->index_pt_theta_g,_TRUE_,index_pt,1); /* photon velocity */
@@ -3901,7 +4403,7 @@ int perturbations_vector_init(
 
         /* polarization */
 
-        ppv->l_max_pol_g = ppr->l_max_pol_g;
+        ppv->l_max_pol_g = MIN(ppr->l_max_pol_g,l_max_hta);
 
         class_define_index(ppv->index_pt_pol0_g,_TRUE_,index_pt,1);
         class_define_index(ppv->index_pt_pol1_g,_TRUE_,index_pt,1);
@@ -3965,7 +4467,7 @@ int perturbations_vector_init(
       class_define_index(ppv->index_pt_shear_ur,_TRUE_,index_pt,1); /* shear of ultra-relativistic neutrinos/relics */
 
       if (ppw->approx[ppw->index_ap_ufa] == (int)ufa_off) {
-        ppv->l_max_ur = ppr->l_max_ur;
+        ppv->l_max_ur = MIN(ppr->l_max_ur,l_max_hta);
         class_define_index(ppv->index_pt_l3_ur,_TRUE_,index_pt,ppv->l_max_ur-2); /* additional momenta in Boltzmann hierarchy (beyond l=0,1,2,3) */
       }
     }
@@ -4003,7 +4505,7 @@ int perturbations_vector_init(
                      ppt->error_message,
                      "ppr->l_max_ncdm=%d should be at least 4, i.e. we must integrate at least over first four momenta of non-cold dark matter perturbed phase-space distribution",n_ncdm);
           //Copy value from precision parameter:
-          ppv->l_max_ncdm[n_ncdm] = ppr->l_max_ncdm;
+          ppv->l_max_ncdm[n_ncdm] = MIN(ppr->l_max_ncdm,l_max_hta);
           ppv->q_size_ncdm[n_ncdm] = pba->q_size_ncdm[n_ncdm];
         }
         else{
@@ -5057,6 +5559,132 @@ int perturbations_vector_init(
           }
         }
       }
+
+      /* -- case of switching off the hierarchy truncation
+         approximation. Copy all multipoles integrated so far; the new
+         ones beyond the former truncation start from zero, since the
+         switching time is chosen such that they are negligible */
+
+      if (ppr->hierarchy_truncation_approximation != hta_none) {
+
+        if ((pa_old[ppw->index_ap_hta] == (int)hta_on) && (ppw->approx[ppw->index_ap_hta] == (int)hta_off)) {
+
+          if (ppt->perturbations_verbose>2)
+            fprintf(stdout,"Mode k=%e: switch off hierarchy truncation approximation at tau=%e\n",k,tau);
+
+          if (ppw->approx[ppw->index_ap_rsa] == (int)rsa_off) {
+
+            ppv->y[ppv->index_pt_delta_g] =
+              ppw->pv->y[ppw->pv->index_pt_delta_g];
+
+            ppv->y[ppv->index_pt_theta_g] =
+              ppw->pv->y[ppw->pv->index_pt_theta_g];
+          }
+
+          if ((ppw->approx[ppw->index_ap_tca] == (int)tca_off) && (ppw->approx[ppw->index_ap_rsa] == (int)rsa_off)) {
+
+            ppv->y[ppv->index_pt_shear_g] =
+              ppw->pv->y[ppw->pv->index_pt_shear_g];
+
+            ppv->y[ppv->index_pt_l3_g] =
+              ppw->pv->y[ppw->pv->index_pt_l3_g];
+
+            for (l = 4; l <= ppw->pv->l_max_g; l++) {
+
+              ppv->y[ppv->index_pt_delta_g+l] =
+                ppw->pv->y[ppw->pv->index_pt_delta_g+l];
+            }
+
+            ppv->y[ppv->index_pt_pol0_g] =
+              ppw->pv->y[ppw->pv->index_pt_pol0_g];
+
+            ppv->y[ppv->index_pt_pol1_g] =
+              ppw->pv->y[ppw->pv->index_pt_pol1_g];
+
+            ppv->y[ppv->index_pt_pol2_g] =
+              ppw->pv->y[ppw->pv->index_pt_pol2_g];
+
+            ppv->y[ppv->index_pt_pol3_g] =
+              ppw->pv->y[ppw->pv->index_pt_pol3_g];
+
+            for (l = 4; l <= ppw->pv->l_max_pol_g; l++) {
+
+              ppv->y[ppv->index_pt_pol0_g+l] =
+                ppw->pv->y[ppw->pv->index_pt_pol0_g+l];
+            }
+
+          }
+
+          if (pba->has_ur == _TRUE_) {
+
+            if (ppw->approx[ppw->index_ap_rsa] == (int)rsa_off) {
+
+              ppv->y[ppv->index_pt_delta_ur] =
+                ppw->pv->y[ppw->pv->index_pt_delta_ur];
+
+              ppv->y[ppv->index_pt_theta_ur] =
+                ppw->pv->y[ppw->pv->index_pt_theta_ur];
+
+              ppv->y[ppv->index_pt_shear_ur] =
+                ppw->pv->y[ppw->pv->index_pt_shear_ur];
+
+              if (ppw->approx[ppw->index_ap_ufa] == (int)ufa_off) {
+
+                ppv->y[ppv->index_pt_l3_ur] =
+                  ppw->pv->y[ppw->pv->index_pt_l3_ur];
+
+                for (l=4; l <= ppw->pv->l_max_ur; l++)
+                  ppv->y[ppv->index_pt_delta_ur+l] =
+                    ppw->pv->y[ppw->pv->index_pt_delta_ur+l];
+
+              }
+            }
+          }
+
+          if (pba->has_idr == _TRUE_){
+            if (ppw->approx[ppw->index_ap_rsa_idr] == (int)rsa_idr_off){
+
+              ppv->y[ppv->index_pt_delta_idr] =
+                ppw->pv->y[ppw->pv->index_pt_delta_idr];
+
+              ppv->y[ppv->index_pt_theta_idr] =
+                ppw->pv->y[ppw->pv->index_pt_theta_idr];
+
+              if (ppt->idr_nature == idr_free_streaming){
+
+                if (ppw->approx[ppw->index_ap_tca_idm_dr] == (int)tca_idm_dr_off){
+
+                  ppv->y[ppv->index_pt_shear_idr] =
+                    ppw->pv->y[ppw->pv->index_pt_shear_idr];
+
+                  ppv->y[ppv->index_pt_l3_idr] =
+                    ppw->pv->y[ppw->pv->index_pt_l3_idr];
+
+                  for (l=4; l <= ppv->l_max_idr; l++)
+                    ppv->y[ppv->index_pt_delta_idr+l] =
+                      ppw->pv->y[ppw->pv->index_pt_delta_idr+l];
+                }
+              }
+            }
+          }
+
+          /* the ncdm hierarchies have a different length in the old
+             and new vectors, so they are walked through separately */
+          if (pba->has_ncdm == _TRUE_) {
+            index_pt = ppv->index_pt_psi0_ncdm1;
+            index_pt_old = ppw->pv->index_pt_psi0_ncdm1;
+            for (n_ncdm = 0; n_ncdm < ppv->N_ncdm; n_ncdm++){
+              for (index_q=0; index_q < ppv->q_size_ncdm[n_ncdm]; index_q++){
+                for (l=0; l<=ppw->pv->l_max_ncdm[n_ncdm]; l++){
+                  ppv->y[index_pt+l] = ppw->pv->y[index_pt_old+l];
+                }
+                index_pt += ppv->l_max_ncdm[n_ncdm]+1;
+                index_pt_old += ppw->pv->l_max_ncdm[n_ncdm]+1;
+              }
+            }
+          }
+        }
+      }
     }
 
     /** - --> (b) for the vector mode */
@@ -5281,12 +5909,13 @@ int perturbations_initial_conditions(struct precision * ppr,
   double w_fld,dw_over_da_fld,integral_fld;
   double delta_ur=0.,theta_ur=0.,shear_ur=0.,l3_ur=0.,eta=0.,delta_cdm=0.,alpha, alpha_prime;
   double delta_dr=0;
+  double delta_cold;
   double q,epsilon,k2;
   int index_q,n_ncdm,idx;
   double rho_r,rho_m,rho_nu,rho_m_over_rho_r, rho_cdm =0.;
   double fracnu,fracg,fracb,fraccdm = 0.,fracidm = 0.;
   double om;
-  double ktau_two,ktau_three;
+  double ktau_two,ktau_three,ktau_four;
   double f_dr;
 
   double delta_tot;
@@ -5396,6 +6025,7 @@ int perturbations_initial_conditions(struct precision * ppr,
     /* (k tau)^2, (k tau)^3 */
     ktau_two=k*k*tau*tau;
     ktau_three=k*tau*ktau_two;
+    ktau_four=ktau_two*ktau_two;
 
 
     /* curvature-dependent factors */
@@ -5410,14 +6040,25 @@ int perturbations_initial_conditions(struct precision * ppr,
 
     if ((ppt->has_ad == _TRUE_) && (index_ic == ppt->index_ic_ad)) {
 
-      /* The following formulas are valid at leading order in
-         (k*tau) and (om*tau), and order zero in
+      /* The leading terms in the following formulas are valid at
+         leading order in (k*tau) and (om*tau), and order zero in
          tight-coupling. Identical to first order terms in CRS,
          except for normalization (when ppr->curvature_ini=1, tau=1:
          leads to factor 1/2 difference between CRS formulas with
          beta1=0). Identical to CAMB when om set to zero in theta_g,
          theta_ur, shear_ur, tau
 
+         The series has been pushed to the next orders, (om*tau)^2
+         and (k*tau)^2 x [1, om*tau], using the exact solution a
+         ~ tau (1+om*tau/4) for radiation and matter. With these
+         terms the initial conditions remain accurate when the
+         integration starts later, closer to horizon crossing or to
+         radiation/matter equality (see the precision parameters
+         start_small_k_at_tau_c_over_tau_h and
+         start_large_k_at_tau_h_over_tau_k). The curvature factors
+         of the next-to-leading (k*tau)^2 terms are approximated by
+         those of the leading terms.
+
          In the non-flat case the relation R=eta is still valid
          outside the horizon for adiabatic IC. Hence eta is still
          set to ppr->curvature_ini at leading order.  Factors s2
@@ -5425,19 +6066,36 @@ int perturbations_initial_conditions(struct precision * ppr,
          equations of motion. */
 
       /* photon density */
-      ppw->pv->y[ppw->pv->index_pt_delta_g] = - ktau_two/3. * (1.-om*tau/5.)
+      ppw->pv->y[ppw->pv->index_pt_delta_g] = - ktau_two/3. * (1.-om*tau/5.+om*om*tau*tau/16.)
+        * ppr->curvature_ini * s2_squared
+        + ktau_four/27.*((2.*fracnu+5.)/(4.*fracnu+15.)
+                         +3.*(8.*fracb*fracnu*fracnu*fracnu-30.*fracb*fracnu*fracnu-1125.*fracb*fracnu-3375.*fracb
+                              +72.*fracnu*fracnu*fracnu+838.*fracnu*fracnu+465.*fracnu-1375.)/280./(1.-fracnu)/(2.*fracnu+15.)/(4.*fracnu+15.)*om*tau)
         * ppr->curvature_ini * s2_squared;
 
       /* photon velocity */
-      ppw->pv->y[ppw->pv->index_pt_theta_g] = - k*ktau_three/36. * (1.-3.*(1.+5.*fracb-fracnu)/20./(1.-fracnu)*om*tau)
+      ppw->pv->y[ppw->pv->index_pt_theta_g] = - k*ktau_three/36. * (1.-3.*(1.+5.*fracb-fracnu)/20./(1.-fracnu)*om*tau
+                                                                     +3.*(15.*fracb*fracb-2.*fracb*(1.-fracnu)+(1.-fracnu)*(1.-fracnu))/80./(1.-fracnu)/(1.-fracnu)*om*om*tau*tau)
+        * ppr->curvature_ini * s2_squared
+        + k*ktau_three*ktau_two/540.*((2.*fracnu+5.)/(4.*fracnu+15.)
+                                +(8.*fracb*fracnu*fracnu*fracnu-366.*fracb*fracnu*fracnu-4485.*fracb*fracnu-9675.*fracb
+                                  +72.*fracnu*fracnu*fracnu+838.*fracnu*fracnu+465.*fracnu-1375.)/112./(1.-fracnu)/(2.*fracnu+15.)/(4.*fracnu+15.)*om*tau)
         * ppr->curvature_ini * s2_squared;
 
       /* tighly-coupled baryons */
       ppw->pv->y[ppw->pv->index_pt_delta_b] = 3./4.*ppw->pv->y[ppw->pv->index_pt_delta_g]; /* baryon density */
       ppw->pv->y[ppw->pv->index_pt_theta_b] = ppw->pv->y[ppw->pv->index_pt_theta_g]; /* baryon velocity */
 
+      /* cold species without velocity in the synchronous gauge: same as
+         3/4 delta_g at order (k*tau)^2, but not at order (k*tau)^4 */
+      delta_cold = - ktau_two/4. * (1.-om*tau/5.+om*om*tau*tau/16.)
+        * ppr->curvature_ini * s2_squared
+        + ktau_four/144.*(4.*fracnu+5.)/(4.*fracnu+15.)
+        * (1.-(40.*fracb*fracnu*fracnu+450.*fracb*fracnu+1125.*fracb+248.*fracnu*fracnu+3290.*fracnu+3725.)*3./350./(4.*fracnu+5.)/(2.*fracnu+15.)*om*tau)
+        * ppr->curvature_ini * s2_squared;
+
       if (pba->has_cdm == _TRUE_) {
-        ppw->pv->y[ppw->pv->index_pt_delta_cdm] = 3./4.*ppw->pv->y[ppw->pv->index_pt_delta_g]; /* cdm density */
+        ppw->pv->y[ppw->pv->index_pt_delta_cdm] = delta_cold; /* cdm density */
         /* cdm velocity vanishes in the synchronous gauge */
       }
 
@@ -5448,7 +6106,7 @@ int perturbations_initial_conditions(struct precision * ppr,
       }
 
       if (pba->has_dcdm == _TRUE_) {
-        ppw->pv->y[ppw->pv->index_pt_delta_dcdm] = 3./4.*ppw->pv->y[ppw->pv->index_pt_delta_g]; /* dcdm density */
+        ppw->pv->y[ppw->pv->index_pt_delta_dcdm] = delta_cold; /* dcdm density */
         /* dcdm velocity velocity vanishes initially in the synchronous gauge */
 
       }
@@ -5489,14 +6147,31 @@ int perturbations_initial_conditions(struct precision * ppr,
 
       if ((pba->has_ur == _TRUE_) || (pba->has_ncdm == _TRUE_) || (pba->has_dr == _TRUE_) || (pba->has_idr == _TRUE_)) {
 
-        delta_ur = ppw->pv->y[ppw->pv->index_pt_delta_g]; /* density of ultra-relativistic neutrinos/relics */
+        /* density of ultra-relativistic neutrinos/relics: same as delta_g except at order (k*tau)^4 */
+        delta_ur = - ktau_two/3. * (1.-om*tau/5.+om*om*tau*tau/16.)
+          * ppr->curvature_ini * s2_squared
+          + ktau_four/27.*((2.*fracnu+7.)/(4.*fracnu+15.)
+                           -3.*(8.*fracb*fracnu*fracnu+90.*fracb*fracnu+225.*fracb+72.*fracnu*fracnu+798.*fracnu+1515.)/280./(2.*fracnu+15.)/(4.*fracnu+15.)*om*tau)
+          * ppr->curvature_ini * s2_squared;
 
         /* velocity of ultra-relativistic neutrinos/relics */ //TBC
-        theta_ur = - k*ktau_three/36./(4.*fracnu+15.) * (4.*fracnu+11.+12.*s2_squared-3.*(8.*fracnu*fracnu+50.*fracnu+275.)/20./(2.*fracnu+15.)*tau*om) * ppr->curvature_ini * s2_squared;
-
-        shear_ur = ktau_two/(45.+12.*fracnu) * (3.*s2_squared-1.) * (1.+(4.*fracnu-5.)/4./(2.*fracnu+15.)*tau*om) * ppr->curvature_ini;//TBC /s2_squared; /* shear of ultra-relativistic neutrinos/relics */  //TBC:0
-
-        l3_ur = ktau_three*2./7./(12.*fracnu+45.)* ppr->curvature_ini;//TBC
+        theta_ur = - k*ktau_three/36./(4.*fracnu+15.) * (4.*fracnu+11.+12.*s2_squared-3.*(8.*fracnu*fracnu+50.*fracnu+275.)/20./(2.*fracnu+15.)*tau*om
+                                                        +3.*(16.*fracnu*fracnu*fracnu+412.*fracnu*fracnu+1660.*fracnu+6525.)/80./(2.*fracnu+15.)/(2.*fracnu+25.)*tau*tau*om*om) * ppr->curvature_ini * s2_squared
+          + k*ktau_three*ktau_two/3780./(4.*fracnu+15.)
+          * ((28.*fracnu*fracnu+672.*fracnu+2405.)/(2.*fracnu+25.)
+             -(64.*fracb*fracnu*fracnu*fracnu*fracnu+2720.*fracb*fracnu*fracnu*fracnu+39300.*fracb*fracnu*fracnu+225000.*fracb*fracnu+421875.*fracb
+               +576.*fracnu*fracnu*fracnu*fracnu+15424.*fracnu*fracnu*fracnu+273820.*fracnu*fracnu+2000000.*fracnu+4758125.)/16./(2.*fracnu+15.)/(2.*fracnu+25.)/(4.*fracnu+75.)*tau*om)
+          * ppr->curvature_ini * s2_squared;
+
+        shear_ur = ktau_two/(45.+12.*fracnu) * (3.*s2_squared-1.) * (1.+(4.*fracnu-5.)/4./(2.*fracnu+15.)*tau*om+(8.*fracnu*fracnu-260.*fracnu+225.)/32./(2.*fracnu+15.)/(2.*fracnu+25.)*tau*tau*om*om) * ppr->curvature_ini
+          - ktau_four/189./(4.*fracnu+15.)
+          * ((56.*fracnu+295.)/(2.*fracnu+25.)
+             +3.*(448.*fracnu*fracnu*fracnu+3640.*fracnu*fracnu-6250.*fracnu-95875.)/8./(2.*fracnu+15.)/(2.*fracnu+25.)/(4.*fracnu+75.)*tau*om)
+          * ppr->curvature_ini;//TBC /s2_squared; /* shear of ultra-relativistic neutrinos/relics */  //TBC:0
+
+        l3_ur = ktau_three*4./7./(12.*fracnu+45.)
+          * (1.+3.*(4.*fracnu-5.)/16./(2.*fracnu+15.)*tau*om+3.*(8.*fracnu*fracnu-260.*fracnu+225.)/160./(2.*fracnu+15.)/(2.*fracnu+25.)*tau*tau*om*om)
+          * ppr->curvature_ini;
 
         if (pba->has_dr == _TRUE_) delta_dr = delta_ur;
       }
@@ -5504,7 +6179,12 @@ int perturbations_initial_conditions(struct precision * ppr,
       /* synchronous metric perturbation eta */
       //eta = ppr->curvature_ini * (1.-ktau_two/12./(15.+4.*fracnu)*(5.+4.*fracnu - (16.*fracnu*fracnu+280.*fracnu+325)/10./(2.*fracnu+15.)*tau*om)) /  s2_squared;
       //eta = ppr->curvature_ini * s2_squared * (1.-ktau_two/12./(15.+4.*fracnu)*(15.*s2_squared-10.+4.*s2_squared*fracnu - (16.*fracnu*fracnu+280.*fracnu+325)/10./(2.*fracnu+15.)*tau*om));
-      eta = ppr->curvature_ini * (1.-ktau_two/12./(15.+4.*fracnu)*(5.+4.*s2_squared*fracnu - (16.*fracnu*fracnu+280.*fracnu+325)/10./(2.*fracnu+15.)*tau*om));
+      eta = ppr->curvature_ini * (1.-ktau_two/12./(15.+4.*fracnu)*(5.+4.*s2_squared*fracnu - (16.*fracnu*fracnu+280.*fracnu+325)/10./(2.*fracnu+15.)*tau*om
+                                                                   + (4.*fracnu+5.)*(fracnu*fracnu+20.*fracnu+225.)/4./(2.*fracnu+15.)/(2.*fracnu+25.)*tau*tau*om*om)
+                                  + ktau_four/1512./(4.*fracnu+15.)
+                                  * ((56.*fracnu*fracnu+390.*fracnu+175.)/(2.*fracnu+25.)
+                                     -3.*(64.*fracb*fracnu*fracnu*fracnu*fracnu+2720.*fracb*fracnu*fracnu*fracnu+39300.*fracb*fracnu*fracnu+225000.*fracb*fracnu+421875.*fracb
+                                          +576.*fracnu*fracnu*fracnu*fracnu+34720.*fracnu*fracnu*fracnu+411700.*fracnu*fracnu+1550000.*fracnu+696875.)/20./(2.*fracnu+15.)/(2.*fracnu+25.)/(4.*fracnu+75.)*tau*om));
 
     }
 
@@ -6211,6 +6891,17 @@ int perturbations_approximations(
         ppw->approx[ppw->index_ap_ncdmfa] = (int)ncdmfa_off;
       }
     }
+
+    if (ppr->hierarchy_truncation_approximation != hta_none) {
+
+      if (tau/tau_k > ppw->hta_trigger_tau_over_tau_k) {
+
+        ppw->approx[ppw->index_ap_hta] = (int)hta_off;
+      }
+      else {
+        ppw->approx[ppw->index_ap_hta] = (int)hta_on;
+      }
+    }
   }
 
   /** - for tensor modes: */
@@ -7411,30 +8102,31 @@ int perturbations_sources(
   pvecthermo = ppw->pvecthermo;
   pvecmetric = ppw->pvecmetric;
 
-  /** - get background/thermo quantities in this point */
+  /** - get background/thermo quantities in this point, from the
+      table filled once for all wavenumbers in
+      perturbations_timesampling_for_sources(). The k-independent
+      factors of each source type are then simple products of these
+      values, and are not tabulated separately: for a default run
+      with lensed C_l's and P(k), this whole function takes about 6%
+      of the time spent in perturbations_solve(), including the call
+      to perturbations_einstein(), and the assembly of sources less
+      than 2% of the total running time. */
+
+  class_test((index_tau < 0) || (index_tau >= ppt->tau_size) || (tau != ppt->tau_sampling[index_tau]),
+             error_message,
+             "source function requested at tau=%e which is not the sampling point of index %d",tau,index_tau);
 
-  class_call(background_at_tau(pba,
-                               tau,
-                               normal_info,
-                               inter_closeby,
-                               &(ppw->last_index_back),
-                               pvecback),
-             pba->error_message,
-             error_message);
+  memcpy(pvecback,
+         ppt->tau_sampling_pvecback + index_tau*pba->bg_size_normal,
+         pba->bg_size_normal*sizeof(double));
+
+  memcpy(pvecthermo,
+         ppt->tau_sampling_pvecthermo + index_tau*pth->th_size,
+         pth->th_size*sizeof(double));
 
   /* redshift (remember that a in the code stands for (a/a_0)) */
   z = 1./pvecback[pba->index_bg_a]-1.;
 
-  class_call(thermodynamics_at_z(pba,
-                                 pth,
-                                 z,  /* redshift z=1/a-1 */
-                                 inter_closeby,
-                                 &(ppw->last_index_thermo),
-                                 pvecback,
-                                 pvecthermo),
-             pth->error_message,
-             error_message);
-
   a = ppw->pvecback[pba->index_bg_a];
   a2 = a * a;
 
@@ -223,6 +223,13 @@ int primordial_init(
   }
   else{
     k_max = ppt->k_max; /* last value, inferred from perturbations structure */
+    /* the fourier module may extend P(k) analytically beyond the last
+       value of the sources, by steps of 1/k_per_decade_for_pk decade */
+    if (ppt->has_k_max_for_pk_sources == _TRUE_) {
+      k_max = MAX(k_max,ppt->k_max_for_pk*pow(10.,1./ppr->k_per_decade_for_pk));
+      if (ppt->has_nl_corrections_based_on_delta_m == _TRUE_)
+        k_max = MAX(k_max,ppr->nonlinear_min_k_max*pow(10.,1./ppr->k_per_decade_for_pk));
+    }
   }
 
   class_test(k_min <= 0.,
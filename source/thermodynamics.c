@@ -505,6 +505,159 @@ int thermodynamics_free_input(
 
   return _SUCCESS_;
 }
+
+/** BBN table loaded once for the whole process by thermodynamics_load_bbn_table() */
+static struct {
+  FileName file;
+  int num_omegab;
+  int num_deltaN;
+  double * omegab;
+  double * deltaN;
+  double * YHe;
+} thermodynamics_bbn_table = {"",0,0,NULL,NULL,NULL};
+
+/**
+ * Read the table of the primordial helium fraction as a function of
+ * the baryon density and of the effective number of neutrinos.
+ *
+ * @param file           Input: name of the BBN file
+ * @param num_omegab_out Output: number of values of omega_b
+ * @param num_deltaN_out Output: number of values of Delta N_eff
+ * @param omegab_out     Output: values of omega_b (allocated here)
+ * @param deltaN_out     Output: values of Delta N_eff (allocated here)
+ * @param YHe_out        Output: helium fraction, omega_b varying fastest (allocated here)
+ * @param errmsg         Output: error message
+ * @return the error status
+ */
+
+int thermodynamics_read_bbn_table(
+                                  char * file,
+                                  int * num_omegab_out,
+                                  int * num_deltaN_out,
+                                  double ** omegab_out,
+                                  double ** deltaN_out,
+                                  double ** YHe_out,
+                                  ErrorMsg errmsg
+                                  ) {
+
+  FILE * fA;
+  char line[_LINE_LENGTH_MAX_];
+  char * left;
+
+  int num_omegab=0;
+  int num_deltaN=0;
+
+  double * omegab=NULL;
+  double * deltaN=NULL;
+  double * YHe=NULL;
+
+  int array_line=0;
+
+  /* the following file is assumed to contain (apart from comments and blank lines):
+     - the two numbers (num_omegab, num_deltaN) = number of values of BBN free parameters
+     - three columns (omegab, deltaN, YHe) where omegab = Omega0_b h^2 and deltaN = Neff-3.046 by definition
+     - omegab and deltaN are assumed to be arranged as:
+     omegab1 deltaN1 YHe
+     omegab2 deltaN1 YHe
+     .....
+     omegab1 delatN2 YHe
+     omegab2 deltaN2 YHe
+     .....
+  */
+
+  class_open(fA,file, "r",errmsg);
+
+  /* go through each line */
+  while (fgets(line,_LINE_LENGTH_MAX_-1,fA) != NULL) {
+
+    /* eliminate blank spaces at beginning of line */
+    left=line;
+    while (left[0]==' ') {
+      left++;
+    }
+
+    /* check that the line is neither blank neither a comment. In ASCII, left[0]>39 means that first non-blank character might
+       be the beginning of some data (it is not a newline, a #, a %, etc.) */
+    if (left[0] > 39) {
+
+      /* if the line contains data, we must interpret it. If (num_omegab, num_deltaN)=(0,0), the current line must contain
+         their values. Otherwise, it must contain (omegab, delatN, YHe). */
+      if ((num_omegab==0) && (num_deltaN==0)) {
+
+        /* read (num_omegab, num_deltaN), infer size of arrays and allocate them */
+        class_test(sscanf(line,"%d %d",&num_omegab,&num_deltaN) != 2,
+                   errmsg,
+                   "could not read value of parameters (num_omegab,num_deltaN) in file %s\n",file);
+
+        class_alloc(omegab,num_omegab*sizeof(double),errmsg);
+        class_alloc(deltaN,num_deltaN*sizeof(double),errmsg);
+        class_alloc(YHe,num_omegab*num_deltaN*sizeof(double),errmsg);
+        array_line=0;
+
+      }
+      else{
+
+        /* read (omegab, deltaN, YHe) */
+        class_test(sscanf(line,"%lg %lg %lg",&(omegab[array_line%num_omegab]),
+                          &(deltaN[array_line/num_omegab]),
+                          &(YHe[array_line])
+                          ) != 3,
+                   errmsg,
+                   "could not read value of parameters (omegab,deltaN,YHe) in file %s\n",file);
+        array_line ++;
+      }
+    }
+  }
+
+  fclose(fA);
+
+  class_test((num_omegab == 0) || (array_line != num_omegab*num_deltaN),
+             errmsg,
+             "found %d values of (omegab,deltaN,YHe) instead of %d in file %s\n",array_line,num_omegab*num_deltaN,file);
+
+  *num_omegab_out = num_omegab;
+  *num_deltaN_out = num_deltaN;
+  *omegab_out = omegab;
+  *deltaN_out = deltaN;
+  *YHe_out = YHe;
+
+  return _SUCCESS_;
+}
+
+/**
+ * Read the BBN table once for the whole process: the following calls
+ * to thermodynamics_helium_from_bbn() with the same file use it
+ * instead of reading the file. This is meant for resident processes
+ * (e.g. before forking workers); the table is never freed.
+ *
+ * @param file   Input: name of the BBN file
+ * @param errmsg Output: error message
+ * @return the error status
+ */
+
+int thermodynamics_load_bbn_table(
+                                  char * file,
+                                  ErrorMsg errmsg
+                                  ) {
+
+  if (thermodynamics_bbn_table.omegab != NULL)
+    return _SUCCESS_;
+
+  class_call(thermodynamics_read_bbn_table(file,
+                                           &(thermodynamics_bbn_table.num_omegab),
+                                           &(thermodynamics_bbn_table.num_deltaN),
+                                           &(thermodynamics_bbn_table.omegab),
+                                           &(thermodynamics_bbn_table.deltaN),
+                                           &(thermodynamics_bbn_table.YHe),
+                                           errmsg),
+             errmsg,
+             errmsg);
+
+  strcpy(thermodynamics_bbn_table.file,file);
+
+  return _SUCCESS_;
+}
+
 /**
  * Infer the primordial helium mass fraction from standard BBN
  * calculations, as a function of the baryon density and expansion
@@ -529,10 +682,6 @@ int thermodynamics_helium_from_bbn(
   /** Summary: */
 
   /** Define local variables */
-  FILE * fA;
-  char line[_LINE_LENGTH_MAX_];
-  char * left;
-
   int num_omegab=0;
   int num_deltaN=0;
 
@@ -543,7 +692,7 @@ int thermodynamics_helium_from_bbn(
   double * YHe_at_deltaN=NULL;
   double * ddYHe_at_deltaN=NULL;
 
-  int array_line=0;
+  int is_preloaded;
   double DeltaNeff;
   double omega_b;
   int last_index;
@@ -578,66 +727,26 @@ int thermodynamics_helium_from_bbn(
    */
   DeltaNeff = Neff_bbn - 3.046;
 
-  /* the following file is assumed to contain (apart from comments and blank lines):
-     - the two numbers (num_omegab, num_deltaN) = number of values of BBN free parameters
-     - three columns (omegab, deltaN, YHe) where omegab = Omega0_b h^2 and deltaN = Neff-3.046 by definition
-     - omegab and deltaN are assumed to be arranged as:
-     omegab1 deltaN1 YHe
-     omegab2 deltaN1 YHe
-     .....
-     omegab1 delatN2 YHe
-     omegab2 deltaN2 YHe
-     .....
-  */
-
-  class_open(fA,ppr->sBBN_file, "r",pth->error_message);
-
-  /* go through each line */
-  while (fgets(line,_LINE_LENGTH_MAX_-1,fA) != NULL) {
-
-    /* eliminate blank spaces at beginning of line */
-    left=line;
-    while (left[0]==' ') {
-      left++;
-    }
-
-    /* check that the line is neither blank neither a comment. In ASCII, left[0]>39 means that first non-blank character might
-       be the beginning of some data (it is not a newline, a #, a %, etc.) */
-    if (left[0] > 39) {
-
-      /* if the line contains data, we must interpret it. If (num_omegab, num_deltaN)=(0,0), the current line must contain
-         their values. Otherwise, it must contain (omegab, delatN, YHe). */
-      if ((num_omegab==0) && (num_deltaN==0)) {
-
-        /* read (num_omegab, num_deltaN), infer size of arrays and allocate them */
-        class_test(sscanf(line,"%d %d",&num_omegab,&num_deltaN) != 2,
-                   pth->error_message,
-                   "could not read value of parameters (num_omegab,num_deltaN) in file %s\n",ppr->sBBN_file);
-
-        class_alloc(omegab,num_omegab*sizeof(double),pth->error_message);
-        class_alloc(deltaN,num_deltaN*sizeof(double),pth->error_message);
-        class_alloc(YHe,num_omegab*num_deltaN*sizeof(double),pth->error_message);
-        class_alloc(ddYHe,num_omegab*num_deltaN*sizeof(double),pth->error_message);
-        class_alloc(YHe_at_deltaN,num_omegab*sizeof(double),pth->error_message);
-        class_alloc(ddYHe_at_deltaN,num_omegab*sizeof(double),pth->error_message);
-        array_line=0;
-
-      }
-      else{
+  /** - read the BBN table, unless it was loaded once for the whole process */
+  is_preloaded = ((thermodynamics_bbn_table.omegab != NULL) &&
+                  (strcmp(thermodynamics_bbn_table.file,ppr->sBBN_file) == 0));
 
-        /* read (omegab, deltaN, YHe) */
-        class_test(sscanf(line,"%lg %lg %lg",&(omegab[array_line%num_omegab]),
-                          &(deltaN[array_line/num_omegab]),
-                          &(YHe[array_line])
-                          ) != 3,
-                   pth->error_message,
-                   "could not read value of parameters (omegab,deltaN,YHe) in file %s\n",ppr->sBBN_file);
-        array_line ++;
-      }
-    }
+  if (is_preloaded == _TRUE_) {
+    num_omegab = thermodynamics_bbn_table.num_omegab;
+    num_deltaN = thermodynamics_bbn_table.num_deltaN;
+    omegab = thermodynamics_bbn_table.omegab;
+    deltaN = thermodynamics_bbn_table.deltaN;
+    YHe = thermodynamics_bbn_table.YHe;
+  }
+  else {
+    class_call(thermodynamics_read_bbn_table(ppr->sBBN_file,&num_omegab,&num_deltaN,&omegab,&deltaN,&YHe,pth->error_message),
+               pth->error_message,
+               pth->error_message);
   }
 
-  fclose(fA);
+  class_alloc(ddYHe,num_omegab*num_deltaN*sizeof(double),pth->error_message);
+  class_alloc(YHe_at_deltaN,num_omegab*sizeof(double),pth->error_message);
+  class_alloc(ddYHe_at_deltaN,num_omegab*sizeof(double),pth->error_message);
 
   /** - spline in one dimension (along deltaN) */
   class_call(array_spline_table_lines(deltaN,
@@ -717,9 +826,11 @@ int thermodynamics_helium_from_bbn(
   }
 
   /** - deallocate arrays */
-  free(omegab);
-  free(deltaN);
-  free(YHe);
+  if (is_preloaded == _FALSE_) {
+    free(omegab);
+    free(deltaN);
+    free(YHe);
+  }
   free(ddYHe);
   free(YHe_at_deltaN);
   free(ddYHe_at_deltaN);
@@ -1675,6 +1786,7 @@ int thermodynamics_solve(
                                  pth->tt_size, // size of previous array
                                  thermodynamics_sources, // function for output
                                  NULL, // print variables
+                                 ppr,
                                  pth->error_message),
                  pth->error_message,
                  pth->error_message);
@@ -2301,6 +2413,7 @@ int thermodynamics_reionization_evolve_with_tau(
                              mz_size, // size of previous array
                              thermodynamics_sources, // function for output
                              NULL, // print variables
+                             ppr,
                              pth->error_message),
              pth->error_message,
              pth->error_message);
@@ -2366,6 +2479,7 @@ int thermodynamics_reionization_evolve_with_tau(
                              mz_size, // size of previous array
                              thermodynamics_sources, // function for output
                              NULL, // print variables
+                             ppr,
                              pth->error_message),
              pth->error_message,
              pth->error_message);
@@ -2440,6 +2554,7 @@ int thermodynamics_reionization_evolve_with_tau(
                                mz_size, // size of previous array
                                thermodynamics_sources, // function for output
                                NULL, // print variables
+                               ppr,
                                pth->error_message),
                pth->error_message,
                pth->error_message);
@@ -4406,6 +4521,43 @@ int thermodynamics_output_titles(
   return _SUCCESS_;
 }
 
+/**
+ * Subroutine storing, at one redshift, the leading thermodynamics
+ * output quantities that are not columns of the thermodynamics table
+ * (scale factor, z, conformal time), in the same order as
+ * thermodynamics_output_data()
+ *
+ * @param pba      Input: pointer to background structure
+ * @param pth      Input: pointer to the thermodynamics structure
+ * @param index_z  Input: index of the redshift in the thermodynamics table
+ * @param dataptr  Output: row in which the quantities are stored
+ * @param storeidx Input/Output: index of the next free entry of the row
+ * @return the error status
+ */
+
+int thermodynamics_output_derived_data(
+                                       struct background * pba,
+                                       struct thermodynamics *pth,
+                                       int index_z,
+                                       double *dataptr,
+                                       int *storeidx
+                                       ) {
+
+  double z,tau;
+
+  z = pth->z_table[index_z];
+
+  class_call(background_tau_of_z(pba, z, &tau),
+             pba->error_message,
+             pth->error_message);
+
+  class_store_double(dataptr,1./(1.+z),_TRUE_,(*storeidx));
+  class_store_double(dataptr,z,_TRUE_,(*storeidx));
+  class_store_double(dataptr,tau,_TRUE_,(*storeidx));
+
+  return _SUCCESS_;
+}
+
 /**
  * Output the data for the output into files
  *
@@ -4425,7 +4577,6 @@ int thermodynamics_output_data(
 
   int index_z, storeidx;
   double *dataptr, *pvecthermo;
-  double z,tau;
 
   // pth->number_of_thermodynamics_titles = get_number_of_titles(pth->thermodynamics_titles);
   // pth->size_thermodynamics_data = pth->number_of_thermodynamics_titles*pth->tt_size;
@@ -4434,16 +4585,12 @@ int thermodynamics_output_data(
   for (index_z=0; index_z<pth->tt_size; index_z++) {
     dataptr = data + index_z*number_of_titles;
     pvecthermo = pth->thermodynamics_table+index_z*pth->th_size;
-    z = pth->z_table[index_z];
     storeidx=0;
 
-    class_call(background_tau_of_z(pba, z, &tau),
-               pba->error_message,
+    class_call(thermodynamics_output_derived_data(pba,pth,index_z,dataptr,&storeidx),
+               pth->error_message,
                pth->error_message);
 
-    class_store_double(dataptr,1./(1.+z),_TRUE_,storeidx);
-    class_store_double(dataptr,z,_TRUE_,storeidx);
-    class_store_double(dataptr,tau,_TRUE_,storeidx);
     class_store_double(dataptr,pvecthermo[pth->index_th_xe],_TRUE_,storeidx);
     class_store_double(dataptr,pvecthermo[pth->index_th_dkappa],_TRUE_,storeidx);
     //class_store_double(dataptr,pvecthermo[pth->index_th_ddkappa],_TRUE_,storeidx);
@@ -4488,6 +4635,69 @@ int thermodynamics_output_data(
 
 
 
+/**
+ * Subroutine locating the columns of the thermodynamics output in the
+ * thermodynamics table, in the same order as thermodynamics_output_data().
+ * This allows wrappers to expose these columns without copying them.
+ *
+ * @param pba              Input: pointer to background structure
+ * @param pth              Input: pointer to the thermodynamics structure
+ * @param number_of_titles Input: number of thermodynamics quantities printed at each redshift
+ * @param index_column     Output: for each quantity, its index in pth->thermodynamics_table, or -1 if it is derived from other tables
+ * @return the error status
+ */
+
+int thermodynamics_output_columns(
+                                  struct background * pba,
+                                  struct thermodynamics *pth,
+                                  int number_of_titles,
+                                  int *index_column
+                                  ) {
+
+  int storeidx=0;
+
+  class_store_int(index_column,-1,_TRUE_,storeidx); /* scale factor */
+  class_store_int(index_column,-1,_TRUE_,storeidx); /* z */
+  class_store_int(index_column,-1,_TRUE_,storeidx); /* conformal time */
+  class_store_int(index_column,pth->index_th_xe,_TRUE_,storeidx);
+  class_store_int(index_column,pth->index_th_dkappa,_TRUE_,storeidx);
+  class_store_int(index_column,pth->index_th_exp_m_kappa,_TRUE_,storeidx);
+  class_store_int(index_column,pth->index_th_g,_TRUE_,storeidx);
+  class_store_int(index_column,pth->index_th_Tb,_TRUE_,storeidx);
+  class_store_int(index_column,pth->index_th_dTb,_TRUE_,storeidx);
+  class_store_int(index_column,pth->index_th_wb,_TRUE_,storeidx);
+  class_store_int(index_column,pth->index_th_cb2,_TRUE_,storeidx);
+  if (pba->has_idm == _TRUE_) {
+    class_store_int(index_column,pth->index_th_T_idm,_TRUE_,storeidx);
+    class_store_int(index_column,pth->index_th_c2_idm,_TRUE_,storeidx);
+    if (pth->has_idm_g == _TRUE_) {
+      class_store_int(index_column,pth->index_th_dmu_idm_g,_TRUE_,storeidx);
+      class_store_int(index_column,pth->index_th_ddmu_idm_g,_TRUE_,storeidx);
+    }
+    if (pth->has_idm_b == _TRUE_){
+      class_store_int(index_column,pth->index_th_R_idm_b,_TRUE_,storeidx);
+    }
+    if (pth->has_idm_dr == _TRUE_){
+      class_store_int(index_column,pth->index_th_dmu_idm_dr,_TRUE_,storeidx);
+      class_store_int(index_column,pth->index_th_tau_idm_dr,_TRUE_,storeidx);
+      class_store_int(index_column,pth->index_th_tau_idr,_TRUE_,storeidx);
+      class_store_int(index_column,pth->index_th_g_idm_dr,_TRUE_,storeidx);
+    }
+  }
+  if (pba->has_idr == _TRUE_) {
+    class_store_int(index_column,pth->index_th_T_idr,_TRUE_,storeidx);
+    class_store_int(index_column,pth->index_th_dmu_idr,_TRUE_,storeidx);
+  }
+  class_store_int(index_column,pth->index_th_tau_d,_TRUE_,storeidx);
+  class_store_int(index_column,pth->index_th_r_d,pth->compute_damping_scale,storeidx);
+
+  class_test(storeidx != number_of_titles,
+             pth->error_message,
+             "found %d thermodynamics columns instead of %d",storeidx,number_of_titles);
+
+  return _SUCCESS_;
+}
+
 /**
  * This routine computes the quantities connected to interacting dark
  * matter with photons, baryons & dark radiation (idm), and interacting dark radiation (idr)
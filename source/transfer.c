@@ -129,6 +129,24 @@ int transfer_init(
   /* running index for wavenumbers */
   int index_q;
 
+  /* running index for modes */
+  int index_md;
+
+  /* rank of this process and number of processes */
+  int mpi_rank, mpi_size;
+  double ** mpi_arrays;
+  size_t * mpi_sizes;
+  int number_of_arrays;
+  /* status of the loop over wavenumbers on this process */
+  int status = _SUCCESS_;
+
+  /* checkpoint file, and flags for wavenumbers recovered from it,
+     is_restored[index_q] and is_restored_limber[index_q] */
+  struct checkpoint checkpoint;
+  struct checkpoint * pch = &checkpoint;
+  short * is_restored = NULL;
+  short * is_restored_limber = NULL;
+
   /* conformal time today */
   double tau0;
   /* conformal time at recombination */
@@ -293,12 +311,60 @@ int transfer_init(
                ptr->error_message);
   }
 
+  /** - if the run is distributed over several MPI processes, each
+      of them computes the transfer functions for its share of
+      wavenumbers, and sets the other ones to zero before the sum over
+      processes */
+
+  class_call(class_mpi_rank_and_size(&mpi_rank,&mpi_size),
+             ptr->error_message,
+             ptr->error_message);
+
+  if (mpi_size > 1) {
+    for (index_md = 0; index_md < ptr->md_size; index_md++) {
+      memset(ptr->transfer[index_md],
+             0,
+             ppt->ic_size[index_md] * ptr->tt_size[index_md] * ptr->l_size[index_md] * ptr->q_size * sizeof(double));
+      if (ptr->do_lcmb_full_limber == _TRUE_)
+        memset(ptr->transfer_limber[index_md],
+               0,
+               ppt->ic_size[index_md] * ptr->tt_size[index_md] * ptr->l_size[index_md] * ptr->q_size_limber * sizeof(double));
+    }
+  }
+
+  /** - if checkpointing is requested, recover the transfer functions
+      computed by a previous run with the same input, and open the
+      checkpoint file for appending new ones */
+
+  if (ptr->has_checkpoint == _TRUE_) {
+    class_call(transfer_checkpoint_init(ppt,
+                                        ptr,
+                                        mpi_rank,
+                                        mpi_size,
+                                        pch,
+                                        &is_restored,
+                                        &is_restored_limber),
+               ptr->error_message,
+               ptr->error_message);
+  }
+
   class_setup_parallel();
 
   /** - loop over all wavenumbers (parallelized).*/
   /* For each wavenumber: */
   for (index_q = 0; index_q < MAX(ptr->q_size,ptr->q_size_limber); index_q++) {
- class_run_parallel(with_arguments(pba,pth,ppt,ptr,ppr,index_q,tau_rec,tp_of_tt,sources,sources_spline,tau_size_max,window,tau0,&BIS),
+
+    /* wavenumbers are dealt cyclically to MPI processes */
+    if (index_q % mpi_size != mpi_rank)
+      continue;
+
+    /* wavenumbers recovered from the checkpoint file are not computed again */
+    if ((ptr->has_checkpoint == _TRUE_) &&
+        ((index_q >= (int)ptr->q_size) || (is_restored[index_q] == _TRUE_)) &&
+        ((index_q >= (int)ptr->q_size_limber) || (is_restored_limber[index_q] == _TRUE_)))
+      continue;
+
+ class_run_parallel(with_arguments(pba,pth,ppt,ptr,ppr,index_q,tau_rec,tp_of_tt,sources,sources_spline,tau_size_max,window,tau0,&BIS,pch,is_restored,is_restored_limber),
 
       /* compute the transfer functions in the normal case (not the
          full Limber one) */
@@ -306,6 +372,11 @@ int transfer_init(
       struct transfer_workspace tw;
       struct transfer_workspace * ptw = &tw;
 
+      /* skip the remaining wavenumbers if the run is over its deadline or was cancelled */
+      class_call(class_check_deadline(ppr,ptr->error_message),
+                 ptr->error_message,
+                 ptr->error_message);
+
       class_call(transfer_workspace_init(ptr,
                                          ppr,
                                          ptw,
@@ -318,58 +389,77 @@ int transfer_init(
                  ptr->error_message,
                  ptr->error_message);
 
-      if (index_q < ptr->q_size) {
+      if ((index_q < (int)ptr->q_size) &&
+          ((ptr->has_checkpoint == _FALSE_) || (is_restored[index_q] == _FALSE_))) {
 
         if (ptr->transfer_verbose > 2)
         printf("Compute transfer for wavenumber [%d/%zu]\n",index_q,ptr->q_size-1);
 
         /* Update interpolation structure: */
-        class_call(transfer_update_HIS(ppr,
-                                       ptr,
-                                       ptw,
-                                       index_q,
-                                       tau0),
-                   ptr->error_message,
-                   ptr->error_message);
-
-        class_call(transfer_compute_for_each_q(ppr,
-                                               pba,
-                                               ppt,
-                                               ptr,
-                                               tp_of_tt,
-                                               index_q,
-                                               tau_size_max,
-                                               tau_rec,
-                                               sources,
-                                               sources_spline,
-                                               window,
-                                               ptw,
-                                               _FALSE_),
-                   ptr->error_message,
-                   ptr->error_message);
+        class_call_except(transfer_update_HIS(ppr,
+                                             ptr,
+                                             ptw,
+                                             index_q,
+                                             tau0),
+                          ptr->error_message,
+                          ptr->error_message,
+                          transfer_workspace_free(ptr,ptw));
+
+        class_call_except(transfer_compute_for_each_q(ppr,
+                                                      pba,
+                                                      ppt,
+                                                      ptr,
+                                                      tp_of_tt,
+                                                      index_q,
+                                                      tau_size_max,
+                                                      tau_rec,
+                                                      sources,
+                                                      sources_spline,
+                                                      window,
+                                                      ptw,
+                                                      _FALSE_),
+                          ptr->error_message,
+                          ptr->error_message,
+                          transfer_workspace_free(ptr,ptw));
+
+        if (ptr->has_checkpoint == _TRUE_) {
+          class_call_except(transfer_checkpoint_write(ppt,ptr,pch,index_q,_FALSE_),
+                            ptr->error_message,
+                            ptr->error_message,
+                            transfer_workspace_free(ptr,ptw));
+        }
       }
 
       /* compute the transfer functions in the full Limber case (if
        this case is not needed, ptr->q_size_limber=0 and the
        condition is never met) */
 
-      if (index_q < ptr->q_size_limber) {
+      if ((index_q < (int)ptr->q_size_limber) &&
+          ((ptr->has_checkpoint == _FALSE_) || (is_restored_limber[index_q] == _FALSE_))) {
 
-        class_call(transfer_compute_for_each_q(ppr,
-                                               pba,
-                                               ppt,
-                                               ptr,
-                                               tp_of_tt,
-                                               index_q,
-                                               tau_size_max,
-                                               tau_rec,
-                                               sources,
-                                               sources_spline,
-                                               window,
-                                               ptw,
-                                               _TRUE_),
+        class_call_except(transfer_compute_for_each_q(ppr,
+                                                      pba,
+                                                      ppt,
+                                                      ptr,
+                                                      tp_of_tt,
+                                                      index_q,
+                                                      tau_size_max,
+                                                      tau_rec,
+                                                      sources,
+                                                      sources_spline,
+                                                      window,
+                                                      ptw,
+                                                      _TRUE_),
+                          ptr->error_message,
+                          ptr->error_message,
+                          transfer_workspace_free(ptr,ptw));
+
+        if (ptr->has_checkpoint == _TRUE_) {
+          class_call_except(transfer_checkpoint_write(ppt,ptr,pch,index_q,_TRUE_),
                             ptr->error_message,
-                            ptr->error_message);
+                            ptr->error_message,
+                            transfer_workspace_free(ptr,ptw));
+        }
       }
 
       class_call(transfer_workspace_free(ptr,ptw),
@@ -379,7 +469,73 @@ int transfer_init(
     );
   } /* end of loop over wavenumber */
 
-  class_finish_parallel();
+  class_finish_parallel_status(status);
+
+  /* the records written before a failure are kept for the next run */
+  if (ptr->has_checkpoint == _TRUE_) {
+    if (checkpoint_close(pch,ptr->error_message) == _FAILURE_)
+      status = _FAILURE_;
+    free(is_restored);
+    free(is_restored_limber);
+  }
+
+  /** - stop all MPI processes together if any of them failed (nothing to do without MPI) */
+
+  status = class_mpi_check_status(status,ptr->error_message);
+
+  /** - if the run failed or was aborted, free the local arrays and
+      the partially filled tables, since callers only free complete
+      structures */
+
+  if (status == _FAILURE_) {
+    free(window);
+    transfer_perturbation_sources_spline_free(ppt,ptr,sources_spline);
+    transfer_perturbation_sources_free(ppt,pfo,ptr,sources);
+    transfer_free_source_correspondence(ptr,tp_of_tt);
+    hyperspherical_HIS_free(&BIS,ptr->error_message);
+    transfer_free(ptr);
+    return _FAILURE_;
+  }
+
+  /** - gather the transfer functions computed by all MPI processes (nothing to do without MPI) */
+
+  if (mpi_size > 1) {
+    class_alloc(mpi_arrays,2*ptr->md_size*sizeof(double*),ptr->error_message);
+    class_alloc(mpi_sizes,2*ptr->md_size*sizeof(size_t),ptr->error_message);
+    number_of_arrays = 0;
+    for (index_md = 0; index_md < ptr->md_size; index_md++) {
+      mpi_arrays[number_of_arrays] = ptr->transfer[index_md];
+      mpi_sizes[number_of_arrays] = (size_t)ppt->ic_size[index_md] * ptr->tt_size[index_md] * ptr->l_size[index_md] * ptr->q_size;
+      number_of_arrays++;
+      if (ptr->do_lcmb_full_limber == _TRUE_) {
+        mpi_arrays[number_of_arrays] = ptr->transfer_limber[index_md];
+        mpi_sizes[number_of_arrays] = (size_t)ppt->ic_size[index_md] * ptr->tt_size[index_md] * ptr->l_size[index_md] * ptr->q_size_limber;
+        number_of_arrays++;
+      }
+    }
+    class_call_except(class_mpi_sum(mpi_arrays,mpi_sizes,number_of_arrays,ptr->error_message),
+                      ptr->error_message,
+                      ptr->error_message,
+                      free(mpi_arrays);free(mpi_sizes));
+    free(mpi_arrays);
+    free(mpi_sizes);
+  }
+
+  /** - compute the number count transfer functions handled by the FFTLog engine, if any */
+  if (ppt->has_cl_number_count == _TRUE_) {
+    class_call(transfer_fftlog_nc(ppr,
+                                  pba,
+                                  ppt,
+                                  ptr,
+                                  tp_of_tt,
+                                  tau_rec,
+                                  tau_size_max,
+                                  sources,
+                                  sources_spline,
+                                  window),
+               ptr->error_message,
+               ptr->error_message);
+  }
 
   /** - finally, free arrays allocated outside parallel zone */
   free(window);
@@ -465,6 +621,250 @@ int transfer_free(
 
 }
 
+/**
+ * This routine frees the tables of transfer functions
+ * \f$ \Delta_l(q) \f$, once the harmonic module has used them to
+ * compute the \f$ C_l \f$'s. The sampling in l and q is kept, so
+ * that transfer_free() can still be called at the end of the run.
+ * Front-ends that need the transfer functions afterwards should not
+ * call this function.
+ *
+ * @param ptr Input: pointer to transfer structure
+ * @return the error status
+ */
+
+int transfer_free_transfer_functions(
+                                     struct transfer * ptr
+                                     ) {
+
+  int index_md;
+
+  if ((ptr->has_cls == _FALSE_) || (ptr->is_allocated == _FALSE_))
+    return _SUCCESS_;
+
+  for (index_md = 0; index_md < ptr->md_size; index_md++) {
+    free(ptr->transfer[index_md]);
+    ptr->transfer[index_md] = NULL;
+    if (ptr->do_lcmb_full_limber == _TRUE_) {
+      free(ptr->transfer_limber[index_md]);
+      ptr->transfer_limber[index_md] = NULL;
+    }
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Open the checkpoint file of the transfer module and recover the
+ * transfer functions of all wavenumbers already computed by a
+ * previous run with the same input parameters.
+ *
+ * Each record contains the index of the wavenumber, a flag telling
+ * whether it belongs to the full Limber table, and the transfer
+ * functions of all modes, initial conditions, types and multipoles
+ * for this wavenumber. When the run is distributed over several MPI
+ * processes, each of them uses its own file.
+ *
+ * @param ppt                Input: pointer to perturbation structure
+ * @param ptr                Input/Output: pointer to transfer structure (transfer functions filled for recovered wavenumbers)
+ * @param mpi_rank           Input: rank of this process
+ * @param mpi_size           Input: number of processes
+ * @param pch                Output: checkpoint structure, open for appending new records
+ * @param is_restored        Output: allocated array of flags for the normal table, is_restored[index_q]
+ * @param is_restored_limber Output: allocated array of flags for the full Limber table, is_restored_limber[index_q]
+ * @return the error status
+ */
+
+int transfer_checkpoint_init(
+                             struct perturbations * ppt,
+                             struct transfer * ptr,
+                             int mpi_rank,
+                             int mpi_size,
+                             struct checkpoint * pch,
+                             short ** is_restored,
+                             short ** is_restored_limber
+                             ) {
+
+  FileName filename;
+  int * header;
+  int header_size;
+  int record_doubles=0;
+  int index_md,index_q,index_ic_tt_l,size_ic_tt_l;
+  int ints[2];
+  double * doubles;
+  double * transfer;
+  int has_record;
+  int restored_num=0;
+  int is_limber;
+  size_t q_size;
+
+  /** - describe the size of the transfer arrays in the file header */
+  header_size = 4+3*ptr->md_size;
+  class_alloc(header,header_size*sizeof(int),ptr->error_message);
+  header[0] = mpi_size;
+  header[1] = ptr->md_size;
+  header[2] = (int)ptr->q_size;
+  header[3] = (int)ptr->q_size_limber;
+  for (index_md = 0; index_md < ptr->md_size; index_md++) {
+    header[4+3*index_md] = ppt->ic_size[index_md];
+    header[5+3*index_md] = ptr->tt_size[index_md];
+    header[6+3*index_md] = ptr->l_size[index_md];
+    record_doubles += ppt->ic_size[index_md]*ptr->tt_size[index_md]*ptr->l_size[index_md];
+  }
+
+  if (mpi_size > 1)
+    class_sprintf(filename,"%s_%d",ptr->checkpoint_file,mpi_rank);
+  else
+    class_sprintf(filename,"%s",ptr->checkpoint_file);
+
+  class_call(checkpoint_open(filename,
+                             ptr->checkpoint_hash,
+                             header,
+                             header_size,
+                             2,
+                             record_doubles,
+                             pch,
+                             ptr->error_message),
+             ptr->error_message,
+             ptr->error_message);
+
+  free(header);
+
+  /** - read all complete records */
+  class_calloc(*is_restored,MAX(ptr->q_size,1),sizeof(short),ptr->error_message);
+  class_calloc(*is_restored_limber,MAX(ptr->q_size_limber,1),sizeof(short),ptr->error_message);
+
+  class_alloc(doubles,MAX(record_doubles,1)*sizeof(double),ptr->error_message);
+
+  do {
+    class_call_except(checkpoint_read(pch,ints,doubles,&has_record,ptr->error_message),
+                      ptr->error_message,
+                      ptr->error_message,
+                      transfer_checkpoint_free(ptr,pch,doubles,*is_restored,*is_restored_limber));
+
+    if (has_record == _TRUE_) {
+      index_q = ints[0];
+      is_limber = ints[1];
+
+      class_test_except((is_limber != _FALSE_) && (is_limber != _TRUE_),
+                        ptr->error_message,
+                        transfer_checkpoint_free(ptr,pch,doubles,*is_restored,*is_restored_limber),
+                        "corrupted record in checkpoint file %s",filename);
+
+      q_size = (is_limber == _TRUE_) ? ptr->q_size_limber : ptr->q_size;
+
+      class_test_except((index_q < 0) || (index_q >= (int)q_size),
+                        ptr->error_message,
+                        transfer_checkpoint_free(ptr,pch,doubles,*is_restored,*is_restored_limber),
+                        "corrupted record in checkpoint file %s",filename);
+
+      record_doubles = 0;
+      for (index_md = 0; index_md < ptr->md_size; index_md++) {
+        transfer = (is_limber == _TRUE_) ? ptr->transfer_limber[index_md] : ptr->transfer[index_md];
+        size_ic_tt_l = ppt->ic_size[index_md]*ptr->tt_size[index_md]*ptr->l_size[index_md];
+        for (index_ic_tt_l = 0; index_ic_tt_l < size_ic_tt_l; index_ic_tt_l++)
+          transfer[index_ic_tt_l*q_size+index_q] = doubles[record_doubles+index_ic_tt_l];
+        record_doubles += size_ic_tt_l;
+      }
+
+      if (is_limber == _TRUE_)
+        (*is_restored_limber)[index_q] = _TRUE_;
+      else
+        (*is_restored)[index_q] = _TRUE_;
+      restored_num++;
+    }
+  } while (has_record == _TRUE_);
+
+  free(doubles);
+
+  if ((ptr->transfer_verbose > 0) && (restored_num > 0))
+    printf(" -> recovered transfer functions for %d wavenumbers from checkpoint file %s\n",restored_num,filename);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Close the checkpoint file and free the arrays of
+ * transfer_checkpoint_init(), when the recovery of records failed.
+ *
+ * @param ptr                Input: pointer to transfer structure
+ * @param pch                Input: checkpoint structure
+ * @param doubles            Input: buffer for the doubles of one record
+ * @param is_restored        Input: array of flags for the normal table
+ * @param is_restored_limber Input: array of flags for the full Limber table
+ * @return the error status
+ */
+
+int transfer_checkpoint_free(
+                             struct transfer * ptr,
+                             struct checkpoint * pch,
+                             double * doubles,
+                             short * is_restored,
+                             short * is_restored_limber
+                             ) {
+
+  free(is_restored);
+  free(is_restored_limber);
+  free(doubles);
+
+  class_call(checkpoint_close(pch,ptr->error_message),
+             ptr->error_message,
+             ptr->error_message);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Append the transfer functions of one wavenumber to the checkpoint
+ * file. Called from parallel tasks once transfer_compute_for_each_q()
+ * has filled the transfer functions for this wavenumber.
+ *
+ * @param ppt       Input: pointer to perturbation structure
+ * @param ptr       Input: pointer to transfer structure
+ * @param pch       Input: checkpoint structure
+ * @param index_q   Input: index of wavenumber
+ * @param is_limber Input: does this wavenumber belong to the full Limber table?
+ * @return the error status
+ */
+
+int transfer_checkpoint_write(
+                              struct perturbations * ppt,
+                              struct transfer * ptr,
+                              struct checkpoint * pch,
+                              int index_q,
+                              short is_limber
+                              ) {
+
+  int ints[2];
+  double * doubles;
+  double * transfer;
+  int index_md,index_ic_tt_l,size_ic_tt_l;
+  int index_record=0;
+  size_t q_size;
+
+  ints[0] = index_q;
+  ints[1] = is_limber;
+  q_size = (is_limber == _TRUE_) ? ptr->q_size_limber : ptr->q_size;
+
+  class_alloc(doubles,MAX(pch->record_doubles,1)*sizeof(double),ptr->error_message);
+
+  for (index_md = 0; index_md < ptr->md_size; index_md++) {
+    transfer = (is_limber == _TRUE_) ? ptr->transfer_limber[index_md] : ptr->transfer[index_md];
+    size_ic_tt_l = ppt->ic_size[index_md]*ptr->tt_size[index_md]*ptr->l_size[index_md];
+    for (index_ic_tt_l = 0; index_ic_tt_l < size_ic_tt_l; index_ic_tt_l++)
+      doubles[index_record+index_ic_tt_l] = transfer[index_ic_tt_l*q_size+index_q];
+    index_record += size_ic_tt_l;
+  }
+
+  class_call(checkpoint_write(pch,ints,doubles,ptr->error_message),
+             ptr->error_message,
+             ptr->error_message);
+
+  free(doubles);
+
+  return _SUCCESS_;
+}
+
 /**
  * This routine defines all indices and allocates all tables
  * in the transfer structure
@@ -696,7 +1096,7 @@ int transfer_perturbation_copy_sources_and_nl_corrections(
                   ppt->sources[index_md]
                   [index_ic * ppt->tp_size[index_md] + index_tp]
                   [index_tau * ppt->k_size[index_md] + index_k]
-                  * pfo->nl_corr_density[pfo->index_pk_cb][index_tau * ppt->k_size[index_md] + index_k];
+                  * pfo->nl_corr_density[pfo->index_pk_cb][index_tau * pfo->k_size + index_k];
               }
               else{
                 sources[index_md]
@@ -705,7 +1105,7 @@ int transfer_perturbation_copy_sources_and_nl_corrections(
                   ppt->sources[index_md]
                   [index_ic * ppt->tp_size[index_md] + index_tp]
                   [index_tau * ppt->k_size[index_md] + index_k]
-                  * pfo->nl_corr_density[pfo->index_pk_m][index_tau * ppt->k_size[index_md] + index_k];
+                  * pfo->nl_corr_density[pfo->index_pk_m][index_tau * pfo->k_size + index_k];
               }
             }
           }
@@ -1867,6 +2267,8 @@ int transfer_compute_for_each_q(
 
   short neglect;
 
+  short use_fftlog;
+
   radial_function_type radial_type;
 
   double q,k,k_max;
@@ -1991,6 +2393,23 @@ int transfer_compute_for_each_q(
 
               l = (double)ptr->l[index_l];
 
+              /* transfer functions computed by the FFTLog engine are
+                 filled later by transfer_fftlog_nc() for all wavenumbers at once */
+              if (use_full_limber == _FALSE_) {
+                class_call(transfer_use_fftlog(ppr,
+                                               pba,
+                                               ppt,
+                                               ptr,
+                                               index_md,
+                                               index_tt,
+                                               l,
+                                               &use_fftlog),
+                           ptr->error_message,
+                           ptr->error_message);
+                if (use_fftlog == _TRUE_)
+                  continue;
+              }
+
               /* neglect transfer function when l is much smaller than k*tau0 */
               class_call(transfer_can_be_neglected(ppr,
                                                    ppt,
@@ -3366,6 +3785,407 @@ int transfer_use_limber(
   return _SUCCESS_;
 }
 
+/**
+ * This routine decides whether the transfer function of a given type
+ * and multipole is computed by the FFTLog engine of
+ * transfer_fftlog_nc() instead of the line-of-sight integral or the
+ * Limber approximation.
+ *
+ * This is the case, when requested by the user, for the density,
+ * redshift-space distortion and lensing number count contributions
+ * in flat space, below the multipole at which the Limber
+ * approximation would be used.
+ *
+ * @param ppr        Input: pointer to precision structure
+ * @param pba        Input: pointer to background structure
+ * @param ppt        Input: pointer to perturbation structure
+ * @param ptr        Input: pointer to transfer structure
+ * @param index_md   Input: index of mode
+ * @param index_tt   Input: index of type
+ * @param l          Input: multipole
+ * @param use_fftlog Output: whether the FFTLog engine should be used
+ * @return the error status
+ */
+
+int transfer_use_fftlog(
+                        struct precision * ppr,
+                        struct background * pba,
+                        struct perturbations * ppt,
+                        struct transfer * ptr,
+                        int index_md,
+                        int index_tt,
+                        double l,
+                        short * use_fftlog) {
+
+  *use_fftlog = _FALSE_;
+
+  if ((ppr->transfer_nc_method == nc_fftlog) && (pba->sgnK == 0) && (ppt->selection != dirac) && _scalars_) {
+
+    if (_index_tt_in_range_(ptr->index_tt_density, ppt->selection_num, ppt->has_nc_density) && (l<ppr->l_switch_limber_for_nc_local_over_z*ppt->selection_mean[index_tt-ptr->index_tt_density])) {
+      *use_fftlog = _TRUE_;
+    }
+    if (_index_tt_in_range_(ptr->index_tt_rsd,     ppt->selection_num, ppt->has_nc_rsd) && (l<ppr->l_switch_limber_for_nc_local_over_z*ppt->selection_mean[index_tt-ptr->index_tt_rsd])) {
+      *use_fftlog = _TRUE_;
+    }
+    if (_index_tt_in_range_(ptr->index_tt_nc_lens, ppt->selection_num, ppt->has_nc_lens) && (l<ppr->l_switch_limber_for_nc_los_over_z*ppt->selection_mean[index_tt-ptr->index_tt_nc_lens])) {
+      *use_fftlog = _TRUE_;
+    }
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * This routine computes the number count transfer functions selected
+ * by transfer_use_fftlog(), for all wavenumbers at once, with the
+ * generalised FFTLog method (Fang et al. 2020, arXiv:1911.11947).
+ *
+ * At late times, the perturbation sources of the density, RSD and
+ * lensing contributions are separable, \f$ S(k,\tau) = A(k) B(\tau)
+ * \f$, with \f$ B = D \f$, \f$ f D \f$ and \f$ D/a \f$ respectively,
+ * where D is the growth factor and f the growth rate. The transfer
+ * function is then \f$ \Delta_l(k) = A(k) \int d\tau\, W(\tau)
+ * B(\tau) j_l(k(\tau_0-\tau)) \f$ (with \f$ j_l'' \f$ for RSD), where W is
+ * the window function computed by transfer_precompute_selection(). The
+ * integral is computed for all k with a single FFTLog transform per
+ * multipole, instead of one line-of-sight integral per wavenumber. The
+ * amplitude A(k) is the window-weighted average of the actual
+ * sources divided by B, so that the result coincides with the
+ * line-of-sight integral whenever the sources are separable.
+ *
+ * @param ppr            Input: pointer to precision structure
+ * @param pba            Input: pointer to background structure
+ * @param ppt            Input: pointer to perturbation structure
+ * @param ptr            Input/Output: pointer to transfer structure (result stored there)
+ * @param tp_of_tt       Input: correspondence between perturbation and transfer types
+ * @param tau_rec        Input: recombination time
+ * @param tau_size_max   Input: maximum number of times at which transfer sources are sampled
+ * @param pert_sources        Input: array of perturbation sources
+ * @param pert_sources_spline Input: array of second derivatives of perturbation sources
+ * @param window         Input: window functions for each type and time
+ * @return the error status
+ */
+
+int transfer_fftlog_nc(
+                       struct precision * ppr,
+                       struct background * pba,
+                       struct perturbations * ppt,
+                       struct transfer * ptr,
+                       int ** tp_of_tt,
+                       double tau_rec,
+                       int tau_size_max,
+                       double *** pert_sources,
+                       double *** pert_sources_spline,
+                       double * window
+                       ) {
+
+  int index_md = ppt->index_md_scalars;
+  int index_ic,index_tt,index_q,index_tau,index_l,index_chi;
+  int tau_size=0,last_index=0,chi_size;
+  short use_fftlog,any_fftlog;
+  double tau0,k,k_max,norm,growth,chi_min,chi_max,dlnchi,bias,weight;
+  double * interpolated_sources;
+  double * sources;
+  double * tau0_minus_tau;
+  double * w_trapz;
+  double * pvecback;
+  double * amplitude;
+  double * window_growth;
+  double * chi;
+  double * window_growth_chi;
+  int derivative;
+  radial_function_type radial_type;
+
+  if (ppr->transfer_nc_method != nc_fftlog)
+    return _SUCCESS_;
+
+  tau0 = pba->conformal_age;
+  k_max = ppt->k[index_md][ppt->k_size_cl[index_md]-1];
+
+  class_alloc(interpolated_sources,ppt->tau_size*sizeof(double),ptr->error_message);
+  class_alloc(sources,tau_size_max*sizeof(double),ptr->error_message);
+  class_alloc(tau0_minus_tau,tau_size_max*sizeof(double),ptr->error_message);
+  class_alloc(w_trapz,tau_size_max*sizeof(double),ptr->error_message);
+  class_alloc(window_growth,tau_size_max*sizeof(double),ptr->error_message);
+  class_alloc(pvecback,pba->bg_size*sizeof(double),ptr->error_message);
+  class_alloc(amplitude,ptr->q_size*sizeof(double),ptr->error_message);
+
+  for (index_ic = 0; index_ic < ppt->ic_size[index_md]; index_ic++) {
+
+    for (index_tt = 0; index_tt < ptr->tt_size[index_md]; index_tt++) {
+
+      /** - check whether at least one multipole of this type is computed here */
+
+      any_fftlog = _FALSE_;
+      for (index_l = 0; index_l < ptr->l_size[index_md]; index_l++) {
+        class_call(transfer_use_fftlog(ppr,pba,ppt,ptr,index_md,index_tt,(double)ptr->l[index_l],&use_fftlog),
+                   ptr->error_message,
+                   ptr->error_message);
+        if (use_fftlog == _TRUE_)
+          any_fftlog = _TRUE_;
+      }
+      if (any_fftlog == _FALSE_)
+        continue;
+
+      class_call(transfer_select_radial_function(ppt,ptr,index_md,index_tt,&radial_type),
+                 ptr->error_message,
+                 ptr->error_message);
+
+      if (radial_type == NC_RSD) {
+        derivative = 2;
+        bias = 0.;
+      }
+      else if (_index_tt_in_range_(ptr->index_tt_nc_lens, ppt->selection_num, ppt->has_nc_lens)) {
+        /* the lensing window scales like 1/(tau0-tau) near the observer */
+        derivative = 0;
+        bias = -1.5;
+      }
+      else {
+        derivative = 0;
+        bias = 0.;
+      }
+
+      /** - compute the transfer sources at each wavenumber, and their
+          window-weighted integral (the time sampling does not depend
+          on the wavenumber) */
+
+      for (index_q = 0; index_q < (int)ptr->q_size; index_q++) {
+
+        k = ptr->k[index_md][index_q];
+
+        amplitude[index_q] = 0.;
+
+        if (k > k_max)
+          continue;
+
+        class_call(transfer_interpolate_sources(ppt,
+                                                ptr,
+                                                k,
+                                                index_md,
+                                                index_ic,
+                                                tp_of_tt[index_md][index_tt],
+                                                pert_sources[index_md][index_ic * ppt->tp_size[index_md] + tp_of_tt[index_md][index_tt]],
+                                                pert_sources_spline[index_md][index_ic * ppt->tp_size[index_md] + tp_of_tt[index_md][index_tt]],
+                                                interpolated_sources),
+                   ptr->error_message,
+                   ptr->error_message);
+
+        class_call(transfer_sources(ppr,
+                                    pba,
+                                    ppt,
+                                    ptr,
+                                    interpolated_sources,
+                                    tau_rec,
+                                    k,
+                                    index_md,
+                                    index_tt,
+                                    sources,
+                                    window,
+                                    tau_size_max,
+                                    tau0_minus_tau,
+                                    w_trapz,
+                                    &tau_size),
+                   ptr->error_message,
+                   ptr->error_message);
+
+        class_call(array_trapezoidal_integral(sources,
+                                              tau_size,
+                                              w_trapz,
+                                              &(amplitude[index_q]),
+                                              ptr->error_message),
+                   ptr->error_message,
+                   ptr->error_message);
+      }
+
+      /** - multiply the window function by the time dependence B(tau) of the sources */
+
+      for (index_tau = 0; index_tau < tau_size; index_tau++) {
+
+        class_call(background_at_tau(pba,
+                                     tau0 - tau0_minus_tau[index_tau],
+                                     long_info,
+                                     inter_closeby,
+                                     &last_index,
+                                     pvecback),
+                   pba->error_message,
+                   ptr->error_message);
+
+        growth = pvecback[pba->index_bg_D];
+        if (radial_type == NC_RSD)
+          growth *= pvecback[pba->index_bg_f];
+        if (_index_tt_in_range_(ptr->index_tt_nc_lens, ppt->selection_num, ppt->has_nc_lens))
+          growth /= pvecback[pba->index_bg_a];
+
+        window_growth[index_tau] = window[index_tt*tau_size_max+index_tau]*growth;
+      }
+
+      class_call(array_trapezoidal_integral(window_growth,
+                                            tau_size,
+                                            w_trapz,
+                                            &norm,
+                                            ptr->error_message),
+                 ptr->error_message,
+                 ptr->error_message);
+
+      class_test(norm == 0.,
+                 ptr->error_message,
+                 "window function of type %d vanishes, cannot use FFTLog",index_tt);
+
+      for (index_q = 0; index_q < (int)ptr->q_size; index_q++) {
+        amplitude[index_q] /= norm;
+      }
+
+      /** - define a logarithmic grid in (tau0-tau), covering the
+          support of the window function and such that the
+          reciprocal grid covers all wavenumbers. Its step is a
+          fraction of the smallest logarithmic step of the time
+          sampling of the window. */
+
+      dlnchi = _HUGE_;
+      for (index_tau = 0; index_tau < tau_size-1; index_tau++) {
+        if (tau0_minus_tau[index_tau+1] > 0.)
+          dlnchi = MIN(dlnchi,log(tau0_minus_tau[index_tau]/tau0_minus_tau[index_tau+1]));
+      }
+      class_test(dlnchi == _HUGE_,
+                 ptr->error_message,
+                 "cannot use FFTLog with a window function sampled at less than two times");
+      dlnchi /= ppr->fftlog_nc_sampling;
+
+      chi_max = exp(1.)*MAX(tau0_minus_tau[0],1./ptr->k[index_md][0]);
+      chi_min = exp(-1.)*MIN(1./ptr->k[index_md][ptr->q_size-1],MAX(tau0_minus_tau[tau_size-1],ppr->fftlog_nc_chi_min_over_max*tau0_minus_tau[0]));
+
+      chi_size = 2;
+      while ((chi_size < ppr->fftlog_nc_size_max) && (log(chi_max/chi_min)/(chi_size-1) > dlnchi))
+        chi_size *= 2;
+
+      dlnchi = log(chi_max/chi_min)/(chi_size-1);
+
+      class_alloc(chi,chi_size*sizeof(double),ptr->error_message);
+      class_alloc(window_growth_chi,chi_size*sizeof(double),ptr->error_message);
+
+      /* linear interpolation of the window (sampled in decreasing order of tau0-tau) on the logarithmic grid */
+      index_tau = tau_size-1;
+      for (index_chi = 0; index_chi < chi_size; index_chi++) {
+        chi[index_chi] = chi_min*exp(index_chi*dlnchi);
+        while ((index_tau > 0) && (tau0_minus_tau[index_tau-1] < chi[index_chi]))
+          index_tau--;
+        if ((chi[index_chi] < tau0_minus_tau[tau_size-1]) || (chi[index_chi] > tau0_minus_tau[0]) || (index_tau == 0)) {
+          window_growth_chi[index_chi] = 0.;
+        }
+        else {
+          weight = (chi[index_chi]-tau0_minus_tau[index_tau])/(tau0_minus_tau[index_tau-1]-tau0_minus_tau[index_tau]);
+          window_growth_chi[index_chi] = (1.-weight)*window_growth[index_tau] + weight*window_growth[index_tau-1];
+        }
+      }
+
+      /** - loop over multipoles (parallelised): one FFTLog transform
+          gives the transfer function at all wavenumbers */
+
+      class_setup_parallel();
+
+      for (index_l = 0; index_l < ptr->l_size[index_md]; index_l++) {
+
+        class_run_parallel(=,
+
+          short use_fftlog_l;
+          int index_q_l;
+          int last_index_l=0;
+          double l = (double)ptr->l[index_l];
+          double * y;
+          double * lny;
+          double * F;
+          double * ddF;
+          double F_at_k;
+
+          class_call(transfer_use_fftlog(ppr,pba,ppt,ptr,index_md,index_tt,l,&use_fftlog_l),
+                     ptr->error_message,
+                     ptr->error_message);
+
+          if (use_fftlog_l == _FALSE_)
+            return _SUCCESS_;
+
+          class_alloc(y,chi_size*sizeof(double),ptr->error_message);
+          class_alloc(lny,chi_size*sizeof(double),ptr->error_message);
+          class_alloc(F,chi_size*sizeof(double),ptr->error_message);
+          class_alloc(ddF,chi_size*sizeof(double),ptr->error_message);
+
+          class_call(fftlog_spherical_bessel_transform(chi,
+                                                       window_growth_chi,
+                                                       chi_size,
+                                                       l,
+                                                       derivative,
+                                                       bias,
+                                                       y,
+                                                       F,
+                                                       ptr->error_message),
+                     ptr->error_message,
+                     ptr->error_message);
+
+          for (int index_y = 0; index_y < chi_size; index_y++)
+            lny[index_y] = log(y[index_y]);
+
+          class_call(array_spline_table_lines(lny,
+                                              chi_size,
+                                              F,
+                                              1,
+                                              ddF,
+                                              _SPLINE_NATURAL_,
+                                              ptr->error_message),
+                     ptr->error_message,
+                     ptr->error_message);
+
+          for (index_q_l = 0; index_q_l < (int)ptr->q_size; index_q_l++) {
+
+            F_at_k = 0.;
+
+            if (ptr->k[index_md][index_q_l] <= k_max) {
+              class_call(array_interpolate_spline(lny,
+                                                  chi_size,
+                                                  F,
+                                                  ddF,
+                                                  1,
+                                                  log(ptr->k[index_md][index_q_l]),
+                                                  &last_index_l,
+                                                  &F_at_k,
+                                                  1,
+                                                  ptr->error_message),
+                         ptr->error_message,
+                         ptr->error_message);
+            }
+
+            ptr->transfer[index_md][((index_ic * ptr->tt_size[index_md] + index_tt)
+                                     * ptr->l_size[index_md] + index_l)
+                                    * ptr->q_size + index_q_l]
+              = amplitude[index_q_l]*F_at_k;
+          }
+
+          free(y);
+          free(lny);
+          free(F);
+          free(ddF);
+
+          return _SUCCESS_;
+        );
+      }
+
+      class_finish_parallel();
+
+      free(chi);
+      free(window_growth_chi);
+    }
+  }
+
+  free(interpolated_sources);
+  free(sources);
+  free(tau0_minus_tau);
+  free(w_trapz);
+  free(window_growth);
+  free(pvecback);
+  free(amplitude);
+
+  return _SUCCESS_;
+}
+
 /**
  * This routine computes the transfer functions \f$ \Delta_l^{X} (k) \f$)
  * for each mode, initial condition, type, multipole l and wavenumber k,
@@ -3522,7 +4342,11 @@ int transfer_integrate(
              ptr->error_message,
              ptr->error_message);
 
-  /** - Now we do most of the convolution integral: */
+  /** - Now we do most of the convolution integral. The trapezoidal
+      rule is sufficient here: the time sampling of the sources is set
+      by the sources themselves near recombination, and a rule
+      integrating the Bessel oscillations exactly (Filon) was found to
+      give the same C_l's for any sampling step. */
   class_call(array_trapezoidal_convolution(sources,
                                            radial_function,
                                            index_tau_max+1,
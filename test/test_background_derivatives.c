@@ -0,0 +1,167 @@
+/** @file test_background_derivatives.c
+ *
+ * Check of background_derivatives_at_z(): the derivatives of the
+ * background quantities with respect to each parameter of enum
+ * background_derivatives_parameter must agree with central finite
+ * differences of the values returned for displaced parameters. The
+ * check is done for a flat model (where only the derivative of the
+ * curvature is non-zero) and for an open and a closed one.
+ *
+ * Usage: ./test_background_derivatives
+ */
+
+#include "class.h"
+
+#define _Z_SIZE_ 4          /**< number of redshifts */
+#define _TOLERANCE_ 1.e-4   /**< maximum relative difference between the two derivatives */
+
+/* names of the input parameters matching enum background_derivatives_parameter */
+char * parameter_names[_BGD_PARAMETERS_SIZE_] = {"h","omega_b","omega_cdm","N_ur","Omega_k"};
+char * quantity_names[_BGD_QUANTITIES_SIZE_] = {"H","time","conf_distance","ang_distance","lum_distance","rs","theta"};
+
+/* fiducial values of the parameters, and finite difference steps */
+double fiducial[_BGD_PARAMETERS_SIZE_] = {0.67,0.0224,0.12,3.044,0.};
+double step[_BGD_PARAMETERS_SIZE_] = {1.e-3,1.e-5,1.e-4,1.e-3,1.e-3};
+
+/* Omega_k of the tested models */
+double Omega_k_models[] = {0.,0.01,-0.01};
+
+#define _NUM_MODELS_ (int)(sizeof(Omega_k_models)/sizeof(Omega_k_models[0]))
+
+/* values, and optionally derivatives, of the background quantities for some parameters */
+int compute_quantities(
+                       double * parameters,
+                       double * z,
+                       double * values,
+                       double * derivatives,
+                       ErrorMsg errmsg
+                       ) {
+
+  struct precision pr;        /* for precision parameters */
+  struct background ba;       /* for cosmological background */
+  struct thermodynamics th;           /* for thermodynamics */
+  struct perturbations pt;         /* for source functions */
+  struct transfer tr;        /* for transfer functions */
+  struct primordial pm;       /* for primordial spectra */
+  struct harmonic hr;          /* for output spectra */
+  struct fourier fo;        /* for non-linear spectra */
+  struct lensing le;          /* for lensed spectra */
+  struct distortions sd;      /* for spectral distortions */
+  struct output op;           /* for output files */
+  struct file_content fc;
+  double * buffer = NULL;
+  int index_p;
+
+  class_call(parser_init(&fc,_BGD_PARAMETERS_SIZE_,"",errmsg),
+             errmsg,
+             errmsg);
+
+  for (index_p=0; index_p<_BGD_PARAMETERS_SIZE_; index_p++) {
+    strcpy(fc.name[index_p],parameter_names[index_p]);
+    class_sprintf(fc.value[index_p],"%.20e",parameters[index_p]);
+  }
+
+  class_call(input_read_from_file(&fc,&pr,&ba,&th,&pt,&tr,&pm,&hr,&fo,&le,&sd,&op,errmsg),
+             errmsg,
+             errmsg);
+
+  class_call(parser_free(&fc),
+             errmsg,
+             errmsg);
+
+  class_call(background_init(&pr,&ba),
+             ba.error_message,
+             errmsg);
+
+  if (derivatives == NULL) {
+    class_alloc(buffer,_Z_SIZE_*_BGD_QUANTITIES_SIZE_*_BGD_PARAMETERS_SIZE_*sizeof(double),errmsg);
+    derivatives = buffer;
+  }
+
+  class_call(background_derivatives_at_z(&ba,z,_Z_SIZE_,values,derivatives),
+             ba.error_message,
+             errmsg);
+
+  free(buffer);
+
+  class_call(background_free(&ba),
+             ba.error_message,
+             errmsg);
+
+  return _SUCCESS_;
+}
+
+int main(int argc, char **argv) {
+
+  double z[_Z_SIZE_] = {0.,0.5,2.,1100.};
+  double parameters[_BGD_PARAMETERS_SIZE_];
+  double values[_Z_SIZE_*_BGD_QUANTITIES_SIZE_];
+  double derivatives[_Z_SIZE_*_BGD_QUANTITIES_SIZE_*_BGD_PARAMETERS_SIZE_];
+  double values_plus[_Z_SIZE_*_BGD_QUANTITIES_SIZE_];
+  double values_minus[_Z_SIZE_*_BGD_QUANTITIES_SIZE_];
+  double exact,finite_difference,scale;
+  int index_model,index_p,index_z,index_q,index_q_z;
+  int num_failures = 0;
+  ErrorMsg errmsg;
+
+  for (index_model=0; index_model<_NUM_MODELS_; index_model++) {
+
+    for (index_p=0; index_p<_BGD_PARAMETERS_SIZE_; index_p++)
+      parameters[index_p] = fiducial[index_p];
+    parameters[bgd_Omega_k] = Omega_k_models[index_model];
+
+    if (compute_quantities(parameters,z,values,derivatives,errmsg) == _FAILURE_) {
+      printf("\n\nError for Omega_k=%g\n=>%s\n",Omega_k_models[index_model],errmsg);
+      return _FAILURE_;
+    }
+
+    for (index_p=0; index_p<_BGD_PARAMETERS_SIZE_; index_p++) {
+
+      parameters[index_p] += step[index_p];
+      if (compute_quantities(parameters,z,values_plus,NULL,errmsg) == _FAILURE_) {
+        printf("\n\nError for Omega_k=%g, displaced %s\n=>%s\n",Omega_k_models[index_model],parameter_names[index_p],errmsg);
+        return _FAILURE_;
+      }
+      parameters[index_p] -= 2.*step[index_p];
+      if (compute_quantities(parameters,z,values_minus,NULL,errmsg) == _FAILURE_) {
+        printf("\n\nError for Omega_k=%g, displaced %s\n=>%s\n",Omega_k_models[index_model],parameter_names[index_p],errmsg);
+        return _FAILURE_;
+      }
+      parameters[index_p] += step[index_p];
+
+      for (index_z=0; index_z<_Z_SIZE_; index_z++) {
+        for (index_q=0; index_q<_BGD_QUANTITIES_SIZE_; index_q++) {
+
+          index_q_z = index_z*_BGD_QUANTITIES_SIZE_+index_q;
+
+          /* quantities vanishing at z=0 */
+          if (values[index_q_z] == 0.)
+            continue;
+
+          exact = derivatives[index_q_z*_BGD_PARAMETERS_SIZE_+index_p];
+          finite_difference = (values_plus[index_q_z]-values_minus[index_q_z])/2./step[index_p];
+
+          /* derivatives much smaller than the value over the parameter are compared in absolute terms */
+          scale = MAX(fabs(finite_difference),1.e-3*fabs(values[index_q_z]/MAX(fabs(fiducial[index_p]),0.1)));
+
+          if (fabs(exact-finite_difference) > _TOLERANCE_*scale) {
+            printf("Omega_k=%g, z=%g: d%s/d%s = %e, finite difference %e\n",
+                   Omega_k_models[index_model],z[index_z],quantity_names[index_q],parameter_names[index_p],
+                   exact,finite_difference);
+            num_failures++;
+          }
+        }
+      }
+    }
+  }
+
+  if (num_failures > 0) {
+    printf("%d derivatives differ from the finite differences\n",num_failures);
+    return _FAILURE_;
+  }
+
+  printf("All derivatives agree with the finite differences for %d models\n",_NUM_MODELS_);
+
+  return _SUCCESS_;
+
+}
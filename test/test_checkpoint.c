@@ -0,0 +1,297 @@
+/** @file test_checkpoint.c
+ *
+ * Interruption and restart test of the checkpoint files: a run with a
+ * checkpoint_root is killed while the perturbations are being evolved,
+ * then restarted with the same input. The restarted run must recover
+ * the wavenumbers of the checkpoint file, and give C_l's and P(k)
+ * identical to those of a run without checkpoints. A run with other
+ * parameters sharing the checkpoint root must use its own files.
+ *
+ * Usage: ./test_checkpoint [path/to/class]
+ *
+ * (default: ./class)
+ */
+
+#include "class.h"
+#include <unistd.h>
+#include <dirent.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define _NUM_THREADS_ "2"  /**< number of threads of each run */
+
+char * parameters = "output = tCl,pCl,lCl,mPk\nlensing = yes\nperturbations_verbose = 1\ntransfer_verbose = 1\n";
+
+/**
+ * Write an input file in the test directory.
+ */
+
+int write_input(char * filename, char * root, char * checkpoint_root, char * extra, ErrorMsg errmsg) {
+
+  FILE * file;
+
+  class_open(file,filename,"w",errmsg);
+  fprintf(file,"%sroot = %s\noverwrite_root = yes\n%s",parameters,root,extra);
+  if (checkpoint_root != NULL)
+    fprintf(file,"checkpoint_root = %s\n",checkpoint_root);
+  fclose(file);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Start the class binary on an input file, with its standard output
+ * written to a log file.
+ */
+
+int start_class(char * class_path, char * input, char * log, pid_t * pid, ErrorMsg errmsg) {
+
+  int fd;
+
+  *pid = fork();
+  class_test(*pid < 0,errmsg,"could not fork");
+
+  if (*pid == 0) {
+    fd = open(log,O_WRONLY|O_CREAT|O_TRUNC,0600);
+    if (fd >= 0) {
+      dup2(fd,1);
+      close(fd);
+    }
+    setenv("OMP_NUM_THREADS",_NUM_THREADS_,1);
+    execl(class_path,class_path,input,(char *)NULL);
+    _exit(127);
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Run the class binary until it exits, and check that it succeeded.
+ */
+
+int run_class(char * class_path, char * input, char * log, ErrorMsg errmsg) {
+
+  pid_t pid;
+  int status;
+
+  class_call(start_class(class_path,input,log,&pid,errmsg),errmsg,errmsg);
+  class_test(waitpid(pid,&status,0) != pid,errmsg,"could not wait for class");
+  class_test(!WIFEXITED(status) || (WEXITSTATUS(status) != 0),
+             errmsg,
+             "class failed on %s (see %s)",input,log);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Count the files of a directory whose name starts with a prefix, and
+ * return the size of the last one.
+ */
+
+int find_files(char * directory, char * prefix, int * number, long * size, ErrorMsg errmsg) {
+
+  DIR * dir;
+  struct dirent * entry;
+  struct stat st;
+  char filename[_FILENAMESIZE_];
+
+  dir = opendir(directory);
+  class_test(dir == NULL,errmsg,"could not open directory %s",directory);
+
+  *number = 0;
+  *size = 0;
+  while ((entry = readdir(dir)) != NULL) {
+    if (strncmp(entry->d_name,prefix,strlen(prefix)) == 0) {
+      class_sprintf(filename,"%s/%s",directory,entry->d_name);
+      if (stat(filename,&st) == 0) {
+        (*number)++;
+        *size = st.st_size;
+      }
+    }
+  }
+  closedir(dir);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Find the number of wavenumbers recovered by the perturbation module
+ * in the log of a run.
+ */
+
+int read_recovered(char * log, int * recovered, ErrorMsg errmsg) {
+
+  FILE * file;
+  char line[_LINE_LENGTH_MAX_];
+  char * position;
+
+  *recovered = 0;
+  class_open(file,log,"r",errmsg);
+  while (fgets(line,_LINE_LENGTH_MAX_,file) != NULL) {
+    position = strstr(line,"recovered sources for ");
+    if (position != NULL)
+      sscanf(position+strlen("recovered sources for "),"%d",recovered);
+  }
+  fclose(file);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Compare two output files byte by byte.
+ */
+
+int compare_files(char * filename1, char * filename2, int * is_same, ErrorMsg errmsg) {
+
+  FILE * file1;
+  FILE * file2;
+  int c1,c2;
+
+  class_open(file1,filename1,"r",errmsg);
+  class_open(file2,filename2,"r",errmsg);
+
+  do {
+    c1 = fgetc(file1);
+    c2 = fgetc(file2);
+  } while ((c1 == c2) && (c1 != EOF));
+
+  *is_same = (c1 == c2) ? _TRUE_ : _FALSE_;
+
+  fclose(file1);
+  fclose(file2);
+
+  return _SUCCESS_;
+}
+
+int test_checkpoint(char * class_path, char * directory, int * num_failures, ErrorMsg errmsg) {
+
+  char input[_FILENAMESIZE_];
+  char input_other[_FILENAMESIZE_];
+  char input_ref[_FILENAMESIZE_];
+  char log[_FILENAMESIZE_];
+  char root[_FILENAMESIZE_];
+  char checkpoint_root[_FILENAMESIZE_];
+  char filename1[_FILENAMESIZE_];
+  char filename2[_FILENAMESIZE_];
+  char * suffix[3] = {"cl.dat","cl_lensed.dat","pk.dat"};
+  pid_t pid;
+  int status,number,recovered,is_same,index_file,attempt;
+  long size,size_header;
+
+  class_sprintf(checkpoint_root,"%s/chk_",directory);
+
+  /** - reference run without checkpoint */
+  class_sprintf(input_ref,"%s/ref.ini",directory);
+  class_sprintf(root,"%s/ref",directory);
+  class_call(write_input(input_ref,root,NULL,"",errmsg),errmsg,errmsg);
+  class_sprintf(log,"%s/ref.log",directory);
+  class_call(run_class(class_path,input_ref,log,errmsg),errmsg,errmsg);
+
+  /** - run with checkpoints, killed once some wavenumbers are in the file */
+  class_sprintf(input,"%s/run.ini",directory);
+  class_sprintf(root,"%s/run",directory);
+  class_call(write_input(input,root,checkpoint_root,"",errmsg),errmsg,errmsg);
+  class_sprintf(log,"%s/killed.log",directory);
+  class_call(start_class(class_path,input,log,&pid,errmsg),errmsg,errmsg);
+
+  size_header = -1;
+  for (attempt=0; attempt<100000; attempt++) {
+    class_call(find_files(directory,"chk_perturbations_",&number,&size,errmsg),errmsg,errmsg);
+    if ((number == 1) && (size_header < 0))
+      size_header = size;
+    /* a few records (of about 100 kB each) beyond the header */
+    if ((size_header >= 0) && (size > size_header+500000))
+      break;
+    class_test(waitpid(pid,&status,WNOHANG) == pid,
+               errmsg,
+               "the run finished before it could be interrupted");
+    usleep(1000);
+  }
+  kill(pid,SIGKILL);
+  waitpid(pid,&status,0);
+  printf("Run interrupted with a perturbation checkpoint file of %ld bytes\n",size);
+
+  /** - restarted run */
+  class_sprintf(log,"%s/restarted.log",directory);
+  class_call(run_class(class_path,input,log,errmsg),errmsg,errmsg);
+  class_call(read_recovered(log,&recovered,errmsg),errmsg,errmsg);
+  printf("Restarted run recovered %d wavenumbers\n",recovered);
+  if (recovered == 0) {
+    printf("No wavenumber recovered from the checkpoint file\n");
+    (*num_failures)++;
+  }
+
+  for (index_file=0; index_file<3; index_file++) {
+    class_sprintf(filename1,"%s/ref_%s",directory,suffix[index_file]);
+    class_sprintf(filename2,"%s/run_%s",directory,suffix[index_file]);
+    class_call(compare_files(filename1,filename2,&is_same,errmsg),errmsg,errmsg);
+    if (is_same == _FALSE_) {
+      printf("%s differs from %s\n",filename2,filename1);
+      (*num_failures)++;
+    }
+  }
+
+  /** - run with other parameters and the same checkpoint root: it must
+      not overwrite the files of the first run, which a third run of the
+      latter must recover entirely */
+  class_sprintf(input_other,"%s/other.ini",directory);
+  class_sprintf(root,"%s/other",directory);
+  class_call(write_input(input_other,root,checkpoint_root,"omega_b = 0.0225\n",errmsg),errmsg,errmsg);
+  class_sprintf(log,"%s/other.log",directory);
+  class_call(run_class(class_path,input_other,log,errmsg),errmsg,errmsg);
+
+  class_call(find_files(directory,"chk_perturbations_",&number,&size,errmsg),errmsg,errmsg);
+  if (number != 2) {
+    printf("%d perturbation checkpoint files instead of 2\n",number);
+    (*num_failures)++;
+  }
+
+  class_sprintf(log,"%s/third.log",directory);
+  class_call(run_class(class_path,input,log,errmsg),errmsg,errmsg);
+  class_call(read_recovered(log,&recovered,errmsg),errmsg,errmsg);
+  printf("Third run recovered %d wavenumbers\n",recovered);
+  if (recovered == 0) {
+    printf("The checkpoint file was overwritten by a run with other parameters\n");
+    (*num_failures)++;
+  }
+
+  return _SUCCESS_;
+}
+
+int main(int argc, char **argv) {
+
+  char * class_path = "./class";
+  char directory[_FILENAMESIZE_];
+  char command[2*_FILENAMESIZE_];
+  ErrorMsg errmsg;
+  int num_failures = 0;
+
+  if (argc > 1)
+    class_path = argv[1];
+
+  class_sprintf(directory,"/tmp/test_checkpoint.%d",(int)getpid());
+  if (mkdir(directory,0700) != 0) {
+    printf("Cannot create directory %s\n",directory);
+    return _FAILURE_;
+  }
+
+  if (test_checkpoint(class_path,directory,&num_failures,errmsg) == _FAILURE_) {
+    printf("\n\nError in test_checkpoint\n=>%s\n",errmsg);
+    return _FAILURE_;
+  }
+
+  class_sprintf(command,"rm -rf %s",directory);
+  if (system(command) != 0)
+    printf("Could not remove %s\n",directory);
+
+  if (num_failures > 0) {
+    printf("%d check(s) failed\n",num_failures);
+    return _FAILURE_;
+  }
+
+  printf("Interrupted run restarted from its checkpoint files with identical results\n");
+
+  return _SUCCESS_;
+}
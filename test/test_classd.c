@@ -0,0 +1,387 @@
+/** @file test_classd.c
+ *
+ * Round-trip test of classd: a resident service is started on a local
+ * socket, a sequence of requests is sent to it, and the C_l's and P(k)
+ * of each reply must be bit-identical to those of the same cosmology
+ * computed in this process. A request with a wrong parameter must be
+ * answered with an error, without stopping the service.
+ *
+ * Usage: ./test_classd [path/to/classd]
+ *
+ * (default: ./classd, built by 'make test_classd')
+ */
+
+#include "class.h"
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define _NUM_THREADS_ 2  /**< number of threads of the service and of the reference runs */
+
+/* requests sent in this order, and whether they should succeed */
+char * requests[] = {"output = tCl,pCl,lCl,mPk\nlensing = yes\nl_max_scalars = 1000\n",
+                     "output = tCl\nrecombination = nonsense\n",
+                     "output = tCl,pCl,lCl,mPk\nlensing = yes\nl_max_scalars = 1000\nomega_b = 0.0230\nN_ur = 2.5\n",
+                     "output = mPk\nP_k_max_1/Mpc = 2.\nz_pk = 0.,1.\nrecombination = RECFAST\n"};
+int is_valid[] = {_TRUE_,_FALSE_,_TRUE_,_TRUE_};
+
+#define _NUM_REQUESTS_ (int)(sizeof(requests)/sizeof(requests[0]))
+
+/* tables of one reply, or of the reference run, in the layout of the classd blocks */
+struct reply {
+  int num_blocks;
+  char name[4][_ARGUMENT_LENGTH_MAX_];
+  int rows[4];
+  int columns[4];
+  double * data[4];
+};
+
+int transfer_bytes(int fd, void * buffer, size_t size, int is_write) {
+
+  char * pointer = (char *)buffer;
+  ssize_t done;
+
+  while (size > 0) {
+    done = (is_write == _TRUE_) ? write(fd,pointer,size) : read(fd,pointer,size);
+    if (done <= 0)
+      return _FAILURE_;
+    pointer += done;
+    size -= done;
+  }
+
+  return _SUCCESS_;
+}
+
+int read_string(int fd, char * string, int size_max, ErrorMsg errmsg) {
+
+  int length;
+
+  class_test(transfer_bytes(fd,&length,sizeof(int),_FALSE_) == _FAILURE_,
+             errmsg,
+             "could not read string length");
+  class_test((length < 0) || (length >= size_max),
+             errmsg,
+             "string of %d bytes is too long",length);
+  class_test(transfer_bytes(fd,string,length,_FALSE_) == _FAILURE_,
+             errmsg,
+             "could not read string");
+  string[length] = '\0';
+
+  return _SUCCESS_;
+}
+
+void reply_free(struct reply * prep) {
+
+  int index_block;
+
+  for (index_block=0; index_block<prep->num_blocks; index_block++)
+    free(prep->data[index_block]);
+  prep->num_blocks = 0;
+}
+
+/**
+ * Send one request to the service and read its reply.
+ */
+
+int send_request(char * socket_name, char * text, int * status, struct reply * prep, ErrorMsg errmsg) {
+
+  struct sockaddr_un address;
+  char titles[_MAXTITLESTRINGLENGTH_];
+  int fd,length,index_block,attempt;
+
+  memset(&address,0,sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path,socket_name);
+
+  /* the service may still be starting */
+  fd = -1;
+  for (attempt=0; (attempt<100) && (fd < 0); attempt++) {
+    fd = socket(AF_UNIX,SOCK_STREAM,0);
+    class_test(fd < 0,errmsg,"could not create socket");
+    if (connect(fd,(struct sockaddr *)&address,sizeof(address)) != 0) {
+      close(fd);
+      fd = -1;
+      usleep(100000);
+    }
+  }
+  class_test(fd < 0,errmsg,"could not connect to %s",socket_name);
+
+  length = strlen(text);
+  class_test((transfer_bytes(fd,&length,sizeof(int),_TRUE_) == _FAILURE_) ||
+             (transfer_bytes(fd,text,length,_TRUE_) == _FAILURE_) ||
+             (transfer_bytes(fd,status,sizeof(int),_FALSE_) == _FAILURE_),
+             errmsg,
+             "could not send request");
+
+  prep->num_blocks = 0;
+
+  if (*status != 0) {
+    class_call(read_string(fd,errmsg,_ERRORMSGSIZE_,errmsg),errmsg,errmsg);
+    close(fd);
+    return _SUCCESS_;
+  }
+
+  for (index_block=0; ; index_block++) {
+    class_test(index_block == 4,errmsg,"too many blocks in reply");
+    class_call(read_string(fd,prep->name[index_block],_ARGUMENT_LENGTH_MAX_,errmsg),errmsg,errmsg);
+    if (strlen(prep->name[index_block]) == 0)
+      break;
+    class_call(read_string(fd,titles,_MAXTITLESTRINGLENGTH_,errmsg),errmsg,errmsg);
+    class_test((transfer_bytes(fd,&(prep->rows[index_block]),sizeof(int),_FALSE_) == _FAILURE_) ||
+               (transfer_bytes(fd,&(prep->columns[index_block]),sizeof(int),_FALSE_) == _FAILURE_),
+               errmsg,
+               "could not read size of block %s",prep->name[index_block]);
+    class_alloc(prep->data[index_block],(size_t)prep->rows[index_block]*prep->columns[index_block]*sizeof(double),errmsg);
+    prep->num_blocks++;
+    class_test(transfer_bytes(fd,prep->data[index_block],(size_t)prep->rows[index_block]*prep->columns[index_block]*sizeof(double),_FALSE_) == _FAILURE_,
+               errmsg,
+               "could not read block %s",prep->name[index_block]);
+  }
+
+  close(fd);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Compute the same blocks as the service, in this process.
+ */
+
+int compute_reference(char * text, struct reply * prep, ErrorMsg errmsg) {
+
+  struct precision pr;
+  struct background ba;
+  struct thermodynamics th;
+  struct perturbations pt;
+  struct primordial pm;
+  struct fourier fo;
+  struct transfer tr;
+  struct harmonic hr;
+  struct lensing le;
+  struct distortions sd;
+  struct output op;
+  struct file_content fc;
+  char line[_LINE_LENGTH_MAX_];
+  char * copy, * token, * value;
+  double ** cl_md;
+  double ** cl_md_ic;
+  double * data;
+  double * pk;
+  int size,i,index_md,index_l,index_k,index_z,rows,columns;
+
+  /** - pass the parameters of the request through a file_content structure */
+  class_alloc(copy,strlen(text)+1,errmsg);
+  strcpy(copy,text);
+  for (size=0, token=copy; *token != '\0'; token++)
+    if (*token == '\n')
+      size++;
+
+  class_call(parser_init(&fc,size,"",errmsg),errmsg,errmsg);
+
+  for (i=0, token=strtok(copy,"\n"); token != NULL; i++, token=strtok(NULL,"\n")) {
+    strcpy(line,token);
+    value = strchr(line,'=');
+    *value = '\0';
+    sscanf(line,"%s",fc.name[i]);
+    sscanf(value+1,"%s",fc.value[i]);
+  }
+  free(copy);
+
+  /** - run all modules */
+  class_call(input_read_from_file(&fc,&pr,&ba,&th,&pt,&tr,&pm,&hr,&fo,&le,&sd,&op,errmsg),errmsg,errmsg);
+  class_call(parser_free(&fc),errmsg,errmsg);
+
+  class_call(background_init(&pr,&ba),ba.error_message,errmsg);
+  class_call(thermodynamics_init(&pr,&ba,&th),th.error_message,errmsg);
+  class_call(perturbations_init(&pr,&ba,&th,&pt),pt.error_message,errmsg);
+  class_call(primordial_init(&pr,&pt,&pm),pm.error_message,errmsg);
+  class_call(fourier_init(&pr,&ba,&th,&pt,&pm,&fo),fo.error_message,errmsg);
+  class_call(transfer_init(&pr,&ba,&th,&pt,&fo,&tr),tr.error_message,errmsg);
+  class_call(harmonic_init(&pr,&ba,&pt,&pm,&fo,&tr,&hr),hr.error_message,errmsg);
+  class_call(lensing_init(&pr,&pt,&hr,&fo,&le),le.error_message,errmsg);
+
+  /** - store the blocks */
+  prep->num_blocks = 0;
+
+  if (pt.has_cls == _TRUE_) {
+
+    class_alloc(cl_md,hr.md_size*sizeof(double *),errmsg);
+    class_alloc(cl_md_ic,hr.md_size*sizeof(double *),errmsg);
+    for (index_md=0; index_md<hr.md_size; index_md++) {
+      class_alloc(cl_md[index_md],hr.ct_size*sizeof(double),errmsg);
+      class_alloc(cl_md_ic[index_md],hr.ic_ic_size[index_md]*hr.ct_size*sizeof(double),errmsg);
+    }
+
+    rows = hr.l_max_tot-1;
+    columns = hr.ct_size+1;
+    class_alloc(data,rows*columns*sizeof(double),errmsg);
+    for (index_l=0; index_l<rows; index_l++) {
+      data[index_l*columns] = index_l+2;
+      class_call(harmonic_cl_at_l(&hr,index_l+2,data+index_l*columns+1,cl_md,cl_md_ic),hr.error_message,errmsg);
+    }
+    strcpy(prep->name[prep->num_blocks],"cl");
+    prep->rows[prep->num_blocks] = rows;
+    prep->columns[prep->num_blocks] = columns;
+    prep->data[prep->num_blocks++] = data;
+
+    for (index_md=0; index_md<hr.md_size; index_md++) {
+      free(cl_md[index_md]);
+      free(cl_md_ic[index_md]);
+    }
+    free(cl_md);
+    free(cl_md_ic);
+
+    if (le.has_lensed_cls == _TRUE_) {
+      rows = le.l_lensed_max-1;
+      columns = le.lt_size+1;
+      class_alloc(data,rows*columns*sizeof(double),errmsg);
+      for (index_l=0; index_l<rows; index_l++) {
+        data[index_l*columns] = index_l+2;
+        class_call(lensing_cl_at_l(&le,index_l+2,data+index_l*columns+1),le.error_message,errmsg);
+      }
+      strcpy(prep->name[prep->num_blocks],"cl_lensed");
+      prep->rows[prep->num_blocks] = rows;
+      prep->columns[prep->num_blocks] = columns;
+      prep->data[prep->num_blocks++] = data;
+    }
+  }
+
+  if (pt.has_pk_matter == _TRUE_) {
+    rows = fo.k_size;
+    columns = op.z_pk_num+1;
+    class_alloc(data,rows*columns*sizeof(double),errmsg);
+    class_alloc(pk,fo.k_size*sizeof(double),errmsg);
+    for (index_k=0; index_k<rows; index_k++)
+      data[index_k*columns] = fo.k[index_k];
+    for (index_z=0; index_z<op.z_pk_num; index_z++) {
+      class_call(fourier_pk_at_z(&ba,&fo,linear,pk_linear,op.z_pk[index_z],fo.index_pk_m,pk,NULL),
+                 fo.error_message,
+                 errmsg);
+      for (index_k=0; index_k<rows; index_k++)
+        data[index_k*columns+index_z+1] = pk[index_k];
+    }
+    free(pk);
+    strcpy(prep->name[prep->num_blocks],"pk");
+    prep->rows[prep->num_blocks] = rows;
+    prep->columns[prep->num_blocks] = columns;
+    prep->data[prep->num_blocks++] = data;
+  }
+
+  /** - free the structures */
+  class_call(lensing_free(&le),le.error_message,errmsg);
+  class_call(harmonic_free(&hr),hr.error_message,errmsg);
+  class_call(transfer_free(&tr),tr.error_message,errmsg);
+  class_call(fourier_free(&fo),fo.error_message,errmsg);
+  class_call(primordial_free(&pm),pm.error_message,errmsg);
+  class_call(perturbations_free(&pt),pt.error_message,errmsg);
+  class_call(thermodynamics_free(&th),th.error_message,errmsg);
+  class_call(background_free(&ba),ba.error_message,errmsg);
+
+  return _SUCCESS_;
+}
+
+int main(int argc, char **argv) {
+
+  char * classd = "./classd";
+  char socket_name[64];
+  char threads[16];
+  struct reply reply,reference;
+  ErrorMsg errmsg;
+  int index_request,index_block,status;
+  int num_failures = 0;
+  pid_t pid;
+
+  if (argc > 1)
+    classd = argv[1];
+
+  /** - start the service on a private socket, with the threads of the reference runs */
+  sprintf(socket_name,"/tmp/test_classd.%d",(int)getpid());
+  sprintf(threads,"%d",_NUM_THREADS_);
+  setenv("OMP_NUM_THREADS",threads,1);
+  class_set_num_threads(_NUM_THREADS_);
+
+  pid = fork();
+  if (pid == 0) {
+    execl(classd,classd,socket_name,(char *)NULL);
+    printf("Cannot execute %s\n",classd);
+    _exit(1);
+  }
+  if (pid < 0) {
+    printf("Cannot start %s\n",classd);
+    return _FAILURE_;
+  }
+
+  /** - send the requests one after the other and compare their replies */
+  for (index_request=0; index_request<_NUM_REQUESTS_; index_request++) {
+
+    if (send_request(socket_name,requests[index_request],&status,&reply,errmsg) == _FAILURE_) {
+      printf("request %d: %s\n",index_request,errmsg);
+      reply_free(&reply);
+      num_failures++;
+      break;
+    }
+
+    if (is_valid[index_request] == _FALSE_) {
+      if (status == 0) {
+        printf("request %d: accepted instead of failing\n",index_request);
+        num_failures++;
+      }
+      else {
+        printf("request %d: failed as expected\n",index_request);
+      }
+      reply_free(&reply);
+      continue;
+    }
+
+    if (status != 0) {
+      printf("request %d: error\n=>%s\n",index_request,errmsg);
+      num_failures++;
+      continue;
+    }
+
+    if (compute_reference(requests[index_request],&reference,errmsg) == _FAILURE_) {
+      printf("request %d: error in reference run\n=>%s\n",index_request,errmsg);
+      reply_free(&reply);
+      num_failures++;
+      continue;
+    }
+
+    if (reply.num_blocks != reference.num_blocks) {
+      printf("request %d: %d block(s) instead of %d\n",index_request,reply.num_blocks,reference.num_blocks);
+      num_failures++;
+    }
+
+    for (index_block=0; index_block<reference.num_blocks; index_block++) {
+      if ((index_block >= reply.num_blocks) ||
+          (strcmp(reply.name[index_block],reference.name[index_block]) != 0) ||
+          (reply.rows[index_block] != reference.rows[index_block]) ||
+          (reply.columns[index_block] != reference.columns[index_block]) ||
+          (memcmp(reply.data[index_block],reference.data[index_block],
+                  (size_t)reference.rows[index_block]*reference.columns[index_block]*sizeof(double)) != 0)) {
+        printf("request %d: block %s differs from the reference run\n",index_request,reference.name[index_block]);
+        num_failures++;
+      }
+    }
+
+    printf("request %d: %d block(s) compared\n",index_request,reference.num_blocks);
+
+    reply_free(&reply);
+    reply_free(&reference);
+  }
+
+  /** - stop the service */
+  kill(pid,SIGTERM);
+  waitpid(pid,NULL,0);
+  unlink(socket_name);
+
+  if (num_failures > 0) {
+    printf("%d failure(s)\n",num_failures);
+    return _FAILURE_;
+  }
+
+  printf("All %d requests answered as expected\n",_NUM_REQUESTS_);
+
+  return _SUCCESS_;
+}
@@ -0,0 +1,306 @@
+/** @file test_concurrent_instances.c
+ *
+ * Stress test of the reentrancy of CLASS: several cosmologies are
+ * computed at the same time, each in its own thread of one process,
+ * and their spectra must be bit-identical to those of the same
+ * cosmologies computed one after the other.
+ *
+ * Usage: ./test_concurrent_instances [instances_per_model [threads_per_instance]]
+ *
+ * (default: 2 instances of each of the 8 models, i.e. 16 concurrent
+ * instances, with 2 threads each). To look for data races, compile
+ * CLASS and this test with ThreadSanitizer:
+ *
+ *     make clean; make OPTFLAG="-O1 -g -fsanitize=thread" test_concurrent_instances
+ *     ./test_concurrent_instances
+ */
+
+#include "class.h"
+#include <pthread.h>
+
+#define _L_MAX_ 1500     /**< maximum multipole of the compared C_l's */
+#define _NUM_CT_MAX_ 7   /**< maximum number of C_l types */
+#define _K_SIZE_ 20      /**< number of compared wavenumbers of P(k,z) */
+#define _Z_SIZE_ 3       /**< number of compared redshifts of P(k,z) */
+
+/* parameters common to all models */
+char * common_parameters[] = {"output","tCl,pCl,lCl,mPk",
+                              "lensing","yes",
+                              "l_max_scalars","1500",
+                              "P_k_max_1/Mpc","1.",
+                              "z_max_pk","2.",
+                              NULL};
+
+/* parameters of each model, on top of the common ones */
+char * model_parameters[][9] = {{NULL},
+                                {"N_ncdm","1","m_ncdm","0.06","N_ur","2.0328",NULL},
+                                {"100*theta_s","1.0411",NULL},
+                                {"Omega_Lambda","0.","w0_fld","-0.9","wa_fld","0.1",NULL},
+                                {"Omega_k","0.01",NULL},
+                                {"recombination","RECFAST",NULL},
+                                {"tau_reio","0.06",NULL},
+                                {"non_linear","halofit",NULL}};
+
+#define _NUM_MODELS_ (int)(sizeof(model_parameters)/sizeof(model_parameters[0]))
+
+/* one computation of one model, and its results */
+struct run {
+  int index_model;
+  int num_threads;
+  double * cl;              /* total (lensed) C_l's, [l*_NUM_CT_MAX_+index_ct] */
+  double * pk;              /* linear P(k,z), [index_z*_K_SIZE_+index_k] */
+  int status;
+  ErrorMsg error_message;
+};
+
+int run_model(
+              struct run * prun
+              ) {
+
+  struct precision pr;        /* for precision parameters */
+  struct background ba;       /* for cosmological background */
+  struct thermodynamics th;           /* for thermodynamics */
+  struct perturbations pt;         /* for source functions */
+  struct transfer tr;        /* for transfer functions */
+  struct primordial pm;       /* for primordial spectra */
+  struct harmonic hr;          /* for output spectra */
+  struct fourier fo;        /* for non-linear spectra */
+  struct lensing le;          /* for lensed spectra */
+  struct distortions sd;      /* for spectral distortions */
+  struct output op;           /* for output files */
+  struct file_content fc;
+  char ** parameters;
+  char * errmsg = prun->error_message;
+  int size,i,l,index_k;
+  double k[_K_SIZE_];
+  double z[_Z_SIZE_] = {0.,1.,2.};
+
+  /** - pass the common and model parameters through a private file_content structure */
+  for (size=0; common_parameters[2*size] != NULL; size++)
+    ;
+  parameters = model_parameters[prun->index_model];
+  for (i=0; parameters[2*i] != NULL; i++)
+    ;
+
+  class_call(parser_init(&fc,size+i,"",errmsg),
+             errmsg,
+             errmsg);
+
+  for (i=0; i<fc.size; i++) {
+    parameters = (i < size) ? common_parameters+2*i : model_parameters[prun->index_model]+2*(i-size);
+    strcpy(fc.name[i],parameters[0]);
+    strcpy(fc.value[i],parameters[1]);
+  }
+
+  /** - run all modules */
+  class_call(input_read_from_file(&fc,&pr,&ba,&th,&pt,&tr,&pm,&hr,&fo,&le,&sd,&op,errmsg),
+             errmsg,
+             errmsg);
+
+  class_call(parser_free(&fc),
+             errmsg,
+             errmsg);
+
+  class_call(background_init(&pr,&ba),
+             ba.error_message,
+             errmsg);
+
+  class_call(thermodynamics_init(&pr,&ba,&th),
+             th.error_message,
+             errmsg);
+
+  class_call(perturbations_init(&pr,&ba,&th,&pt),
+             pt.error_message,
+             errmsg);
+
+  class_call(primordial_init(&pr,&pt,&pm),
+             pm.error_message,
+             errmsg);
+
+  class_call(fourier_init(&pr,&ba,&th,&pt,&pm,&fo),
+             fo.error_message,
+             errmsg);
+
+  class_call(transfer_init(&pr,&ba,&th,&pt,&fo,&tr),
+             tr.error_message,
+             errmsg);
+
+  class_call(harmonic_init(&pr,&ba,&pt,&pm,&fo,&tr,&hr),
+             hr.error_message,
+             errmsg);
+
+  class_call(lensing_init(&pr,&pt,&hr,&fo,&le),
+             le.error_message,
+             errmsg);
+
+  /** - store the spectra */
+  for (l=2; l <= _L_MAX_; l++) {
+    class_call(output_total_cl_at_l(&hr,&le,&op,(double)l,prun->cl+l*_NUM_CT_MAX_),
+               hr.error_message,
+               errmsg);
+  }
+
+  for (index_k=0; index_k<_K_SIZE_; index_k++) {
+    k[index_k] = 1.e-4*pow(1.e4,(double)index_k/(double)(_K_SIZE_-1));
+  }
+
+  class_call(fourier_pk_at_kvec_and_zvec(&ba,&pm,&fo,pk_linear,k,_K_SIZE_,z,_Z_SIZE_,fo.index_pk_m,prun->pk),
+             fo.error_message,
+             errmsg);
+
+  /** - free the structures */
+  class_call(lensing_free(&le),
+             le.error_message,
+             errmsg);
+
+  class_call(harmonic_free(&hr),
+             hr.error_message,
+             errmsg);
+
+  class_call(transfer_free(&tr),
+             tr.error_message,
+             errmsg);
+
+  class_call(fourier_free(&fo),
+             fo.error_message,
+             errmsg);
+
+  class_call(primordial_free(&pm),
+             pm.error_message,
+             errmsg);
+
+  class_call(perturbations_free(&pt),
+             pt.error_message,
+             errmsg);
+
+  class_call(thermodynamics_free(&th),
+             th.error_message,
+             errmsg);
+
+  class_call(background_free(&ba),
+             ba.error_message,
+             errmsg);
+
+  return _SUCCESS_;
+
+}
+
+/* each concurrent instance runs in its own thread, with its own number of threads for the parallel loops */
+void * run_thread(void * voidprun) {
+
+  struct run * prun = (struct run *) voidprun;
+
+  class_set_num_threads(prun->num_threads);
+  prun->status = run_model(prun);
+
+  return NULL;
+}
+
+int run_alloc(struct run * prun, int index_model, int num_threads) {
+
+  prun->index_model = index_model;
+  prun->num_threads = num_threads;
+  prun->cl = calloc((_L_MAX_+1)*_NUM_CT_MAX_,sizeof(double));
+  prun->pk = calloc(_Z_SIZE_*_K_SIZE_,sizeof(double));
+
+  return ((prun->cl == NULL) || (prun->pk == NULL)) ? _FAILURE_ : _SUCCESS_;
+}
+
+void run_free(struct run * prun) {
+  free(prun->cl);
+  free(prun->pk);
+}
+
+int main(int argc, char **argv) {
+
+  int instances_per_model = 2;
+  int threads_per_instance = 2;
+  int num_instances,index_model,index_instance;
+  int num_failures = 0;
+  struct run serial[_NUM_MODELS_];
+  struct run * concurrent;
+  pthread_t * threads;
+
+  if (argc > 1)
+    instances_per_model = atoi(argv[1]);
+  if (argc > 2)
+    threads_per_instance = atoi(argv[2]);
+
+  num_instances = instances_per_model*_NUM_MODELS_;
+
+  if ((instances_per_model < 1) || (threads_per_instance < 1)) {
+    printf("Usage: %s [instances_per_model [threads_per_instance]]\n",argv[0]);
+    return _FAILURE_;
+  }
+
+  /** - reference: one model after the other */
+  class_set_num_threads(threads_per_instance);
+
+  for (index_model=0; index_model<_NUM_MODELS_; index_model++) {
+    if (run_alloc(&serial[index_model],index_model,threads_per_instance) == _FAILURE_) {
+      printf("Cannot allocate the results of model %d\n",index_model);
+      return _FAILURE_;
+    }
+    if (run_model(&serial[index_model]) == _FAILURE_) {
+      printf("\n\nError in serial run of model %d\n=>%s\n",index_model,serial[index_model].error_message);
+      return _FAILURE_;
+    }
+  }
+
+  printf("Computed %d models serially\n",_NUM_MODELS_);
+
+  /** - all instances at the same time */
+  concurrent = malloc(num_instances*sizeof(struct run));
+  threads = malloc(num_instances*sizeof(pthread_t));
+
+  for (index_instance=0; index_instance<num_instances; index_instance++) {
+    if (run_alloc(&concurrent[index_instance],index_instance%_NUM_MODELS_,threads_per_instance) == _FAILURE_) {
+      printf("Cannot allocate the results of instance %d\n",index_instance);
+      return _FAILURE_;
+    }
+    if (pthread_create(&threads[index_instance],NULL,run_thread,&concurrent[index_instance]) != 0) {
+      printf("Cannot create the thread of instance %d\n",index_instance);
+      return _FAILURE_;
+    }
+  }
+
+  for (index_instance=0; index_instance<num_instances; index_instance++) {
+    pthread_join(threads[index_instance],NULL);
+  }
+
+  printf("Computed %d instances concurrently, with %d threads each\n",num_instances,threads_per_instance);
+
+  /** - compare the results bit by bit */
+  for (index_instance=0; index_instance<num_instances; index_instance++) {
+
+    struct run * prun = &concurrent[index_instance];
+    struct run * pref = &serial[prun->index_model];
+
+    if (prun->status == _FAILURE_) {
+      printf("instance %d (model %d): error\n=>%s\n",index_instance,prun->index_model,prun->error_message);
+      num_failures++;
+    }
+    else if ((memcmp(prun->cl,pref->cl,(_L_MAX_+1)*_NUM_CT_MAX_*sizeof(double)) != 0) ||
+             (memcmp(prun->pk,pref->pk,_Z_SIZE_*_K_SIZE_*sizeof(double)) != 0)) {
+      printf("instance %d (model %d): results differ from the serial run\n",index_instance,prun->index_model);
+      num_failures++;
+    }
+
+    run_free(prun);
+  }
+
+  for (index_model=0; index_model<_NUM_MODELS_; index_model++)
+    run_free(&serial[index_model]);
+  free(concurrent);
+  free(threads);
+
+  if (num_failures > 0) {
+    printf("%d out of %d instances failed\n",num_failures,num_instances);
+    return _FAILURE_;
+  }
+
+  printf("All %d instances identical to the serial runs\n",num_instances);
+
+  return _SUCCESS_;
+
+}
@@ -0,0 +1,287 @@
+/** @file test_correction.c
+ *
+ * Test of the multi-fidelity correction: the reference and fast runs
+ * of a fiducial model fill a correction file, and a fast run of the
+ * same model corrected by this file must give the C_l's and P(k) of
+ * the reference run. A run with parameters too far from the fiducial
+ * ones, or with an incomplete file, must fail, unless it is given the
+ * reference precision parameters: it must then compute its own
+ * fiducial model and give the C_l's and P(k) of its reference run,
+ * also when some of its parameters are found by shooting.
+ *
+ * Usage: ./test_correction [path/to/class]
+ *
+ * (default: ./class)
+ */
+
+#include "class.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define _TOLERANCE_ 1.e-6  /**< largest difference between corrected and reference spectra, relative to their maximum */
+
+char * parameters = "output = tCl,pCl,mPk\noverwrite_root = yes\n";
+char * reference_precision = "tol_perturbations_integration = 1.e-7\n";
+
+/**
+ * Write an input file in the test directory.
+ */
+
+int write_input(char * filename, char * root, char * extra, ErrorMsg errmsg) {
+
+  FILE * file;
+
+  class_open(file,filename,"w",errmsg);
+  fprintf(file,"%sroot = %s\n%s",parameters,root,extra);
+  fclose(file);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Run the class binary on an input file, with its standard output
+ * written to a log file, and tell whether it succeeded.
+ */
+
+int run_class(char * class_path, char * input, char * log, short * has_succeeded, ErrorMsg errmsg) {
+
+  pid_t pid;
+  int fd,status;
+
+  pid = fork();
+  class_test(pid < 0,errmsg,"could not fork");
+
+  if (pid == 0) {
+    fd = open(log,O_WRONLY|O_CREAT|O_TRUNC,0600);
+    if (fd >= 0) {
+      dup2(fd,1);
+      close(fd);
+    }
+    execl(class_path,class_path,input,(char *)NULL);
+    _exit(127);
+  }
+
+  class_test(waitpid(pid,&status,0) != pid,errmsg,"could not wait for class");
+  class_test(WIFEXITED(status) && (WEXITSTATUS(status) == 127),errmsg,"could not run %s",class_path);
+
+  *has_succeeded = (WIFEXITED(status) && (WEXITSTATUS(status) == 0)) ? _TRUE_ : _FALSE_;
+
+  return _SUCCESS_;
+}
+
+/**
+ * Read the numbers of an output file, skipping comment lines.
+ */
+
+int read_table(char * filename, double ** table, int * size, ErrorMsg errmsg) {
+
+  FILE * file;
+  char line[_LINE_LENGTH_MAX_];
+  char * position;
+  char * end;
+  double value;
+  int size_max = 1000;
+
+  class_open(file,filename,"r",errmsg);
+  class_alloc(*table,size_max*sizeof(double),errmsg);
+  *size = 0;
+
+  while (fgets(line,_LINE_LENGTH_MAX_,file) != NULL) {
+    if (line[0] == '#')
+      continue;
+    for (position = line; ; position = end) {
+      value = strtod(position,&end);
+      if (end == position)
+        break;
+      if (*size == size_max) {
+        size_max *= 2;
+        class_realloc(*table,size_max*sizeof(double),errmsg);
+      }
+      (*table)[(*size)++] = value;
+    }
+  }
+  fclose(file);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Largest difference between the numbers of two output files with
+ * the given number of columns, relative to the largest number of each
+ * column of the first file.
+ */
+
+int compare_files(char * filename1, char * filename2, int columns, double * difference, ErrorMsg errmsg) {
+
+  double * table1;
+  double * table2;
+  int size1,size2,index,index_column;
+  double maximum;
+
+  class_call(read_table(filename1,&table1,&size1,errmsg),errmsg,errmsg);
+  class_call_except(read_table(filename2,&table2,&size2,errmsg),errmsg,errmsg,free(table1));
+
+  class_test_except((size1 != size2) || (size1 % columns != 0),
+                    errmsg,
+                    free(table1);free(table2),
+                    "%s and %s do not have the same number of values",filename1,filename2);
+
+  *difference = 0.;
+  for (index_column=0; index_column<columns; index_column++) {
+    maximum = 0.;
+    for (index=index_column; index<size1; index+=columns)
+      maximum = MAX(maximum,fabs(table1[index]));
+    if (maximum == 0.)
+      continue;
+    for (index=index_column; index<size1; index+=columns)
+      *difference = MAX(*difference,fabs(table2[index]-table1[index])/maximum);
+  }
+
+  free(table1);
+  free(table2);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Compare the C_l's and P(k) of two runs, and count a failure if they
+ * differ (or not) by more than _TOLERANCE_.
+ */
+
+int compare_runs(char * directory, char * root1, char * root2, short should_differ, int * num_failures, ErrorMsg errmsg) {
+
+  char filename1[_FILENAMESIZE_];
+  char filename2[_FILENAMESIZE_];
+  char * suffix[2] = {"cl.dat","pk.dat"};
+  int columns[2] = {5,2};
+  int index_file;
+  double difference;
+
+  for (index_file=0; index_file<2; index_file++) {
+    class_sprintf(filename1,"%s/%s_%s",directory,root1,suffix[index_file]);
+    class_sprintf(filename2,"%s/%s_%s",directory,root2,suffix[index_file]);
+    class_call(compare_files(filename1,filename2,columns[index_file],&difference,errmsg),errmsg,errmsg);
+    printf("%s differs from %s by %e\n",filename2,filename1,difference);
+    if ((difference > _TOLERANCE_) != should_differ) {
+      printf("=> %s\n",(should_differ == _TRUE_) ? "not enough to test the correction" : "too much");
+      (*num_failures)++;
+    }
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Run the class binary on an input file, and count a failure if it
+ * does not succeed (or fail) as expected.
+ */
+
+int check_run(char * class_path, char * directory, char * name, char * extra, short should_succeed, int * num_failures, ErrorMsg errmsg) {
+
+  char input[_FILENAMESIZE_];
+  char root[_FILENAMESIZE_];
+  char log[_FILENAMESIZE_];
+  short has_succeeded;
+
+  class_sprintf(input,"%s/%s.ini",directory,name);
+  class_sprintf(root,"%s/%s",directory,name);
+  class_sprintf(log,"%s/%s.log",directory,name);
+  class_call(write_input(input,root,extra,errmsg),errmsg,errmsg);
+  class_call(run_class(class_path,input,log,&has_succeeded,errmsg),errmsg,errmsg);
+
+  if (has_succeeded != should_succeed) {
+    printf("Run %s %s (see %s)\n",name,(should_succeed == _TRUE_) ? "failed" : "should have failed",log);
+    (*num_failures)++;
+  }
+
+  return _SUCCESS_;
+}
+
+int test_correction(char * class_path, char * directory, int * num_failures, ErrorMsg errmsg) {
+
+  char extra[_LINE_LENGTH_MAX_];
+  char precision_file[_FILENAMESIZE_];
+  char correction_file[_FILENAMESIZE_];
+  FILE * file;
+
+  class_sprintf(precision_file,"%s/reference.pre",directory);
+  class_open(file,precision_file,"w",errmsg);
+  fprintf(file,"%s",reference_precision);
+  fclose(file);
+
+  class_sprintf(correction_file,"%s/fiducial.corr",directory);
+
+  /** - reference and fast runs of the fiducial model */
+  class_sprintf(extra,"h = 0.67\ncorrection_mode = reference\ncorrection_file = %s\n%s",correction_file,reference_precision);
+  class_call(check_run(class_path,directory,"reference",extra,_TRUE_,num_failures,errmsg),errmsg,errmsg);
+  class_sprintf(extra,"h = 0.67\ncorrection_mode = fast\ncorrection_file = %s\n",correction_file);
+  class_call(check_run(class_path,directory,"fast",extra,_TRUE_,num_failures,errmsg),errmsg,errmsg);
+  class_call(compare_runs(directory,"reference","fast",_TRUE_,num_failures,errmsg),errmsg,errmsg);
+
+  /** - corrected fast run of the fiducial model */
+  class_sprintf(extra,"h = 0.67\ncorrection_mode = apply\ncorrection_file = %s\n",correction_file);
+  class_call(check_run(class_path,directory,"corrected",extra,_TRUE_,num_failures,errmsg),errmsg,errmsg);
+  class_call(compare_runs(directory,"reference","corrected",_FALSE_,num_failures,errmsg),errmsg,errmsg);
+
+  /** - runs too far from the fiducial model, or with an incomplete
+      file, without reference precision parameters */
+  class_sprintf(extra,"h = 0.70\ncorrection_mode = apply\ncorrection_file = %s\ncorrection_max_drift = 0.01\n",correction_file);
+  class_call(check_run(class_path,directory,"drifted",extra,_FALSE_,num_failures,errmsg),errmsg,errmsg);
+  class_sprintf(extra,"h = 0.67\ncorrection_mode = apply\ncorrection_file = %s/missing.corr\n",directory);
+  class_call(check_run(class_path,directory,"incomplete",extra,_FALSE_,num_failures,errmsg),errmsg,errmsg);
+
+  /** - run too far from the fiducial model, with reference precision
+      parameters, and the reference run of its model */
+  class_sprintf(extra,"h = 0.70\ncorrection_mode = apply\ncorrection_file = %s\ncorrection_max_drift = 0.01\ncorrection_reference_precision = %s\n",
+                correction_file,precision_file);
+  class_call(check_run(class_path,directory,"refreshed",extra,_TRUE_,num_failures,errmsg),errmsg,errmsg);
+  class_sprintf(extra,"h = 0.70\n%s",reference_precision);
+  class_call(check_run(class_path,directory,"reference_drifted",extra,_TRUE_,num_failures,errmsg),errmsg,errmsg);
+  class_call(compare_runs(directory,"reference_drifted","refreshed",_FALSE_,num_failures,errmsg),errmsg,errmsg);
+
+  /** - run with an incomplete file, with reference precision
+      parameters, and a parameter found by shooting */
+  class_sprintf(extra,"sigma8 = 0.8\ncorrection_mode = apply\ncorrection_file = %s/shooting.corr\ncorrection_reference_precision = %s\n",
+                directory,precision_file);
+  class_call(check_run(class_path,directory,"refreshed_shooting",extra,_TRUE_,num_failures,errmsg),errmsg,errmsg);
+
+  return _SUCCESS_;
+}
+
+int main(int argc, char **argv) {
+
+  char * class_path = "./class";
+  char directory[_FILENAMESIZE_];
+  char command[2*_FILENAMESIZE_];
+  ErrorMsg errmsg;
+  int num_failures = 0;
+
+  if (argc > 1)
+    class_path = argv[1];
+
+  class_sprintf(directory,"/tmp/test_correction.%d",(int)getpid());
+  if (mkdir(directory,0700) != 0) {
+    printf("Cannot create directory %s\n",directory);
+    return _FAILURE_;
+  }
+
+  if (test_correction(class_path,directory,&num_failures,errmsg) == _FAILURE_) {
+    printf("\n\nError in test_correction\n=>%s\n",errmsg);
+    return _FAILURE_;
+  }
+
+  class_sprintf(command,"rm -rf %s",directory);
+  if (system(command) != 0)
+    printf("Could not remove %s\n",directory);
+
+  if (num_failures > 0) {
+    printf("%d check(s) failed\n",num_failures);
+    return _FAILURE_;
+  }
+
+  printf("Corrected spectra identical to the reference ones, drifted and incomplete corrections refused or refreshed\n");
+
+  return _SUCCESS_;
+}
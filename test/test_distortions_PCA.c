@@ -0,0 +1,183 @@
+/** @file test_distortions_PCA.c
+ *
+ * Regression test of the principal component analysis of new spectral
+ * distortions detectors: the branching ratios and distortion shapes
+ * computed by distortions_generate_detector() for a PIXIE-like
+ * detector (30 to 1005 GHz in steps of 15 GHz, noise 5e-26
+ * W/m^2/Hz/sr) must agree, with the same signs, with those stored in
+ * test/distortions/, which were produced by
+ * external/distortions/generate_PCA_files.py with the arguments
+ *
+ *     PCA_reference 3.0e+01 1.005e+03 1.5e+01 65 1.02e+03 5.0e+06 400 5.0e-26 6 \
+ *                   1.9746677806e+06 2.7006382549e-18 5.6790273206e+01
+ *
+ * (the last three are z_th, DI_units and x_to_nu for the default cosmology).
+ *
+ * Each column is compared relative to its largest value.
+ *
+ * Usage: ./test_distortions_PCA [tolerance]
+ *
+ * (default tolerance: 1e-4)
+ */
+
+#include "class.h"
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define _REFERENCE_PATH_ __CLASSDIR__"/test/distortions"
+
+/**
+ * Read one file written by distortions_generate_detector() or
+ * generate_PCA_files.py: a header line with the number of rows and of
+ * principal components, then the rows.
+ */
+
+int read_PCA_file(char * filename, int * rows, int * columns, double ** data, ErrorMsg errmsg) {
+
+  FILE * infile;
+  char line[_LINE_LENGTH_MAX_];
+  int PCA_size,index;
+
+  class_open(infile,filename,"r",errmsg);
+
+  *rows = 0;
+  while (fgets(line,_LINE_LENGTH_MAX_-1,infile) != NULL) {
+    if (line[0] != '#') {
+      class_test(sscanf(line,"%d %d",rows,&PCA_size) != 2,
+                 errmsg,
+                 "could not read header of file '%s'",filename);
+      break;
+    }
+  }
+  class_test(*rows == 0,errmsg,"no data in file '%s'",filename);
+
+  *columns = 4+PCA_size;
+  class_alloc(*data,(*rows)*(*columns)*sizeof(double),errmsg);
+  for (index=0; index<(*rows)*(*columns); index++) {
+    class_test(fscanf(infile,"%le",(*data)+index) != 1,
+               errmsg,
+               "could not read value %d in file '%s'",index,filename);
+  }
+
+  fclose(infile);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Compare a generated file with its reference, column by column.
+ */
+
+int compare_PCA_files(char * filename, char * reference, double tolerance, int * num_failures, ErrorMsg errmsg) {
+
+  double * data;
+  double * data_ref;
+  int rows,columns,rows_ref,columns_ref,index_row,index_column;
+  double scale,difference;
+
+  class_call(read_PCA_file(filename,&rows,&columns,&data,errmsg),errmsg,errmsg);
+  class_call(read_PCA_file(reference,&rows_ref,&columns_ref,&data_ref,errmsg),errmsg,errmsg);
+
+  class_test((rows != rows_ref) || (columns != columns_ref),
+             errmsg,
+             "file '%s' has %d x %d values instead of %d x %d",filename,rows,columns,rows_ref,columns_ref);
+
+  for (index_column=0; index_column<columns; index_column++) {
+    scale = 0.;
+    difference = 0.;
+    for (index_row=0; index_row<rows; index_row++) {
+      scale = MAX(scale,fabs(data_ref[index_row*columns+index_column]));
+      difference = MAX(difference,fabs(data[index_row*columns+index_column]-data_ref[index_row*columns+index_column]));
+    }
+    if (difference > tolerance*scale) {
+      printf("%s, column %d: relative difference %e\n",filename,index_column+1,difference/scale);
+      (*num_failures)++;
+    }
+  }
+
+  free(data);
+  free(data_ref);
+
+  return _SUCCESS_;
+}
+
+int main(int argc, char **argv) {
+
+  struct precision pr;
+  struct distortions sd;
+  ErrorMsg errmsg;
+  char directory[_FILENAMESIZE_];
+  char Greens_file[_FILENAMESIZE_];
+  char filename[_FILENAMESIZE_];
+  char reference[_FILENAMESIZE_];
+  char * suffix[2] = {"branching_ratios","distortions_shapes"};
+  double tolerance = 1.e-4;
+  int index_file;
+  int num_failures = 0;
+
+  if (argc > 1)
+    tolerance = atof(argv[1]);
+
+  /** - generate the detector in a private directory, next to the Green's function of CLASS */
+  input_default_precisions(&pr);
+  pr.sd_z_min = 1.02e3;
+  pr.sd_z_max = 5.0e6;
+  pr.sd_z_size = 400;
+
+  class_sprintf(directory,"/tmp/test_distortions_PCA.%d",(int)getpid());
+  class_sprintf(Greens_file,"%s/Greens_data.dat",pr.sd_external_path);
+  if (mkdir(directory,0700) != 0) {
+    printf("Cannot create directory %s\n",directory);
+    return _FAILURE_;
+  }
+  strcpy(pr.sd_external_path,directory);
+  class_sprintf(filename,"%s/Greens_data.dat",directory);
+  if (symlink(Greens_file,filename) != 0) {
+    printf("Cannot link %s\n",Greens_file);
+    return _FAILURE_;
+  }
+
+  memset(&sd,0,sizeof(struct distortions));
+  sd.distortions_verbose = 0;
+  strcpy(sd.sd_detector_name,"PCA_reference");
+  class_sprintf(sd.sd_detector_list_file,"%s/detectors_list.dat",directory);
+  sd.has_detector_file = _FALSE_;
+  sd.sd_detector_nu_min = 30.;
+  sd.sd_detector_nu_max = 1005.;
+  sd.sd_detector_nu_delta = 15.;
+  sd.sd_detector_bin_number = 65;
+  sd.sd_detector_delta_Ic = 5.e-26;
+  sd.z_th = 1.9746677806e+06;
+  sd.DI_units = 2.7006382549e-18;
+  sd.x_to_nu = 5.6790273206e+01;
+
+  if (distortions_generate_detector(&pr,&sd) == _FAILURE_) {
+    printf("\n\nError in distortions_generate_detector\n=>%s\n",sd.error_message);
+    return _FAILURE_;
+  }
+
+  /** - compare with the files of generate_PCA_files.py */
+  for (index_file=0; index_file<2; index_file++) {
+    class_sprintf(filename,"%s/PCA_reference_%s.dat",directory,suffix[index_file]);
+    class_sprintf(reference,"%s/PCA_reference_%s.dat",_REFERENCE_PATH_,suffix[index_file]);
+    if (compare_PCA_files(filename,reference,tolerance,&num_failures,errmsg) == _FAILURE_) {
+      printf("\n\nError comparing %s\n=>%s\n",filename,errmsg);
+      return _FAILURE_;
+    }
+    unlink(filename);
+  }
+
+  unlink(sd.sd_detector_list_file);
+  class_sprintf(filename,"%s/Greens_data.dat",directory);
+  unlink(filename);
+  rmdir(directory);
+
+  if (num_failures > 0) {
+    printf("%d column(s) differ from the reference by more than %e\n",num_failures,tolerance);
+    return _FAILURE_;
+  }
+
+  printf("Principal components agree with generate_PCA_files.py to better than %e\n",tolerance);
+
+  return _SUCCESS_;
+}
@@ -0,0 +1,154 @@
+/** @file test_fftlog.c
+ *
+ * Regression test of fftlog_spherical_bessel_transform() against the
+ * analytic transforms of a Gaussian,
+ *
+ *     int_0^infty dx x^(l+2) e^(-x^2/2) j_l(xy) = sqrt(pi/2) y^l e^(-y^2/2) = G(y)
+ *
+ * and, for the second derivative of the Bessel function,
+ *
+ *     int_0^infty dx x^(l+4) e^(-x^2/2) j_l''(xy) = G''(y).
+ *
+ * Each case is run with several biases, including one close to the
+ * lower end of the range of convergence, for which the Gamma functions
+ * are evaluated with the reflection formula. The latter is also checked
+ * directly against the recurrence ln Gamma(z+1) = ln Gamma(z) + ln z.
+ *
+ * Usage: ./test_fftlog [tolerance]
+ *
+ * (default tolerance: 1e-6, relative to the maximum of |G| or |G''|,
+ * and for the Gamma function)
+ */
+
+#include "common.h"
+#include "fftlog.h"
+
+#define _N_FFTLOG_ 1024
+
+/**
+ * Check ln Gamma(z) for Re(z) < 1/2 (reflection formula) against
+ * ln Gamma(z+1) - ln z, and return the largest difference of
+ * Gamma(z+1)/Gamma(z)/z with one (the imaginary parts are defined up
+ * to multiples of 2 pi).
+ */
+
+int test_fftlog_reflection(double * error, ErrorMsg errmsg) {
+
+  double re_list[4] = {-0.45,-0.1,0.2,0.45};
+  double im_list[4] = {0.,0.7,-5.,80.};
+  double lng_re,lng_im,lng1_re,lng1_im,d_re,d_im;
+  int i,j;
+
+  *error = 0.;
+
+  for (i=0; i<4; i++) {
+    for (j=0; j<4; j++) {
+      class_call(fftlog_lngamma(re_list[i],im_list[j],&lng_re,&lng_im,errmsg),errmsg,errmsg);
+      class_call(fftlog_lngamma(re_list[i]+1.,im_list[j],&lng1_re,&lng1_im,errmsg),errmsg,errmsg);
+      /* ln Gamma(z+1) - ln Gamma(z) - ln z, which should be 0 modulo 2 i pi */
+      d_re = lng1_re - lng_re - 0.5*log(re_list[i]*re_list[i]+im_list[j]*im_list[j]);
+      d_im = lng1_im - lng_im - atan2(im_list[j],re_list[i]);
+      *error = MAX(*error,sqrt(pow(exp(d_re)*cos(d_im)-1.,2)+pow(exp(d_re)*sin(d_im),2)));
+    }
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Run one transform and return the largest difference with the
+ * analytic result, relative to the largest value of the latter, over
+ * 0.1 < y < 5.
+ */
+
+int test_fftlog_gaussian(double l, int derivative, double bias, double * error, ErrorMsg errmsg) {
+
+  double x[_N_FFTLOG_],f[_N_FFTLOG_],y[_N_FFTLOG_],F[_N_FFTLOG_];
+  double exact,scale=0.,difference=0.;
+  int n;
+
+  for (n=0; n<_N_FFTLOG_; n++) {
+    x[n] = 1.e-4*pow(1.e16,(double)n/(_N_FFTLOG_-1));
+    f[n] = exp((l+2.+derivative)*log(x[n])-0.5*x[n]*x[n]);
+  }
+
+  class_call(fftlog_spherical_bessel_transform(x,f,_N_FFTLOG_,l,derivative,bias,y,F,errmsg),
+             errmsg,
+             errmsg);
+
+  for (n=0; n<_N_FFTLOG_; n++) {
+    if ((y[n] > 0.1) && (y[n] < 5.)) {
+      exact = sqrt(_PI_/2.)*exp(-0.5*y[n]*y[n]);
+      if (derivative == 0)
+        exact *= pow(y[n],l);
+      else
+        exact *= l*(l-1.)*pow(y[n],l-2.) - (2.*l+1.)*pow(y[n],l) + pow(y[n],l+2.);
+      scale = MAX(scale,fabs(exact));
+      /* written such that a NaN result is counted as a failure */
+      if (!(fabs(F[n]-exact) <= difference))
+        difference = (isnan(F[n]) ? F[n] : fabs(F[n]-exact));
+    }
+  }
+
+  *error = difference/scale;
+
+  return _SUCCESS_;
+}
+
+int main(int argc, char **argv) {
+
+  ErrorMsg errmsg;
+  double tolerance = 1.e-6;
+  double l_list[3] = {2.,10.,50.};
+  double bias_list[3];
+  double l,error;
+  int index_l,index_bias,derivative;
+  int num_failures = 0;
+
+  if (argc > 1)
+    tolerance = atof(argv[1]);
+
+  if (test_fftlog_reflection(&error,errmsg) == _FAILURE_) {
+    printf("\n\nError in fftlog_lngamma\n=>%s\n",errmsg);
+    return _FAILURE_;
+  }
+
+  printf("ln Gamma(z) for Re(z)<1/2: relative error %e\n",error);
+
+  if (!(error <= tolerance))
+    num_failures++;
+
+  for (derivative=0; derivative<=2; derivative+=2) {
+    for (index_l=0; index_l<3; index_l++) {
+
+      l = l_list[index_l];
+
+      /* the range of convergence is -l-1 < bias < 1 for j_l and 1-l < bias < 1 for j_l'' */
+      bias_list[0] = 0.;
+      bias_list[1] = -0.25*l;
+      bias_list[2] = -l-0.1+derivative;
+
+      for (index_bias=0; index_bias<3; index_bias++) {
+
+        if (test_fftlog_gaussian(l,derivative,bias_list[index_bias],&error,errmsg) == _FAILURE_) {
+          printf("\n\nError in fftlog_spherical_bessel_transform\n=>%s\n",errmsg);
+          return _FAILURE_;
+        }
+
+        printf("l=%g, derivative %d, bias %g: relative error %e\n",l,derivative,bias_list[index_bias],error);
+
+        if (!(error <= tolerance))
+          num_failures++;
+      }
+    }
+  }
+
+  if (num_failures > 0) {
+    printf("%d transform(s) differ from the analytic result by more than %e\n",num_failures,tolerance);
+    return _FAILURE_;
+  }
+
+  printf("All transforms agree with the analytic results to better than %e\n",tolerance);
+
+  return _SUCCESS_;
+}
@@ -0,0 +1,213 @@
+/**
+ * Module with tools for checkpoint files
+ *
+ * Completed pieces of a long computation are appended to a binary
+ * file, and recovered by a restarted run with the same input.
+ */
+
+#include "checkpoint.h"
+#include <mutex>
+
+#define _CHECKPOINT_MAGIC_ "CLASSCHK" /**< first bytes of any checkpoint file */
+
+/**
+ * Update a 64-bit FNV-1a hash with the characters of a string.
+ *
+ * @param hash   Input: current value of the hash (14695981039346656037 to start a new one)
+ * @param string Input: string to be hashed
+ * @return the updated hash
+ */
+
+unsigned long long checkpoint_hash(
+                                   unsigned long long hash,
+                                   const char * string
+                                   ) {
+
+  for (; *string != '\0'; string++) {
+    hash ^= (unsigned char)(*string);
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+}
+
+/**
+ * Open a checkpoint file. If the file exists and its header matches
+ * the arguments, it is positioned on the first record, to be read by
+ * checkpoint_read(). Otherwise, a new file is created with the
+ * relevant header.
+ *
+ * @param filename       Input: name of the file
+ * @param hash           Input: hash of the input parameters
+ * @param header         Input: array of integers describing the sizes of the computation
+ * @param header_size    Input: size of the previous array
+ * @param record_ints    Input: number of integers in each record
+ * @param record_doubles Input: number of doubles in each record
+ * @param pch            Output: checkpoint structure
+ * @param error_message  Output: error message
+ * @return the error status
+ */
+
+int checkpoint_open(
+                    char * filename,
+                    unsigned long long hash,
+                    int * header,
+                    int header_size,
+                    int record_ints,
+                    int record_doubles,
+                    struct checkpoint * pch,
+                    ErrorMsg error_message
+                    ) {
+
+  char magic[sizeof(_CHECKPOINT_MAGIC_)];
+  unsigned long long file_hash;
+  int * file_header;
+  int file_sizes[3];
+  int index;
+  short is_matching = _FALSE_;
+
+  pch->record_ints = record_ints;
+  pch->record_doubles = record_doubles;
+
+  class_alloc(file_header,MAX(header_size,1)*sizeof(int),error_message);
+
+  /** - check whether an existing file belongs to the same run */
+  pch->file = fopen(filename,"r+b");
+
+  if (pch->file != NULL) {
+
+    if ((fread(magic,sizeof(char),sizeof(magic),pch->file) == sizeof(magic)) &&
+        (strncmp(magic,_CHECKPOINT_MAGIC_,sizeof(magic)) == 0) &&
+        (fread(&file_hash,sizeof(unsigned long long),1,pch->file) == 1) &&
+        (file_hash == hash) &&
+        (fread(file_sizes,sizeof(int),3,pch->file) == 3) &&
+        (file_sizes[0] == header_size) &&
+        (file_sizes[1] == record_ints) &&
+        (file_sizes[2] == record_doubles) &&
+        (fread(file_header,sizeof(int),header_size,pch->file) == (size_t)header_size)) {
+
+      is_matching = _TRUE_;
+      for (index=0; index<header_size; index++) {
+        if (file_header[index] != header[index])
+          is_matching = _FALSE_;
+      }
+    }
+
+    if (is_matching == _FALSE_)
+      fclose(pch->file);
+  }
+
+  free(file_header);
+
+  /** - otherwise, start a new file */
+  if (is_matching == _FALSE_) {
+
+    class_open(pch->file,filename,"w+b",error_message);
+
+    file_sizes[0] = header_size;
+    file_sizes[1] = record_ints;
+    file_sizes[2] = record_doubles;
+
+    class_test_except((fwrite(_CHECKPOINT_MAGIC_,sizeof(char),sizeof(magic),pch->file) != sizeof(magic)) ||
+                      (fwrite(&hash,sizeof(unsigned long long),1,pch->file) != 1) ||
+                      (fwrite(file_sizes,sizeof(int),3,pch->file) != 3) ||
+                      (fwrite(header,sizeof(int),header_size,pch->file) != (size_t)header_size),
+                      error_message,
+                      fclose(pch->file),
+                      "could not write header of checkpoint file %s",filename);
+
+    fflush(pch->file);
+  }
+
+  pch->lock = new std::mutex;
+
+  return _SUCCESS_;
+}
+
+/**
+ * Read the next record of a checkpoint file. When there is no
+ * complete record left (end of file, or last record truncated by an
+ * interrupted run), the file is positioned for appending new records
+ * after the last complete one.
+ *
+ * @param pch           Input: checkpoint structure
+ * @param ints          Output: integers of the record
+ * @param doubles       Output: doubles of the record
+ * @param has_record    Output: _TRUE_ if a complete record was read
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int checkpoint_read(
+                    struct checkpoint * pch,
+                    int * ints,
+                    double * doubles,
+                    int * has_record,
+                    ErrorMsg error_message
+                    ) {
+
+  long position;
+
+  position = ftell(pch->file);
+
+  if ((fread(ints,sizeof(int),pch->record_ints,pch->file) == (size_t)pch->record_ints) &&
+      (fread(doubles,sizeof(double),pch->record_doubles,pch->file) == (size_t)pch->record_doubles)) {
+    *has_record = _TRUE_;
+  }
+  else {
+    *has_record = _FALSE_;
+    class_test(fseek(pch->file,position,SEEK_SET) != 0,
+               error_message,
+               "could not rewind checkpoint file to last complete record");
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Append a record to a checkpoint file and flush it to disk. Can be
+ * called from parallel tasks.
+ *
+ * @param pch           Input: checkpoint structure
+ * @param ints          Input: integers of the record
+ * @param doubles       Input: doubles of the record
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int checkpoint_write(
+                     struct checkpoint * pch,
+                     int * ints,
+                     double * doubles,
+                     ErrorMsg error_message
+                     ) {
+
+  std::lock_guard<std::mutex> guard(*(std::mutex *)pch->lock);
+
+  class_test((fwrite(ints,sizeof(int),pch->record_ints,pch->file) != (size_t)pch->record_ints) ||
+             (fwrite(doubles,sizeof(double),pch->record_doubles,pch->file) != (size_t)pch->record_doubles) ||
+             (fflush(pch->file) != 0),
+             error_message,
+             "could not write record to checkpoint file");
+
+  return _SUCCESS_;
+}
+
+/**
+ * Close a checkpoint file.
+ *
+ * @param pch           Input: checkpoint structure
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int checkpoint_close(
+                     struct checkpoint * pch,
+                     ErrorMsg error_message
+                     ) {
+
+  fclose(pch->file);
+  delete (std::mutex *)pch->lock;
+
+  return _SUCCESS_;
+}
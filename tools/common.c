@@ -1,4 +1,5 @@
 #include "common.h"
+#include <time.h>
 
 void class_protect_sprintf(char* dest, char* tpl,...) {
   va_list args;
@@ -114,3 +115,292 @@ int class_version(
   sprintf(version,"%s",_VERSION_);
   return _SUCCESS_;
 }
+
+/**
+ * Get the rank of the current process and the number of processes
+ * among which loops over wavenumbers and multipoles are distributed.
+ *
+ * Without MPI, or when MPI has not been initialised (e.g. when CLASS
+ * is called from the python wrapper), there is a single process of
+ * rank 0.
+ *
+ * @param rank  Output: rank of the current process
+ * @param size  Output: number of processes
+ * @return the error status
+ */
+
+int class_mpi_rank_and_size(
+                            int * rank,
+                            int * size
+                            ) {
+
+  *rank = 0;
+  *size = 1;
+
+#ifdef WITH_MPI
+  int initialized;
+
+  MPI_Initialized(&initialized);
+  if (initialized) {
+    MPI_Comm_rank(MPI_COMM_WORLD,rank);
+    MPI_Comm_size(MPI_COMM_WORLD,size);
+  }
+#endif
+
+  return _SUCCESS_;
+}
+
+/**
+ * Sum several arrays element by element over all processes, and
+ * broadcast the results to all of them. Each process is expected to
+ * have filled its own share of the arrays and set the rest to zero,
+ * so that the result is exactly the one of a single-process run.
+ *
+ * The arrays are packed in a single buffer, such that there is one
+ * reduction for all of them (or a few, for very large arrays).
+ *
+ * Without MPI, or with a single process, this function does nothing.
+ *
+ * @param arrays           Input/Output: arrays to be summed in place
+ * @param sizes            Input: number of elements in each array
+ * @param number_of_arrays Input: number of arrays
+ * @param error_message    Output: error message
+ * @return the error status
+ */
+
+int class_mpi_sum(
+                  double ** arrays,
+                  size_t * sizes,
+                  int number_of_arrays,
+                  ErrorMsg error_message
+                  ) {
+
+#ifdef WITH_MPI
+  int rank,nproc,index_array,index_start;
+  size_t total_size,buffer_size,filled,offset,offset_start,n;
+  double * buffer;
+
+  class_call(class_mpi_rank_and_size(&rank,&nproc),
+             error_message,
+             error_message);
+
+  if (nproc == 1)
+    return _SUCCESS_;
+
+  total_size = 0;
+  for (index_array=0; index_array<number_of_arrays; index_array++)
+    total_size += sizes[index_array];
+
+  if (total_size == 0)
+    return _SUCCESS_;
+
+  /* the buffer is limited to 2^24 doubles (128 MB), and MPI counts are int */
+  buffer_size = MIN(total_size,(size_t)1<<24);
+  class_alloc(buffer,buffer_size*sizeof(double),error_message);
+
+  index_array = 0;
+  offset = 0;
+
+  while (index_array < number_of_arrays) {
+
+    /** - pack the next values of the arrays in the buffer */
+    index_start = index_array;
+    offset_start = offset;
+    filled = 0;
+    while ((index_array < number_of_arrays) && (filled < buffer_size)) {
+      n = MIN(sizes[index_array]-offset,buffer_size-filled);
+      memcpy(buffer+filled,arrays[index_array]+offset,n*sizeof(double));
+      filled += n;
+      offset += n;
+      if (offset == sizes[index_array]) {
+        index_array++;
+        offset = 0;
+      }
+    }
+
+    class_test_except(MPI_Allreduce(MPI_IN_PLACE,buffer,(int)filled,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD) != MPI_SUCCESS,
+                      error_message,
+                      free(buffer),
+                      "MPI_Allreduce failed on %zu values",filled);
+
+    /** - unpack the sums in the same order */
+    index_array = index_start;
+    offset = offset_start;
+    filled = 0;
+    while ((index_array < number_of_arrays) && (filled < buffer_size)) {
+      n = MIN(sizes[index_array]-offset,buffer_size-filled);
+      memcpy(arrays[index_array]+offset,buffer+filled,n*sizeof(double));
+      filled += n;
+      offset += n;
+      if (offset == sizes[index_array]) {
+        index_array++;
+        offset = 0;
+      }
+    }
+  }
+
+  free(buffer);
+#endif
+
+  return _SUCCESS_;
+}
+
+/**
+ * Make all processes fail together if any of them failed. A process
+ * failing in a loop distributed over processes must call this
+ * function, like the others, before the next collective operation
+ * (e.g. class_mpi_sum()): otherwise the others would wait for it
+ * forever.
+ *
+ * Without MPI, or with a single process, this function just returns
+ * the status of the current process.
+ *
+ * @param status        Input: status of the current process
+ * @param error_message Input/Output: error message, set if another process failed
+ * @return _FAILURE_ if any process failed, _SUCCESS_ otherwise
+ */
+
+int class_mpi_check_status(
+                           int status,
+                           ErrorMsg error_message
+                           ) {
+
+#ifdef WITH_MPI
+  int rank,nproc,failed,any_failed;
+
+  class_call(class_mpi_rank_and_size(&rank,&nproc),
+             error_message,
+             error_message);
+
+  if (nproc == 1)
+    return status;
+
+  failed = (status == _FAILURE_) ? 1 : 0;
+  class_test(MPI_Allreduce(&failed,&any_failed,1,MPI_INT,MPI_MAX,MPI_COMM_WORLD) != MPI_SUCCESS,
+             error_message,
+             "MPI_Allreduce failed on the status of process %d",rank);
+
+  if ((any_failed == 1) && (failed == 0)) {
+    class_sprintf(error_message,"stopped because another MPI process failed");
+  }
+
+  return (any_failed == 1) ? _FAILURE_ : _SUCCESS_;
+#else
+  return status;
+#endif
+}
+
+/**
+ * Wall-clock time in seconds, from an arbitrary origin which is fixed
+ * for the whole process (only differences of this time are meaningful).
+ *
+ * @return the time
+ */
+
+double class_wall_time(void) {
+
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC,&now);
+
+  return (double)now.tv_sec + 1.e-9*(double)now.tv_nsec;
+}
+
+/**
+ * Tell whether a run was stopped by class_check_deadline(), because
+ * it went past its deadline or was cancelled (see the fields deadline
+ * and cancel of the precision structure).
+ *
+ * After a failed run, this distinguishes an aborted run from a real
+ * error, even if the latter happened after the deadline.
+ *
+ * @param ppr  Input: pointer to precision structure (can be NULL)
+ * @return _TRUE_ if the run was aborted, _FALSE_ otherwise
+ */
+
+int class_run_aborted(
+                      struct precision * ppr
+                      ) {
+
+  if (ppr == NULL)
+    return _FALSE_;
+
+  return ppr->aborted;
+}
+
+/**
+ * Cooperative check of the deadline and cancellation flag of a run,
+ * to be called regularly in the long loops of the code (integration
+ * steps, loops over wavenumbers, shooting iterations). It costs one
+ * reading of the clock, and nothing when the run has neither a
+ * deadline nor a cancellation flag.
+ *
+ * @param ppr            Input: pointer to precision structure (can be NULL)
+ * @param error_message  Output: error message
+ * @return _FAILURE_ if the run should stop, _SUCCESS_ otherwise
+ */
+
+int class_check_deadline(
+                         struct precision * ppr,
+                         ErrorMsg error_message
+                         ) {
+
+  struct precision * pr_run;
+  short is_cancelled,is_late;
+
+  if (ppr == NULL)
+    return _SUCCESS_;
+
+  is_cancelled = ((ppr->cancel != NULL) && (*(ppr->cancel) != 0));
+  is_late = ((ppr->deadline > 0.) && (class_wall_time() > ppr->deadline));
+
+  /* mark this run, and the run it is a preliminary run of, as aborted */
+  if (is_cancelled || is_late) {
+    for (pr_run = ppr; pr_run != NULL; pr_run = pr_run->main_run)
+      pr_run->aborted = _TRUE_;
+  }
+
+  class_test(is_cancelled,
+             error_message,
+             "run aborted: cancelled by the caller");
+
+  class_test(is_late,
+             error_message,
+             "run aborted: maximum run time exceeded");
+
+  return _SUCCESS_;
+}
+
+/**
+ * Number of threads of the parallel loops (see parallel.h) started by
+ * the calling thread, such that several CLASS instances running in
+ * different threads of one process can share the cores. It is a
+ * property of the calling thread only; the threads of a parallel loop
+ * have it set to one, such that nested loops run serially.
+ */
+
+static __thread int class_num_threads = 0;
+
+/**
+ * Set the number of threads of the parallel loops started by the
+ * calling thread.
+ *
+ * @param number_of_threads  Input: number of threads, or 0 for the default (OMP_NUM_THREADS, SLURM_CPUS_PER_TASK or the number of cores)
+ */
+
+void class_set_num_threads(
+                           int number_of_threads
+                           ) {
+  class_num_threads = MAX(number_of_threads,0);
+}
+
+/**
+ * Get the number of threads of the parallel loops started by the
+ * calling thread.
+ *
+ * @return the number of threads, or 0 for the default
+ */
+
+int class_get_num_threads(void) {
+  return class_num_threads;
+}
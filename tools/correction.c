@@ -0,0 +1,401 @@
+/**
+ * Module with tools for multi-fidelity correction files
+ *
+ * A correction file contains the spectra of a fiducial model computed
+ * with reference and with fast precision, in one slot per module and
+ * per precision. Each slot starts with the input parameters of the
+ * run which wrote it, followed by data packed by the module.
+ */
+
+#include "correction.h"
+#include <unistd.h>
+
+/**
+ * Read the reference and fast slots of one module in a correction
+ * file. A missing file or slot is returned as a NULL pointer.
+ *
+ * @param filename      Input: name of the correction file
+ * @param module        Input: module owning the slots
+ * @param slot          Output: allocated content of each slot (reference, fast)
+ * @param slot_size     Output: size in bytes of each slot
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int correction_fetch(
+                     char * filename,
+                     enum correction_module module,
+                     char ** slot,
+                     size_t * slot_size,
+                     ErrorMsg error_message
+                     ) {
+
+  FILE * file;
+  char magic[sizeof(_CORRECTION_MAGIC_)];
+  int index_slot;
+  size_t size;
+
+  slot[0] = NULL;
+  slot[1] = NULL;
+  slot_size[0] = 0;
+  slot_size[1] = 0;
+
+  file = fopen(filename,"rb");
+  if (file == NULL)
+    return _SUCCESS_;
+
+  class_test_except((fread(magic,sizeof(char),sizeof(magic),file) != sizeof(magic)) ||
+                    (strncmp(magic,_CORRECTION_MAGIC_,sizeof(magic)) != 0),
+                    error_message,
+                    fclose(file),
+                    "%s is not a correction file",filename);
+
+  for (index_slot=0; index_slot<2*correction_modules; index_slot++) {
+
+    class_test_except(fread(&size,sizeof(size_t),1,file) != 1,
+                      error_message,
+                      fclose(file);free(slot[0]);free(slot[1]),
+                      "could not read correction file %s",filename);
+
+    /* slots of other modules are skipped */
+    if (index_slot/2 != module) {
+      class_test_except(fseek(file,size,SEEK_CUR) != 0,
+                        error_message,
+                        fclose(file);free(slot[0]);free(slot[1]),
+                        "could not read correction file %s",filename);
+      continue;
+    }
+
+    if (size > 0) {
+      class_alloc(slot[index_slot%2],size,error_message);
+      class_test_except(fread(slot[index_slot%2],1,size,file) != size,
+                        error_message,
+                        fclose(file);free(slot[0]);free(slot[1]),
+                        "could not read correction file %s",filename);
+    }
+    slot_size[index_slot%2] = size;
+  }
+
+  fclose(file);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Replace the reference or fast slot of one module in a correction
+ * file, keeping the other slots. The file is written under a
+ * temporary name and then renamed, so that other runs reading it at
+ * the same time never see it incomplete.
+ *
+ * @param filename      Input: name of the correction file
+ * @param module        Input: module owning the slot
+ * @param mode          Input: correction_reference or correction_fast
+ * @param slot          Input: new content of the slot
+ * @param slot_size     Input: size in bytes of the slot
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int correction_store(
+                     char * filename,
+                     enum correction_module module,
+                     enum correction_mode mode,
+                     char * slot,
+                     size_t slot_size,
+                     ErrorMsg error_message
+                     ) {
+
+  char * all_slots[2*correction_modules];
+  size_t all_sizes[2*correction_modules];
+  FILE * file;
+  char temporary_file[_FILENAMESIZE_+32];
+  int index_module,index_slot;
+  size_t size;
+  short has_failed = _FALSE_;
+
+  class_test((mode != correction_reference) && (mode != correction_fast),
+             error_message,
+             "only the reference or fast spectra can be stored in a correction file");
+
+  /** - read the slots of all modules */
+  for (index_module=0; index_module<correction_modules; index_module++) {
+    class_call_except(correction_fetch(filename,
+                                       (enum correction_module)index_module,
+                                       all_slots+2*index_module,
+                                       all_sizes+2*index_module,
+                                       error_message),
+                      error_message,
+                      error_message,
+                      for (index_slot=0; index_slot<2*index_module; index_slot++) free(all_slots[index_slot]));
+  }
+
+  /** - replace the relevant one */
+  index_slot = 2*module + ((mode == correction_reference) ? 0 : 1);
+  free(all_slots[index_slot]);
+  all_slots[index_slot] = slot;
+  all_sizes[index_slot] = slot_size;
+
+  /** - write all slots */
+  class_sprintf(temporary_file,"%s.%d.tmp",filename,(int)getpid());
+
+  file = fopen(temporary_file,"wb");
+
+  if ((file == NULL) ||
+      (fwrite(_CORRECTION_MAGIC_,sizeof(char),sizeof(_CORRECTION_MAGIC_),file) != sizeof(_CORRECTION_MAGIC_)))
+    has_failed = _TRUE_;
+
+  for (index_slot=0; index_slot<2*correction_modules; index_slot++) {
+    size = (all_slots[index_slot] == NULL) ? 0 : all_sizes[index_slot];
+    if ((has_failed == _FALSE_) &&
+        ((fwrite(&size,sizeof(size_t),1,file) != 1) ||
+         (fwrite(all_slots[index_slot],1,size,file) != size)))
+      has_failed = _TRUE_;
+  }
+
+  /* the slot of the caller is not freed here */
+  for (index_slot=0; index_slot<2*correction_modules; index_slot++) {
+    if (all_slots[index_slot] != slot)
+      free(all_slots[index_slot]);
+  }
+
+  if ((file != NULL) && (fclose(file) != 0))
+    has_failed = _TRUE_;
+
+  class_test(has_failed == _TRUE_,
+             error_message,
+             "could not write correction file %s",temporary_file);
+
+  class_test(rename(temporary_file,filename) != 0,
+             error_message,
+             "could not rename %s into correction file %s",temporary_file,filename);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Write the input parameters at the beginning of a slot, as their
+ * number of characters followed by the characters. The slot must
+ * have sizeof(int)+strlen(parameters) bytes available.
+ *
+ * @param parameters Input: input parameters, as 'name=value' lines
+ * @param position   Input/Output: position in the slot, moved after the parameters
+ * @return the error status
+ */
+
+int correction_pack_parameters(
+                               char * parameters,
+                               char ** position
+                               ) {
+
+  int parameters_size = strlen(parameters);
+
+  class_correction_pack(*position,&parameters_size,sizeof(int));
+  class_correction_pack(*position,parameters,parameters_size);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Read the input parameters at the beginning of a slot.
+ *
+ * @param position        Input/Output: position in the slot, moved after the parameters
+ * @param end             Input: end of the slot
+ * @param parameters      Output: pointer to the parameters in the slot (not null-terminated)
+ * @param parameters_size Output: number of characters of the parameters
+ * @param filename        Input: name of the correction file, for error messages
+ * @param error_message   Output: error message
+ * @return the error status
+ */
+
+int correction_unpack_parameters(
+                                 char ** position,
+                                 char * end,
+                                 char ** parameters,
+                                 int * parameters_size,
+                                 char * filename,
+                                 ErrorMsg error_message
+                                 ) {
+
+  int * pint;
+
+  class_correction_unpack(*position,end,pint,int,1,filename,error_message);
+  *parameters_size = *pint;
+  class_correction_unpack(*position,end,*parameters,char,*parameters_size,filename,error_message);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Check whether the slots of a module can correct the spectra of the
+ * current run: both slots must be present, and the input parameters
+ * of the current run must not differ from those of the fiducial fast
+ * run by more than max_drift (if positive).
+ *
+ * @param slot          Input: content of each slot (reference, fast), possibly NULL
+ * @param slot_size     Input: size in bytes of each slot
+ * @param parameters    Input: input parameters of the current run
+ * @param max_drift     Input: largest relative difference allowed (none if zero)
+ * @param filename      Input: name of the correction file, for error messages
+ * @param drift         Output: largest relative difference (_HUGE_ for missing slots)
+ * @param is_usable     Output: can the correction be applied?
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int correction_check(
+                     char ** slot,
+                     size_t * slot_size,
+                     char * parameters,
+                     double max_drift,
+                     char * filename,
+                     double * drift,
+                     short * is_usable,
+                     ErrorMsg error_message
+                     ) {
+
+  char * position;
+  char * fiducial;
+  int fiducial_size;
+
+  *drift = _HUGE_;
+  *is_usable = _FALSE_;
+
+  if ((slot[0] == NULL) || (slot[1] == NULL))
+    return _SUCCESS_;
+
+  position = slot[1];
+  class_call(correction_unpack_parameters(&position,
+                                          slot[1]+slot_size[1],
+                                          &fiducial,
+                                          &fiducial_size,
+                                          filename,
+                                          error_message),
+             error_message,
+             error_message);
+
+  class_call(correction_drift(parameters,
+                              strlen(parameters),
+                              fiducial,
+                              fiducial_size,
+                              drift),
+             error_message,
+             error_message);
+
+  if ((max_drift <= 0.) || (*drift <= max_drift))
+    *is_usable = _TRUE_;
+
+  return _SUCCESS_;
+}
+
+/**
+ * Largest relative difference between two lists of input parameters
+ * given as 'name=value' lines. Parameters present in only one list,
+ * or with non-numerical values which differ, give a drift of _HUGE_.
+ *
+ * @param text1      Input: first list (current run)
+ * @param size1      Input: number of characters of first list
+ * @param text2      Input: second list (fiducial run)
+ * @param size2      Input: number of characters of second list
+ * @param drift      Output: largest relative difference
+ * @return the error status
+ */
+
+int correction_drift(
+                     char * text1,
+                     int size1,
+                     char * text2,
+                     int size2,
+                     double * drift
+                     ) {
+
+  char * list[2] = {text1,text2};
+  int size[2] = {size1,size2};
+  char * line1, * line2, * end1, * end2;
+  char * eq1, * eq2;
+  char * num_end1, * num_end2;
+  double value1,value2;
+  int index_list,found;
+
+  *drift = 0.;
+
+  /* compare each parameter of each list with the other list */
+  for (index_list=0; index_list<2; index_list++) {
+    for (line1 = list[index_list]; line1 < list[index_list]+size[index_list]; line1 = end1+1) {
+      end1 = (char *)memchr(line1,'\n',list[index_list]+size[index_list]-line1);
+      if (end1 == NULL)
+        end1 = list[index_list]+size[index_list];
+      eq1 = (char *)memchr(line1,'=',end1-line1);
+      if (eq1 == NULL)
+        continue;
+
+      found = _FALSE_;
+      for (line2 = list[1-index_list]; line2 < list[1-index_list]+size[1-index_list]; line2 = end2+1) {
+        end2 = (char *)memchr(line2,'\n',list[1-index_list]+size[1-index_list]-line2);
+        if (end2 == NULL)
+          end2 = list[1-index_list]+size[1-index_list];
+        eq2 = (char *)memchr(line2,'=',end2-line2);
+        if ((eq2 == NULL) || (eq2-line2 != eq1-line1) || (strncmp(line1,line2,eq1-line1) != 0))
+          continue;
+
+        found = _TRUE_;
+        value1 = strtod(eq1+1,&num_end1);
+        value2 = strtod(eq2+1,&num_end2);
+        if ((num_end1 == end1) && (num_end2 == end2) && (num_end1 > eq1+1) && (num_end2 > eq2+1)) {
+          if (value2 != 0.)
+            *drift = MAX(*drift,fabs(value1/value2-1.));
+          else
+            *drift = MAX(*drift,fabs(value1));
+        }
+        else if ((end1-eq1 != end2-eq2) || (strncmp(eq1,eq2,end1-eq1) != 0)) {
+          *drift = _HUGE_;
+        }
+        break;
+      }
+
+      if (found == _FALSE_)
+        *drift = _HUGE_;
+    }
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Linear interpolation of a tabulated function y(x) (x increasing),
+ * set to zero outside of the table.
+ *
+ * @param x      Input: table of x values
+ * @param y      Input: table of y values
+ * @param size   Input: size of the tables
+ * @param x0     Input: value of x
+ * @param y0     Output: interpolated value
+ * @return the error status
+ */
+
+int correction_interpolate(
+                           double * x,
+                           double * y,
+                           int size,
+                           double x0,
+                           double * y0
+                           ) {
+
+  int inf=0,sup=size-1,mid;
+
+  if ((x0 < x[0]) || (x0 > x[size-1])) {
+    *y0 = 0.;
+    return _SUCCESS_;
+  }
+
+  while (sup-inf > 1) {
+    mid = (inf+sup)/2;
+    if (x0 < x[mid])
+      sup = mid;
+    else
+      inf = mid;
+  }
+
+  *y0 = y[inf] + (y[sup]-y[inf])*(x0-x[inf])/(x[sup]-x[inf]);
+
+  return _SUCCESS_;
+}
@@ -58,6 +58,7 @@
 #include "evolver_ndf15.h"
 //#include "perturbations.h"
 #include "sparse.h"
+#include "parallel.h"
 
 int evolver_ndf15(
           int (*derivs)(double x,double * y,double * dy,
@@ -81,6 +82,7 @@ int evolver_ndf15(
                 ErrorMsg error_message),
           int (*print_variables)(double x, double y[], double dy[], void *parameters_and_workspace,
                      ErrorMsg error_message),
+          struct precision * ppr,
           ErrorMsg error_message){
 
   /* Constants: */
@@ -302,6 +304,10 @@ int evolver_ndf15(
   done = _FALSE_;
   at_hmin = _FALSE_;
   while (done==_FALSE_){
+    /* stop here if the run is over its deadline or was cancelled */
+    class_call_except(class_check_deadline(ppr,error_message),
+                      error_message,error_message,
+                      free(buffer);uninitialize_jacobian(&jac);uninitialize_numjac_workspace(&nj_ws));
     /**class_test(stepstat[2] > 1e5, error_message,
            "Too many steps in evolver! Current stepsize:%g, in interval: [%g:%g]\n",
            absh,t0,tfinal);*/
@@ -1083,13 +1089,17 @@ int fzero_Newton(int (*func)(double *x,
   /**Given an initial guess x[1..n] for a root in n dimensions,
      take ntrial Newton-Raphson steps to improve the root.
      Stop if the root converges in either summed absolute
-     variable increments tolx or summed absolute function values tolf.*/
-  int k,i,j,*indx, ntrial=20;
-  double errx,errf,d,*F0,*Fdel,**Fjac,*p, *lu_work;
+     variable increments tolx or summed absolute function values tolf.
+     The columns of the jacobian are evaluated in parallel, so func must
+     be reentrant with respect to param.*/
+  int k,i,*indx, ntrial=20;
+  double errx,errf,d,*F0,*Fdel,*xdel,**Fjac,*p, *lu_work;
+  ErrorMsg *column_error_message;
   int has_converged = _FALSE_;
   int funcreturn;
   double toljac = 1e-3;
   double *delx;
+  int nested_threads;
 
   /** All arrays are indexed as [0, n-1] with the exception of p, indx,
       lu_work and Fjac, since they are passed to ludcmp and lubksb. */
@@ -1105,7 +1115,11 @@ int fzero_Newton(int (*func)(double *x,
 
   class_alloc(F0, sizeof(double)*x_size, error_message);
   class_alloc(delx, sizeof(double)*x_size, error_message);
-  class_alloc(Fdel, sizeof(double)*x_size, error_message);
+  /* one copy of x and of F(x) per column of the jacobian, such that
+     all columns can be evaluated simultaneously */
+  class_alloc(xdel, sizeof(double)*x_size*x_size, error_message);
+  class_alloc(Fdel, sizeof(double)*x_size*x_size, error_message);
+  class_alloc(column_error_message, sizeof(ErrorMsg)*x_size, error_message);
 
   for (i=1; i<=x_size; i++){
     delx[i-1] = toljac*dxdF[i-1];
@@ -1135,21 +1149,54 @@ int fzero_Newton(int (*func)(double *x,
     }
     */
 
-    /** Compute the jacobian of F: */
+    /** Compute the jacobian of F (parallelized over columns, each
+        evaluation of func only sees its own displaced copy of x): */
     for (i=1; i<=x_size; i++){
       if (F0[i-1]<0.0)
         delx[i-1] *= -1;
-      x_inout[i-1] += delx[i-1];
-
-      /**      printf("x = [%f, %f], delx = [%e, %e]\n",
-               x_inout[0],x_inout[1],delx[0],delx[1]);*/
-      class_call(func(x_inout, x_size, param, Fdel, error_message),
-                 error_message, error_message);
-      /**      printf("F = [%f, %f]\n",Fdel[0],Fdel[1]);*/
-      for (j=1; j<=x_size; j++)
-        Fjac[j][i] = (Fdel[j-1]-F0[j-1])/delx[i-1];
-      x_inout[i-1] -= delx[i-1];
     }
+
+    /* the threads are shared among the columns: each column runs its own
+       parallel loops (e.g. over wavenumbers for sigma8) with its share */
+    nested_threads = MAX(1,(int)Tools::TaskSystem::GetNumThreads()/x_size);
+
+    class_setup_parallel();
+
+    for (i=1; i<=x_size; i++){
+      class_run_parallel(with_arguments(func,x_inout,xdel,delx,x_size,param,F0,Fdel,Fjac,column_error_message,i,nested_threads),
+
+        int j;
+        class_set_num_threads(nested_threads);
+        double * x_i = xdel + (i-1)*x_size;
+        double * F_i = Fdel + (i-1)*x_size;
+
+        for (j=0; j<x_size; j++)
+          x_i[j] = x_inout[j];
+        x_i[i-1] += delx[i-1];
+
+        class_call(func(x_i, x_size, param, F_i, column_error_message[i-1]),
+                   column_error_message[i-1], column_error_message[i-1]);
+
+        for (j=1; j<=x_size; j++)
+          Fjac[j][i] = (F_i[j-1]-F0[j-1])/delx[i-1];
+
+        return _SUCCESS_;
+      );
+    }
+
+    /* wait for all columns, each with its own error message, and
+       report the error of the first failing one */
+    funcreturn = _SUCCESS_;
+    for (i=1; i<=x_size; i++){
+      if ((future_output[i-1].get() != _SUCCESS_) && (funcreturn == _SUCCESS_)){
+        strcpy(error_message, column_error_message[i-1]);
+        funcreturn = _FAILURE_;
+      }
+    }
+    future_output.clear();
+    if (funcreturn == _FAILURE_)
+      return _FAILURE_;
+
     *fevals = *fevals + x_size;
 
     for (i=1; i<=x_size; i++)
@@ -1178,7 +1225,9 @@ int fzero_Newton(int (*func)(double *x,
   free(Fjac);
   free(F0);
   free(delx);
+  free(xdel);
   free(Fdel);
+  free(column_error_message);
 
   if (has_converged == _TRUE_){
     return _SUCCESS_;
@@ -31,6 +31,7 @@ int evolver_rk(int (*derivs)(double x,
 					   double dy[],
 					   void * parameters_and_workspace,
 					   ErrorMsg error_message),
+		    struct precision * ppr,
 		    ErrorMsg error_message) {
 
   int next_index_x;
@@ -59,6 +60,12 @@ int evolver_rk(int (*derivs)(double x,
 
   while ((x1 < x_end) && (next_index_x<x_size)) {
 
+    /* stop here if the run is over its deadline or was cancelled */
+    class_call_except(class_check_deadline(ppr,error_message),
+		      error_message,
+		      error_message,
+		      cleanup_generic_integrator(&gi);free(dy));
+
     class_call((*evaluate_timescale)(x1,
 				     parameters_and_workspace_for_derivs,
 				     &timescale,
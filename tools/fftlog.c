@@ -0,0 +1,307 @@
+/**
+ * Module with tools for FFTLog transforms
+ *
+ * Fourier transform of functions sampled on a logarithmic grid,
+ * following Hamilton 2000 (astro-ph/9905191) and the generalisation
+ * to spherical Bessel kernels of Fang et al. 2020 (arXiv:1911.11947).
+ */
+
+#include "fftlog.h"
+
+/**
+ * In-place forward discrete Fourier transform
+ * \f$ a_m = \sum_n a_n e^{-2 i \pi m n / N} \f$ with a radix-2
+ * Cooley-Tukey algorithm.
+ *
+ * @param re            Input/Output: real part of the array
+ * @param im            Input/Output: imaginary part of the array
+ * @param N             Input: size of the array (must be a power of two)
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int fftlog_fft(
+               double * re,
+               double * im,
+               int N,
+               ErrorMsg error_message
+               ) {
+
+  int i,j,m,len,half;
+  double tmp,wr,wi,wlen_r,wlen_i,ur,ui,vr,vi,angle;
+
+  class_test((N < 1) || ((N & (N-1)) != 0),
+             error_message,
+             "the size of the array (%d) should be a power of two",N);
+
+  /** - bit-reversal permutation */
+  for (i=1, j=0; i<N; i++) {
+    m = N >> 1;
+    for (; j & m; m >>= 1)
+      j ^= m;
+    j ^= m;
+    if (i < j) {
+      tmp = re[i]; re[i] = re[j]; re[j] = tmp;
+      tmp = im[i]; im[i] = im[j]; im[j] = tmp;
+    }
+  }
+
+  /** - butterflies */
+  for (len=2; len<=N; len <<= 1) {
+    half = len >> 1;
+    angle = -2.*_PI_/len;
+    wlen_r = cos(angle);
+    wlen_i = sin(angle);
+    for (i=0; i<N; i+=len) {
+      wr = 1.;
+      wi = 0.;
+      for (j=0; j<half; j++) {
+        ur = re[i+j];
+        ui = im[i+j];
+        vr = re[i+j+half]*wr - im[i+j+half]*wi;
+        vi = re[i+j+half]*wi + im[i+j+half]*wr;
+        re[i+j] = ur+vr;
+        im[i+j] = ui+vi;
+        re[i+j+half] = ur-vr;
+        im[i+j+half] = ui-vi;
+        tmp = wr*wlen_r - wi*wlen_i;
+        wi = wr*wlen_i + wi*wlen_r;
+        wr = tmp;
+      }
+    }
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Logarithm of the Gamma function for a complex argument z = re + i im,
+ * using the Lanczos approximation (g=7, n=9) for Re(z) >= 1/2 and the
+ * reflection formula \f$ \Gamma(z)\Gamma(1-z) = \pi/\sin(\pi z) \f$
+ * otherwise. The imaginary part is defined up to a multiple of 2 pi.
+ *
+ * @param re            Input: real part of z
+ * @param im            Input: imaginary part of z
+ * @param lngamma_re    Output: real part of ln Gamma(z)
+ * @param lngamma_im    Output: imaginary part of ln Gamma(z)
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int fftlog_lngamma(
+                   double re,
+                   double im,
+                   double * lngamma_re,
+                   double * lngamma_im,
+                   ErrorMsg error_message
+                   ) {
+
+  static const double p[9] = {0.99999999999980993,
+                              676.5203681218851,
+                              -1259.1392167224028,
+                              771.32342877765313,
+                              -176.61502916214059,
+                              12.507343278686905,
+                              -0.13857109526572012,
+                              9.9843695780195716e-6,
+                              1.5056327351493116e-7};
+  double sum_re,sum_im,den,t_re,t_im,log_t_re,log_t_im;
+  double sin_re,sin_im,exp_m2y,log_sin_re,log_sin_im;
+  int k;
+
+  /** - for Re(z) < 1/2, use ln Gamma(z) = ln pi - ln sin(pi z) - ln Gamma(1-z) */
+  if (re < 0.5) {
+
+    class_call(fftlog_lngamma(1.-re,-im,lngamma_re,lngamma_im,error_message),
+               error_message,
+               error_message);
+
+    /* sin(pi z) divided by cosh(pi im), to avoid overflows for large im */
+    sin_re = sin(_PI_*re);
+    sin_im = cos(_PI_*re)*tanh(_PI_*im);
+
+    class_test((sin_re == 0.) && (sin_im == 0.),
+               error_message,
+               "Gamma function has a pole at z=%e",re);
+
+    /* ln|sin(pi z)| = pi|im| + ln(|sin(pi z)| e^(-pi|im|)), with cosh(pi im) e^(-pi|im|) = (1+e^(-2 pi|im|))/2 */
+    exp_m2y = exp(-2.*_PI_*fabs(im));
+    log_sin_re = _PI_*fabs(im) + log(0.5*(1.+exp_m2y)) + 0.5*log(sin_re*sin_re+sin_im*sin_im);
+    log_sin_im = atan2(sin_im,sin_re);
+
+    *lngamma_re = log(_PI_) - log_sin_re - *lngamma_re;
+    *lngamma_im = -log_sin_im - *lngamma_im;
+
+    return _SUCCESS_;
+  }
+
+  /* Gamma(z) = sqrt(2 pi) t^(z-1/2) e^(-t) A(z) with t = z+g-1/2 and A(z) = p0 + sum_k p_k/(z-1+k) */
+  re -= 1.;
+
+  sum_re = p[0];
+  sum_im = 0.;
+  for (k=1; k<9; k++) {
+    den = (re+k)*(re+k)+im*im;
+    sum_re += p[k]*(re+k)/den;
+    sum_im -= p[k]*im/den;
+  }
+
+  t_re = re+7.5;
+  t_im = im;
+
+  log_t_re = 0.5*log(t_re*t_re+t_im*t_im);
+  log_t_im = atan2(t_im,t_re);
+
+  *lngamma_re = 0.5*log(2.*_PI_) + (re+0.5)*log_t_re - im*log_t_im - t_re + 0.5*log(sum_re*sum_re+sum_im*sum_im);
+  *lngamma_im = (re+0.5)*log_t_im + im*log_t_re - t_im + atan2(sum_im,sum_re);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Compute \f$ F(y) = \int_0^\infty dx\, f(x)\, j_l^{(n)}(xy) \f$,
+ * where \f$ j_l^{(n)} \f$ is the n-th derivative (n=0 or 2) of the
+ * spherical Bessel function, for a function sampled on a logarithmic
+ * grid.
+ *
+ * The function \f$ f(x) x^{-b} \f$ (with b the bias) is decomposed in
+ * a sum of complex power laws with a FFT. Each power law is then
+ * transformed analytically, and the sum is evaluated on the grid
+ * \f$ y_n = 1/x_{N-1-n} \f$ with a second FFT. The result is exact
+ * for the periodic extension of \f$ f(x) x^{-b} \f$ in \f$ \ln x\f$,
+ * so this function should go to zero at both edges of the grid. The
+ * bias must lie in the range -l-1 < b < 1 for n=0, and 1-l < b < 1
+ * for n=2.
+ *
+ * @param x             Input: logarithmically spaced values of x, in increasing order
+ * @param f             Input: values of f(x)
+ * @param N             Input: size of the arrays (must be a power of two)
+ * @param l             Input: multipole
+ * @param derivative    Input: order of derivative of the Bessel function (0 or 2)
+ * @param bias          Input: power-law bias b
+ * @param y             Output: values of y
+ * @param F             Output: values of F(y)
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int fftlog_spherical_bessel_transform(
+                                      double * x,
+                                      double * f,
+                                      int N,
+                                      double l,
+                                      int derivative,
+                                      double bias,
+                                      double * y,
+                                      double * F,
+                                      ErrorMsg error_message
+                                      ) {
+
+  double * c_re;
+  double * c_im;
+  double dlnx,eta,s_re,s_im,shift;
+  double lng1_re,lng1_im,lng2_re,lng2_im;
+  double kernel_mod,kernel_arg,pre_re,pre_im,tmp;
+  double filter,m_cut,ratio;
+  int n,m;
+
+  class_test((derivative != 0) && (derivative != 2),
+             error_message,
+             "only derivatives of order 0 and 2 are coded");
+
+  class_test((bias >= 1.) || (bias <= -l-1.+2.*(derivative/2)),
+             error_message,
+             "bias %e out of range of convergence for l=%e",bias,l);
+
+  class_alloc(c_re,N*sizeof(double),error_message);
+  class_alloc(c_im,N*sizeof(double),error_message);
+
+  dlnx = log(x[1]/x[0]);
+
+  /** - decompose f(x) x^(-bias) in complex power laws */
+  for (n=0; n<N; n++) {
+    /* x^(-bias) may overflow where f(x) has already vanished */
+    c_re[n] = (f[n] == 0.) ? 0. : f[n]*pow(x[n],-bias)/N;
+    c_im[n] = 0.;
+  }
+
+  class_call_except(fftlog_fft(c_re,c_im,N,error_message),
+                    error_message,
+                    error_message,
+                    free(c_re);free(c_im));
+
+  /** - multiply each coefficient by the Mellin transform of the
+      kernel, \f$ \int_0^\infty dx\, x^{s-1} j_l(x) = 2^{s-2} \sqrt{\pi}
+      \Gamma((l+s)/2) / \Gamma((3+l-s)/2) \f$ with s = 1+bias+i eta, and
+      by the phase coming from the choice of y grid. For the second
+      derivative, integrating twice by parts gives (s-1)(s-2) times
+      the same transform at s-2. Coefficients close to the Nyquist
+      frequency are smoothly filtered out to avoid ringing. */
+
+  m_cut = 0.75*(N/2);
+
+  for (m=0; m<=N/2; m++) {
+
+    eta = 2.*_PI_*m/(N*dlnx);
+    s_re = 1.+bias;
+    s_im = eta;
+
+    shift = (derivative == 2) ? 2. : 0.;
+
+    class_call_except(fftlog_lngamma(0.5*(l+s_re-shift),0.5*s_im,&lng1_re,&lng1_im,error_message),
+                      error_message,
+                      error_message,
+                      free(c_re);free(c_im));
+    class_call_except(fftlog_lngamma(0.5*(3.+l-s_re+shift),-0.5*s_im,&lng2_re,&lng2_im,error_message),
+                      error_message,
+                      error_message,
+                      free(c_re);free(c_im));
+
+    kernel_mod = exp((s_re-shift-2.)*log(2.) + 0.5*log(_PI_) + lng1_re - lng2_re);
+    kernel_arg = s_im*log(2.) + lng1_im - lng2_im + eta*(N-1)*dlnx;
+
+    pre_re = kernel_mod*cos(kernel_arg);
+    pre_im = kernel_mod*sin(kernel_arg);
+
+    if (derivative == 2) {
+      /* multiply by (s-1)(s-2) */
+      tmp = pre_re*((s_re-1.)*(s_re-2.)-s_im*s_im) - pre_im*s_im*(2.*s_re-3.);
+      pre_im = pre_re*s_im*(2.*s_re-3.) + pre_im*((s_re-1.)*(s_re-2.)-s_im*s_im);
+      pre_re = tmp;
+    }
+
+    if (m > m_cut) {
+      ratio = (N/2-m)/(N/2-m_cut);
+      filter = ratio - sin(2.*_PI_*ratio)/(2.*_PI_);
+    }
+    else {
+      filter = 1.;
+    }
+
+    tmp = (c_re[m]*pre_re - c_im[m]*pre_im)*filter;
+    c_im[m] = (c_re[m]*pre_im + c_im[m]*pre_re)*filter;
+    c_re[m] = tmp;
+  }
+
+  /* the transformed function is real: negative frequencies are complex conjugates */
+  for (m=1; m<N/2; m++) {
+    c_re[N-m] = c_re[m];
+    c_im[N-m] = -c_im[m];
+  }
+
+  /** - sum the transformed power laws on the y grid */
+  class_call_except(fftlog_fft(c_re,c_im,N,error_message),
+                    error_message,
+                    error_message,
+                    free(c_re);free(c_im));
+
+  for (n=0; n<N; n++) {
+    y[n] = 1./x[N-1-n];
+    F[n] = (c_re[n] == 0.) ? 0. : c_re[n]*pow(y[n],-1.-bias);
+  }
+
+  free(c_re);
+  free(c_im);
+
+  return _SUCCESS_;
+}
@@ -573,6 +573,7 @@ int compute_Hermite(double *x, double *w, int N, int alpha, double *b, double *c
 
 int compute_Laguerre(double *x, double *w, int N, double alpha, double *b, double *c,int totalweight){
   int i,j,iter,maxiter=10;
+  int sign_gamma;
   double x0=0.,r1,r2,ratio,d,logprod,logcc;
   double p0,p1,p2,dp0,dp1,dp2;
   double eps=1e-14;
@@ -583,7 +584,8 @@ int compute_Laguerre(double *x, double *w, int N, double alpha, double *b, doubl
   }
   logprod = 0.0;
   for(i=1; i<N; i++) logprod +=log(c[i]);
-  logcc = lgamma(alpha+1)+logprod;
+  /* lgamma_r() instead of lgamma(), which writes the sign in a global variable shared by concurrent runs */
+  logcc = lgamma_r(alpha+1,&sign_gamma)+logprod;
 
   /* Loop over roots: */
   for (i=0; i<N; i++){